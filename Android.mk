@@ -10,6 +10,7 @@ GST_PLUGINS_BAD_BUILT_SOURCES := \
 	gst-libs/gst/basecamerabinsrc/Android.mk \
 	gst-libs/gst/codecparsers/Android.mk \
 	gst-libs/gst/insertbin/Android.mk \
+	gst-libs/gst/video/Android.mk \
 	gst-libs/gst/interfaces/Android.mk \
 	gst/h264parse/Android.mk \
 	gst/videoparsers/Android.mk \
@@ -98,6 +99,7 @@ CONFIGURE_TARGETS += gst-plugins-bad-configure
 -include $(GST_PLUGINS_BAD_TOP)/gst-libs/gst/basecamerabinsrc/Android.mk
 -include $(GST_PLUGINS_BAD_TOP)/gst-libs/gst/codecparsers/Android.mk
 -include $(GST_PLUGINS_BAD_TOP)/gst-libs/gst/insertbin/Android.mk
+-include $(GST_PLUGINS_BAD_TOP)/gst-libs/gst/video/Android.mk
 -include $(GST_PLUGINS_BAD_TOP)/gst-libs/gst/interfaces/Android.mk
 -include $(GST_PLUGINS_BAD_TOP)/gst/h264parse/Android.mk
 -include $(GST_PLUGINS_BAD_TOP)/gst/audiobuffer/Android.mk
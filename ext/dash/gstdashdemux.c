@@ -627,9 +627,11 @@ gst_dash_demux_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
   return gst_pad_event_default (pad, parent, event);
 }
 
+/* @old_client is the client of the previous manifest on updates, the
+ * streams are matched by their index */
 static gboolean
 gst_dash_demux_setup_mpdparser_streams (GstDashDemux * demux,
-    GstMpdClient * client)
+    GstMpdClient * client, GstMpdClient * old_client)
 {
   gboolean has_streams = FALSE;
   GList *adapt_sets, *iter;
@@ -638,7 +640,16 @@ gst_dash_demux_setup_mpdparser_streams (GstDashDemux * demux,
   for (iter = adapt_sets; iter; iter = g_list_next (iter)) {
     GstAdaptationSetNode *adapt_set_node = iter->data;
 
-    gst_mpd_client_setup_streaming (client, adapt_set_node);
+    if (old_client) {
+      GstActiveStream *old_stream = NULL;
+      guint idx = gst_mpdparser_get_nb_active_stream (client);
+
+      if (idx < gst_mpdparser_get_nb_active_stream (old_client))
+        old_stream = gst_mpdparser_get_active_stream_by_index (old_client, idx);
+      gst_mpd_client_update_streaming (client, adapt_set_node, old_stream);
+    } else {
+      gst_mpd_client_setup_streaming (client, adapt_set_node);
+    }
     has_streams = TRUE;
   }
 
@@ -682,7 +693,7 @@ gst_dash_demux_setup_all_streams (GstDashDemux * demux)
   /* clean old active stream list, if any */
   gst_active_streams_free (demux->client);
 
-  if (!gst_dash_demux_setup_mpdparser_streams (demux, demux->client)) {
+  if (!gst_dash_demux_setup_mpdparser_streams (demux, demux->client, NULL)) {
     return FALSE;
   }
 
@@ -1321,26 +1332,43 @@ gst_dash_demux_refresh_mpd (GstDashDemux * demux)
             }
           }
 
-          if (!gst_dash_demux_setup_mpdparser_streams (demux, new_client)) {
+          if (!gst_dash_demux_setup_mpdparser_streams (demux, new_client,
+                  demux->client)) {
             GST_ERROR_OBJECT (demux, "Failed to setup streams on manifest "
                 "update");
             return GST_FLOW_ERROR;
           }
 
-          /* update the streams to play from the next segment */
           for (iter = demux->streams; iter; iter = g_slist_next (iter)) {
             GstDashDemuxStream *demux_stream = iter->data;
-            GstActiveStream *new_stream = demux_stream->active_stream;
-            GstClockTime ts;
 
-            if (!new_stream) {
+            if ((guint) demux_stream->index >=
+                gst_mpdparser_get_nb_active_stream (new_client)) {
               GST_DEBUG_OBJECT (demux,
                   "Stream of index %d is missing from manifest update",
                   demux_stream->index);
+              gst_mpd_client_free (new_client);
               return GST_FLOW_EOS;
             }
+          }
 
-            if (gst_mpd_client_get_next_fragment_timestamp (demux->client,
+          /* update the streams to play from the next segment */
+          for (iter = demux->streams; iter; iter = g_slist_next (iter)) {
+            GstDashDemuxStream *demux_stream = iter->data;
+            GstActiveStream *new_stream;
+            GstClockTime ts;
+
+            new_stream = gst_mpdparser_get_active_stream_by_index (new_client,
+                demux_stream->index);
+
+            /* segment timelines are updated in place and keep the position,
+             * the other streams look for the next fragment by time */
+            if (gst_mpd_client_merge_stream_segments (new_client, new_stream,
+                    demux_stream->active_stream)) {
+              GST_DEBUG_OBJECT (demux, "Merged segment timeline of stream %d",
+                  demux_stream->index);
+            } else
+                if (gst_mpd_client_get_next_fragment_timestamp (demux->client,
                     demux_stream->index, &ts)) {
               gst_mpd_client_stream_seek (new_client, new_stream, ts);
             } else
@@ -1349,6 +1377,9 @@ gst_dash_demux_refresh_mpd (GstDashDemux * demux)
               /* try to set to the old timestamp + 1 */
               gst_mpd_client_stream_seek (new_client, new_stream, ts + 1);
             }
+
+            /* the old client and its streams are freed below */
+            demux_stream->active_stream = new_stream;
           }
 
           gst_mpd_client_free (demux->client);
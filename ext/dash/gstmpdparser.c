@@ -132,7 +132,26 @@ static gchar *gst_mpdparser_build_URL_from_template (const gchar * url_template,
     const gchar * id, guint number, guint bandwidth, guint64 time);
 static gboolean gst_mpd_client_add_media_segment (GstActiveStream * stream,
     GstSegmentURLNode * url_node, guint number, guint64 start,
-    GstClockTime start_time, GstClockTime duration);
+    GstClockTime start_time, GstClockTime duration, guint64 scale_duration,
+    guint repeat);
+static gboolean gst_mpd_client_extend_last_media_segment (GstActiveStream *
+    stream, guint number, guint64 start, guint64 scale_duration, guint repeat);
+static GstMediaSegment *gst_mpdparser_find_segment_run (GPtrArray * segments,
+    guint index);
+static gint gst_mpdparser_find_segment_at_time (GPtrArray * segments,
+    GstClockTime ts, gboolean nearest);
+static guint gst_mpdparser_get_segments_count (GPtrArray * segments);
+static gboolean gst_mpd_client_add_timeline_segments (GstActiveStream * stream,
+    GstMultSegmentBaseType * mult_seg, GstClockTime PeriodStart, guint64 from);
+static gboolean gst_mpd_client_fix_last_segment_duration (GstActiveStream *
+    stream, GstClockTime PeriodEnd);
+static gboolean gst_mpd_client_can_merge_segments (GstActiveStream * stream,
+    GstActiveStream * old_stream);
+static gboolean gst_mpd_client_setup_representation_full (GstMpdClient *
+    client, GstActiveStream * stream, GstRepresentationNode * representation,
+    GstActiveStream * old_stream);
+static gboolean gst_mpd_client_setup_streaming_full (GstMpdClient * client,
+    GstAdaptationSetNode * adapt_set, GstActiveStream * old_stream);
 static const gchar *gst_mpdparser_mimetype_to_caps (const gchar * mimeType);
 static GstClockTime gst_mpd_client_get_segment_duration (GstMpdClient * client,
     GstActiveStream * stream);
@@ -2899,17 +2918,23 @@ gst_mpdparser_get_chunk_by_index (GstMpdClient * client, guint indexStream,
   g_return_val_if_fail (stream != NULL, FALSE);
 
   if (stream->segments) {
-    GstMediaSegment *list_segment;
-    /* fixed list of segments */
-    if (indexChunk >= stream->segments->len)
+    GstMediaSegment *run;
+    guint k;
+
+    /* fixed list of segment runs */
+    run = gst_mpdparser_find_segment_run (stream->segments, indexChunk);
+    if (run == NULL)
       return FALSE;
 
-    list_segment = g_ptr_array_index (stream->segments, indexChunk);
-    segment->SegmentURL = list_segment->SegmentURL;
-    segment->number = list_segment->number;
-    segment->start = list_segment->start;
-    segment->start_time = list_segment->start_time;
-    segment->duration = list_segment->duration;
+    k = indexChunk - run->index;
+    segment->SegmentURL = run->SegmentURL;
+    segment->number = run->number + k;
+    segment->start = run->start + k * run->scale_duration;
+    segment->start_time = run->start_time + k * run->duration;
+    segment->duration = run->duration;
+    segment->scale_duration = run->scale_duration;
+    segment->repeat = 0;
+    segment->index = indexChunk;
   } else {
     GstClockTime duration;
     GstStreamPeriod *stream_period;
@@ -2928,6 +2953,8 @@ gst_mpdparser_get_chunk_by_index (GstMpdClient * client, guint indexStream,
     segment->start_time = duration * indexChunk;
     segment->duration = duration;
     segment->SegmentURL = NULL;
+    segment->repeat = 0;
+    segment->index = indexChunk;
 
     if (segment->start_time > stream_period->start + stream_period->duration) {
       return FALSE;
@@ -2939,9 +2966,10 @@ gst_mpdparser_get_chunk_by_index (GstMpdClient * client, guint indexStream,
 static gboolean
 gst_mpd_client_add_media_segment (GstActiveStream * stream,
     GstSegmentURLNode * url_node, guint number, guint64 start,
-    GstClockTime start_time, GstClockTime duration)
+    GstClockTime start_time, GstClockTime duration, guint64 scale_duration,
+    guint repeat)
 {
-  GstMediaSegment *media_segment;
+  GstMediaSegment *media_segment, *last;
 
   g_return_val_if_fail (stream->segments != NULL, FALSE);
 
@@ -2956,20 +2984,386 @@ gst_mpd_client_add_media_segment (GstActiveStream * stream,
   media_segment->start = start;
   media_segment->start_time = start_time;
   media_segment->duration = duration;
+  media_segment->scale_duration = scale_duration;
+  media_segment->repeat = repeat;
+
+  /* prefix sum of the segment counts of the previous runs */
+  if (stream->segments->len > 0) {
+    last = g_ptr_array_index (stream->segments, stream->segments->len - 1);
+    media_segment->index = last->index + last->repeat + 1;
+  }
 
   g_ptr_array_add (stream->segments, media_segment);
 
   return TRUE;
 }
 
+/* Extends the last run of the stream with the @repeat + 1 segments starting
+ * at @start if they continue it seamlessly, so that S nodes without @r or
+ * with redundant @t attributes don't end up as separate runs */
+static gboolean
+gst_mpd_client_extend_last_media_segment (GstActiveStream * stream,
+    guint number, guint64 start, guint64 scale_duration, guint repeat)
+{
+  GstMediaSegment *last;
+
+  if (stream->segments->len == 0)
+    return FALSE;
+
+  last = g_ptr_array_index (stream->segments, stream->segments->len - 1);
+  if (last->SegmentURL != NULL || last->scale_duration != scale_duration
+      || last->number + last->repeat + 1 != number
+      || last->start + (last->repeat + 1) * scale_duration != start)
+    return FALSE;
+
+  last->repeat += repeat + 1;
+  return TRUE;
+}
+
+/* Returns the run containing the segment with index @index */
+static GstMediaSegment *
+gst_mpdparser_find_segment_run (GPtrArray * segments, guint index)
+{
+  GstMediaSegment *run;
+  guint lo, hi, mid;
+
+  if (segments->len == 0)
+    return NULL;
+
+  /* look for the last run starting at or before @index */
+  lo = 0;
+  hi = segments->len;
+  while (hi - lo > 1) {
+    mid = lo + (hi - lo) / 2;
+    run = g_ptr_array_index (segments, mid);
+    if (run->index <= index)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  run = g_ptr_array_index (segments, lo);
+  if (index < run->index || index - run->index > run->repeat)
+    return NULL;
+
+  return run;
+}
+
+/* Returns the index of the segment containing @ts, or -1 if there is none.
+ * With @nearest, times before the first segment resolve to the first one
+ * and times in a gap of the timeline or past its end to the last segment
+ * starting before them */
+static gint
+gst_mpdparser_find_segment_at_time (GPtrArray * segments, GstClockTime ts,
+    gboolean nearest)
+{
+  GstMediaSegment *run;
+  guint lo, hi, mid;
+  guint64 k;
+
+  if (segments->len == 0)
+    return -1;
+
+  run = g_ptr_array_index (segments, 0);
+  if (ts < run->start_time)
+    return nearest ? 0 : -1;
+
+  /* look for the last run starting at or before @ts */
+  lo = 0;
+  hi = segments->len;
+  while (hi - lo > 1) {
+    mid = lo + (hi - lo) / 2;
+    run = g_ptr_array_index (segments, mid);
+    if (run->start_time <= ts)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  run = g_ptr_array_index (segments, lo);
+  if (!GST_CLOCK_TIME_IS_VALID (run->duration))
+    return run->index;
+  if (run->duration == 0)
+    return nearest ? run->index : -1;
+
+  k = (ts - run->start_time) / run->duration;
+  if (k > run->repeat) {
+    if (!nearest)
+      return -1;
+    k = run->repeat;
+  }
+
+  return run->index + k;
+}
+
+static guint
+gst_mpdparser_get_segments_count (GPtrArray * segments)
+{
+  GstMediaSegment *last;
+
+  if (segments->len == 0)
+    return 0;
+
+  last = g_ptr_array_index (segments, segments->len - 1);
+  return last->index + last->repeat + 1;
+}
+
+/* Drops the first @k segments of @run */
+static void
+gst_mpdparser_trim_segment_run (GstMediaSegment * run, guint k)
+{
+  run->number += k;
+  run->start += k * run->scale_duration;
+  run->start_time += k * run->duration;
+  run->repeat -= k;
+}
+
+/* Appends the segments of the SegmentTimeline of @mult_seg starting at or
+ * after @from (in timescale units) to the runs of @stream, each S node
+ * being stored as a single run */
+static gboolean
+gst_mpd_client_add_timeline_segments (GstActiveStream * stream,
+    GstMultSegmentBaseType * mult_seg, GstClockTime PeriodStart, guint64 from)
+{
+  GstSNode *S;
+  GList *list;
+  GstClockTime duration, start_time;
+  guint64 start, k;
+  guint i, timescale;
+
+  i = mult_seg->startNumber;
+  start = 0;
+  start_time = PeriodStart;
+  timescale = mult_seg->SegBaseType->timescale;
+
+  for (list = g_queue_peek_head_link (&mult_seg->SegmentTimeline->S); list;
+      list = g_list_next (list)) {
+    S = (GstSNode *) list->data;
+    GST_LOG ("Processing S node: d=%" G_GUINT64_FORMAT " r=%u t=%"
+        G_GUINT64_FORMAT, S->d, S->r, S->t);
+    duration = S->d * GST_SECOND;
+    if (timescale > 1)
+      duration /= timescale;
+    if (S->t > 0) {
+      start = S->t;
+      start_time = S->t * GST_SECOND;
+      if (timescale > 1)
+        start_time /= timescale;
+    }
+
+    /* skip the segments starting before @from */
+    if (start >= from)
+      k = 0;
+    else if (S->d > 0)
+      k = MIN ((from - start + S->d - 1) / S->d, (guint64) S->r + 1);
+    else
+      k = (guint64) S->r + 1;
+
+    if (k <= S->r
+        && !gst_mpd_client_extend_last_media_segment (stream, i + k,
+            start + k * S->d, S->d, S->r - k)
+        && !gst_mpd_client_add_media_segment (stream, NULL, i + k,
+            start + k * S->d, start_time + k * duration, duration, S->d,
+            S->r - k)) {
+      return FALSE;
+    }
+    i += S->r + 1;
+    start += S->d * (S->r + 1);
+    start_time += duration * (S->r + 1);
+  }
+
+  return TRUE;
+}
+
+/* Shortens the last segment of @stream so that it ends with the Period */
+static gboolean
+gst_mpd_client_fix_last_segment_duration (GstActiveStream * stream,
+    GstClockTime PeriodEnd)
+{
+  GstMediaSegment *last_media_segment;
+  GstClockTime last_start;
+
+  last_media_segment = (stream->segments && stream->segments->len) ?
+      g_ptr_array_index (stream->segments, stream->segments->len - 1) : NULL;
+
+  if (!last_media_segment || !GST_CLOCK_TIME_IS_VALID (PeriodEnd))
+    return TRUE;
+
+  last_start = last_media_segment->start_time +
+      last_media_segment->repeat * last_media_segment->duration;
+
+  if (last_start + last_media_segment->duration > PeriodEnd) {
+    if (last_media_segment->repeat > 0) {
+      /* split the last segment off its run to shorten only that one */
+      last_media_segment->repeat--;
+      if (!gst_mpd_client_add_media_segment (stream,
+              last_media_segment->SegmentURL,
+              last_media_segment->number + last_media_segment->repeat + 1,
+              last_media_segment->start + (last_media_segment->repeat +
+                  1) * last_media_segment->scale_duration, last_start,
+              last_media_segment->duration,
+              last_media_segment->scale_duration, 0)) {
+        return FALSE;
+      }
+      last_media_segment =
+          g_ptr_array_index (stream->segments, stream->segments->len - 1);
+    }
+    last_media_segment->duration = PeriodEnd - last_media_segment->start_time;
+    GST_LOG ("Fixed duration of last segment: %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (last_media_segment->duration));
+  }
+  GST_LOG ("Built a list of %u segments in %u runs",
+      gst_mpdparser_get_segments_count (stream->segments),
+      stream->segments->len);
+
+  return TRUE;
+}
+
+/* Whether the segment runs of @old_stream, from the previous version of a
+ * live manifest, can be updated with the SegmentTimeline of @stream */
+static gboolean
+gst_mpd_client_can_merge_segments (GstActiveStream * stream,
+    GstActiveStream * old_stream)
+{
+  GstMultSegmentBaseType *mult_seg, *old_mult_seg;
+
+  if (old_stream == NULL || old_stream->segments == NULL
+      || old_stream->segments->len == 0)
+    return FALSE;
+
+  /* only template timelines can be merged, SegmentURL nodes belong to the
+   * manifest they were parsed from */
+  if (stream->cur_seg_template == NULL || old_stream->cur_seg_template == NULL
+      || old_stream->cur_segment_list != NULL)
+    return FALSE;
+  mult_seg = stream->cur_seg_template->MultSegBaseType;
+  old_mult_seg = old_stream->cur_seg_template->MultSegBaseType;
+  if (mult_seg == NULL || old_mult_seg == NULL
+      || mult_seg->SegmentTimeline == NULL
+      || old_mult_seg->SegmentTimeline == NULL
+      || g_queue_is_empty (&mult_seg->SegmentTimeline->S)
+      || mult_seg->SegBaseType->timescale !=
+      old_mult_seg->SegBaseType->timescale)
+    return FALSE;
+
+  return g_strcmp0 (stream->cur_representation->id,
+      old_stream->cur_representation->id) == 0;
+}
+
+/**
+ * gst_mpd_client_merge_stream_segments:
+ * @client: the client of the updated manifest
+ * @stream: a stream set up with gst_mpd_client_update_streaming()
+ * @old_stream: the same stream in the previous manifest
+ *
+ * Merges the SegmentTimeline of an updated live manifest into the segment
+ * runs of @old_stream and hands them over to @stream instead of building
+ * them again: runs that left the timeline are dropped and only the segments
+ * following the known ones are appended. @stream keeps the position of
+ * @old_stream.
+ *
+ * Returns: %TRUE if the segments were merged, %FALSE if the streams can't be
+ * merged, @stream then has the segments of the updated manifest.
+ */
+gboolean
+gst_mpd_client_merge_stream_segments (GstMpdClient * client,
+    GstActiveStream * stream, GstActiveStream * old_stream)
+{
+  GstStreamPeriod *stream_period;
+  GstMultSegmentBaseType *mult_seg;
+  GPtrArray *segments;
+  GstMediaSegment *run;
+  GstClockTime PeriodEnd;
+  GstSNode *S;
+  guint64 first, end;
+  guint i, k, dropped, index;
+
+  g_return_val_if_fail (stream != NULL, FALSE);
+
+  if (!gst_mpd_client_can_merge_segments (stream, old_stream))
+    return FALSE;
+
+  stream_period = gst_mpdparser_get_stream_period (client);
+  g_return_val_if_fail (stream_period != NULL, FALSE);
+
+  if (GST_CLOCK_TIME_IS_VALID (stream_period->duration))
+    PeriodEnd = stream_period->start + stream_period->duration;
+  else
+    PeriodEnd = GST_CLOCK_TIME_NONE;
+
+  /* take over the runs of the previous manifest */
+  segments = old_stream->segments;
+  old_stream->segments = stream->segments;
+  stream->segments = segments;
+
+  /* drop what is no longer in the timeline */
+  mult_seg = stream->cur_seg_template->MultSegBaseType;
+  S = g_queue_peek_head (&mult_seg->SegmentTimeline->S);
+  first = S->t;
+  dropped = 0;
+  for (i = 0; i < segments->len; i++) {
+    run = g_ptr_array_index (segments, i);
+    if (run->start + (run->repeat + 1) * run->scale_duration > first)
+      break;
+    dropped += run->repeat + 1;
+  }
+  if (i > 0)
+    g_ptr_array_remove_range (segments, 0, i);
+
+  end = 0;
+  if (segments->len > 0) {
+    run = g_ptr_array_index (segments, 0);
+    if (run->start < first && run->scale_duration > 0) {
+      k = MIN ((first - run->start) / run->scale_duration, run->repeat);
+      gst_mpdparser_trim_segment_run (run, k);
+      dropped += k;
+    }
+
+    run = g_ptr_array_index (segments, segments->len - 1);
+    end = run->start + (run->repeat + 1) * run->scale_duration;
+  }
+
+  /* append the segments following the known ones */
+  if (!gst_mpd_client_add_timeline_segments (stream, mult_seg,
+          stream_period->start, end))
+    GST_WARNING ("Could not append all the segments of the update");
+
+  /* the first runs were dropped, recompute the prefix sums */
+  index = 0;
+  for (i = 0; i < segments->len; i++) {
+    run = g_ptr_array_index (segments, i);
+    run->index = index;
+    index += run->repeat + 1;
+  }
+
+  gst_mpd_client_fix_last_segment_duration (stream, PeriodEnd);
+
+  stream->segment_idx = old_stream->segment_idx > dropped ?
+      old_stream->segment_idx - dropped : 0;
+
+  GST_DEBUG ("Merged segment timeline: dropped %u segments, %u segments in "
+      "%u runs, next segment %u", dropped, index, segments->len,
+      stream->segment_idx);
+
+  return TRUE;
+}
+
 gboolean
 gst_mpd_client_setup_representation (GstMpdClient * client,
     GstActiveStream * stream, GstRepresentationNode * representation)
+{
+  return gst_mpd_client_setup_representation_full (client, stream,
+      representation, NULL);
+}
+
+static gboolean
+gst_mpd_client_setup_representation_full (GstMpdClient * client,
+    GstActiveStream * stream, GstRepresentationNode * representation,
+    GstActiveStream * old_stream)
 {
   GstStreamPeriod *stream_period;
   GList *rep_list;
   GstClockTime PeriodStart, PeriodEnd, start_time, duration;
-  GstMediaSegment *last_media_segment;
   guint i;
   guint64 start;
 
@@ -3023,7 +3417,7 @@ gst_mpd_client_setup_representation (GstMpdClient * client,
       GST_DEBUG ("No useful SegmentList node for the current Representation");
       /* here we should have a single segment for each representation, whose URL is encoded in the baseURL element */
       if (!gst_mpd_client_add_media_segment (stream, NULL, 1, 0, PeriodStart,
-              PeriodEnd)) {
+              PeriodEnd, 0, 0)) {
         return FALSE;
       }
     } else {
@@ -3066,9 +3460,10 @@ gst_mpd_client_setup_representation (GstMpdClient * client,
               start_time /= timescale;
           }
 
+          /* every segment has its own SegmentURL here, no runs */
           for (j = 0; j <= S->r && SegmentURL != NULL; j++) {
             if (!gst_mpd_client_add_media_segment (stream, SegmentURL->data, i,
-                    start, start_time, duration)) {
+                    start, start_time, duration, S->d, 0)) {
               return FALSE;
             }
             i++;
@@ -3084,7 +3479,7 @@ gst_mpd_client_setup_representation (GstMpdClient * client,
 
         while (SegmentURL) {
           if (!gst_mpd_client_add_media_segment (stream, SegmentURL->data, i, 0,
-                  start_time, duration)) {
+                  start_time, duration, 0, 0)) {
             return FALSE;
           }
           i++;
@@ -3107,52 +3502,21 @@ gst_mpd_client_setup_representation (GstMpdClient * client,
 
       gst_mpdparser_init_active_stream_segments (stream);
       /* here we should have a single segment for each representation, whose URL is encoded in the baseURL element */
-      if (!gst_mpd_client_add_media_segment (stream, NULL, 1, 0, 0, PeriodEnd)) {
+      if (!gst_mpd_client_add_media_segment (stream, NULL, 1, 0, 0, PeriodEnd,
+              0, 0)) {
         return FALSE;
       }
     } else {
-      /* build segment list */
-      i = stream->cur_seg_template->MultSegBaseType->startNumber;
-      start = 0;
-      start_time = PeriodStart;
-
       GST_LOG ("Building media segment list using this template: %s",
           stream->cur_seg_template->media);
       if (stream->cur_seg_template->MultSegBaseType->SegmentTimeline) {
-        GstSegmentTimelineNode *timeline;
-        GstSNode *S;
-        GList *list;
-
-        timeline = stream->cur_seg_template->MultSegBaseType->SegmentTimeline;
         gst_mpdparser_init_active_stream_segments (stream);
-        for (list = g_queue_peek_head_link (&timeline->S); list;
-            list = g_list_next (list)) {
-          guint j, timescale;
-
-          S = (GstSNode *) list->data;
-          GST_LOG ("Processing S node: d=%" G_GUINT64_FORMAT " r=%u t=%"
-              G_GUINT64_FORMAT, S->d, S->r, S->t);
-          duration = S->d * GST_SECOND;
-          timescale =
-              stream->cur_seg_template->MultSegBaseType->SegBaseType->timescale;
-          if (timescale > 1)
-            duration /= timescale;
-          if (S->t > 0) {
-            start = S->t;
-            start_time = S->t * GST_SECOND;
-            if (timescale > 1)
-              start_time /= timescale;
-          }
-
-          for (j = 0; j <= S->r; j++) {
-            if (!gst_mpd_client_add_media_segment (stream, NULL, i, start,
-                    start_time, duration)) {
-              return FALSE;
-            }
-            i++;
-            start += S->d;
-            start_time += duration;
-          }
+        /* on live manifest updates, the runs of the previous manifest are
+         * reused by gst_mpd_client_merge_stream_segments() instead */
+        if (!gst_mpd_client_can_merge_segments (stream, old_stream)
+            && !gst_mpd_client_add_timeline_segments (stream,
+                stream->cur_seg_template->MultSegBaseType, PeriodStart, 0)) {
+          return FALSE;
         }
       } else {
         /* NOP - The segment is created on demand with the template, no need
@@ -3162,18 +3526,8 @@ gst_mpd_client_setup_representation (GstMpdClient * client,
   }
 
   /* check duration of last segment */
-  last_media_segment = (stream->segments && stream->segments->len) ?
-      g_ptr_array_index (stream->segments, stream->segments->len - 1) : NULL;
-
-  if (last_media_segment && GST_CLOCK_TIME_IS_VALID (PeriodEnd)) {
-    if (last_media_segment->start_time + last_media_segment->duration >
-        PeriodEnd) {
-      last_media_segment->duration = PeriodEnd - last_media_segment->start_time;
-      GST_LOG ("Fixed duration of last segment: %" GST_TIME_FORMAT,
-          GST_TIME_ARGS (last_media_segment->duration));
-    }
-    GST_LOG ("Built a list of %d segments", last_media_segment->number);
-  }
+  if (!gst_mpd_client_fix_last_segment_duration (stream, PeriodEnd))
+    return FALSE;
 
   g_free (stream->baseURL);
   g_free (stream->queryURL);
@@ -3316,7 +3670,34 @@ gboolean
 gst_mpd_client_setup_streaming (GstMpdClient * client,
     GstAdaptationSetNode * adapt_set)
 {
-  GstRepresentationNode *representation;
+  return gst_mpd_client_setup_streaming_full (client, adapt_set, NULL);
+}
+
+/**
+ * gst_mpd_client_update_streaming:
+ * @client: the client of the updated manifest
+ * @adapt_set: the adaptation set to set up a stream for
+ * @old_stream: (allow-none): the same stream in the previous manifest
+ *
+ * Like gst_mpd_client_setup_streaming() for a live manifest update: the
+ * representation of @old_stream is kept if it is still available, and the
+ * segment runs of a SegmentTimeline are not built, they are taken over from
+ * @old_stream by gst_mpd_client_merge_stream_segments() afterwards.
+ *
+ * Returns: %TRUE if the stream was set up.
+ */
+gboolean
+gst_mpd_client_update_streaming (GstMpdClient * client,
+    GstAdaptationSetNode * adapt_set, GstActiveStream * old_stream)
+{
+  return gst_mpd_client_setup_streaming_full (client, adapt_set, old_stream);
+}
+
+static gboolean
+gst_mpd_client_setup_streaming_full (GstMpdClient * client,
+    GstAdaptationSetNode * adapt_set, GstActiveStream * old_stream)
+{
+  GstRepresentationNode *representation = NULL;
   GList *rep_list = NULL;
   GstActiveStream *stream;
 
@@ -3354,8 +3735,21 @@ gst_mpd_client_setup_streaming (GstMpdClient * client,
     representation = gst_mpdparser_get_lowest_representation (rep_list);
   }
 #else
-  /* slow start */
-  representation = gst_mpdparser_get_lowest_representation (rep_list);
+  /* keep playing the same representation on updates, slow start otherwise */
+  if (old_stream && old_stream->cur_representation) {
+    GList *list;
+
+    for (list = rep_list; list; list = g_list_next (list)) {
+      GstRepresentationNode *rep = list->data;
+
+      if (g_strcmp0 (rep->id, old_stream->cur_representation->id) == 0) {
+        representation = rep;
+        break;
+      }
+    }
+  }
+  if (!representation)
+    representation = gst_mpdparser_get_lowest_representation (rep_list);
 #endif
 
   if (!representation) {
@@ -3371,7 +3765,8 @@ gst_mpd_client_setup_streaming (GstMpdClient * client,
   }
 
   client->active_streams = g_list_append (client->active_streams, stream);
-  if (!gst_mpd_client_setup_representation (client, stream, representation))
+  if (!gst_mpd_client_setup_representation_full (client, stream,
+          representation, old_stream))
     return FALSE;
 
   GST_INFO ("Successfully setup the download pipeline for mimeType %d",
@@ -3385,24 +3780,16 @@ gst_mpd_client_stream_seek (GstMpdClient * client, GstActiveStream * stream,
     GstClockTime ts)
 {
   gint index = 0;
-  GstMediaSegment *selectedChunk = NULL;
 
   g_return_val_if_fail (stream != NULL, 0);
 
   GST_MPD_CLIENT_LOCK (client);
   if (stream->segments) {
-    for (index = 0; index < stream->segments->len; index++) {
-      GstMediaSegment *segment = g_ptr_array_index (stream->segments, index);
-
-      GST_DEBUG ("Looking at fragment sequence chunk %d", index);
-      if (segment->start_time <= ts
-          && ts < segment->start_time + segment->duration) {
-        selectedChunk = segment;
-        break;
-      }
-    }
+    index = gst_mpdparser_find_segment_at_time (stream->segments, ts, FALSE);
+    GST_DEBUG ("Found fragment sequence chunk %d for time %" GST_TIME_FORMAT,
+        index, GST_TIME_ARGS (ts));
 
-    if (selectedChunk == NULL) {
+    if (index < 0) {
       GST_MPD_CLIENT_UNLOCK (client);
       return FALSE;
     }
@@ -3492,7 +3879,21 @@ gst_mpd_client_get_segment_index_at_time (GstMpdClient * client,
   if (diff > gst_mpd_client_get_media_presentation_duration (client))
     return -3;
 
-  /* TODO: Assumes all fragments are roughly the same duration */
+  if (stream->segments) {
+    GstClockTime ts = diff;
+    gint index;
+
+    /* segment start times include the start of the period */
+    if (stream_period)
+      ts += stream_period->start;
+
+    GST_MPD_CLIENT_LOCK (client);
+    index = gst_mpdparser_find_segment_at_time (stream->segments, ts, TRUE);
+    GST_MPD_CLIENT_UNLOCK (client);
+    return index;
+  }
+
+  /* without a timeline all segments have the same duration */
   seg_duration = gst_mpd_client_get_next_fragment_duration (client, stream);
   if (seg_duration == 0)
     return -1;
@@ -3796,8 +4197,7 @@ gst_mpd_client_get_next_fragment_duration (GstMpdClient * client,
   seg_idx = gst_mpd_client_get_segment_index (stream);
 
   if (stream->segments) {
-    if (seg_idx < stream->segments->len)
-      media_segment = g_ptr_array_index (stream->segments, seg_idx);
+    media_segment = gst_mpdparser_find_segment_run (stream->segments, seg_idx);
 
     return media_segment == NULL ? 0 : media_segment->duration;
   } else {
@@ -3962,7 +4362,7 @@ gst_mpd_client_get_segments_counts (GstActiveStream * stream)
   g_return_val_if_fail (stream != NULL, 0);
 
   if (stream->segments)
-    return stream->segments->len;
+    return gst_mpdparser_get_segments_count (stream->segments);
   g_return_val_if_fail (stream->cur_seg_template->
       MultSegBaseType->SegmentTimeline == NULL, 0);
   return 0;
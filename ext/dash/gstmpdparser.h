@@ -408,7 +408,10 @@ struct _GstStreamPeriod
 /**
  * GstMediaSegment:
  *
- * Media segment data structure
+ * Media segment data structure. In the segments array of an active stream
+ * one entry describes a run of repeat + 1 consecutive segments of the same
+ * duration (a SegmentTimeline S node), the fields then refer to the first
+ * segment of the run.
  */
 struct _GstMediaSegment
 {
@@ -417,6 +420,9 @@ struct _GstMediaSegment
   guint64 start;                                /* segment start time in timescale units */
   GstClockTime start_time;                    /* segment start time */
   GstClockTime duration;                      /* segment duration */
+  guint64 scale_duration;                     /* segment duration in timescale units */
+  guint repeat;                               /* number of segments following in the run */
+  guint index;                                /* index of the first segment of the run */
 };
 
 struct _GstMediaFragmentInfo
@@ -455,7 +461,7 @@ struct _GstActiveStream
   GstSegmentListNode *cur_segment_list;       /* active segment list */
   GstSegmentTemplateNode *cur_seg_template;   /* active segment template */
   guint segment_idx;                          /* index of next sequence chunk */
-  GPtrArray *segments;                        /* array of GstMediaSegment */
+  GPtrArray *segments;                        /* array of GstMediaSegment runs */
 };
 
 struct _GstMpdClient
@@ -484,6 +490,7 @@ gboolean gst_mpd_parse (GstMpdClient *client, const gchar *data, gint size);
 /* Streaming management */
 gboolean gst_mpd_client_setup_media_presentation (GstMpdClient *client);
 gboolean gst_mpd_client_setup_streaming (GstMpdClient * client, GstAdaptationSetNode * adapt_set);
+gboolean gst_mpd_client_update_streaming (GstMpdClient * client, GstAdaptationSetNode * adapt_set, GstActiveStream * old_stream);
 gboolean gst_mpd_client_setup_representation (GstMpdClient *client, GstActiveStream *stream, GstRepresentationNode *representation);
 GList * gst_mpd_client_get_adaptation_sets (GstMpdClient * client);
 GstClockTime gst_mpd_client_get_next_fragment_duration (GstMpdClient * client, GstActiveStream * stream);
@@ -498,6 +505,7 @@ gboolean gst_mpd_client_stream_seek (GstMpdClient * client, GstActiveStream * st
 gboolean gst_mpd_client_seek_to_time (GstMpdClient * client, GDateTime * time);
 GstDateTime *gst_mpd_client_add_time_difference (GstDateTime * t1, gint64 usecs);
 gint gst_mpd_client_get_segment_index_at_time (GstMpdClient *client, GstActiveStream * stream, const GstDateTime *time);
+gboolean gst_mpd_client_merge_stream_segments (GstMpdClient * client, GstActiveStream * stream, GstActiveStream * old_stream);
 gint gst_mpd_client_check_time_position (GstMpdClient * client, GstActiveStream * stream, GstClockTime ts, gint64 * diff);
 
 /* Period selection */
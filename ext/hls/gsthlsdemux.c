@@ -64,6 +64,12 @@ enum
   PROP_FRAGMENTS_CACHE,
   PROP_BITRATE_LIMIT,
   PROP_CONNECTION_SPEED,
+  PROP_PREFETCH_FRAGMENTS,
+  PROP_BITRATE_ESTIMATOR,
+  PROP_ESTIMATOR_WINDOW,
+  PROP_SWITCH_HYSTERESIS,
+  PROP_ESTIMATED_BITRATE,
+  PROP_BUFFER_LEVEL,
   PROP_LAST
 };
 
@@ -71,6 +77,27 @@ enum
 #define DEFAULT_FAILED_COUNT 3
 #define DEFAULT_BITRATE_LIMIT 0.8
 #define DEFAULT_CONNECTION_SPEED    0
+#define DEFAULT_PREFETCH_FRAGMENTS  0
+#define MAX_PREFETCH_FRAGMENTS      16
+#define DEFAULT_BITRATE_ESTIMATOR   GST_HLS_DEMUX_ESTIMATOR_HARMONIC_MEAN
+#define DEFAULT_ESTIMATOR_WINDOW    5
+#define DEFAULT_SWITCH_HYSTERESIS   0.2
+
+/* Fragments to download after a switch before switching up again */
+#define MIN_FRAGMENTS_BETWEEN_SWITCHES 2
+/* Buffer level, in target durations, above which a lower estimate doesn't
+ * cause a switch down */
+#define DOWNSWITCH_BUFFER_FRAGMENTS 3
+
+struct _GstHLSPrefetchFragment
+{
+  gint64 sequence;
+  gchar *uri;
+  gint64 range_start;
+  gint64 range_end;
+
+  GstUriDownloadFuture *future;
+};
 
 /* GObject */
 static void gst_hls_demux_set_property (GObject * object, guint prop_id,
@@ -117,9 +144,32 @@ gst_hls_demux_decrypt_start (GstHLSDemux * demux, const guint8 * key_data,
     const guint8 * iv_data);
 static void gst_hls_demux_decrypt_end (GstHLSDemux * demux);
 
+static void gst_hls_demux_prefetch_flush (GstHLSDemux * demux);
+
 #define gst_hls_demux_parent_class parent_class
 G_DEFINE_TYPE (GstHLSDemux, gst_hls_demux, GST_TYPE_BIN);
 
+#define GST_TYPE_HLS_DEMUX_BITRATE_ESTIMATOR \
+  (gst_hls_demux_bitrate_estimator_get_type ())
+static GType
+gst_hls_demux_bitrate_estimator_get_type (void)
+{
+  static GType estimator_type = 0;
+  static const GEnumValue estimators[] = {
+    {GST_HLS_DEMUX_ESTIMATOR_EWMA, "Exponentially weighted moving average",
+        "ewma"},
+    {GST_HLS_DEMUX_ESTIMATOR_HARMONIC_MEAN,
+          "Harmonic mean of the last fragments", "harmonic-mean"},
+    {0, NULL, NULL}
+  };
+
+  if (!estimator_type) {
+    estimator_type =
+        g_enum_register_static ("GstHLSDemuxBitrateEstimator", estimators);
+  }
+  return estimator_type;
+}
+
 static void
 gst_hls_demux_dispose (GObject * obj)
 {
@@ -144,6 +194,12 @@ gst_hls_demux_dispose (GObject * obj)
 
   gst_hls_demux_reset (demux, TRUE);
 
+  if (demux->prefetch_pool) {
+    gst_hls_demux_prefetch_flush (demux);
+    gst_object_unref (demux->prefetch_pool);
+    demux->prefetch_pool = NULL;
+  }
+
   if (demux->src_srcpad) {
     gst_object_unref (demux->src_srcpad);
     demux->src_srcpad = NULL;
@@ -155,6 +211,7 @@ gst_hls_demux_dispose (GObject * obj)
   g_cond_clear (&demux->updates_timed_cond);
   g_mutex_clear (&demux->fragment_download_lock);
   g_cond_clear (&demux->fragment_download_cond);
+  g_mutex_clear (&demux->prefetch_lock);
 
   G_OBJECT_CLASS (parent_class)->dispose (obj);
 }
@@ -194,6 +251,44 @@ gst_hls_demux_class_init (GstHLSDemuxClass * klass)
           0, G_MAXUINT / 1000, DEFAULT_CONNECTION_SPEED,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_PREFETCH_FRAGMENTS,
+      g_param_spec_uint ("prefetch-fragments", "Prefetch fragments",
+          "Number of upcoming fragments downloaded concurrently ahead of "
+          "playback (0 = download one fragment at a time)",
+          0, MAX_PREFETCH_FRAGMENTS, DEFAULT_PREFETCH_FRAGMENTS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_BITRATE_ESTIMATOR,
+      g_param_spec_enum ("bitrate-estimator", "Bitrate estimator",
+          "How the available bitrate is estimated from the fragment downloads",
+          GST_TYPE_HLS_DEMUX_BITRATE_ESTIMATOR, DEFAULT_BITRATE_ESTIMATOR,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_ESTIMATOR_WINDOW,
+      g_param_spec_uint ("estimator-window", "Estimator window",
+          "Number of fragment downloads the harmonic mean estimate is based on",
+          1, GST_HLS_DEMUX_MAX_ESTIMATOR_WINDOW, DEFAULT_ESTIMATOR_WINDOW,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SWITCH_HYSTERESIS,
+      g_param_spec_float ("switch-hysteresis", "Switch hysteresis",
+          "Fraction by which the usable bitrate has to exceed the bandwidth "
+          "of a higher variant before switching to it",
+          0, 10, DEFAULT_SWITCH_HYSTERESIS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_ESTIMATED_BITRATE,
+      g_param_spec_int ("estimated-bitrate", "Estimated bitrate",
+          "Current estimate of the download bitrate in bps (-1 = unknown)",
+          -1, G_MAXINT, -1, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_BUFFER_LEVEL,
+      g_param_spec_uint64 ("buffer-level", "Buffer level",
+          "Duration of the data pushed ahead of the pipeline clock when the "
+          "last fragment finished (-1 = unknown)",
+          0, G_MAXUINT64, GST_CLOCK_TIME_NONE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   element_class->change_state = GST_DEBUG_FUNCPTR (gst_hls_demux_change_state);
 
   gst_element_class_add_pad_template (element_class,
@@ -234,6 +329,10 @@ gst_hls_demux_init (GstHLSDemux * demux)
   /* Properties */
   demux->bitrate_limit = DEFAULT_BITRATE_LIMIT;
   demux->connection_speed = DEFAULT_CONNECTION_SPEED;
+  demux->prefetch_fragments = DEFAULT_PREFETCH_FRAGMENTS;
+  demux->bitrate_estimator = DEFAULT_BITRATE_ESTIMATOR;
+  demux->estimator_window = DEFAULT_ESTIMATOR_WINDOW;
+  demux->switch_hysteresis = DEFAULT_SWITCH_HYSTERESIS;
 
   g_mutex_init (&demux->download_lock);
   g_cond_init (&demux->download_cond);
@@ -242,6 +341,11 @@ gst_hls_demux_init (GstHLSDemux * demux)
   g_mutex_init (&demux->fragment_download_lock);
   g_cond_init (&demux->fragment_download_cond);
 
+  /* Prefetching, connections are only opened once fragments are queued */
+  g_mutex_init (&demux->prefetch_lock);
+  g_queue_init (&demux->prefetch_queue);
+  demux->prefetch_pool = gst_uri_downloader_pool_new (MAX_PREFETCH_FRAGMENTS);
+
   /* Updates task */
   g_rec_mutex_init (&demux->updates_lock);
   demux->updates_task =
@@ -273,6 +377,18 @@ gst_hls_demux_set_property (GObject * object, guint prop_id,
     case PROP_CONNECTION_SPEED:
       demux->connection_speed = g_value_get_uint (value) * 1000;
       break;
+    case PROP_PREFETCH_FRAGMENTS:
+      demux->prefetch_fragments = g_value_get_uint (value);
+      break;
+    case PROP_BITRATE_ESTIMATOR:
+      demux->bitrate_estimator = g_value_get_enum (value);
+      break;
+    case PROP_ESTIMATOR_WINDOW:
+      demux->estimator_window = g_value_get_uint (value);
+      break;
+    case PROP_SWITCH_HYSTERESIS:
+      demux->switch_hysteresis = g_value_get_float (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -295,6 +411,24 @@ gst_hls_demux_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_CONNECTION_SPEED:
       g_value_set_uint (value, demux->connection_speed / 1000);
       break;
+    case PROP_PREFETCH_FRAGMENTS:
+      g_value_set_uint (value, demux->prefetch_fragments);
+      break;
+    case PROP_BITRATE_ESTIMATOR:
+      g_value_set_enum (value, demux->bitrate_estimator);
+      break;
+    case PROP_ESTIMATOR_WINDOW:
+      g_value_set_uint (value, demux->estimator_window);
+      break;
+    case PROP_SWITCH_HYSTERESIS:
+      g_value_set_float (value, demux->switch_hysteresis);
+      break;
+    case PROP_ESTIMATED_BITRATE:
+      g_value_set_int (value, demux->current_download_rate);
+      break;
+    case PROP_BUFFER_LEVEL:
+      g_value_set_uint64 (value, demux->buffer_level);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -326,6 +460,7 @@ gst_hls_demux_change_state (GstElement * element, GstStateChange transition)
       gst_hls_demux_stop (demux);
       gst_task_join (demux->updates_task);
       gst_task_join (demux->stream_task);
+      gst_hls_demux_prefetch_flush (demux);
       gst_hls_demux_reset (demux, FALSE);
       break;
     case GST_STATE_CHANGE_READY_TO_NULL:
@@ -388,10 +523,8 @@ gst_hls_demux_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
       GstSeekFlags flags;
       GstSeekType start_type, stop_type;
       gint64 start, stop;
-      GList *walk;
       GstClockTime current_pos, target_pos;
       gint64 current_sequence;
-      GstM3U8MediaFile *file;
 
       GST_INFO_OBJECT (demux, "Received GST_EVENT_SEEK");
 
@@ -434,6 +567,9 @@ gst_hls_demux_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
 
       g_rec_mutex_lock (&demux->stream_lock);
 
+      /* prefetched fragments are for the old position */
+      gst_hls_demux_prefetch_flush (demux);
+
       /* properly cleanup pending decryption status */
       if (flags & GST_SEEK_FLAG_FLUSH) {
         if (demux->adapter)
@@ -503,27 +639,11 @@ gst_hls_demux_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
             demux->current_download_rate * demux->bitrate_limit);
       }
 
-      GST_M3U8_CLIENT_LOCK (demux->client);
-      file = GST_M3U8_MEDIA_FILE (demux->client->current->files->data);
-      current_sequence = file->sequence;
-      current_pos = 0;
       target_pos = rate > 0 ? start : stop;
       /* FIXME: Here we need proper discont handling */
-      for (walk = demux->client->current->files; walk; walk = walk->next) {
-        file = walk->data;
-
-        current_sequence = file->sequence;
-        if (current_pos <= target_pos
-            && target_pos < current_pos + file->duration) {
-          break;
-        }
-        current_pos += file->duration;
-      }
-      GST_M3U8_CLIENT_UNLOCK (demux->client);
-
-      if (walk == NULL) {
+      if (!gst_m3u8_client_find_fragment_at_position (demux->client,
+              target_pos, &current_sequence, &current_pos)) {
         GST_DEBUG_OBJECT (demux, "seeking further than track duration");
-        current_sequence++;
       }
 
       GST_M3U8_CLIENT_LOCK (demux->client);
@@ -743,6 +863,7 @@ gst_hls_demux_pause_tasks (GstHLSDemux * demux)
     g_mutex_lock (&demux->fragment_download_lock);
     g_cond_signal (&demux->fragment_download_cond);
     g_mutex_unlock (&demux->fragment_download_lock);
+    gst_uri_downloader_pool_cancel (demux->prefetch_pool);
     gst_task_pause (demux->stream_task);
   }
 }
@@ -769,6 +890,7 @@ gst_hls_demux_stop (GstHLSDemux * demux)
     g_mutex_lock (&demux->fragment_download_lock);
     g_cond_signal (&demux->fragment_download_cond);
     g_mutex_unlock (&demux->fragment_download_lock);
+    gst_uri_downloader_pool_cancel (demux->prefetch_pool);
     gst_task_stop (demux->stream_task);
     g_rec_mutex_lock (&demux->stream_lock);
     g_rec_mutex_unlock (&demux->stream_lock);
@@ -1040,8 +1162,12 @@ switch_pads (GstHLSDemux * demux)
   /* First create and activate new pad */
   name = g_strdup_printf ("src_%u", demux->srcpad_counter++);
   tmpl = gst_static_pad_template_get (&srctemplate);
-  demux->srcpad =
-      gst_ghost_pad_new_from_template (name, demux->src_srcpad, tmpl);
+  /* Prefetched fragments are pushed without the source element, which
+   * might not exist yet */
+  demux->srcpad = gst_ghost_pad_new_no_target_from_template (name, tmpl);
+  if (demux->src_srcpad)
+    gst_ghost_pad_set_target (GST_GHOST_PAD_CAST (demux->srcpad),
+        demux->src_srcpad);
   gst_object_unref (tmpl);
   g_free (name);
 
@@ -1107,6 +1233,21 @@ gst_hls_demux_configure_src_pad (GstHLSDemux * demux)
   }
 }
 
+/* The source pad might have been created while pushing prefetched
+ * fragments, or the source element might have been replaced */
+static void
+gst_hls_demux_link_src_pad (GstHLSDemux * demux)
+{
+  GstPad *target;
+
+  target = gst_ghost_pad_get_target (GST_GHOST_PAD_CAST (demux->srcpad));
+  if (target != demux->src_srcpad)
+    gst_ghost_pad_set_target (GST_GHOST_PAD_CAST (demux->srcpad),
+        demux->src_srcpad);
+  if (target)
+    gst_object_unref (target);
+}
+
 static void
 gst_hls_demux_stream_loop (GstHLSDemux * demux)
 {
@@ -1321,6 +1462,10 @@ gst_hls_demux_reset (GstHLSDemux * demux, gboolean dispose)
   gst_hls_demux_decrypt_end (demux);
 
   demux->current_download_rate = -1;
+  demux->n_download_rates = 0;
+  demux->download_rates_idx = 0;
+  demux->buffer_level = GST_CLOCK_TIME_NONE;
+  demux->fragments_since_switch = 0;
 }
 
 static gboolean
@@ -1526,8 +1671,8 @@ gst_hls_demux_update_playlist (GstHLSDemux * demux, gboolean update,
 
     GST_M3U8_CLIENT_LOCK (demux->client);
     last_sequence =
-        GST_M3U8_MEDIA_FILE (g_list_last (demux->client->current->files)->
-        data)->sequence;
+        GST_M3U8_MEDIA_FILE (g_ptr_array_index (demux->client->current->files,
+            demux->client->current->files->len - 1))->sequence;
 
     if (demux->client->sequence >= last_sequence - 3) {
       GST_DEBUG_OBJECT (demux, "Sequence is beyond playlist. Moving back to %u",
@@ -1537,30 +1682,17 @@ gst_hls_demux_update_playlist (GstHLSDemux * demux, gboolean update,
     }
     GST_M3U8_CLIENT_UNLOCK (demux->client);
   } else if (demux->client->current && !gst_m3u8_client_is_live (demux->client)) {
-    GstClockTime current_pos, target_pos;
-    guint sequence = 0;
-    GList *walk;
+    GstClockTime current_pos;
+    gint64 sequence;
 
     /* Sequence numbers are not guaranteed to be the same in different
      * playlists, so get the correct fragment here based on the current
-     * position
-     */
+     * position. Past the end of the playlist this is the sequence after
+     * the last fragment */
+    gst_m3u8_client_find_fragment_at_position (demux->client,
+        demux->segment.position, &sequence, &current_pos);
+
     GST_M3U8_CLIENT_LOCK (demux->client);
-    current_pos = 0;
-    target_pos = demux->segment.position;
-    for (walk = demux->client->current->files; walk; walk = walk->next) {
-      GstM3U8MediaFile *file = walk->data;
-
-      sequence = file->sequence;
-      if (current_pos <= target_pos
-          && target_pos < current_pos + file->duration) {
-        break;
-      }
-      current_pos += file->duration;
-    }
-    /* End of playlist */
-    if (!walk)
-      sequence++;
     demux->client->sequence = sequence;
     demux->client->sequence_position = current_pos;
     GST_M3U8_CLIENT_UNLOCK (demux->client);
@@ -1580,74 +1712,150 @@ gst_hls_demux_change_playlist (GstHLSDemux * demux, guint max_bitrate)
   if (demux->connection_speed != 0 && max_bitrate > demux->connection_speed)
     max_bitrate = demux->connection_speed;
 
+  GST_M3U8_CLIENT_LOCK (demux->client);
   previous_variant = demux->client->main->current_variant;
+  old_bandwidth = GST_M3U8 (previous_variant->data)->bandwidth;
+  GST_M3U8_CLIENT_UNLOCK (demux->client);
+
   current_variant = gst_m3u8_client_get_playlist_for_bitrate (demux->client,
       max_bitrate);
 
-retry_failover_protection:
-  old_bandwidth = GST_M3U8 (previous_variant->data)->bandwidth;
-  new_bandwidth = GST_M3U8 (current_variant->data)->bandwidth;
+  while (current_variant != NULL) {
+    new_bandwidth = GST_M3U8 (current_variant->data)->bandwidth;
 
-  /* Don't do anything else if the playlist is the same */
-  if (new_bandwidth == old_bandwidth) {
-    return TRUE;
-  }
+    /* Don't do anything else if the playlist is the same */
+    if (new_bandwidth == old_bandwidth)
+      break;
 
-  demux->client->main->current_variant = current_variant;
-  GST_M3U8_CLIENT_UNLOCK (demux->client);
+    GST_M3U8_CLIENT_LOCK (demux->client);
+    demux->client->main->current_variant = current_variant;
+    GST_M3U8_CLIENT_UNLOCK (demux->client);
 
-  gst_m3u8_client_set_current (demux->client, current_variant->data);
+    gst_m3u8_client_set_current (demux->client, current_variant->data);
 
-  GST_INFO_OBJECT (demux, "Client was on %dbps, max allowed is %dbps, switching"
-      " to bitrate %dbps", old_bandwidth, max_bitrate, new_bandwidth);
-  demux->discont = TRUE;
-  demux->new_playlist = TRUE;
+    GST_INFO_OBJECT (demux, "Client was on %dbps, max allowed is %dbps, "
+        "switching to bitrate %dbps", old_bandwidth, max_bitrate,
+        new_bandwidth);
+    demux->discont = TRUE;
+    demux->new_playlist = TRUE;
 
-  if (gst_hls_demux_update_playlist (demux, FALSE, NULL)) {
-    GstStructure *s;
+    /* prefetched fragments belong to the old variant */
+    gst_hls_demux_prefetch_flush (demux);
 
-    s = gst_structure_new ("playlist",
-        "uri", G_TYPE_STRING, gst_m3u8_client_get_current_uri (demux->client),
-        "bitrate", G_TYPE_INT, new_bandwidth, NULL);
-    gst_element_post_message (GST_ELEMENT_CAST (demux),
-        gst_message_new_element (GST_OBJECT_CAST (demux), s));
-  } else {
-    GList *failover = NULL;
+    if (gst_hls_demux_update_playlist (demux, FALSE, NULL)) {
+      GstStructure *s;
 
-    GST_INFO_OBJECT (demux, "Unable to update playlist. Switching back");
-    GST_M3U8_CLIENT_LOCK (demux->client);
+      s = gst_structure_new ("playlist",
+          "uri", G_TYPE_STRING, gst_m3u8_client_get_current_uri (demux->client),
+          "bitrate", G_TYPE_INT, new_bandwidth, NULL);
+      gst_element_post_message (GST_ELEMENT_CAST (demux),
+          gst_message_new_element (GST_OBJECT_CAST (demux), s));
 
-    failover = g_list_previous (current_variant);
-    if (failover && new_bandwidth == GST_M3U8 (failover->data)->bandwidth) {
-      current_variant = failover;
-      goto retry_failover_protection;
+      /* Force typefinding since we might have changed media type */
+      demux->do_typefind = TRUE;
+      demux->fragments_since_switch = 0;
+      return TRUE;
     }
 
+    /* The previous entry is either a failover for the same bitrate or the
+     * next lower bitrate. Going down stops at the variant we were on */
+    GST_INFO_OBJECT (demux, "Unable to update playlist, trying a lower one");
+    current_variant = g_list_previous (current_variant);
+  }
+
+  GST_M3U8_CLIENT_LOCK (demux->client);
+  if (demux->client->main->current_variant != previous_variant) {
+    GST_INFO_OBJECT (demux, "Switching back to %dbps", old_bandwidth);
     demux->client->main->current_variant = previous_variant;
     GST_M3U8_CLIENT_UNLOCK (demux->client);
     gst_m3u8_client_set_current (demux->client, previous_variant->data);
-    /*  Try a lower bitrate (or stop if we just tried the lowest) */
-    if (GST_M3U8 (previous_variant->data)->iframe && new_bandwidth ==
-        GST_M3U8 (g_list_first (demux->client->main->iframe_lists)->
-            data)->bandwidth)
-      return FALSE;
-    else if (!GST_M3U8 (previous_variant->data)->iframe && new_bandwidth ==
-        GST_M3U8 (g_list_first (demux->client->main->lists)->data)->bandwidth)
-      return FALSE;
-    else
-      return gst_hls_demux_change_playlist (demux, new_bandwidth - 1);
+  } else {
+    GST_M3U8_CLIENT_UNLOCK (demux->client);
   }
 
-  /* Force typefinding since we might have changed media type */
-  demux->do_typefind = TRUE;
+  /* FALSE if even the lowest bitrate failed */
+  return current_variant != NULL;
+}
 
-  return TRUE;
+static void
+gst_hls_demux_update_bitrate_estimate (GstHLSDemux * demux, gint64 bitrate)
+{
+  guint window = MIN (demux->estimator_window, demux->n_download_rates + 1);
+  guint i;
+
+  demux->download_rates[demux->download_rates_idx] = MAX (bitrate, 1);
+  demux->download_rates_idx =
+      (demux->download_rates_idx + 1) % GST_HLS_DEMUX_MAX_ESTIMATOR_WINDOW;
+  if (demux->n_download_rates < GST_HLS_DEMUX_MAX_ESTIMATOR_WINDOW)
+    demux->n_download_rates++;
+
+  switch (demux->bitrate_estimator) {
+    case GST_HLS_DEMUX_ESTIMATOR_HARMONIC_MEAN:{
+      gdouble sum = 0;
+
+      /* Dominated by the slow downloads, so a single fast fragment
+       * doesn't trigger a switch up */
+      for (i = 1; i <= window; i++) {
+        guint idx = (demux->download_rates_idx +
+            GST_HLS_DEMUX_MAX_ESTIMATOR_WINDOW -
+            i) % GST_HLS_DEMUX_MAX_ESTIMATOR_WINDOW;
+
+        sum += 1.0 / demux->download_rates[idx];
+      }
+      bitrate = window / sum;
+      break;
+    }
+    case GST_HLS_DEMUX_ESTIMATOR_EWMA:
+    default:
+      /* Take old rate into account too */
+      if (demux->current_download_rate != -1)
+        bitrate = (demux->current_download_rate + bitrate * 3) / 4;
+      break;
+  }
+
+  if (bitrate > G_MAXINT)
+    bitrate = G_MAXINT;
+  demux->current_download_rate = bitrate;
+}
+
+/* Returns how much data was pushed ahead of the pipeline clock, or
+ * GST_CLOCK_TIME_NONE if it can't be known */
+static GstClockTime
+gst_hls_demux_get_buffer_level (GstHLSDemux * demux)
+{
+  GstClock *clock;
+  GstClockTime now, base_time, running_time;
+
+  if (GST_STATE (demux) != GST_STATE_PLAYING || demux->segment.rate <= 0)
+    return GST_CLOCK_TIME_NONE;
+
+  running_time = gst_segment_to_running_time (&demux->segment,
+      GST_FORMAT_TIME, demux->segment.position);
+  if (!GST_CLOCK_TIME_IS_VALID (running_time))
+    return GST_CLOCK_TIME_NONE;
+
+  clock = gst_element_get_clock (GST_ELEMENT_CAST (demux));
+  if (clock == NULL)
+    return GST_CLOCK_TIME_NONE;
+  now = gst_clock_get_time (clock);
+  gst_object_unref (clock);
+
+  base_time = gst_element_get_base_time (GST_ELEMENT_CAST (demux));
+  if (now < base_time)
+    return running_time;
+  now -= base_time;
+
+  return running_time > now ? running_time - now : 0;
 }
 
 static gboolean
 gst_hls_demux_switch_playlist (GstHLSDemux * demux)
 {
   gint64 bitrate;
+  GstClockTime target_duration;
+  GstStructure *s;
+  guint current_bandwidth, target, max_bitrate;
+  gboolean ret = TRUE;
 
   /* compare the time when the fragment was downloaded with the time when it was
    * scheduled */
@@ -1660,23 +1868,55 @@ gst_hls_demux_switch_playlist (GstHLSDemux * demux)
       (guint) demux->download_total_bytes,
       GST_TIME_ARGS (demux->download_total_time * GST_USECOND), (gint) bitrate);
 
-  /* Take old rate into account too */
-  if (demux->current_download_rate != -1)
-    bitrate = (demux->current_download_rate + bitrate * 3) / 4;
-  if (bitrate > G_MAXINT)
-    bitrate = G_MAXINT;
-  demux->current_download_rate = bitrate;
+  gst_hls_demux_update_bitrate_estimate (demux, bitrate);
+  demux->buffer_level = gst_hls_demux_get_buffer_level (demux);
+  demux->fragments_since_switch++;
 
-  GST_DEBUG_OBJECT (demux, "Using current download rate: %d", (gint) bitrate);
+  GST_DEBUG_OBJECT (demux, "Using current download rate: %d, buffer level %"
+      GST_TIME_FORMAT, demux->current_download_rate,
+      GST_TIME_ARGS (demux->buffer_level));
 
   GST_M3U8_CLIENT_LOCK (demux->client);
   if (!demux->client->main->lists) {
     GST_M3U8_CLIENT_UNLOCK (demux->client);
     return TRUE;
   }
+  current_bandwidth =
+      GST_M3U8 (demux->client->main->current_variant->data)->bandwidth;
   GST_M3U8_CLIENT_UNLOCK (demux->client);
 
-  return gst_hls_demux_change_playlist (demux, bitrate * demux->bitrate_limit);
+  target_duration = gst_m3u8_client_get_target_duration (demux->client);
+  target = demux->current_download_rate * demux->bitrate_limit;
+  max_bitrate = current_bandwidth;
+
+  if (target > current_bandwidth) {
+    /* Only go up if the estimate leaves some headroom above the new
+     * variant, the last switch has settled and a wrong estimate would not
+     * immediately drain the buffer */
+    if (demux->fragments_since_switch >= MIN_FRAGMENTS_BETWEEN_SWITCHES
+        && (!GST_CLOCK_TIME_IS_VALID (demux->buffer_level)
+            || demux->buffer_level >= target_duration))
+      max_bitrate = MAX (target / (1.0 + demux->switch_hysteresis),
+          current_bandwidth);
+  } else if (target < current_bandwidth) {
+    /* A short dip doesn't matter as long as enough is buffered */
+    if (!GST_CLOCK_TIME_IS_VALID (demux->buffer_level)
+        || demux->buffer_level < DOWNSWITCH_BUFFER_FRAGMENTS * target_duration)
+      max_bitrate = target;
+  }
+
+  s = gst_structure_new ("adaptive-bitrate",
+      "estimated-bitrate", G_TYPE_INT, demux->current_download_rate,
+      "buffer-level", G_TYPE_UINT64, demux->buffer_level,
+      "current-bitrate", G_TYPE_UINT, current_bandwidth,
+      "target-bitrate", G_TYPE_UINT, max_bitrate, NULL);
+  gst_element_post_message (GST_ELEMENT_CAST (demux),
+      gst_message_new_element (GST_OBJECT_CAST (demux), s));
+
+  if (max_bitrate != current_bandwidth)
+    ret = gst_hls_demux_change_playlist (demux, max_bitrate);
+
+  return ret;
 }
 
 #ifdef HAVE_NETTLE
@@ -1884,6 +2124,183 @@ gst_hls_demux_update_source (GstHLSDemux * demux, const gchar * uri,
   return TRUE;
 }
 
+static void
+gst_hls_prefetch_fragment_free (GstHLSPrefetchFragment * pf)
+{
+  gst_uri_download_future_unref (pf->future);
+  g_free (pf->uri);
+  g_slice_free (GstHLSPrefetchFragment, pf);
+}
+
+/* Queues downloads for the fragments following the ones already in the
+ * prefetch queue. @skip is the number of fragments that were taken from the
+ * queue but not yet advanced over in the playlist */
+static void
+gst_hls_demux_prefetch_schedule (GstHLSDemux * demux, guint skip)
+{
+  GstHLSPrefetchFragment *pf;
+  gboolean forward = demux->segment.rate > 0;
+  const gchar *referer;
+  gboolean allow_cache;
+  guint n;
+
+  if (demux->stop_stream_task)
+    return;
+
+  referer = demux->client->main ? demux->client->main->uri : NULL;
+  allow_cache = demux->client->current ? demux->client->current->allowcache :
+      TRUE;
+
+  g_mutex_lock (&demux->prefetch_lock);
+  for (n = g_queue_get_length (&demux->prefetch_queue);
+      n < demux->prefetch_fragments; n++) {
+    pf = g_slice_new0 (GstHLSPrefetchFragment);
+    if (!gst_m3u8_client_peek_fragment (demux->client, n + skip,
+            &pf->sequence, &pf->uri, &pf->range_start, &pf->range_end,
+            forward)) {
+      g_slice_free (GstHLSPrefetchFragment, pf);
+      break;
+    }
+
+    GST_DEBUG_OBJECT (demux, "Prefetching fragment %" G_GINT64_FORMAT ": %s",
+        pf->sequence, pf->uri);
+    pf->future = gst_uri_downloader_pool_fetch_uri_with_range
+        (demux->prefetch_pool, pf->uri, referer, FALSE, FALSE, allow_cache,
+        pf->range_start, pf->range_end);
+    g_queue_push_tail (&demux->prefetch_queue, pf);
+  }
+  g_mutex_unlock (&demux->prefetch_lock);
+}
+
+/* Cancels the running prefetches and drops all prefetched fragments */
+static void
+gst_hls_demux_prefetch_flush (GstHLSDemux * demux)
+{
+  GstHLSPrefetchFragment *pf;
+
+  g_mutex_lock (&demux->prefetch_lock);
+  while ((pf = g_queue_pop_head (&demux->prefetch_queue))) {
+    gst_uri_download_future_cancel (pf->future);
+    gst_hls_prefetch_fragment_free (pf);
+  }
+  g_mutex_unlock (&demux->prefetch_lock);
+}
+
+/* Takes the fragment at the head of the prefetch queue if it is the one at
+ * the playlist position. Returns NULL if the fragment was not prefetched */
+static GstHLSPrefetchFragment *
+gst_hls_demux_prefetch_take (GstHLSDemux * demux, const gchar * uri,
+    gint64 range_start, gint64 range_end)
+{
+  GstHLSPrefetchFragment *pf;
+  gint64 sequence;
+
+  GST_M3U8_CLIENT_LOCK (demux->client);
+  sequence = demux->client->sequence;
+  GST_M3U8_CLIENT_UNLOCK (demux->client);
+
+  g_mutex_lock (&demux->prefetch_lock);
+  pf = g_queue_peek_head (&demux->prefetch_queue);
+  if (pf == NULL) {
+    g_mutex_unlock (&demux->prefetch_lock);
+    return NULL;
+  }
+
+  if (pf->sequence != sequence || pf->range_start != range_start
+      || pf->range_end != range_end || strcmp (pf->uri, uri) != 0) {
+    g_mutex_unlock (&demux->prefetch_lock);
+    GST_DEBUG_OBJECT (demux, "Prefetched fragments don't follow the playlist "
+        "position anymore, dropping them");
+    gst_hls_demux_prefetch_flush (demux);
+    return NULL;
+  }
+  g_queue_pop_head (&demux->prefetch_queue);
+  g_mutex_unlock (&demux->prefetch_lock);
+
+  return pf;
+}
+
+/* Receives the data of the prefetched fragment being played, from the
+ * download thread while it is downloaded. It goes through the same path as
+ * the data coming from the source element */
+static void
+gst_hls_demux_prefetch_data (GstFragment * fragment, GstBuffer * buffer,
+    gpointer user_data)
+{
+  GstHLSDemux *demux = user_data;
+  GstProxyPad *internal_pad;
+
+  /* downstream stopped, drop the rest of the fragment */
+  if (demux->last_ret != GST_FLOW_OK || demux->stop_stream_task) {
+    gst_buffer_unref (buffer);
+    return;
+  }
+
+  demux->prefetch_pushed = TRUE;
+  internal_pad = gst_proxy_pad_get_internal (GST_PROXY_PAD (demux->srcpad));
+  _src_chain (GST_PAD_CAST (internal_pad), GST_OBJECT_CAST (demux->srcpad),
+      buffer);
+  gst_object_unref (internal_pad);
+}
+
+/* Finishes a streamed prefetched fragment, like the EOS of the source
+ * element does */
+static void
+gst_hls_demux_prefetch_finish (GstHLSDemux * demux)
+{
+  GstProxyPad *internal_pad;
+
+  internal_pad = gst_proxy_pad_get_internal (GST_PROXY_PAD (demux->srcpad));
+  _src_event (GST_PAD_CAST (internal_pad), GST_OBJECT_CAST (demux->srcpad),
+      gst_event_new_eos ());
+  gst_object_unref (internal_pad);
+}
+
+/* Streams the prefetched fragment @pf downstream: the data downloaded so
+ * far is pushed right away and the rest while it arrives, without keeping
+ * the whole fragment in memory. Returns FALSE if the download failed, @err
+ * is then only set if data was pushed already and the fragment can't be
+ * downloaded again from the source element */
+static gboolean
+gst_hls_demux_prefetch_push (GstHLSDemux * demux, GstHLSPrefetchFragment * pf,
+    GError ** err)
+{
+  GstFragment *fragment;
+  GError *fetch_err = NULL;
+
+  demux->prefetch_pushed = FALSE;
+  demux->download_start_time = g_get_monotonic_time ();
+  gst_uri_download_future_set_data_func (pf->future,
+      gst_hls_demux_prefetch_data, demux, NULL);
+
+  /* stopping the streaming task cancels the pool */
+  fragment = gst_uri_download_future_wait (pf->future, &fetch_err);
+  if (fragment == NULL) {
+    GST_INFO_OBJECT (demux, "Prefetching fragment %" G_GINT64_FORMAT
+        " failed: %s", pf->sequence, fetch_err->message);
+    if (demux->prefetch_pushed) {
+      /* drops the data pending decryption */
+      demux->last_ret = GST_FLOW_ERROR;
+      gst_hls_demux_prefetch_finish (demux);
+      g_propagate_error (err, fetch_err);
+    } else {
+      g_clear_error (&fetch_err);
+    }
+    return FALSE;
+  }
+
+  gst_hls_demux_prefetch_finish (demux);
+
+  /* The bitrate is estimated from the time the fragment took to download,
+   * not from the time it took to push it */
+  demux->download_total_time =
+      MAX ((fragment->download_stop_time -
+          fragment->download_start_time) / GST_USECOND, 1);
+  g_object_unref (fragment);
+
+  return TRUE;
+}
+
 static gboolean
 gst_hls_demux_get_next_fragment (GstHLSDemux * demux,
     gboolean * end_of_playlist, GError ** err)
@@ -1905,6 +2322,57 @@ gst_hls_demux_get_next_fragment (GstHLSDemux * demux,
     return FALSE;
   }
 
+  if (demux->prefetch_fragments > 0) {
+    GstHLSPrefetchFragment *pf;
+    gboolean pushed;
+
+    gst_hls_demux_prefetch_schedule (demux, 0);
+    pf = gst_hls_demux_prefetch_take (demux, next_fragment_uri, range_start,
+        range_end);
+    /* Keep the queue filled while this fragment is pushed downstream */
+    gst_hls_demux_prefetch_schedule (demux, 1);
+
+    if (pf != NULL) {
+      GST_DEBUG_OBJECT (demux, "Streaming prefetched fragment %s %"
+          GST_TIME_FORMAT, next_fragment_uri, GST_TIME_ARGS (timestamp));
+
+      demux->current_timestamp = timestamp;
+      demux->current_duration = duration;
+      demux->starting_fragment = TRUE;
+      demux->current_key = key;
+      demux->current_iv = iv;
+      demux->last_ret = GST_FLOW_OK;
+
+      gst_hls_demux_configure_src_pad (demux);
+      pushed = gst_hls_demux_prefetch_push (demux, pf, err);
+      gst_hls_prefetch_fragment_free (pf);
+
+      if (demux->stop_stream_task) {
+        g_clear_error (err);
+        g_set_error (err, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_FAILED,
+            "Fragment download cancelled");
+        return FALSE;
+      }
+
+      if (pushed && demux->last_ret != GST_FLOW_OK) {
+        g_set_error (err, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_FAILED,
+            "Failed to push fragment");
+        return FALSE;
+      }
+
+      if (pushed) {
+        if (demux->segment.rate > 0)
+          demux->segment.position += demux->current_duration;
+        return TRUE;
+      }
+
+      /* Part of the fragment was pushed already */
+      if (*err != NULL)
+        return FALSE;
+    }
+    /* Not prefetched or failed, download it from the source element */
+  }
+
   g_mutex_lock (&demux->fragment_download_lock);
   GST_DEBUG_OBJECT (demux,
       "Fetching next fragment %s %" GST_TIME_FORMAT "(range=%" G_GINT64_FORMAT
@@ -1933,6 +2401,7 @@ gst_hls_demux_get_next_fragment (GstHLSDemux * demux,
   }
 
   gst_hls_demux_configure_src_pad (demux);
+  gst_hls_demux_link_src_pad (demux);
 
   if (gst_element_set_state (demux->src,
           GST_STATE_READY) != GST_STATE_CHANGE_FAILURE) {
@@ -29,6 +29,7 @@
 #include "m3u8.h"
 #include "gstfragmented.h"
 #include <gst/uridownloader/gsturidownloader.h>
+#include <gst/uridownloader/gsturidownloaderpool.h>
 #ifdef HAVE_NETTLE
 #include <nettle/aes.h>
 #include <nettle/cbc.h>
@@ -53,6 +54,23 @@ G_BEGIN_DECLS
   ((GstHLSDemux *)obj)
 typedef struct _GstHLSDemux GstHLSDemux;
 typedef struct _GstHLSDemuxClass GstHLSDemuxClass;
+typedef struct _GstHLSPrefetchFragment GstHLSPrefetchFragment;
+
+#define GST_HLS_DEMUX_MAX_ESTIMATOR_WINDOW 32
+
+/**
+ * GstHLSDemuxBitrateEstimator:
+ * @GST_HLS_DEMUX_ESTIMATOR_EWMA: exponentially weighted moving average
+ * @GST_HLS_DEMUX_ESTIMATOR_HARMONIC_MEAN: harmonic mean over the last
+ *     fragments
+ *
+ * How the download bitrate is estimated from the fragment downloads.
+ */
+typedef enum
+{
+  GST_HLS_DEMUX_ESTIMATOR_EWMA,
+  GST_HLS_DEMUX_ESTIMATOR_HARMONIC_MEAN
+} GstHLSDemuxBitrateEstimator;
 
 /**
  * GstHLSDemux:
@@ -82,6 +100,10 @@ struct _GstHLSDemux
   guint fragments_cache;        /* number of fragments needed to be cached to start playing */
   gfloat bitrate_limit;         /* limit of the available bitrate to use */
   guint connection_speed;       /* Network connection speed in kbps (0 = unknown) */
+  guint prefetch_fragments;     /* number of fragments downloaded ahead (0 = disabled) */
+  GstHLSDemuxBitrateEstimator bitrate_estimator;
+  guint estimator_window;       /* number of fragments the estimate is based on */
+  gfloat switch_hysteresis;     /* bitrate headroom needed before switching up */
 
   /* Streaming task */
   GstTask *stream_task;
@@ -112,6 +134,12 @@ struct _GstHLSDemux
 
   /* Current download rate (bps) */
   gint current_download_rate;
+  /* Ring buffer with the download rates (bps) of the last fragments */
+  gint64 download_rates[GST_HLS_DEMUX_MAX_ESTIMATOR_WINDOW];
+  guint n_download_rates;
+  guint download_rates_idx;     /* where the next rate is stored */
+  GstClockTime buffer_level;    /* data pushed ahead of the clock, or NONE */
+  guint fragments_since_switch;
 
   /* fragment download tooling */
   GstElement *src;
@@ -126,6 +154,12 @@ struct _GstHLSDemux
   gint64 download_total_bytes;
   GstFlowReturn last_ret;
 
+  /* fragment prefetching */
+  GstUriDownloaderPool *prefetch_pool;
+  GMutex prefetch_lock;         /* Protects the queue below */
+  GQueue prefetch_queue;        /* GstHLSPrefetchFragment, in playback order */
+  gboolean prefetch_pushed;     /* data of the streamed prefetch was pushed */
+
   /* decryption tooling */
 #ifdef HAVE_NETTLE
   struct CBC_CTX (struct aes_ctx, AES_BLOCK_SIZE) aes_ctx;
@@ -35,8 +35,10 @@ static void gst_m3u8_free (GstM3U8 * m3u8);
 static gboolean gst_m3u8_update (GstM3U8 * m3u8, gchar * data,
     gboolean * updated);
 static GstM3U8MediaFile *gst_m3u8_media_file_new (gchar * uri,
-    gchar * title, GstClockTime duration, guint sequence);
+    gchar * title, GstClockTime duration, gint64 sequence);
 static void gst_m3u8_media_file_free (GstM3U8MediaFile * self);
+static GstM3U8MediaFile *gst_m3u8_get_file (GstM3U8 * self, gint64 sequence);
+static void gst_m3u8_update_files (GstM3U8 * self, gint64 first_sequence);
 gchar *uri_join (const gchar * uri, const gchar * path);
 
 static GstM3U8 *
@@ -45,6 +47,9 @@ gst_m3u8_new (void)
   GstM3U8 *m3u8;
 
   m3u8 = g_new0 (GstM3U8, 1);
+  m3u8->files =
+      g_ptr_array_new_with_free_func ((GDestroyNotify)
+      gst_m3u8_media_file_free);
 
   return m3u8;
 }
@@ -68,8 +73,7 @@ gst_m3u8_free (GstM3U8 * self)
   g_free (self->codecs);
   g_free (self->key);
 
-  g_list_foreach (self->files, (GFunc) gst_m3u8_media_file_free, NULL);
-  g_list_free (self->files);
+  g_ptr_array_free (self->files, TRUE);
 
   g_free (self->last_data);
   g_list_foreach (self->lists, (GFunc) gst_m3u8_free, NULL);
@@ -82,7 +86,7 @@ gst_m3u8_free (GstM3U8 * self)
 
 static GstM3U8MediaFile *
 gst_m3u8_media_file_new (gchar * uri, gchar * title, GstClockTime duration,
-    guint sequence)
+    gint64 sequence)
 {
   GstM3U8MediaFile *file;
 
@@ -253,6 +257,66 @@ gst_m3u8_compare_playlist_by_bitrate (gconstpointer a, gconstpointer b)
   return ((GstM3U8 *) (a))->bandwidth - ((GstM3U8 *) (b))->bandwidth;
 }
 
+/* Returns the file with the given media sequence, or NULL */
+static GstM3U8MediaFile *
+gst_m3u8_get_file (GstM3U8 * self, gint64 sequence)
+{
+  GstM3U8MediaFile *first;
+
+  if (self->files->len == 0)
+    return NULL;
+
+  first = g_ptr_array_index (self->files, 0);
+  if (sequence < first->sequence
+      || sequence - first->sequence >= self->files->len)
+    return NULL;
+
+  return g_ptr_array_index (self->files, sequence - first->sequence);
+}
+
+/* Drops the files that are not in the playlist anymore, given the media
+ * sequence of its first file. The files are indexed by media sequence, so
+ * everything is dropped if the new files don't directly follow the ones we
+ * have, e.g. when the sequence numbers restarted */
+static void
+gst_m3u8_update_files (GstM3U8 * self, gint64 first_sequence)
+{
+  GstM3U8MediaFile *first, *last;
+
+  if (self->files->len == 0)
+    return;
+
+  first = g_ptr_array_index (self->files, 0);
+  last = g_ptr_array_index (self->files, self->files->len - 1);
+
+  if (first_sequence < first->sequence || first_sequence > last->sequence + 1) {
+    GST_DEBUG ("Media sequence %" G_GINT64_FORMAT " doesn't follow the "
+        "previous playlist, dropping all files", first_sequence);
+    g_ptr_array_set_size (self->files, 0);
+  } else if (first_sequence > first->sequence) {
+    GST_DEBUG ("Dropping %u expired files",
+        (guint) (first_sequence - first->sequence));
+    g_ptr_array_remove_range (self->files, 0,
+        first_sequence - first->sequence);
+  }
+}
+
+/* Sum of the durations of all files, in O(1) thanks to the cumulative
+ * start positions */
+static GstClockTime
+gst_m3u8_get_duration (GstM3U8 * self)
+{
+  GstM3U8MediaFile *first, *last;
+
+  if (self->files->len == 0)
+    return 0;
+
+  first = g_ptr_array_index (self->files, 0);
+  last = g_ptr_array_index (self->files, self->files->len - 1);
+
+  return last->start + last->duration - first->start;
+}
+
 /*
  * @data: a m3u8 playlist text data, taking ownership
  */
@@ -267,6 +331,8 @@ gst_m3u8_update (GstM3U8 * self, gchar * data, gboolean * updated)
   gboolean have_iv = FALSE;
   guint8 iv[16] = { 0, };
   gint64 size = -1, offset = -1;
+  GstM3U8MediaFile *prev = NULL;
+  gboolean first_file = TRUE;
 
   g_return_val_if_fail (self != NULL, FALSE);
   g_return_val_if_fail (data != NULL, FALSE);
@@ -292,11 +358,9 @@ gst_m3u8_update (GstM3U8 * self, gchar * data, gboolean * updated)
   g_free (self->last_data);
   self->last_data = data;
 
-  if (self->files) {
-    g_list_foreach (self->files, (GFunc) gst_m3u8_media_file_free, NULL);
-    g_list_free (self->files);
-    self->files = NULL;
-  }
+  /* The files we already know about are kept and only the new ones at the
+   * end of the playlist are added, see gst_m3u8_update_files() */
+  self->mediasequence = 0;
 
   /* By default, allow caching */
   self->allowcache = TRUE;
@@ -322,11 +386,11 @@ gst_m3u8_update (GstM3U8 * self, gchar * data, gboolean * updated)
         goto next_line;
       }
 
-      data = uri_join (self->uri, data);
-      if (data == NULL)
-        goto next_line;
-
       if (list != NULL) {
+        data = uri_join (self->uri, data);
+        if (data == NULL)
+          goto next_line;
+
         if (g_list_find_custom (self->lists, data,
                 (GCompareFunc) _m3u8_compare_uri)) {
           GST_DEBUG ("Already have a list with this URI");
@@ -339,9 +403,28 @@ gst_m3u8_update (GstM3U8 * self, gchar * data, gboolean * updated)
         list = NULL;
       } else {
         GstM3U8MediaFile *file;
-        file =
-            gst_m3u8_media_file_new (data, title, duration,
-            self->mediasequence++);
+        gint64 sequence = self->mediasequence;
+
+        if (first_file) {
+          gst_m3u8_update_files (self, sequence);
+          first_file = FALSE;
+        }
+
+        file = gst_m3u8_get_file (self, sequence);
+        if (file != NULL) {
+          /* Already known, media sequence numbers identify files, so its
+           * URI doesn't need to be joined again */
+          self->mediasequence++;
+          g_free (title);
+          goto next_file;
+        }
+
+        data = uri_join (self->uri, data);
+        if (data == NULL)
+          goto next_line;
+        self->mediasequence++;
+
+        file = gst_m3u8_media_file_new (data, title, duration, sequence);
 
         /* set encryption params */
         file->key = g_strdup (self->key);
@@ -349,8 +432,7 @@ gst_m3u8_update (GstM3U8 * self, gchar * data, gboolean * updated)
           if (have_iv) {
             memcpy (file->iv, iv, sizeof (iv));
           } else {
-            guint8 *iv = file->iv + 12;
-            GST_WRITE_UINT32_BE (iv + 12, file->sequence);
+            GST_WRITE_UINT32_BE (file->iv + 12, file->sequence);
           }
         }
 
@@ -358,15 +440,10 @@ gst_m3u8_update (GstM3U8 * self, gchar * data, gboolean * updated)
           file->size = size;
           if (offset != -1) {
             file->offset = offset;
+          } else if (prev) {
+            file->offset = prev->offset + prev->size;
           } else {
-            GstM3U8MediaFile *prev =
-                self->files ? g_list_last (self->files)->data : NULL;
-
-            if (!prev) {
-              offset = 0;
-            } else {
-              offset = prev->offset + prev->size;
-            }
+            file->offset = 0;
           }
         } else {
           file->size = -1;
@@ -375,11 +452,20 @@ gst_m3u8_update (GstM3U8 * self, gchar * data, gboolean * updated)
 
         file->discont = discontinuity;
 
+        if (self->files->len > 0) {
+          GstM3U8MediaFile *last = g_ptr_array_index (self->files,
+              self->files->len - 1);
+
+          file->start = last->start + last->duration;
+        }
+        g_ptr_array_add (self->files, file);
+
+      next_file:
+        prev = file;
         duration = 0;
         title = NULL;
         discontinuity = FALSE;
         size = offset = -1;
-        self->files = g_list_append (self->files, file);
       }
 
     } else if (g_str_has_prefix (data, "#EXT-X-ENDLIST")) {
@@ -558,6 +644,10 @@ gst_m3u8_update (GstM3U8 * self, gchar * data, gboolean * updated)
     data = g_utf8_next_char (end);      /* skip \n */
   }
 
+  /* No media files in the playlist anymore */
+  if (first_file)
+    g_ptr_array_set_size (self->files, 0);
+
   /* reorder playlists by bitrate */
   if (self->lists) {
     gchar *top_variant_uri = NULL;
@@ -652,7 +742,7 @@ gst_m3u8_client_update (GstM3U8Client * self, gchar * data)
     goto out;
   }
 
-  if (self->current && !self->current->files) {
+  if (self->current && self->current->files->len == 0) {
     GST_ERROR ("Invalid media playlist, it does not contain any media files");
     goto out;
   }
@@ -666,9 +756,9 @@ gst_m3u8_client_update (GstM3U8Client * self, gchar * data)
     }
   }
 
-  if (m3u8->files && self->sequence == -1) {
+  if (m3u8->files->len > 0 && self->sequence == -1) {
     self->sequence =
-        GST_M3U8_MEDIA_FILE (g_list_first (m3u8->files)->data)->sequence;
+        GST_M3U8_MEDIA_FILE (g_ptr_array_index (m3u8->files, 0))->sequence;
     self->sequence_position = 0;
     GST_DEBUG ("Setting first sequence at %u", (guint) self->sequence);
   }
@@ -679,32 +769,29 @@ out:
   return ret;
 }
 
-static gboolean
-_find_current (GstM3U8MediaFile * file, GstM3U8Client * client)
-{
-  return file->sequence != client->sequence;
-}
-
-static GList *
-find_next_fragment (GstM3U8Client * client, GList * l, gboolean forward)
+/* Returns the index of the file with the client's sequence, or of the
+ * closest one in the playback direction, or -1 if there is none */
+static gint
+find_next_fragment (GstM3U8Client * client, GPtrArray * files, gboolean forward)
 {
-  GstM3U8MediaFile *file;
+  GstM3U8MediaFile *first;
+  gint64 idx;
 
-  if (!forward)
-    l = g_list_last (l);
+  if (files->len == 0)
+    return -1;
 
-  while (l) {
-    file = l->data;
-
-    if (forward && file->sequence >= client->sequence)
-      break;
-    else if (!forward && file->sequence <= client->sequence)
-      break;
+  first = g_ptr_array_index (files, 0);
+  idx = client->sequence - first->sequence;
 
-    l = (forward ? l->next : l->prev);
+  if (forward) {
+    if (idx >= files->len)
+      return -1;
+    return MAX (idx, 0);
+  } else {
+    if (idx < 0)
+      return -1;
+    return MIN (idx, files->len - 1);
   }
-
-  return l;
 }
 
 gboolean
@@ -713,8 +800,8 @@ gst_m3u8_client_get_next_fragment (GstM3U8Client * client,
     GstClockTime * timestamp, gint64 * range_start, gint64 * range_end,
     const gchar ** key, const guint8 ** iv, gboolean forward)
 {
-  GList *l;
   GstM3U8MediaFile *file;
+  gint idx;
 
   g_return_val_if_fail (client != NULL, FALSE);
   g_return_val_if_fail (client->current != NULL, FALSE);
@@ -725,13 +812,13 @@ gst_m3u8_client_get_next_fragment (GstM3U8Client * client,
     GST_M3U8_CLIENT_UNLOCK (client);
     return FALSE;
   }
-  l = find_next_fragment (client, client->current->files, forward);
-  if (!l) {
+  idx = find_next_fragment (client, client->current->files, forward);
+  if (idx < 0) {
     GST_M3U8_CLIENT_UNLOCK (client);
     return FALSE;
   }
 
-  file = GST_M3U8_MEDIA_FILE (l->data);
+  file = g_ptr_array_index (client->current->files, idx);
   GST_DEBUG ("Got fragment with sequence %u (client sequence %u)",
       (guint) file->sequence, (guint) client->sequence);
 
@@ -759,10 +846,50 @@ gst_m3u8_client_get_next_fragment (GstM3U8Client * client,
   return TRUE;
 }
 
+/* Looks up the fragment @n positions after the next one (0 being the next
+ * fragment) without moving the client. The returned uri must be freed */
+gboolean
+gst_m3u8_client_peek_fragment (GstM3U8Client * client, guint n,
+    gint64 * sequence, gchar ** uri, gint64 * range_start,
+    gint64 * range_end, gboolean forward)
+{
+  GstM3U8MediaFile *file;
+  gint idx;
+
+  g_return_val_if_fail (client != NULL, FALSE);
+  g_return_val_if_fail (client->current != NULL, FALSE);
+
+  GST_M3U8_CLIENT_LOCK (client);
+  if (client->sequence < 0) {
+    GST_M3U8_CLIENT_UNLOCK (client);
+    return FALSE;
+  }
+
+  idx = find_next_fragment (client, client->current->files, forward);
+  if (idx >= 0)
+    idx = forward ? idx + n : idx - (gint) n;
+  if (idx < 0 || (guint) idx >= client->current->files->len) {
+    GST_M3U8_CLIENT_UNLOCK (client);
+    return FALSE;
+  }
+
+  file = g_ptr_array_index (client->current->files, idx);
+  if (sequence)
+    *sequence = file->sequence;
+  if (uri)
+    *uri = g_strdup (file->uri);
+  if (range_start)
+    *range_start = file->offset;
+  if (range_end)
+    *range_end = file->size != -1 ? file->offset + file->size - 1 : -1;
+
+  GST_M3U8_CLIENT_UNLOCK (client);
+  return TRUE;
+}
+
 void
 gst_m3u8_client_advance_fragment (GstM3U8Client * client, gboolean forward)
 {
-  GList *l;
   GstM3U8MediaFile *file;
 
   g_return_if_fail (client != NULL);
@@ -770,15 +897,13 @@ gst_m3u8_client_advance_fragment (GstM3U8Client * client, gboolean forward)
 
   GST_M3U8_CLIENT_LOCK (client);
   GST_DEBUG ("Looking for fragment %" G_GINT64_FORMAT, client->sequence);
-  l = g_list_find_custom (client->current->files, client,
-      (GCompareFunc) _find_current);
-  if (l == NULL) {
+  file = gst_m3u8_get_file (client->current, client->sequence);
+  if (file == NULL) {
     GST_ERROR ("Could not find current fragment");
     GST_M3U8_CLIENT_UNLOCK (client);
     return;
   }
 
-  file = GST_M3U8_MEDIA_FILE (l->data);
   GST_DEBUG ("Advancing from sequence %u", (guint) file->sequence);
   if (forward) {
     client->sequence = file->sequence + 1;
@@ -793,12 +918,6 @@ gst_m3u8_client_advance_fragment (GstM3U8Client * client, gboolean forward)
   GST_M3U8_CLIENT_UNLOCK (client);
 }
 
-static void
-_sum_duration (GstM3U8MediaFile * self, GstClockTime * duration)
-{
-  *duration += self->duration;
-}
-
 GstClockTime
 gst_m3u8_client_get_duration (GstM3U8Client * client)
 {
@@ -812,12 +931,65 @@ gst_m3u8_client_get_duration (GstM3U8Client * client)
     GST_M3U8_CLIENT_UNLOCK (client);
     return GST_CLOCK_TIME_NONE;
   }
-  if (client->current->files)
-    g_list_foreach (client->current->files, (GFunc) _sum_duration, &duration);
+  duration = gst_m3u8_get_duration (client->current);
   GST_M3U8_CLIENT_UNLOCK (client);
   return duration;
 }
 
+/* Looks up the fragment containing @position, relative to the first file of
+ * the current playlist, and the position at which it starts. Returns FALSE
+ * if @position is after the end of the playlist, in which case @sequence
+ * and @start are those just after its last fragment */
+gboolean
+gst_m3u8_client_find_fragment_at_position (GstM3U8Client * client,
+    GstClockTime position, gint64 * sequence, GstClockTime * start)
+{
+  GstM3U8MediaFile *first, *file;
+  GPtrArray *files;
+  guint lo, hi, mid;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (client != NULL, FALSE);
+  g_return_val_if_fail (client->current != NULL, FALSE);
+
+  GST_M3U8_CLIENT_LOCK (client);
+  files = client->current->files;
+  if (files->len == 0) {
+    *sequence = client->current->mediasequence;
+    *start = 0;
+    goto out;
+  }
+
+  first = g_ptr_array_index (files, 0);
+  if (position >= gst_m3u8_get_duration (client->current)) {
+    file = g_ptr_array_index (files, files->len - 1);
+    *sequence = file->sequence + 1;
+    *start = file->start + file->duration - first->start;
+    goto out;
+  }
+
+  /* last file starting at or before position */
+  lo = 0;
+  hi = files->len - 1;
+  while (lo < hi) {
+    mid = lo + (hi - lo + 1) / 2;
+    file = g_ptr_array_index (files, mid);
+    if (file->start - first->start <= position)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+
+  file = g_ptr_array_index (files, lo);
+  *sequence = file->sequence;
+  *start = file->start - first->start;
+  ret = TRUE;
+
+out:
+  GST_M3U8_CLIENT_UNLOCK (client);
+  return ret;
+}
+
 GstClockTime
 gst_m3u8_client_get_target_duration (GstM3U8Client * client)
 {
@@ -973,18 +1145,17 @@ guint64
 gst_m3u8_client_get_current_fragment_duration (GstM3U8Client * client)
 {
   guint64 dur;
-  GList *list;
+  GstM3U8MediaFile *file;
 
   g_return_val_if_fail (client != NULL, 0);
 
   GST_M3U8_CLIENT_LOCK (client);
 
-  list = g_list_find_custom (client->current->files, client,
-      (GCompareFunc) _find_current);
-  if (list == NULL) {
+  file = gst_m3u8_get_file (client->current, client->sequence);
+  if (file == NULL) {
     dur = -1;
   } else {
-    dur = GST_M3U8_MEDIA_FILE (list->data)->duration;
+    dur = file->duration;
   }
 
   GST_M3U8_CLIENT_UNLOCK (client);
@@ -51,7 +51,8 @@ struct _GstM3U8
   gint width;
   gint height;
   gboolean iframe;
-  GList *files;
+  GPtrArray *files;             /* GstM3U8MediaFile, indexed by media sequence
+                                 * relative to the first one */
 
   /*< private > */
   gchar *last_data;
@@ -72,6 +73,8 @@ struct _GstM3U8MediaFile
   gchar *key;
   guint8 iv[16];
   gint64 offset, size;
+  GstClockTime start;           /* sum of the durations of all the previous
+                                 * files since the playlist was first parsed */
 };
 
 struct _GstM3U8Client
@@ -93,8 +96,13 @@ gboolean gst_m3u8_client_get_next_fragment (GstM3U8Client * client,
     gboolean * discontinuity, const gchar ** uri, GstClockTime * duration,
     GstClockTime * timestamp, gint64 * range_start, gint64 * range_end,
     const gchar ** key, const guint8 ** iv, gboolean forward);
+gboolean gst_m3u8_client_peek_fragment (GstM3U8Client * client, guint n,
+    gint64 * sequence, gchar ** uri, gint64 * range_start, gint64 * range_end,
+    gboolean forward);
 void gst_m3u8_client_advance_fragment (GstM3U8Client * client, gboolean forward);
 GstClockTime gst_m3u8_client_get_duration (GstM3U8Client * client);
+gboolean gst_m3u8_client_find_fragment_at_position (GstM3U8Client * client,
+    GstClockTime position, gint64 * sequence, GstClockTime * start);
 GstClockTime gst_m3u8_client_get_target_duration (GstM3U8Client * client);
 const gchar *gst_m3u8_client_get_uri(GstM3U8Client * client);
 const gchar *gst_m3u8_client_get_current_uri(GstM3U8Client * client);
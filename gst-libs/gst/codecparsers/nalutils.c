@@ -63,6 +63,63 @@ ceil_log2 (guint32 v)
 
 /****** Nal parser ******/
 
+/* Size of the chunks in which emulation prevention bytes are looked for,
+ * so that reading a header doesn't scan the whole NAL */
+#define NAL_READER_EPB_WINDOW 64
+
+#define HAS_ZERO_BYTE(x) \
+  (((x) - G_GUINT64_CONSTANT (0x0101010101010101)) & ~(x) & \
+   G_GUINT64_CONSTANT (0x8080808080808080))
+
+/* Returns the position of the first zero byte in @data between @pos and
+ * @end, or @end. Looks at 8 bytes at a time */
+static inline guint
+find_zero_byte (const guint8 * data, guint pos, guint end)
+{
+  guint64 x;
+
+  while (pos + 8 <= end) {
+    memcpy (&x, data + pos, 8);
+    if (HAS_ZERO_BYTE (x))
+      break;
+    pos += 8;
+  }
+
+  while (pos < end && data[pos] != 0)
+    pos++;
+
+  return pos;
+}
+
+/* Looks for the next emulation_prevention_three_byte from @from, in a
+ * window of NAL_READER_EPB_WINDOW bytes */
+static void
+nal_reader_scan_epb (NalReader * nr, guint from)
+{
+  const guint8 *data = nr->data;
+  guint limit = MIN (nr->size, from + NAL_READER_EPB_WINDOW);
+  guint pos;
+
+  /* Look for the 0x00 0x00 0x03 pattern whose 0x03 is in [from, limit) */
+  pos = MAX (from, 2) - 2;
+  pos = MAX (pos, nr->epb_zero_pos);
+
+  while (pos + 2 < limit) {
+    pos = find_zero_byte (data, pos, limit - 2);
+    if (pos + 2 >= limit)
+      break;
+    if (data[pos + 1] == 0x00 && data[pos + 2] == 0x03) {
+      nr->next_epb = pos + 2;
+      nr->is_epb = TRUE;
+      return;
+    }
+    pos++;
+  }
+
+  nr->next_epb = limit;
+  nr->is_epb = FALSE;
+}
+
 void
 nal_reader_init (NalReader * nr, const guint8 * data, guint size)
 {
@@ -72,14 +129,21 @@ nal_reader_init (NalReader * nr, const guint8 * data, guint size)
 
   nr->byte = 0;
   nr->bits_in_cache = 0;
-  /* fill with something other than 0 to detect emulation prevention bytes */
-  nr->first_byte = 0xff;
-  nr->cache = 0xff;
+  nr->cache = 0;
+
+  nr->epb_zero_pos = 0;
+  nal_reader_scan_epb (nr, 0);
 }
 
+/* Makes sure there are at least @nbits (up to 32) bits in the cache.
+ * Emulation prevention bytes are only skipped (and counted) when the bits
+ * after them are needed */
 inline gboolean
 nal_reader_read (NalReader * nr, guint nbits)
 {
+  if (G_LIKELY (nr->bits_in_cache >= nbits))
+    return TRUE;
+
   if (G_UNLIKELY (nr->byte * 8 + (nbits - nr->bits_in_cache) > nr->size * 8)) {
     GST_DEBUG ("Can not read %u bits, bits in cache %u, Byte * 8 %u, size in "
         "bits %u", nbits, nr->bits_in_cache, nr->byte * 8, nr->size * 8);
@@ -87,27 +151,34 @@ nal_reader_read (NalReader * nr, guint nbits)
   }
 
   while (nr->bits_in_cache < nbits) {
-    guint8 byte;
-    gboolean check_three_byte;
-
-    check_three_byte = TRUE;
-  next_byte:
-    if (G_UNLIKELY (nr->byte >= nr->size))
-      return FALSE;
-
-    byte = nr->data[nr->byte++];
+    if (G_UNLIKELY (nr->byte == nr->next_epb)) {
+      if (nr->byte >= nr->size)
+        return FALSE;
+
+      /* skip the emulation_prevention_three_byte, the next byte goes to
+       * the cache unconditionally, even if it's 0x03 */
+      if (nr->is_epb) {
+        nr->n_epb++;
+        nr->byte++;
+        nr->epb_zero_pos = nr->byte;
+      }
+      nal_reader_scan_epb (nr, nr->byte);
+      continue;
+    }
 
-    /* check if the byte is a emulation_prevention_three_byte */
-    if (check_three_byte && byte == 0x03 && nr->first_byte == 0x00 &&
-        ((nr->cache & 0xff) == 0)) {
-      /* next byte goes unconditionally to the cache, even if it's 0x03 */
-      check_three_byte = FALSE;
-      nr->n_epb++;
-      goto next_byte;
+    if (G_LIKELY (nr->byte + 8 <= nr->next_epb)) {
+      /* Fill the cache with as many whole bytes as possible at once */
+      guint n = (63 - nr->bits_in_cache) >> 3;
+
+      nr->cache |= GST_READ_UINT64_BE (nr->data + nr->byte) >>
+          nr->bits_in_cache;
+      nr->byte += n;
+      nr->bits_in_cache += n * 8;
+      nr->cache &= ~(G_MAXUINT64 >> nr->bits_in_cache);
+    } else {
+      nr->cache |= (guint64) nr->data[nr->byte++] << (56 - nr->bits_in_cache);
+      nr->bits_in_cache += 8;
     }
-    nr->cache = (nr->cache << 8) | nr->first_byte;
-    nr->first_byte = byte;
-    nr->bits_in_cache += 8;
   }
 
   return TRUE;
@@ -116,9 +187,18 @@ nal_reader_read (NalReader * nr, guint nbits)
 inline gboolean
 nal_reader_skip (NalReader * nr, guint nbits)
 {
+  while (nbits > 32) {
+    if (G_UNLIKELY (!nal_reader_read (nr, 32)))
+      return FALSE;
+    nr->cache <<= 32;
+    nr->bits_in_cache -= 32;
+    nbits -= 32;
+  }
+
   if (G_UNLIKELY (!nal_reader_read (nr, nbits)))
     return FALSE;
 
+  nr->cache <<= nbits;
   nr->bits_in_cache -= nbits;
 
   return TRUE;
@@ -146,21 +226,14 @@ nal_reader_get_epb_count (const NalReader * nr)
 gboolean \
 nal_reader_get_bits_uint##bits (NalReader *nr, guint##bits *val, guint nbits) \
 { \
-  guint shift; \
-  \
   if (!nal_reader_read (nr, nbits)) \
     return FALSE; \
   \
-  /* bring the required bits down and truncate */ \
-  shift = nr->bits_in_cache - nbits; \
-  *val = nr->first_byte >> shift; \
+  /* the required bits are at the top of the cache */ \
+  *val = nbits ? nr->cache >> (64 - nbits) : 0; \
   \
-  *val |= nr->cache << (8 - shift); \
-  /* mask out required bits */ \
-  if (nbits < bits) \
-    *val &= ((guint##bits)1 << nbits) - 1; \
-  \
-  nr->bits_in_cache = shift; \
+  nr->cache <<= nbits; \
+  nr->bits_in_cache -= nbits; \
   \
   return TRUE; \
 } \
@@ -188,6 +261,25 @@ nal_reader_get_ue (NalReader * nr, guint32 * val)
   guint8 bit;
   guint32 value;
 
+#ifdef __GNUC__
+  /* Fast path when the whole code is already in the cache. The cache is
+   * not refilled here, so that emulation prevention bytes are still only
+   * counted when needed */
+  if (G_LIKELY (nr->cache != 0)) {
+    i = __builtin_clzll (nr->cache);
+    if (G_LIKELY (i < 32 && 2 * i + 1 <= nr->bits_in_cache)) {
+      nr->cache <<= i;
+      /* the leading 1 and the i bits following it */
+      value = nr->cache >> (63 - i);
+      nr->cache <<= i + 1;
+      nr->bits_in_cache -= 2 * i + 1;
+      *val = value - 1;
+      return TRUE;
+    }
+    i = 0;
+  }
+#endif
+
   if (G_UNLIKELY (!nal_reader_get_bits_uint8 (nr, &bit, 1))) {
 
     return FALSE;
@@ -230,7 +322,7 @@ nal_reader_get_se (NalReader * nr, gint32 * val)
 gboolean
 nal_reader_is_byte_aligned (NalReader * nr)
 {
-  if (nr->bits_in_cache != 0)
+  if (nr->bits_in_cache % 8 != 0)
     return FALSE;
   return TRUE;
 }
@@ -281,10 +373,17 @@ nal_reader_has_more_data (NalReader * nr)
 inline gint
 scan_for_start_codes (const guint8 * data, guint size)
 {
-  GstByteReader br;
-  gst_byte_reader_init (&br, data, size);
+  guint pos = 0;
 
   /* NALU not empty, so we can at least expect 1 (even 2) bytes following sc */
-  return gst_byte_reader_masked_scan_uint32 (&br, 0xffffff00, 0x00000100,
-      0, size);
+  while (pos + 3 < size) {
+    pos = find_zero_byte (data, pos, size - 3);
+    if (pos + 3 >= size)
+      break;
+    if (data[pos + 1] == 0x00 && data[pos + 2] == 0x01)
+      return pos;
+    pos++;
+  }
+
+  return -1;
 }
@@ -48,9 +48,15 @@ typedef struct
 
   guint n_epb;                  /* Number of emulation prevention bytes */
   guint byte;                   /* Byte position */
-  guint bits_in_cache;          /* bitpos in the cache of next bit */
-  guint8 first_byte;
-  guint64 cache;                /* cached bytes */
+  guint bits_in_cache;          /* Number of valid bits in the cache */
+  guint64 cache;                /* cached bits, next one is the MSB */
+
+  /* Bytes before next_epb are not emulation prevention bytes, next_epb
+   * is one if is_epb is set. Zero bytes before epb_zero_pos belong to the
+   * last emulation prevention byte */
+  guint next_epb;
+  gboolean is_epb;
+  guint epb_zero_pos;
 } NalReader;
 
 void nal_reader_init (NalReader * nr, const guint8 * data, guint size);
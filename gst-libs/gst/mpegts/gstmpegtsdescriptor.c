@@ -648,20 +648,31 @@ _packetize_descriptor_array (GPtrArray * array, guint8 ** out_data)
   }
 }
 
+/* The descriptor and its data are allocated in one block, which halves the
+ * number of allocations done when parsing descriptor loops */
+static inline GstMpegTsDescriptor *
+_alloc_descriptor (gsize data_size)
+{
+  GstMpegTsDescriptor *descriptor;
+
+  descriptor = g_malloc (sizeof (GstMpegTsDescriptor) + data_size);
+  descriptor->data = (guint8 *) (descriptor + 1);
+
+  return descriptor;
+}
+
 GstMpegTsDescriptor *
 _new_descriptor (guint8 tag, guint8 length)
 {
   GstMpegTsDescriptor *descriptor;
   guint8 *data;
 
-  descriptor = g_slice_new (GstMpegTsDescriptor);
+  descriptor = _alloc_descriptor (length + 2);
 
   descriptor->tag = tag;
   descriptor->tag_extension = 0;
   descriptor->length = length;
 
-  descriptor->data = g_malloc (length + 2);
-
   data = descriptor->data;
 
   *data++ = descriptor->tag;
@@ -676,14 +687,12 @@ _new_descriptor_with_extension (guint8 tag, guint8 tag_extension, guint8 length)
   GstMpegTsDescriptor *descriptor;
   guint8 *data;
 
-  descriptor = g_slice_new (GstMpegTsDescriptor);
+  descriptor = _alloc_descriptor (length + 3);
 
   descriptor->tag = tag;
   descriptor->tag_extension = tag_extension;
   descriptor->length = length;
 
-  descriptor->data = g_malloc (length + 3);
-
   data = descriptor->data;
 
   *data++ = descriptor->tag;
@@ -698,8 +707,11 @@ _copy_descriptor (GstMpegTsDescriptor * desc)
 {
   GstMpegTsDescriptor *copy;
 
-  copy = g_slice_dup (GstMpegTsDescriptor, desc);
-  copy->data = g_memdup (desc->data, desc->length + 2);
+  copy = _alloc_descriptor (desc->length + 2);
+  copy->tag = desc->tag;
+  copy->tag_extension = desc->tag_extension;
+  copy->length = desc->length;
+  memcpy (copy->data, desc->data, desc->length + 2);
 
   return copy;
 }
@@ -707,8 +719,7 @@ _copy_descriptor (GstMpegTsDescriptor * desc)
 void
 _free_descriptor (GstMpegTsDescriptor * desc)
 {
-  g_free ((gpointer) desc->data);
-  g_slice_free (GstMpegTsDescriptor, desc);
+  g_free (desc);
 }
 
 G_DEFINE_BOXED_TYPE (GstMpegTsDescriptor, gst_mpegts_descriptor,
@@ -772,13 +783,12 @@ gst_mpegts_parse_descriptors (guint8 * buffer, gsize buf_len)
   data = buffer;
 
   for (i = 0; i < nb_desc; i++) {
-    GstMpegTsDescriptor *desc = g_slice_new0 (GstMpegTsDescriptor);
+    GstMpegTsDescriptor *desc = _alloc_descriptor (data[1] + 2);
 
-    desc->data = data;
+    memcpy (desc->data, data, data[1] + 2);
     desc->tag = *data++;
     desc->length = *data++;
-    /* Copy the data now that we known the size */
-    desc->data = g_memdup (desc->data, desc->length + 2);
+    desc->tag_extension = 0;
     GST_LOG ("descriptor 0x%02x length:%d", desc->tag, desc->length);
     GST_MEMDUMP ("descriptor", desc->data + 2, desc->length);
     /* extended descriptors */
@@ -127,19 +127,128 @@ static const guint32 crc_tab[256] = {
   0xbcb4666d, 0xb8757bda, 0xb5365d03, 0xb1f740b4
 };
 
+/* crc_tab_8[n][i] is the CRC contribution of byte i followed by n zero
+ * bytes. It allows _calc_crc32 to consume 8 bytes per iteration
+ * ("slicing-by-8") instead of one. crc_tab_8[0] is crc_tab */
+static guint32 crc_tab_8[8][256];
+
+static void
+_init_crc_tables (void)
+{
+  guint i, n;
+
+  memcpy (crc_tab_8[0], crc_tab, sizeof (crc_tab));
+  for (n = 1; n < 8; n++) {
+    for (i = 0; i < 256; i++) {
+      guint32 crc = crc_tab_8[n - 1][i];
+      crc_tab_8[n][i] = (crc << 8) ^ crc_tab[crc >> 24];
+    }
+  }
+}
+
 /* _calc_crc32 relicenced to LGPL from fluendo ts demuxer */
 guint32
 _calc_crc32 (const guint8 * data, guint datalen)
 {
-  gint i;
+  static gsize tables_initialized = 0;
   guint32 crc = 0xffffffff;
+  guint32 next;
 
-  for (i = 0; i < datalen; i++) {
-    crc = (crc << 8) ^ crc_tab[((crc >> 24) ^ *data++) & 0xff];
+  if (g_once_init_enter (&tables_initialized)) {
+    _init_crc_tables ();
+    g_once_init_leave (&tables_initialized, 1);
   }
+
+  while (datalen >= 8) {
+    crc ^= GST_READ_UINT32_BE (data);
+    next = GST_READ_UINT32_BE (data + 4);
+    crc = crc_tab_8[7][crc >> 24] ^
+        crc_tab_8[6][(crc >> 16) & 0xff] ^
+        crc_tab_8[5][(crc >> 8) & 0xff] ^
+        crc_tab_8[4][crc & 0xff] ^
+        crc_tab_8[3][next >> 24] ^
+        crc_tab_8[2][(next >> 16) & 0xff] ^
+        crc_tab_8[1][(next >> 8) & 0xff] ^ crc_tab_8[0][next & 0xff];
+    data += 8;
+    datalen -= 8;
+  }
+
+  while (datalen--)
+    crc = (crc << 8) ^ crc_tab[((crc >> 24) ^ *data++) & 0xff];
+
   return crc;
 }
 
+/* Cache of sections whose CRC was already verified, used to avoid
+ * re-checking repeated (unchanged) sections when enabled with
+ * gst_mpegts_set_skip_validated_crc() */
+#define VALIDATED_CRC_CACHE_MAX 4096
+
+typedef struct
+{
+  /* pid, table_id, subtable_extension and section_number */
+  gint64 key;
+  guint8 version_number;
+  guint section_length;
+  guint32 crc;
+} ValidatedCrc;
+
+static gboolean skip_validated_crc = FALSE;
+static GHashTable *validated_crcs = NULL;
+G_LOCK_DEFINE_STATIC (validated_crcs);
+
+static inline gint64
+_validated_crc_key (GstMpegTsSection * section)
+{
+  return ((gint64) section->pid << 40) | ((gint64) section->table_id << 32) |
+      ((gint64) section->subtable_extension << 16) | section->section_number;
+}
+
+static gboolean
+_section_crc_is_valid (GstMpegTsSection * section)
+{
+  ValidatedCrc *entry;
+  gint64 key;
+  guint32 crc;
+
+  if (!skip_validated_crc)
+    return _calc_crc32 (section->data, section->section_length) == 0;
+
+  key = _validated_crc_key (section);
+  crc = GST_READ_UINT32_BE (section->data + section->section_length - 4);
+
+  G_LOCK (validated_crcs);
+  entry = validated_crcs ? g_hash_table_lookup (validated_crcs, &key) : NULL;
+  if (entry && entry->version_number == section->version_number &&
+      entry->section_length == section->section_length && entry->crc == crc) {
+    G_UNLOCK (validated_crcs);
+    GST_LOG ("PID:0x%04x table_id:0x%02x, CRC 0x%08x already validated",
+        section->pid, section->table_id, crc);
+    return TRUE;
+  }
+  G_UNLOCK (validated_crcs);
+
+  if (_calc_crc32 (section->data, section->section_length) != 0)
+    return FALSE;
+
+  G_LOCK (validated_crcs);
+  if (validated_crcs == NULL)
+    validated_crcs = g_hash_table_new_full (g_int64_hash, g_int64_equal, NULL,
+        g_free);
+  else if (g_hash_table_size (validated_crcs) >= VALIDATED_CRC_CACHE_MAX)
+    g_hash_table_remove_all (validated_crcs);
+
+  entry = g_new (ValidatedCrc, 1);
+  entry->key = key;
+  entry->version_number = section->version_number;
+  entry->section_length = section->section_length;
+  entry->crc = crc;
+  g_hash_table_replace (validated_crcs, &entry->key, entry);
+  G_UNLOCK (validated_crcs);
+
+  return TRUE;
+}
+
 gpointer
 __common_section_checks (GstMpegTsSection * section, guint min_size,
     GstMpegTsParseFunc parsefunc, GDestroyNotify destroynotify)
@@ -155,8 +264,7 @@ __common_section_checks (GstMpegTsSection * section, guint min_size,
   }
 
   /* If section has a CRC, check it */
-  if (!section->short_section
-      && (_calc_crc32 (section->data, section->section_length) != 0)) {
+  if (!section->short_section && !_section_crc_is_valid (section)) {
     GST_WARNING ("PID:0x%04x table_id:0x%02x, Bad CRC on section", section->pid,
         section->table_id);
     return NULL;
@@ -1010,6 +1118,31 @@ gst_mpegts_initialize (void)
   __initialize_descriptors ();
 }
 
+/**
+ * gst_mpegts_set_skip_validated_crc:
+ * @skip: %TRUE to skip the CRC check of already validated sections
+ *
+ * Repeated sections (same PID, table_id, subtable_extension, version_number
+ * and section_number) are by definition identical. If @skip is %TRUE, the
+ * CRC of such a section will only be calculated the first time it is
+ * parsed, subsequent copies with the same CRC field being considered valid.
+ *
+ * This is useful for applications parsing sections themselves (which
+ * therefore see all repetitions of a table), for example for EIT schedule
+ * tables. Defaults to %FALSE.
+ */
+void
+gst_mpegts_set_skip_validated_crc (gboolean skip)
+{
+  G_LOCK (validated_crcs);
+  skip_validated_crc = skip;
+  if (!skip && validated_crcs) {
+    g_hash_table_destroy (validated_crcs);
+    validated_crcs = NULL;
+  }
+  G_UNLOCK (validated_crcs);
+}
+
 /* FIXME : Later on we might need to use more than just the table_id
  * to figure out which type of section this is. */
 static GstMpegTsSectionType
@@ -40,6 +40,7 @@
 G_BEGIN_DECLS
 
 void gst_mpegts_initialize (void);
+void gst_mpegts_set_skip_validated_crc (gboolean skip);
 
 G_END_DECLS
 
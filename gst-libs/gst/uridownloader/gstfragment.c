@@ -43,9 +43,18 @@ enum
 
 struct _GstFragmentPrivate
 {
-  GstBuffer *buffer;
+  GstAdapter *adapter;          /* chunks received so far */
+  guint n_memories;             /* number of memories in the adapter */
+  GstBuffer *buffer;            /* built from the adapter once completed */
+  GstBuffer *first_buffer;      /* first chunk, kept for typefinding */
   GstCaps *caps;
   GMutex lock;
+
+  /* Streaming of the fragment's data, serialized by data_lock */
+  GMutex data_lock;
+  GstFragmentDataFunc data_func;
+  gpointer data_user_data;
+  GDestroyNotify data_notify;
 };
 
 G_DEFINE_TYPE (GstFragment, gst_fragment, G_TYPE_OBJECT);
@@ -159,6 +168,8 @@ gst_fragment_init (GstFragment * fragment)
   fragment->priv = priv = GST_FRAGMENT_GET_PRIVATE (fragment);
 
   g_mutex_init (&fragment->priv->lock);
+  g_mutex_init (&fragment->priv->data_lock);
+  priv->adapter = gst_adapter_new ();
   priv->buffer = NULL;
   fragment->download_start_time = gst_util_get_timestamp ();
   fragment->start_time = 0;
@@ -182,6 +193,7 @@ gst_fragment_finalize (GObject * gobject)
 
   g_free (fragment->name);
   g_mutex_clear (&fragment->priv->lock);
+  g_mutex_clear (&fragment->priv->data_lock);
 
   G_OBJECT_CLASS (gst_fragment_parent_class)->finalize (gobject);
 }
@@ -191,11 +203,27 @@ gst_fragment_dispose (GObject * object)
 {
   GstFragmentPrivate *priv = GST_FRAGMENT (object)->priv;
 
+  if (priv->adapter != NULL) {
+    g_object_unref (priv->adapter);
+    priv->adapter = NULL;
+  }
+
   if (priv->buffer != NULL) {
     gst_buffer_unref (priv->buffer);
     priv->buffer = NULL;
   }
 
+  if (priv->first_buffer != NULL) {
+    gst_buffer_unref (priv->first_buffer);
+    priv->first_buffer = NULL;
+  }
+
+  if (priv->data_notify != NULL) {
+    priv->data_notify (priv->data_user_data);
+    priv->data_notify = NULL;
+  }
+  priv->data_func = NULL;
+
   if (priv->caps != NULL) {
     gst_caps_unref (priv->caps);
     priv->caps = NULL;
@@ -204,18 +232,109 @@ gst_fragment_dispose (GObject * object)
   G_OBJECT_CLASS (gst_fragment_parent_class)->dispose (object);
 }
 
+/* Called with the lock on a completed fragment. The chunks are only joined
+ * once. Their memories are reused if they all fit in one buffer, otherwise
+ * appending them would merge the memories of the buffer again every time
+ * it is full, so copy everything once instead */
+static void
+gst_fragment_join_chunks (GstFragment * fragment)
+{
+  GstFragmentPrivate *priv = fragment->priv;
+  gsize available;
+
+  available = gst_adapter_available (priv->adapter);
+  if (priv->buffer != NULL || available == 0)
+    return;
+
+  if (priv->n_memories <= gst_buffer_get_max_memory ())
+    priv->buffer = gst_adapter_take_buffer_fast (priv->adapter, available);
+  else
+    priv->buffer = gst_adapter_take_buffer (priv->adapter, available);
+  priv->n_memories = 0;
+}
+
+/**
+ * gst_fragment_get_buffer:
+ * @fragment: a #GstFragment
+ *
+ * Returns: the data of the completed fragment, or %NULL if the fragment is
+ * not completed yet or its data was handed to a #GstFragmentDataFunc
+ */
 GstBuffer *
 gst_fragment_get_buffer (GstFragment * fragment)
 {
+  GstFragmentPrivate *priv;
+  GstBuffer *buffer = NULL;
+
   g_return_val_if_fail (fragment != NULL, NULL);
 
   if (!fragment->completed)
     return NULL;
-  if (!fragment->priv->buffer)
-    return NULL;
 
-  gst_buffer_ref (fragment->priv->buffer);
-  return fragment->priv->buffer;
+  priv = fragment->priv;
+  g_mutex_lock (&priv->lock);
+  gst_fragment_join_chunks (fragment);
+  if (priv->buffer)
+    buffer = gst_buffer_ref (priv->buffer);
+  g_mutex_unlock (&priv->lock);
+
+  return buffer;
+}
+
+/**
+ * gst_fragment_set_data_func:
+ * @fragment: a #GstFragment
+ * @func: function called for every chunk of data added to the fragment
+ * @user_data: data passed to @func
+ * @notify: called with @user_data when the fragment is disposed
+ *
+ * Streams the fragment: the chunks are passed to @func as they are added,
+ * while the download is still in progress, instead of being collected in
+ * the fragment. The chunks the fragment already collected are passed to
+ * @func first, from the calling thread, so @func receives all the data in
+ * order even if it is set while the download is running or after it
+ * completed. gst_fragment_get_buffer() then returns %NULL,
+ * gst_fragment_get_caps() still works from the first chunk.
+ */
+void
+gst_fragment_set_data_func (GstFragment * fragment, GstFragmentDataFunc func,
+    gpointer user_data, GDestroyNotify notify)
+{
+  GstFragmentPrivate *priv;
+  GstBuffer *buffer;
+  GList *chunks = NULL, *l;
+  gsize available;
+
+  g_return_if_fail (fragment != NULL);
+
+  priv = fragment->priv;
+  g_mutex_lock (&priv->data_lock);
+  g_mutex_lock (&priv->lock);
+  if (priv->data_notify)
+    priv->data_notify (priv->data_user_data);
+  priv->data_func = func;
+  priv->data_user_data = user_data;
+  priv->data_notify = notify;
+
+  if (func != NULL) {
+    buffer = priv->buffer;
+    priv->buffer = NULL;
+    available = gst_adapter_available (priv->adapter);
+    if (buffer != NULL)
+      chunks = g_list_prepend (NULL, buffer);
+    else if (available > 0)
+      chunks = gst_adapter_take_list (priv->adapter, available);
+    priv->n_memories = 0;
+  }
+  g_mutex_unlock (&priv->lock);
+
+  if (chunks != NULL)
+    GST_DEBUG ("Handing %u collected chunks to the data function",
+        g_list_length (chunks));
+  for (l = chunks; l; l = l->next)
+    func (fragment, l->data, user_data);
+  g_list_free (chunks);
+  g_mutex_unlock (&priv->data_lock);
 }
 
 void
@@ -228,52 +347,97 @@ gst_fragment_set_caps (GstFragment * fragment, GstCaps * caps)
   g_mutex_unlock (&fragment->priv->lock);
 }
 
+static GstCaps *
+gst_fragment_type_find (GstBuffer * buffer)
+{
+  GstCaps *caps;
+
+  /* FIXME: This is currently necessary as typefinding only
+   * works with 0 offsets... need to find a better way to
+   * do that. The buffer is shared, this only copies its metadata */
+  buffer = gst_buffer_make_writable (buffer);
+  GST_BUFFER_OFFSET (buffer) = GST_BUFFER_OFFSET_NONE;
+  GST_BUFFER_OFFSET_END (buffer) = GST_BUFFER_OFFSET_NONE;
+  caps = gst_type_find_helper_for_buffer (NULL, buffer, NULL);
+  gst_buffer_unref (buffer);
+
+  return caps;
+}
+
+/**
+ * gst_fragment_get_caps:
+ * @fragment: a #GstFragment
+ *
+ * Returns: the caps of the fragment, typefound from its first chunk of
+ * data if they were not set, or %NULL if no data was received yet
+ */
 GstCaps *
 gst_fragment_get_caps (GstFragment * fragment)
 {
+  GstFragmentPrivate *priv;
+  GstCaps *caps = NULL;
+
   g_return_val_if_fail (fragment != NULL, NULL);
 
-  if (!fragment->completed)
-    return NULL;
+  priv = fragment->priv;
+  g_mutex_lock (&priv->lock);
+  if (priv->caps == NULL && priv->first_buffer != NULL) {
+    priv->caps = gst_fragment_type_find (gst_buffer_ref (priv->first_buffer));
 
-  g_mutex_lock (&fragment->priv->lock);
-  if (fragment->priv->caps == NULL) {
-    guint64 offset, offset_end;
-
-    /* FIXME: This is currently necessary as typefinding only
-     * works with 0 offsets... need to find a better way to
-     * do that */
-    offset = GST_BUFFER_OFFSET (fragment->priv->buffer);
-    offset_end = GST_BUFFER_OFFSET_END (fragment->priv->buffer);
-    GST_BUFFER_OFFSET (fragment->priv->buffer) = GST_BUFFER_OFFSET_NONE;
-    GST_BUFFER_OFFSET_END (fragment->priv->buffer) = GST_BUFFER_OFFSET_NONE;
-    fragment->priv->caps =
-        gst_type_find_helper_for_buffer (NULL, fragment->priv->buffer, NULL);
-    GST_BUFFER_OFFSET (fragment->priv->buffer) = offset;
-    GST_BUFFER_OFFSET_END (fragment->priv->buffer) = offset_end;
+    /* A first chunk too small to be typefound, use the whole fragment */
+    if (priv->caps == NULL && fragment->completed) {
+      gst_fragment_join_chunks (fragment);
+      if (priv->buffer != NULL)
+        priv->caps = gst_fragment_type_find (gst_buffer_ref (priv->buffer));
+    }
+
+    if (priv->caps != NULL || fragment->completed)
+      gst_buffer_replace (&priv->first_buffer, NULL);
   }
-  gst_caps_ref (fragment->priv->caps);
-  g_mutex_unlock (&fragment->priv->lock);
+  if (priv->caps)
+    caps = gst_caps_ref (priv->caps);
+  g_mutex_unlock (&priv->lock);
 
-  return fragment->priv->caps;
+  return caps;
 }
 
 gboolean
 gst_fragment_add_buffer (GstFragment * fragment, GstBuffer * buffer)
 {
+  GstFragmentPrivate *priv;
+  GstFragmentDataFunc data_func;
+  gpointer user_data;
+
   g_return_val_if_fail (fragment != NULL, FALSE);
   g_return_val_if_fail (buffer != NULL, FALSE);
 
   if (fragment->completed) {
     GST_WARNING ("Fragment is completed, could not add more buffers");
+    gst_buffer_unref (buffer);
     return FALSE;
   }
 
   GST_DEBUG ("Adding new buffer to the fragment");
+  priv = fragment->priv;
+  g_mutex_lock (&priv->data_lock);
+  g_mutex_lock (&priv->lock);
+  if (priv->caps == NULL && priv->first_buffer == NULL)
+    priv->first_buffer = gst_buffer_ref (buffer);
+
+  data_func = priv->data_func;
+  user_data = priv->data_user_data;
   /* We steal the buffers you pass in */
-  if (fragment->priv->buffer == NULL)
-    fragment->priv->buffer = buffer;
-  else
-    fragment->priv->buffer = gst_buffer_append (fragment->priv->buffer, buffer);
+  if (data_func == NULL) {
+    priv->n_memories += gst_buffer_n_memory (buffer);
+    gst_adapter_push (priv->adapter, buffer);
+  }
+  g_mutex_unlock (&priv->lock);
+
+  /* The data lock keeps the chunks in order with the ones handed over by
+   * gst_fragment_set_data_func() */
+  if (data_func != NULL)
+    data_func (fragment, buffer, user_data);
+  g_mutex_unlock (&priv->data_lock);
+
   return TRUE;
 }
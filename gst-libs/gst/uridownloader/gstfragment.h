@@ -58,12 +58,23 @@ struct _GstFragmentClass
   GObjectClass parent_class;
 };
 
+/**
+ * GstFragmentDataFunc:
+ * @fragment: the #GstFragment
+ * @buffer: (transfer full): a chunk of the fragment's data
+ * @user_data: user data
+ *
+ * Receives the data of a streamed fragment while it is downloaded.
+ */
+typedef void (*GstFragmentDataFunc) (GstFragment * fragment, GstBuffer * buffer, gpointer user_data);
+
 GType gst_fragment_get_type (void);
 
 GstBuffer * gst_fragment_get_buffer (GstFragment *fragment);
 void gst_fragment_set_caps (GstFragment * fragment, GstCaps * caps);
 GstCaps * gst_fragment_get_caps (GstFragment * fragment);
 gboolean gst_fragment_add_buffer (GstFragment *fragment, GstBuffer *buffer);
+void gst_fragment_set_data_func (GstFragment * fragment, GstFragmentDataFunc func, gpointer user_data, GDestroyNotify notify);
 GstFragment * gst_fragment_new (void);
 
 G_END_DECLS
@@ -46,6 +46,11 @@ struct _GstUriDownloaderPrivate
 
   GCond cond;
   gboolean cancelled;
+
+  /* Streaming of the downloaded data */
+  GstFragmentDataFunc data_func;
+  gpointer data_user_data;
+  GDestroyNotify data_notify;
 };
 
 static void gst_uri_downloader_finalize (GObject * object);
@@ -133,6 +138,12 @@ gst_uri_downloader_dispose (GObject * object)
     downloader->priv->download = NULL;
   }
 
+  if (downloader->priv->data_notify) {
+    downloader->priv->data_notify (downloader->priv->data_user_data);
+    downloader->priv->data_notify = NULL;
+  }
+  downloader->priv->data_func = NULL;
+
   G_OBJECT_CLASS (gst_uri_downloader_parent_class)->dispose (object);
 }
 
@@ -243,6 +254,7 @@ static GstFlowReturn
 gst_uri_downloader_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
 {
   GstUriDownloader *downloader;
+  GstFragment *download;
 
   downloader = GST_URI_DOWNLOADER (gst_pad_get_element_private (pad));
 
@@ -254,22 +266,70 @@ gst_uri_downloader_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
   if (downloader->priv->download == NULL) {
     /* Download cancelled, quit */
     GST_OBJECT_UNLOCK (downloader);
+    gst_buffer_unref (buf);
     goto done;
   }
 
   GST_LOG_OBJECT (downloader, "The uri fetcher received a new buffer "
       "of size %" G_GSIZE_FORMAT, gst_buffer_get_size (buf));
   downloader->priv->got_buffer = TRUE;
-  if (!gst_fragment_add_buffer (downloader->priv->download, buf))
-    GST_WARNING_OBJECT (downloader, "Could not add buffer to fragment");
+  download = g_object_ref (downloader->priv->download);
   GST_OBJECT_UNLOCK (downloader);
 
+  /* Streamed fragments hand the buffer to their consumer from here, which
+   * must not block a cancel */
+  if (!gst_fragment_add_buffer (download, buf))
+    GST_WARNING_OBJECT (downloader, "Could not add buffer to fragment");
+  g_object_unref (download);
+
 done:
   {
     return GST_FLOW_OK;
   }
 }
 
+/**
+ * gst_uri_downloader_set_data_func:
+ * @downloader: the #GstUriDownloader
+ * @func: function receiving the downloaded data, or %NULL
+ * @user_data: data passed to @func
+ * @notify: called with @user_data when it is not needed anymore
+ *
+ * Streams the download in progress and the following ones: their data is
+ * handed to @func while the download is running, see
+ * gst_fragment_set_data_func(). The fragments returned by the fetch
+ * functions then carry no buffer.
+ */
+void
+gst_uri_downloader_set_data_func (GstUriDownloader * downloader,
+    GstFragmentDataFunc func, gpointer user_data, GDestroyNotify notify)
+{
+  GDestroyNotify old_notify;
+  gpointer old_user_data;
+  GstFragment *download = NULL;
+
+  g_return_if_fail (downloader != NULL);
+
+  GST_OBJECT_LOCK (downloader);
+  old_notify = downloader->priv->data_notify;
+  old_user_data = downloader->priv->data_user_data;
+  downloader->priv->data_func = func;
+  downloader->priv->data_user_data = user_data;
+  downloader->priv->data_notify = notify;
+  if (func != NULL && downloader->priv->download != NULL)
+    download = g_object_ref (downloader->priv->download);
+  GST_OBJECT_UNLOCK (downloader);
+
+  if (old_notify)
+    old_notify (old_user_data);
+
+  /* hands over what was downloaded so far, outside the lock */
+  if (download != NULL) {
+    gst_fragment_set_data_func (download, func, user_data, NULL);
+    g_object_unref (download);
+  }
+}
+
 void
 gst_uri_downloader_reset (GstUriDownloader * downloader)
 {
@@ -464,6 +524,9 @@ gst_uri_downloader_fetch_uri_with_range (GstUriDownloader *
 
   gst_bus_set_flushing (downloader->priv->bus, FALSE);
   downloader->priv->download = gst_fragment_new ();
+  if (downloader->priv->data_func)
+    gst_fragment_set_data_func (downloader->priv->download,
+        downloader->priv->data_func, downloader->priv->data_user_data, NULL);
   GST_OBJECT_UNLOCK (downloader);
   ret = gst_element_set_state (downloader->priv->urisrc, GST_STATE_READY);
   GST_OBJECT_LOCK (downloader);
@@ -0,0 +1,597 @@
+/* GStreamer
+ *
+ * gsturidownloaderpool.c:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* A pool of #GstUriDownloader running several fetches at once. Downloaders
+ * are kept per host, so that their source element (and with it the
+ * keep-alive connection) is reused by the following fetches to the same
+ * host. Fetches return a #GstUriDownloadFuture the caller waits on when it
+ * needs the data. */
+
+#include <string.h>
+#include <glib.h>
+#include "gsturidownloaderpool.h"
+#include "gsturidownloader_debug.h"
+
+#define GST_CAT_DEFAULT uridownloader_debug
+
+#define GST_URI_DOWNLOADER_POOL_GET_PRIVATE(obj)  \
+   (G_TYPE_INSTANCE_GET_PRIVATE ((obj), \
+    GST_TYPE_URI_DOWNLOADER_POOL, GstUriDownloaderPoolPrivate))
+
+#define DEFAULT_MAX_CONNECTIONS_PER_HOST 4
+
+typedef struct
+{
+  gchar *key;                   /* protocol://host */
+  GQueue idle;                  /* GstUriDownloader with a warm source element */
+  GQueue pending;               /* GstUriDownloadFuture waiting for a connection */
+  guint active;                 /* fetches running for this host */
+} GstUriDownloaderHost;
+
+struct _GstUriDownloadFuture
+{
+  gint refcount;
+  GstUriDownloaderPool *pool;
+  GstUriDownloaderHost *host;
+
+  gchar *uri;
+  gchar *referer;
+  gboolean compress;
+  gboolean refresh;
+  gboolean allow_cache;
+  gint64 range_start;
+  gint64 range_end;
+
+  /* protected by the pool lock */
+  GstUriDownloader *downloader; /* set while the fetch is running */
+  gboolean cancelled;
+  gboolean done;
+  GstFragment *fragment;
+  GError *err;
+
+  /* Consumer of the data, see gst_uri_download_future_set_data_func().
+   * data_lock is taken before the pool lock, it keeps the consumer from
+   * being attached to a downloader that moved on to another fetch */
+  GMutex data_lock;
+  GstFragmentDataFunc data_func;
+  gpointer data_user_data;
+  GDestroyNotify data_notify;
+};
+
+struct _GstUriDownloaderPoolPrivate
+{
+  GMutex lock;
+  GCond cond;                   /* signalled when a future is done */
+
+  guint max_connections_per_host;
+  GHashTable *hosts;            /* key -> GstUriDownloaderHost */
+  GQueue requests;              /* futures not done yet */
+  GThreadPool *threads;
+};
+
+static void gst_uri_downloader_pool_finalize (GObject * object);
+static void gst_uri_downloader_pool_dispose (GObject * object);
+static void gst_uri_downloader_pool_run (GstUriDownloadFuture * future,
+    GstUriDownloaderPool * pool);
+
+#define _do_init \
+{ \
+  GST_DEBUG_CATEGORY_INIT (uridownloader_debug, "uridownloader", 0, "URI downloader"); \
+}
+
+G_DEFINE_TYPE_WITH_CODE (GstUriDownloaderPool, gst_uri_downloader_pool,
+    GST_TYPE_OBJECT, _do_init);
+
+static void
+gst_uri_downloader_host_free (GstUriDownloaderHost * host)
+{
+  GstUriDownloader *downloader;
+
+  /* pending requests hold a reference to the pool, there are none left */
+  g_assert (g_queue_is_empty (&host->pending));
+
+  while ((downloader = g_queue_pop_head (&host->idle)))
+    g_object_unref (downloader);
+  g_free (host->key);
+  g_slice_free (GstUriDownloaderHost, host);
+}
+
+static void
+gst_uri_downloader_pool_class_init (GstUriDownloaderPoolClass * klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = (GObjectClass *) klass;
+
+  g_type_class_add_private (klass, sizeof (GstUriDownloaderPoolPrivate));
+
+  gobject_class->dispose = gst_uri_downloader_pool_dispose;
+  gobject_class->finalize = gst_uri_downloader_pool_finalize;
+}
+
+static void
+gst_uri_downloader_pool_init (GstUriDownloaderPool * pool)
+{
+  pool->priv = GST_URI_DOWNLOADER_POOL_GET_PRIVATE (pool);
+
+  g_mutex_init (&pool->priv->lock);
+  g_cond_init (&pool->priv->cond);
+  g_queue_init (&pool->priv->requests);
+
+  pool->priv->max_connections_per_host = DEFAULT_MAX_CONNECTIONS_PER_HOST;
+  pool->priv->hosts = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) gst_uri_downloader_host_free);
+
+  /* The number of threads is bounded by the connections per host */
+  pool->priv->threads =
+      g_thread_pool_new ((GFunc) gst_uri_downloader_pool_run, pool, -1, FALSE,
+      NULL);
+}
+
+static void
+gst_uri_downloader_pool_dispose (GObject * object)
+{
+  GstUriDownloaderPool *pool = GST_URI_DOWNLOADER_POOL (object);
+
+  /* Every request holds a reference to the pool, so nothing is queued or
+   * running anymore. The last reference might be dropped from one of the
+   * pool threads, don't wait for them */
+  if (pool->priv->threads) {
+    g_thread_pool_free (pool->priv->threads, FALSE, FALSE);
+    pool->priv->threads = NULL;
+  }
+
+  if (pool->priv->hosts) {
+    g_hash_table_unref (pool->priv->hosts);
+    pool->priv->hosts = NULL;
+  }
+
+  G_OBJECT_CLASS (gst_uri_downloader_pool_parent_class)->dispose (object);
+}
+
+static void
+gst_uri_downloader_pool_finalize (GObject * object)
+{
+  GstUriDownloaderPool *pool = GST_URI_DOWNLOADER_POOL (object);
+
+  g_mutex_clear (&pool->priv->lock);
+  g_cond_clear (&pool->priv->cond);
+
+  G_OBJECT_CLASS (gst_uri_downloader_pool_parent_class)->finalize (object);
+}
+
+/**
+ * gst_uri_downloader_pool_new:
+ * @max_connections_per_host: maximum number of fetches running at once for
+ *     each host, 0 for the default
+ *
+ * Returns: a new #GstUriDownloaderPool
+ */
+GstUriDownloaderPool *
+gst_uri_downloader_pool_new (guint max_connections_per_host)
+{
+  GstUriDownloaderPool *pool;
+
+  pool = g_object_new (GST_TYPE_URI_DOWNLOADER_POOL, NULL);
+  if (max_connections_per_host > 0)
+    pool->priv->max_connections_per_host = max_connections_per_host;
+
+  return pool;
+}
+
+/* Connections can only be shared between URIs of the same protocol and host */
+static gchar *
+gst_uri_downloader_pool_get_host_key (const gchar * uri)
+{
+  gchar *protocol, *location, *key;
+  gchar *end;
+
+  if (!gst_uri_is_valid (uri))
+    return g_strdup ("");
+
+  protocol = gst_uri_get_protocol (uri);
+  location = gst_uri_get_location (uri);
+  if (location != NULL && (end = strchr (location, '/')) != NULL)
+    *end = '\0';
+
+  key = g_strdup_printf ("%s://%s", protocol, location ? location : "");
+  g_free (protocol);
+  g_free (location);
+
+  return key;
+}
+
+/* Called with the pool lock */
+static void
+gst_uri_download_future_complete (GstUriDownloadFuture * future,
+    GstFragment * fragment, GError * err)
+{
+  GstUriDownloaderPoolPrivate *priv = future->pool->priv;
+
+  future->fragment = fragment;
+  future->err = err;
+  future->done = TRUE;
+  g_queue_remove (&priv->requests, future);
+  g_cond_broadcast (&priv->cond);
+}
+
+/* Called with the pool lock, when the fetch of a host finished. Hands its
+ * connection over to the next request for the host */
+static void
+gst_uri_downloader_pool_next (GstUriDownloaderPool * pool,
+    GstUriDownloaderHost * host)
+{
+  GstUriDownloadFuture *next;
+
+  next = g_queue_pop_head (&host->pending);
+  if (next != NULL)
+    g_thread_pool_push (pool->priv->threads, next, NULL);
+  else
+    host->active--;
+}
+
+static void
+gst_uri_downloader_pool_run (GstUriDownloadFuture * future,
+    GstUriDownloaderPool * pool)
+{
+  GstUriDownloaderHost *host = future->host;
+  GstUriDownloader *downloader;
+  GstFragment *fragment;
+  GError *err = NULL;
+
+  g_mutex_lock (&future->data_lock);
+  g_mutex_lock (&pool->priv->lock);
+  if (future->cancelled) {
+    GST_DEBUG_OBJECT (pool, "Fetch of %s cancelled before it started",
+        future->uri);
+    gst_uri_download_future_complete (future, NULL,
+        g_error_new (GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+            "Download of '%s' was cancelled", future->uri));
+    goto done;
+  }
+
+  downloader = g_queue_pop_head (&host->idle);
+  if (downloader == NULL) {
+    GST_DEBUG_OBJECT (pool, "New connection for %s", host->key);
+    downloader = gst_uri_downloader_new ();
+  }
+  future->downloader = downloader;
+  gst_uri_downloader_set_data_func (downloader, future->data_func,
+      future->data_user_data, NULL);
+  g_mutex_unlock (&pool->priv->lock);
+  g_mutex_unlock (&future->data_lock);
+
+  fragment = gst_uri_downloader_fetch_uri_with_range (downloader, future->uri,
+      future->referer, future->compress, future->refresh, future->allow_cache,
+      future->range_start, future->range_end, &err);
+
+  g_mutex_lock (&future->data_lock);
+  gst_uri_downloader_set_data_func (downloader, NULL, NULL, NULL);
+  /* A consumer set while the fetch was finishing did not reach the
+   * fragment, hand it what is left */
+  if (fragment != NULL && future->data_func != NULL)
+    gst_fragment_set_data_func (fragment, future->data_func,
+        future->data_user_data, NULL);
+  g_mutex_lock (&pool->priv->lock);
+  future->downloader = NULL;
+  /* A cancel might have hit the downloader after the fetch returned */
+  gst_uri_downloader_reset (downloader);
+  g_queue_push_tail (&host->idle, downloader);
+  gst_uri_download_future_complete (future, fragment, err);
+
+done:
+  gst_uri_downloader_pool_next (pool, host);
+  g_mutex_unlock (&pool->priv->lock);
+  g_mutex_unlock (&future->data_lock);
+
+  /* drop the reference of the pool, this might be the last one */
+  gst_uri_download_future_unref (future);
+}
+
+GstUriDownloadFuture *
+gst_uri_downloader_pool_fetch_uri (GstUriDownloaderPool * pool,
+    const gchar * uri, const gchar * referer, gboolean compress,
+    gboolean refresh, gboolean allow_cache)
+{
+  return gst_uri_downloader_pool_fetch_uri_with_range (pool, uri, referer,
+      compress, refresh, allow_cache, 0, -1);
+}
+
+/**
+ * gst_uri_downloader_pool_fetch_uri_with_range:
+ * @pool: the #GstUriDownloaderPool
+ * @uri: the uri
+ * @range_start: the starting byte index
+ * @range_end: the final byte index, use -1 for unspecified
+ *
+ * Starts fetching @uri as soon as a connection to its host is free.
+ *
+ * Returns: a #GstUriDownloadFuture for the downloaded #GstFragment, unref
+ * with gst_uri_download_future_unref()
+ */
+GstUriDownloadFuture *
+gst_uri_downloader_pool_fetch_uri_with_range (GstUriDownloaderPool * pool,
+    const gchar * uri, const gchar * referer, gboolean compress,
+    gboolean refresh, gboolean allow_cache, gint64 range_start,
+    gint64 range_end)
+{
+  GstUriDownloadFuture *future;
+  GstUriDownloaderHost *host;
+  gchar *key;
+
+  g_return_val_if_fail (GST_IS_URI_DOWNLOADER_POOL (pool), NULL);
+  g_return_val_if_fail (uri != NULL, NULL);
+
+  future = g_slice_new0 (GstUriDownloadFuture);
+  future->refcount = 1;
+  g_mutex_init (&future->data_lock);
+  future->pool = gst_object_ref (pool);
+  future->uri = g_strdup (uri);
+  future->referer = g_strdup (referer);
+  future->compress = compress;
+  future->refresh = refresh;
+  future->allow_cache = allow_cache;
+  future->range_start = range_start;
+  future->range_end = range_end;
+
+  key = gst_uri_downloader_pool_get_host_key (uri);
+
+  g_mutex_lock (&pool->priv->lock);
+  host = g_hash_table_lookup (pool->priv->hosts, key);
+  if (host == NULL) {
+    host = g_slice_new0 (GstUriDownloaderHost);
+    host->key = key;
+    g_queue_init (&host->idle);
+    g_queue_init (&host->pending);
+    g_hash_table_insert (pool->priv->hosts, host->key, host);
+  } else {
+    g_free (key);
+  }
+  future->host = host;
+
+  /* reference held by the pool until the request is done */
+  gst_uri_download_future_ref (future);
+  g_queue_push_tail (&pool->priv->requests, future);
+
+  if (host->active < pool->priv->max_connections_per_host) {
+    GST_DEBUG_OBJECT (pool, "Fetching %s (range=%" G_GINT64_FORMAT "-%"
+        G_GINT64_FORMAT ")", uri, range_start, range_end);
+    host->active++;
+    g_thread_pool_push (pool->priv->threads, future, NULL);
+  } else {
+    GST_DEBUG_OBJECT (pool, "All connections to %s busy, queueing %s",
+        host->key, uri);
+    g_queue_push_tail (&host->pending, future);
+  }
+  g_mutex_unlock (&pool->priv->lock);
+
+  return future;
+}
+
+/* Called with the pool lock. Returns TRUE if the request was still pending,
+ * the caller then has to drop the reference of the pool once unlocked */
+static gboolean
+gst_uri_download_future_cancel_unlocked (GstUriDownloadFuture * future)
+{
+  if (future->done || future->cancelled)
+    return FALSE;
+
+  future->cancelled = TRUE;
+  if (future->downloader) {
+    gst_uri_downloader_cancel (future->downloader);
+  } else if (g_queue_remove (&future->host->pending, future)) {
+    gst_uri_download_future_complete (future, NULL,
+        g_error_new (GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+            "Download of '%s' was cancelled", future->uri));
+    return TRUE;
+  }
+  /* else not picked up by a thread yet, it will finish it */
+
+  return FALSE;
+}
+
+/**
+ * gst_uri_downloader_pool_cancel:
+ * @pool: the #GstUriDownloaderPool
+ *
+ * Cancels all the fetches that are not done yet. Their futures return no
+ * fragment.
+ */
+void
+gst_uri_downloader_pool_cancel (GstUriDownloaderPool * pool)
+{
+  GstUriDownloadFuture *future;
+  GList *walk, *next;
+  GSList *pending = NULL;
+
+  g_return_if_fail (GST_IS_URI_DOWNLOADER_POOL (pool));
+
+  g_mutex_lock (&pool->priv->lock);
+  GST_DEBUG_OBJECT (pool, "Cancelling %u requests",
+      g_queue_get_length (&pool->priv->requests));
+  for (walk = pool->priv->requests.head; walk; walk = next) {
+    next = walk->next;
+    future = walk->data;
+    if (gst_uri_download_future_cancel_unlocked (future))
+      pending = g_slist_prepend (pending, future);
+  }
+  g_mutex_unlock (&pool->priv->lock);
+
+  g_slist_free_full (pending, (GDestroyNotify) gst_uri_download_future_unref);
+}
+
+GstUriDownloadFuture *
+gst_uri_download_future_ref (GstUriDownloadFuture * future)
+{
+  g_return_val_if_fail (future != NULL, NULL);
+
+  g_atomic_int_inc (&future->refcount);
+  return future;
+}
+
+void
+gst_uri_download_future_unref (GstUriDownloadFuture * future)
+{
+  g_return_if_fail (future != NULL);
+
+  if (g_atomic_int_dec_and_test (&future->refcount)) {
+    if (future->fragment)
+      g_object_unref (future->fragment);
+    if (future->err)
+      g_error_free (future->err);
+    if (future->data_notify)
+      future->data_notify (future->data_user_data);
+    g_mutex_clear (&future->data_lock);
+    g_free (future->uri);
+    g_free (future->referer);
+    gst_object_unref (future->pool);
+    g_slice_free (GstUriDownloadFuture, future);
+  }
+}
+
+gboolean
+gst_uri_download_future_is_done (GstUriDownloadFuture * future)
+{
+  GstUriDownloaderPoolPrivate *priv;
+  gboolean done;
+
+  g_return_val_if_fail (future != NULL, FALSE);
+
+  priv = future->pool->priv;
+  g_mutex_lock (&priv->lock);
+  done = future->done;
+  g_mutex_unlock (&priv->lock);
+
+  return done;
+}
+
+/**
+ * gst_uri_download_future_wait:
+ * @future: a #GstUriDownloadFuture
+ * @err: a #GError for the download failure
+ *
+ * Waits until the fetch of @future is done.
+ *
+ * Returns: the downloaded #GstFragment or %NULL if the fetch failed or was
+ * cancelled
+ */
+GstFragment *
+gst_uri_download_future_wait (GstUriDownloadFuture * future, GError ** err)
+{
+  GstUriDownloaderPoolPrivate *priv;
+  GstFragment *fragment = NULL;
+
+  g_return_val_if_fail (future != NULL, NULL);
+
+  priv = future->pool->priv;
+  g_mutex_lock (&priv->lock);
+  while (!future->done)
+    g_cond_wait (&priv->cond, &priv->lock);
+
+  if (future->fragment)
+    fragment = g_object_ref (future->fragment);
+  else if (future->err)
+    g_propagate_error (err, g_error_copy (future->err));
+  else
+    g_set_error (err, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_OPEN_READ,
+        "Failed to download '%s'", future->uri);
+  g_mutex_unlock (&priv->lock);
+
+  return fragment;
+}
+
+/**
+ * gst_uri_download_future_cancel:
+ * @future: a #GstUriDownloadFuture
+ *
+ * Cancels the fetch of @future if it is not done yet.
+ */
+void
+gst_uri_download_future_cancel (GstUriDownloadFuture * future)
+{
+  GstUriDownloaderPoolPrivate *priv;
+  gboolean was_pending;
+
+  g_return_if_fail (future != NULL);
+
+  priv = future->pool->priv;
+  g_mutex_lock (&priv->lock);
+  was_pending = gst_uri_download_future_cancel_unlocked (future);
+  g_mutex_unlock (&priv->lock);
+
+  if (was_pending)
+    gst_uri_download_future_unref (future);
+}
+
+/**
+ * gst_uri_download_future_set_data_func:
+ * @future: a #GstUriDownloadFuture
+ * @func: function receiving the downloaded data
+ * @user_data: data passed to @func
+ * @notify: called with @user_data when @future is freed
+ *
+ * Streams the fetch of @future to @func instead of collecting it in its
+ * fragment. The data already downloaded is handed to @func from the calling
+ * thread, the rest from the download thread while it arrives, so this can
+ * be called before, during or after the fetch. gst_uri_download_future_wait()
+ * still returns a fragment if the fetch succeeded, but without a buffer.
+ */
+void
+gst_uri_download_future_set_data_func (GstUriDownloadFuture * future,
+    GstFragmentDataFunc func, gpointer user_data, GDestroyNotify notify)
+{
+  GstUriDownloaderPoolPrivate *priv;
+  GstUriDownloader *downloader = NULL;
+  GstFragment *fragment = NULL;
+  GDestroyNotify old_notify;
+  gpointer old_user_data;
+
+  g_return_if_fail (future != NULL);
+  g_return_if_fail (func != NULL);
+
+  priv = future->pool->priv;
+  g_mutex_lock (&future->data_lock);
+  g_mutex_lock (&priv->lock);
+  old_notify = future->data_notify;
+  old_user_data = future->data_user_data;
+  future->data_func = func;
+  future->data_user_data = user_data;
+  future->data_notify = notify;
+  if (future->downloader)
+    downloader = g_object_ref (future->downloader);
+  else if (future->fragment)
+    fragment = g_object_ref (future->fragment);
+  g_mutex_unlock (&priv->lock);
+
+  if (old_notify)
+    old_notify (old_user_data);
+
+  /* The fetch can't finish before the data lock is released, so the
+   * downloader still works for @future. The consumer may call into the
+   * pool, don't hold its lock */
+  if (downloader) {
+    gst_uri_downloader_set_data_func (downloader, func, user_data, NULL);
+    g_object_unref (downloader);
+  } else if (fragment) {
+    gst_fragment_set_data_func (fragment, func, user_data, NULL);
+    g_object_unref (fragment);
+  }
+  g_mutex_unlock (&future->data_lock);
+}
@@ -0,0 +1,72 @@
+/* GStreamer
+ *
+ * gsturidownloaderpool.h:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GSTURI_DOWNLOADER_POOL_H__
+#define __GSTURI_DOWNLOADER_POOL_H__
+
+#include <glib-object.h>
+#include <gst/gst.h>
+#include "gstfragment.h"
+#include "gsturidownloader.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_URI_DOWNLOADER_POOL (gst_uri_downloader_pool_get_type())
+#define GST_URI_DOWNLOADER_POOL(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_URI_DOWNLOADER_POOL,GstUriDownloaderPool))
+#define GST_URI_DOWNLOADER_POOL_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_URI_DOWNLOADER_POOL,GstUriDownloaderPoolClass))
+#define GST_IS_URI_DOWNLOADER_POOL(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_URI_DOWNLOADER_POOL))
+#define GST_IS_URI_DOWNLOADER_POOL_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_URI_DOWNLOADER_POOL))
+
+typedef struct _GstUriDownloaderPool GstUriDownloaderPool;
+typedef struct _GstUriDownloaderPoolPrivate GstUriDownloaderPoolPrivate;
+typedef struct _GstUriDownloaderPoolClass GstUriDownloaderPoolClass;
+typedef struct _GstUriDownloadFuture GstUriDownloadFuture;
+
+struct _GstUriDownloaderPool
+{
+  GstObject parent;
+
+  GstUriDownloaderPoolPrivate *priv;
+};
+
+struct _GstUriDownloaderPoolClass
+{
+  GstObjectClass parent_class;
+
+  /*< private >*/
+  gpointer _gst_reserved[GST_PADDING];
+};
+
+GType gst_uri_downloader_pool_get_type (void);
+
+GstUriDownloaderPool * gst_uri_downloader_pool_new (guint max_connections_per_host);
+GstUriDownloadFuture * gst_uri_downloader_pool_fetch_uri (GstUriDownloaderPool * pool, const gchar * uri, const gchar * referer, gboolean compress, gboolean refresh, gboolean allow_cache);
+GstUriDownloadFuture * gst_uri_downloader_pool_fetch_uri_with_range (GstUriDownloaderPool * pool, const gchar * uri, const gchar * referer, gboolean compress, gboolean refresh, gboolean allow_cache, gint64 range_start, gint64 range_end);
+void gst_uri_downloader_pool_cancel (GstUriDownloaderPool * pool);
+
+GstUriDownloadFuture * gst_uri_download_future_ref (GstUriDownloadFuture * future);
+void gst_uri_download_future_unref (GstUriDownloadFuture * future);
+gboolean gst_uri_download_future_is_done (GstUriDownloadFuture * future);
+GstFragment * gst_uri_download_future_wait (GstUriDownloadFuture * future, GError ** err);
+void gst_uri_download_future_cancel (GstUriDownloadFuture * future);
+void gst_uri_download_future_set_data_func (GstUriDownloadFuture * future, GstFragmentDataFunc func, gpointer user_data, GDestroyNotify notify);
+
+G_END_DECLS
+#endif /* __GSTURI_DOWNLOADER_POOL_H__ */
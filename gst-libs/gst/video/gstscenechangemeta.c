@@ -0,0 +1,133 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:gstscenechangemeta
+ * @short_description: Scene change metadata
+ *
+ * #GstSceneChangeMeta carries the result of the scene change analysis of
+ * a video frame, i.e. how different it is from the previous picture and
+ * whether it was detected as the start of a new scene.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstscenechangemeta.h"
+
+GST_DEBUG_CATEGORY (scene_change_meta_debug);
+#define GST_CAT_DEFAULT scene_change_meta_debug
+
+static gboolean
+gst_scene_change_meta_init (GstSceneChangeMeta * meta, gpointer params,
+    GstBuffer * buffer)
+{
+  meta->score = 0.0;
+  meta->threshold = 0.0;
+  meta->scene_change = FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+gst_scene_change_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  GstSceneChangeMeta *smeta = (GstSceneChangeMeta *) meta;
+
+  /* the analysis is about the whole picture, don't keep it for parts of it */
+  if (!GST_META_TRANSFORM_IS_COPY (type))
+    return FALSE;
+
+  if (!gst_buffer_add_scene_change_meta (dest, smeta->score, smeta->threshold,
+          smeta->scene_change))
+    return FALSE;
+
+  return TRUE;
+}
+
+GType
+gst_scene_change_meta_api_get_type (void)
+{
+  static volatile GType type;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = gst_meta_api_type_register ("GstSceneChangeMetaAPI", tags);
+    GST_DEBUG_CATEGORY_INIT (scene_change_meta_debug, "scenechangemeta", 0,
+        "Scene change GstMeta");
+
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+const GstMetaInfo *
+gst_scene_change_meta_get_info (void)
+{
+  static const GstMetaInfo *scene_change_meta_info = NULL;
+
+  if (g_once_init_enter (&scene_change_meta_info)) {
+    const GstMetaInfo *meta =
+        gst_meta_register (GST_SCENE_CHANGE_META_API_TYPE,
+        "GstSceneChangeMeta", sizeof (GstSceneChangeMeta),
+        (GstMetaInitFunction) gst_scene_change_meta_init,
+        (GstMetaFreeFunction) NULL,
+        (GstMetaTransformFunction) gst_scene_change_meta_transform);
+    g_once_init_leave (&scene_change_meta_info, meta);
+  }
+
+  return scene_change_meta_info;
+}
+
+/**
+ * gst_buffer_add_scene_change_meta:
+ * @buffer: a #GstBuffer
+ * @score: the difference to the previous picture
+ * @threshold: the threshold @score was compared against
+ * @scene_change: whether the picture starts a new scene
+ *
+ * Creates and adds a #GstSceneChangeMeta to a @buffer.
+ *
+ * Returns: (transfer none): a newly created #GstSceneChangeMeta
+ *
+ * Since: 1.4
+ */
+GstSceneChangeMeta *
+gst_buffer_add_scene_change_meta (GstBuffer * buffer, gdouble score,
+    gdouble threshold, gboolean scene_change)
+{
+  GstSceneChangeMeta *meta;
+
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+
+  meta = (GstSceneChangeMeta *) gst_buffer_add_meta (buffer,
+      GST_SCENE_CHANGE_META_INFO, NULL);
+  if (!meta)
+    return NULL;
+
+  GST_LOG ("score %g, threshold %g, scene change %d", score, threshold,
+      scene_change);
+
+  meta->score = score;
+  meta->threshold = threshold;
+  meta->scene_change = scene_change;
+
+  return meta;
+}
@@ -0,0 +1,69 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_SCENE_CHANGE_META_H__
+#define __GST_SCENE_CHANGE_META_H__
+
+#ifndef GST_USE_UNSTABLE_API
+#warning "The GStreamer bad video library is unstable API and may change in future."
+#warning "You can define GST_USE_UNSTABLE_API to avoid this warning."
+#endif
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstSceneChangeMeta GstSceneChangeMeta;
+
+GType gst_scene_change_meta_api_get_type (void);
+#define GST_SCENE_CHANGE_META_API_TYPE  (gst_scene_change_meta_api_get_type())
+#define GST_SCENE_CHANGE_META_INFO  (gst_scene_change_meta_get_info())
+const GstMetaInfo * gst_scene_change_meta_get_info (void);
+
+/**
+ * GstSceneChangeMeta:
+ * @meta: parent #GstMeta
+ * @score: the mean absolute luma difference to the previous picture
+ * @threshold: the threshold @score was compared against
+ * @scene_change: %TRUE if the picture starts a new scene
+ *
+ * Extra buffer metadata describing the scene change analysis of a video
+ * frame, as done by the scenechange element.
+ *
+ * The first picture after a (re)start of the analysis has no previous
+ * picture to be compared with, it has a @score and @threshold of 0.
+ *
+ * Since: 1.4
+ */
+struct _GstSceneChangeMeta {
+  GstMeta meta;
+
+  gdouble score;
+  gdouble threshold;
+  gboolean scene_change;
+};
+
+#define gst_buffer_get_scene_change_meta(b) ((GstSceneChangeMeta*)gst_buffer_get_meta((b),GST_SCENE_CHANGE_META_API_TYPE))
+
+GstSceneChangeMeta *
+gst_buffer_add_scene_change_meta (GstBuffer * buffer, gdouble score,
+                                  gdouble threshold, gboolean scene_change);
+
+G_END_DECLS
+
+#endif
@@ -33,7 +33,8 @@ GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{ ARGB, BGR, BGRA, BGRx, RGB, "
-            "RGBA, RGBx, AYUV, xBGR, xRGB, GRAY8, GRAY16_BE, GRAY16_LE }"))
+            "RGBA, RGBx, AYUV, xBGR, xRGB, GRAY8, GRAY16_BE, GRAY16_LE, "
+            "I420, NV12 }"))
     );
 
 static GstStaticPadTemplate gst_geometric_transform_sink_template =
@@ -41,7 +42,8 @@ GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{ ARGB, BGR, BGRA, BGRx, RGB, "
-            "RGBA, RGBx, AYUV, xBGR, xRGB, GRAY8, GRAY16_BE, GRAY16_LE }"))
+            "RGBA, RGBx, AYUV, xBGR, xRGB, GRAY8, GRAY16_BE, GRAY16_LE, "
+            "I420, NV12 }"))
     );
 
 static GstVideoFilterClass *parent_class = NULL;
@@ -49,7 +51,8 @@ static GstVideoFilterClass *parent_class = NULL;
 enum
 {
   PROP_0,
-  PROP_OFF_EDGE_PIXELS
+  PROP_OFF_EDGE_PIXELS,
+  PROP_N_THREADS
 };
 
 #define GST_GT_OFF_EDGES_PIXELS_METHOD_TYPE ( \
@@ -75,6 +78,43 @@ gst_geometric_transform_off_edges_pixels_method_get_type (void)
 }
 
 #define DEFAULT_OFF_EDGE_PIXELS GST_GT_OFF_EDGES_PIXELS_IGNORE
+#define DEFAULT_N_THREADS 0
+
+/* don't split frames into bands smaller than this */
+#define MIN_BAND_HEIGHT 16
+
+/* 16.16 fixed point coordinates must fit into a gint32 */
+#define MAX_DIMENSION G_MAXINT16
+
+/* Applies the off edge pixel handling to an input coordinate and converts
+ * it to 16.16 fixed point. Returns GST_GT_MAP_INVALID if the output pixel
+ * has to be left black */
+static inline gint32
+gst_geometric_transform_fixed_coord (gint off_edge_pixels, gdouble in,
+    gint size)
+{
+  switch (off_edge_pixels) {
+    case GST_GT_OFF_EDGES_PIXELS_CLAMP:
+      in = CLAMP (in, 0, size - 1);
+      break;
+
+    case GST_GT_OFF_EDGES_PIXELS_WRAP:
+      in = mod_float (in, size);
+      if (in < 0)
+        in += size;
+      break;
+
+    default:
+      /* same validity check as truncating to the nearest pixel */
+      if (!(in > -1 && in < size))
+        return GST_GT_MAP_INVALID;
+      in = MAX (in, 0);
+      break;
+  }
+
+  /* rounding may have pushed us onto the edge again */
+  return MIN ((gint32) (in * 65536.0), (size << 16) - 1);
+}
 
 /* must be called with the object lock */
 static gboolean
@@ -84,13 +124,9 @@ gst_geometric_transform_generate_map (GstGeometricTransform * gt)
   gdouble in_x, in_y;
   gboolean ret = TRUE;
   GstGeometricTransformClass *klass;
-  gdouble *ptr;
+  gint32 *ptr;
 
-  GST_INFO_OBJECT (gt, "Generating new transform map");
-
-  /* cleanup old map */
-  g_free (gt->map);
-  gt->map = NULL;
+  GST_LOG_OBJECT (gt, "Generating new transform map");
 
   klass = GST_GEOMETRIC_TRANSFORM_GET_CLASS (gt);
 
@@ -98,9 +134,11 @@ gst_geometric_transform_generate_map (GstGeometricTransform * gt)
   g_return_val_if_fail (klass->map_func, FALSE);
 
   /*
-   * (x,y) pairs of the inverse mapping
+   * (x,y) pairs of the inverse mapping. Reuse the old map if there is one,
+   * subclasses without a precalculated map regenerate it for every frame
    */
-  gt->map = g_malloc0 (sizeof (gdouble) * gt->width * gt->height * 2);
+  if (gt->map == NULL)
+    gt->map = g_malloc (sizeof (gint32) * gt->width * gt->height * 2);
   ptr = gt->map;
 
   for (y = 0; y < gt->height; y++) {
@@ -111,8 +149,12 @@ gst_geometric_transform_generate_map (GstGeometricTransform * gt)
         goto end;
       }
 
-      ptr[0] = in_x;
-      ptr[1] = in_y;
+      ptr[0] = gst_geometric_transform_fixed_coord (gt->off_edge_pixels, in_x,
+          gt->width);
+      ptr[1] = gst_geometric_transform_fixed_coord (gt->off_edge_pixels, in_y,
+          gt->height);
+      if (ptr[0] == GST_GT_MAP_INVALID || ptr[1] == GST_GT_MAP_INVALID)
+        ptr[0] = ptr[1] = GST_GT_MAP_INVALID;
       ptr += 2;
     }
   }
@@ -127,6 +169,36 @@ end:
   return ret;
 }
 
+static void
+gst_geometric_transform_init_black (GstGeometricTransform * gt)
+{
+  memset (gt->black, 0, sizeof (gt->black));
+
+  switch (gt->format) {
+    case GST_VIDEO_FORMAT_AYUV:
+      /* in AYUV black is not just all zeros:
+       * 0x10 is black for Y,
+       * 0x80 is black for Cr and Cb */
+      gt->black[0][0] = 0xff;
+      gt->black[0][1] = 0x10;
+      gt->black[0][2] = 0x80;
+      gt->black[0][3] = 0x80;
+      break;
+    case GST_VIDEO_FORMAT_I420:
+      gt->black[0][0] = 0x10;
+      gt->black[1][0] = 0x80;
+      gt->black[2][0] = 0x80;
+      break;
+    case GST_VIDEO_FORMAT_NV12:
+      gt->black[0][0] = 0x10;
+      gt->black[1][0] = 0x80;
+      gt->black[1][1] = 0x80;
+      break;
+    default:
+      break;
+  }
+}
+
 static gboolean
 gst_geometric_transform_set_info (GstVideoFilter * vfilter, GstCaps * incaps,
     GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
@@ -143,15 +215,30 @@ gst_geometric_transform_set_info (GstVideoFilter * vfilter, GstCaps * incaps,
   old_width = gt->width;
   old_height = gt->height;
 
+  if (in_info->width > MAX_DIMENSION || in_info->height > MAX_DIMENSION) {
+    GST_ERROR_OBJECT (gt, "Unsupported frame size %dx%d", in_info->width,
+        in_info->height);
+    return FALSE;
+  }
+
   gt->width = in_info->width;
   gt->height = in_info->height;
+  gt->format = GST_VIDEO_INFO_FORMAT (in_info);
   gt->row_stride = in_info->stride[0];
   gt->pixel_stride = GST_VIDEO_INFO_COMP_PSTRIDE (in_info, 0);
 
+  gst_geometric_transform_init_black (gt);
+
+  gt->n_bands = gt->pool ? g_thread_pool_get_max_threads (gt->pool) + 1 : 1;
+  gt->n_bands = MAX (1, MIN (gt->n_bands, gt->height / MIN_BAND_HEIGHT));
+
   /* regenerate the map */
   GST_OBJECT_LOCK (gt);
   if (gt->map == NULL || old_width == 0 || old_height == 0
       || gt->width != old_width || gt->height != old_height) {
+    g_free (gt->map);
+    gt->map = NULL;
+
     if (klass->prepare_func)
       if (!klass->prepare_func (gt)) {
         GST_OBJECT_UNLOCK (gt);
@@ -164,48 +251,176 @@ gst_geometric_transform_set_info (GstVideoFilter * vfilter, GstCaps * incaps,
   return ret;
 }
 
+/* Bilinear interpolation with 8 bit weights, exact for 8 and 16 bit
+ * samples in 32 bit arithmetic */
+#define BILINEAR(p00,p01,p10,p11,wx,wy) \
+  (((((p00) * (256 - (wx)) + (p01) * (wx)) * (256 - (wy)) + \
+    ((p10) * (256 - (wx)) + (p11) * (wx)) * (wy)) + 32768) >> 16)
+
+/* Fills rows [y_start, y_end) of one plane of the output frame. Chroma
+ * planes use the map entry of their top-left luma pixel, scaled down to
+ * the chroma resolution */
 static void
-gst_geometric_transform_do_map (GstGeometricTransform * gt, guint8 * in_data,
-    guint8 * out_data, gint x, gint y, gdouble in_x, gdouble in_y)
+gst_geometric_transform_map_plane (GstGeometricTransform * gt,
+    GstVideoFrame * in_frame, GstVideoFrame * out_frame, gint plane,
+    gint y_start, gint y_end)
 {
-  gint in_offset;
-  gint out_offset;
+  const GstVideoFormatInfo *finfo = in_frame->info.finfo;
+  const guint8 *black = gt->black[plane];
+  const guint8 *in_data;
+  guint8 *out_data;
+  gint in_stride, out_stride;
+  gint width, height, pstride;
+  gint w_sub, h_sub;
+  gboolean wrap, gray16, big_endian;
+  gint x, y, c;
+
+  in_data = GST_VIDEO_FRAME_PLANE_DATA (in_frame, plane);
+  out_data = GST_VIDEO_FRAME_PLANE_DATA (out_frame, plane);
+  in_stride = GST_VIDEO_FRAME_PLANE_STRIDE (in_frame, plane);
+  out_stride = GST_VIDEO_FRAME_PLANE_STRIDE (out_frame, plane);
+
+  /* the first component of every plane describes its layout */
+  width = GST_VIDEO_FRAME_COMP_WIDTH (in_frame, plane);
+  height = GST_VIDEO_FRAME_COMP_HEIGHT (in_frame, plane);
+  pstride = GST_VIDEO_FRAME_COMP_PSTRIDE (in_frame, plane);
+  w_sub = GST_VIDEO_FORMAT_INFO_W_SUB (finfo, plane);
+  h_sub = GST_VIDEO_FORMAT_INFO_H_SUB (finfo, plane);
+
+  wrap = gt->off_edge_pixels == GST_GT_OFF_EDGES_PIXELS_WRAP;
+  gray16 = gt->format == GST_VIDEO_FORMAT_GRAY16_BE
+      || gt->format == GST_VIDEO_FORMAT_GRAY16_LE;
+  big_endian = gt->format == GST_VIDEO_FORMAT_GRAY16_BE;
+
+  for (y = y_start; y < y_end; y++) {
+    const gint32 *ptr = gt->map + 2 * (y << h_sub) * gt->width;
+    guint8 *out = out_data + y * out_stride;
+
+    for (x = 0; x < width; x++, out += pstride) {
+      const gint32 *m = ptr + 2 * (x << w_sub);
+      const guint8 *s00, *s01, *s10, *s11;
+      gint in_x, in_y, x0, y0, x1, y1;
+      guint wx, wy;
+
+      if (m[0] == GST_GT_MAP_INVALID) {
+        memcpy (out, black, pstride);
+        continue;
+      }
 
-  out_offset = y * gt->row_stride + x * gt->pixel_stride;
+      in_x = m[0] >> w_sub;
+      in_y = m[1] >> h_sub;
+      x0 = in_x >> 16;
+      y0 = in_y >> 16;
+      wx = (in_x >> 8) & 0xff;
+      wy = (in_y >> 8) & 0xff;
 
-  /* operate on out of edge pixels */
-  switch (gt->off_edge_pixels) {
-    case GST_GT_OFF_EDGES_PIXELS_CLAMP:
-      in_x = CLAMP (in_x, 0, gt->width - 1);
-      in_y = CLAMP (in_y, 0, gt->height - 1);
-      break;
+      s00 = in_data + y0 * in_stride + x0 * pstride;
 
-    case GST_GT_OFF_EDGES_PIXELS_WRAP:
-      in_x = mod_float (in_x, gt->width);
-      in_y = mod_float (in_y, gt->height);
-      if (in_x < 0)
-        in_x += gt->width;
-      if (in_y < 0)
-        in_y += gt->height;
-      break;
+      /* integer positions, mirror/rotate/identity like maps hit this a lot */
+      if (wx == 0 && wy == 0) {
+        memcpy (out, s00, pstride);
+        continue;
+      }
 
-    default:
-      break;
+      x1 = x0 + 1;
+      if (x1 >= width)
+        x1 = wrap ? 0 : width - 1;
+      y1 = y0 + 1;
+      if (y1 >= height)
+        y1 = wrap ? 0 : height - 1;
+
+      s01 = in_data + y0 * in_stride + x1 * pstride;
+      s10 = in_data + y1 * in_stride + x0 * pstride;
+      s11 = in_data + y1 * in_stride + x1 * pstride;
+
+      if (gray16) {
+        guint p00, p01, p10, p11, v;
+
+        if (big_endian) {
+          p00 = GST_READ_UINT16_BE (s00);
+          p01 = GST_READ_UINT16_BE (s01);
+          p10 = GST_READ_UINT16_BE (s10);
+          p11 = GST_READ_UINT16_BE (s11);
+        } else {
+          p00 = GST_READ_UINT16_LE (s00);
+          p01 = GST_READ_UINT16_LE (s01);
+          p10 = GST_READ_UINT16_LE (s10);
+          p11 = GST_READ_UINT16_LE (s11);
+        }
+        v = BILINEAR (p00, p01, p10, p11, wx, wy);
+        if (big_endian)
+          GST_WRITE_UINT16_BE (out, v);
+        else
+          GST_WRITE_UINT16_LE (out, v);
+      } else {
+        for (c = 0; c < pstride; c++)
+          out[c] = BILINEAR (s00[c], s01[c], s10[c], s11[c], wx, wy);
+      }
+    }
   }
+}
+
+/* Maps band @band of @n_bands of all planes */
+static void
+gst_geometric_transform_map_band (GstGeometricTransform * gt, guint band,
+    guint n_bands)
+{
+  GstVideoFrame *in_frame = gt->in_frame;
+  GstVideoFrame *out_frame = gt->out_frame;
+  gint plane;
 
-  {
-    gint trunc_x = (gint) in_x;
-    gint trunc_y = (gint) in_y;
-    /* only set the values if the values are valid */
-    if (trunc_x >= 0 && trunc_x < gt->width && trunc_y >= 0 &&
-        trunc_y < gt->height) {
-      in_offset = trunc_y * gt->row_stride + trunc_x * gt->pixel_stride;
+  for (plane = 0; plane < GST_VIDEO_FRAME_N_PLANES (in_frame); plane++) {
+    gint height = GST_VIDEO_FRAME_COMP_HEIGHT (in_frame, plane);
 
-      memcpy (out_data + out_offset, in_data + in_offset, gt->pixel_stride);
-    }
+    gst_geometric_transform_map_plane (gt, in_frame, out_frame, plane,
+        height * band / n_bands, height * (band + 1) / n_bands);
   }
 }
 
+static void
+gst_geometric_transform_map_band_func (gpointer data,
+    GstGeometricTransform * gt)
+{
+  guint band = GPOINTER_TO_UINT (data);
+
+  gst_geometric_transform_map_band (gt, band, gt->n_bands);
+
+  g_mutex_lock (&gt->lock);
+  if (--gt->pending_bands == 0)
+    g_cond_signal (&gt->cond);
+  g_mutex_unlock (&gt->lock);
+}
+
+/* Maps the whole frame, splitting it into row bands over the thread pool */
+static void
+gst_geometric_transform_map_frame (GstGeometricTransform * gt,
+    GstVideoFrame * in_frame, GstVideoFrame * out_frame)
+{
+  guint i;
+
+  gt->in_frame = in_frame;
+  gt->out_frame = out_frame;
+
+  if (!gt->pool || gt->n_bands < 2) {
+    gst_geometric_transform_map_band (gt, 0, 1);
+  } else {
+    gt->pending_bands = gt->n_bands - 1;
+
+    for (i = 1; i < gt->n_bands; i++)
+      g_thread_pool_push (gt->pool, GUINT_TO_POINTER (i), NULL);
+
+    gst_geometric_transform_map_band (gt, 0, gt->n_bands);
+
+    g_mutex_lock (&gt->lock);
+    while (gt->pending_bands > 0)
+      g_cond_wait (&gt->cond, &gt->lock);
+    g_mutex_unlock (&gt->lock);
+  }
+
+  gt->in_frame = NULL;
+  gt->out_frame = NULL;
+}
+
 static void
 gst_geometric_transform_before_transform (GstBaseTransform * trans,
     GstBuffer * outbuf)
@@ -229,64 +444,37 @@ gst_geometric_transform_transform_frame (GstVideoFilter * vfilter,
 {
   GstGeometricTransform *gt;
   GstGeometricTransformClass *klass;
-  gint x, y;
   GstFlowReturn ret = GST_FLOW_OK;
-  gdouble *ptr;
-  guint8 *in_data;
-  guint8 *out_data;
 
   gt = GST_GEOMETRIC_TRANSFORM_CAST (vfilter);
   klass = GST_GEOMETRIC_TRANSFORM_GET_CLASS (gt);
 
-  in_data = GST_VIDEO_FRAME_PLANE_DATA (in_frame, 0);
-  out_data = GST_VIDEO_FRAME_PLANE_DATA (out_frame, 0);
-
-  if (GST_VIDEO_FRAME_FORMAT (out_frame) == GST_VIDEO_FORMAT_AYUV) {
-    /* in AYUV black is not just all zeros:
-     * 0x10 is black for Y,
-     * 0x80 is black for Cr and Cb */
-    for (int i = 0; i < out_frame->map[0].size; i += 4)
-      GST_WRITE_UINT32_BE (out_data + i, 0xff108080);
-  } else {
-    memset (out_data, 0, out_frame->map[0].size);
-  }
-
   GST_OBJECT_LOCK (gt);
-  if (gt->precalc_map) {
-    if (gt->needs_remap) {
-      if (klass->prepare_func)
-        if (!klass->prepare_func (gt)) {
-          ret = FALSE;
-          goto end;
-        }
-      gst_geometric_transform_generate_map (gt);
-    }
-    g_return_val_if_fail (gt->map, GST_FLOW_ERROR);
-    ptr = gt->map;
-    for (y = 0; y < gt->height; y++) {
-      for (x = 0; x < gt->width; x++) {
-        /* do the mapping */
-        gst_geometric_transform_do_map (gt, in_data, out_data, x, y, ptr[0],
-            ptr[1]);
-        ptr += 2;
+  if (gt->needs_remap) {
+    if (klass->prepare_func)
+      if (!klass->prepare_func (gt)) {
+        ret = GST_FLOW_ERROR;
+        goto end;
       }
+    if (!gst_geometric_transform_generate_map (gt)) {
+      ret = GST_FLOW_ERROR;
+      goto end;
     }
-  } else {
-    for (y = 0; y < gt->height; y++) {
-      for (x = 0; x < gt->width; x++) {
-        gdouble in_x, in_y;
-
-        if (klass->map_func (gt, x, y, &in_x, &in_y)) {
-          gst_geometric_transform_do_map (gt, in_data, out_data, x, y, in_x,
-              in_y);
-        } else {
-          GST_WARNING_OBJECT (gt, "Failed to do mapping for %d %d", x, y);
-          ret = GST_FLOW_ERROR;
-          goto end;
-        }
-      }
+  } else if (!gt->precalc_map) {
+    /* the mapping changes for every frame */
+    if (!gst_geometric_transform_generate_map (gt)) {
+      ret = GST_FLOW_ERROR;
+      goto end;
     }
   }
+  if (G_UNLIKELY (gt->map == NULL)) {
+    GST_WARNING_OBJECT (gt, "No transform map");
+    ret = GST_FLOW_ERROR;
+    goto end;
+  }
+
+  gst_geometric_transform_map_frame (gt, in_frame, out_frame);
+
 end:
   GST_OBJECT_UNLOCK (gt);
   return ret;
@@ -304,8 +492,13 @@ gst_geometric_transform_set_property (GObject * object, guint prop_id,
     case PROP_OFF_EDGE_PIXELS:
       GST_OBJECT_LOCK (gt);
       gt->off_edge_pixels = g_value_get_enum (value);
+      /* the off edge handling is part of the map */
+      gst_geometric_transform_set_need_remap (gt);
       GST_OBJECT_UNLOCK (gt);
       break;
+    case PROP_N_THREADS:
+      gt->n_threads = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -324,12 +517,50 @@ gst_geometric_transform_get_property (GObject * object, guint prop_id,
     case PROP_OFF_EDGE_PIXELS:
       g_value_set_enum (value, gt->off_edge_pixels);
       break;
+    case PROP_N_THREADS:
+      g_value_set_uint (value, gt->n_threads);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+static void
+gst_geometric_transform_finalize (GObject * object)
+{
+  GstGeometricTransform *gt = GST_GEOMETRIC_TRANSFORM_CAST (object);
+
+  g_mutex_clear (&gt->lock);
+  g_cond_clear (&gt->cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static gboolean
+gst_geometric_transform_start (GstBaseTransform * trans)
+{
+  GstGeometricTransform *gt = GST_GEOMETRIC_TRANSFORM_CAST (trans);
+  guint n_threads = gt->n_threads;
+
+  if (n_threads == 0) {
+#if GLIB_CHECK_VERSION (2, 36, 0)
+    n_threads = g_get_num_processors ();
+#else
+    n_threads = 1;
+#endif
+  }
+
+  if (n_threads > 1) {
+    gt->pool =
+        g_thread_pool_new ((GFunc) gst_geometric_transform_map_band_func, gt,
+        n_threads - 1, FALSE, NULL);
+  }
+
+  GST_DEBUG_OBJECT (gt, "Mapping with %u threads", n_threads);
+
+  return TRUE;
+}
 
 static gboolean
 gst_geometric_transform_stop (GstBaseTransform * trans)
@@ -338,6 +569,11 @@ gst_geometric_transform_stop (GstBaseTransform * trans)
 
   GST_INFO_OBJECT (gt, "Deleting transform map");
 
+  if (gt->pool) {
+    g_thread_pool_free (gt->pool, FALSE, TRUE);
+    gt->pool = NULL;
+  }
+
   gt->width = 0;
   gt->height = 0;
 
@@ -373,7 +609,9 @@ gst_geometric_transform_class_init (gpointer klass, gpointer class_data)
 
   obj_class->set_property = gst_geometric_transform_set_property;
   obj_class->get_property = gst_geometric_transform_get_property;
+  obj_class->finalize = gst_geometric_transform_finalize;
 
+  trans_class->start = GST_DEBUG_FUNCPTR (gst_geometric_transform_start);
   trans_class->stop = GST_DEBUG_FUNCPTR (gst_geometric_transform_stop);
   trans_class->before_transform =
       GST_DEBUG_FUNCPTR (gst_geometric_transform_before_transform);
@@ -388,6 +626,12 @@ gst_geometric_transform_class_init (gpointer klass, gpointer class_data)
           "What to do with off edge pixels",
           GST_GT_OFF_EDGES_PIXELS_METHOD_TYPE, DEFAULT_OFF_EDGE_PIXELS,
           GST_PARAM_CONTROLLABLE | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Number of threads",
+          "Number of threads used for mapping (0 = number of processors)",
+          0, G_MAXINT, DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -396,8 +640,12 @@ gst_geometric_transform_init (GTypeInstance * instance, gpointer g_class)
   GstGeometricTransform *gt = GST_GEOMETRIC_TRANSFORM_CAST (instance);
 
   gt->off_edge_pixels = DEFAULT_OFF_EDGE_PIXELS;
+  gt->n_threads = DEFAULT_N_THREADS;
   gt->precalc_map = TRUE;
   gt->needs_remap = TRUE;
+
+  g_mutex_init (&gt->lock);
+  g_cond_init (&gt->cond);
 }
 
 GType
@@ -46,6 +46,8 @@ enum
   GST_GT_OFF_EDGES_PIXELS_WRAP
 };
 
+#define GST_GT_MAP_INVALID G_MININT32
+
 typedef struct _GstGeometricTransform GstGeometricTransform;
 typedef struct _GstGeometricTransformClass GstGeometricTransformClass;
 
@@ -99,8 +101,24 @@ struct _GstGeometricTransform {
 
   /* properties */
   gint off_edge_pixels;
-
-  gdouble *map;
+  guint n_threads;
+
+  /* (x,y) pairs of the inverse mapping in 16.16 fixed point, already
+   * clamped or wrapped into the input frame according to off_edge_pixels.
+   * Pixels that map outside of the input are GST_GT_MAP_INVALID */
+  gint32 *map;
+
+  /* per plane value of an off edge output pixel */
+  guint8 black[GST_VIDEO_MAX_PLANES][4];
+
+  /* row band threading, protected by lock */
+  GThreadPool *pool;
+  guint n_bands;
+  GMutex lock;
+  GCond cond;
+  guint pending_bands;
+  GstVideoFrame *in_frame;
+  GstVideoFrame *out_frame;
 };
 
 struct _GstGeometricTransformClass {
@@ -61,6 +61,8 @@ static void gst_inter_audio_sink_finalize (GObject * object);
 
 static void gst_inter_audio_sink_get_times (GstBaseSink * sink,
     GstBuffer * buffer, GstClockTime * start, GstClockTime * end);
+static gboolean gst_inter_audio_sink_set_caps (GstBaseSink * sink,
+    GstCaps * caps);
 static gboolean gst_inter_audio_sink_start (GstBaseSink * sink);
 static gboolean gst_inter_audio_sink_stop (GstBaseSink * sink);
 static GstFlowReturn gst_inter_audio_sink_render (GstBaseSink * sink,
@@ -78,8 +80,7 @@ static GstStaticPadTemplate gst_inter_audio_sink_sink_template =
 GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS ("audio/x-raw, format = (string) " GST_AUDIO_NE (S16) ", "
-        "rate = (int) 48000, channels = (int) 2")
+    GST_STATIC_CAPS (GST_AUDIO_CAPS_MAKE (GST_AUDIO_FORMATS_ALL))
     );
 
 
@@ -111,6 +112,7 @@ gst_inter_audio_sink_class_init (GstInterAudioSinkClass * klass)
   gobject_class->finalize = gst_inter_audio_sink_finalize;
   base_sink_class->get_times =
       GST_DEBUG_FUNCPTR (gst_inter_audio_sink_get_times);
+  base_sink_class->set_caps = GST_DEBUG_FUNCPTR (gst_inter_audio_sink_set_caps);
   base_sink_class->start = GST_DEBUG_FUNCPTR (gst_inter_audio_sink_start);
   base_sink_class->stop = GST_DEBUG_FUNCPTR (gst_inter_audio_sink_stop);
   base_sink_class->render = GST_DEBUG_FUNCPTR (gst_inter_audio_sink_render);
@@ -194,6 +196,31 @@ gst_inter_audio_sink_get_times (GstBaseSink * sink, GstBuffer * buffer,
 
 }
 
+/* Readers can't use the old samples with the new format, so this starts a
+ * new sample timeline */
+static gboolean
+gst_inter_audio_sink_set_caps (GstBaseSink * sink, GstCaps * caps)
+{
+  GstInterAudioSink *interaudiosink = GST_INTER_AUDIO_SINK (sink);
+  GstInterSurface *surface = interaudiosink->surface;
+
+  if (!gst_audio_info_from_caps (&interaudiosink->info, caps)) {
+    GST_ERROR_OBJECT (sink, "Failed to parse caps %" GST_PTR_FORMAT, caps);
+    return FALSE;
+  }
+
+  gst_caps_replace (&interaudiosink->caps, caps);
+
+  g_mutex_lock (&surface->mutex);
+  gst_caps_replace (&surface->audio_caps, caps);
+  gst_inter_surface_ring_clear (&surface->audio_ring);
+  surface->audio_epoch = GST_CLOCK_TIME_NONE;
+  surface->audio_offset = 0;
+  g_mutex_unlock (&surface->mutex);
+
+  return TRUE;
+}
+
 static gboolean
 gst_inter_audio_sink_start (GstBaseSink * sink)
 {
@@ -214,12 +241,17 @@ gst_inter_audio_sink_stop (GstBaseSink * sink)
   GST_DEBUG ("stop");
 
   g_mutex_lock (&interaudiosink->surface->mutex);
-  gst_adapter_clear (interaudiosink->surface->audio_adapter);
+  gst_inter_surface_ring_clear (&interaudiosink->surface->audio_ring);
+  gst_caps_replace (&interaudiosink->surface->audio_caps, NULL);
+  interaudiosink->surface->audio_epoch = GST_CLOCK_TIME_NONE;
+  interaudiosink->surface->audio_offset = 0;
   g_mutex_unlock (&interaudiosink->surface->mutex);
 
   gst_inter_surface_unref (interaudiosink->surface);
   interaudiosink->surface = NULL;
 
+  gst_caps_replace (&interaudiosink->caps, NULL);
+
   return TRUE;
 }
 
@@ -227,22 +259,64 @@ static GstFlowReturn
 gst_inter_audio_sink_render (GstBaseSink * sink, GstBuffer * buffer)
 {
   GstInterAudioSink *interaudiosink = GST_INTER_AUDIO_SINK (sink);
-  int n;
+  GstInterSurface *surface = interaudiosink->surface;
+  GstClockTime timestamp;
+  int rate = GST_AUDIO_INFO_RATE (&interaudiosink->info);
+  guint64 n;
 
   GST_DEBUG ("render %" G_GSIZE_FORMAT, gst_buffer_get_size (buffer));
 
-  g_mutex_lock (&interaudiosink->surface->mutex);
-  n = gst_adapter_available (interaudiosink->surface->audio_adapter) / 4;
-#define SIZE 1600
-  if (n > (SIZE * 3)) {
-    int n_chunks = (n / (SIZE / 2)) - 4;
-    GST_WARNING ("flushing %d samples", n_chunks * 800);
-    gst_adapter_flush (interaudiosink->surface->audio_adapter,
-        n_chunks * (SIZE / 2) * 4);
+  if (G_UNLIKELY (interaudiosink->caps == NULL))
+    return GST_FLOW_NOT_NEGOTIATED;
+
+  n = gst_buffer_get_size (buffer) / GST_AUDIO_INFO_BPF (&interaudiosink->info);
+  timestamp = gst_inter_surface_clock_time (GST_ELEMENT (sink),
+      &sink->segment, GST_BUFFER_PTS (buffer));
+
+  g_mutex_lock (&surface->mutex);
+  /* The ring counts buffers, make sure that it covers enough time for the
+   * sources with the size of the buffers we get */
+  if (n > 0) {
+    guint64 span = gst_util_uint64_scale_int_ceil (GST_INTER_SURFACE_AUDIO_SPAN,
+        rate, GST_SECOND);
+
+    gst_inter_surface_ring_reserve (&surface->audio_ring,
+        MIN ((span + n - 1) / n + 1, G_MAXUINT16));
   }
-  gst_adapter_push (interaudiosink->surface->audio_adapter,
-      gst_buffer_ref (buffer));
-  g_mutex_unlock (&interaudiosink->surface->mutex);
+  /* Samples are placed contiguously on the surface timeline, only resync
+   * the timeline to the timestamps if they drift too much */
+  if (GST_CLOCK_TIME_IS_VALID (timestamp)) {
+    if (!GST_CLOCK_TIME_IS_VALID (surface->audio_epoch)
+        || timestamp < surface->audio_epoch) {
+      gst_inter_surface_ring_clear (&surface->audio_ring);
+      surface->audio_epoch = timestamp;
+      surface->audio_offset = 0;
+    } else {
+      GstClockTime expected = surface->audio_epoch +
+          gst_util_uint64_scale_int (surface->audio_offset, GST_SECOND, rate);
+      guint64 offset = gst_util_uint64_scale_int (timestamp -
+          surface->audio_epoch, rate, GST_SECOND);
+
+      if (timestamp > expected + GST_INTER_SURFACE_AUDIO_RESYNC_THRESHOLD) {
+        GST_DEBUG_OBJECT (sink, "discontinuity of %" GST_TIME_FORMAT,
+            GST_TIME_ARGS (timestamp - expected));
+        surface->audio_offset = offset;
+      } else if (timestamp + GST_INTER_SURFACE_AUDIO_RESYNC_THRESHOLD <
+          expected) {
+        /* readers would see overlapping samples, start over */
+        GST_DEBUG_OBJECT (sink, "going back by %" GST_TIME_FORMAT,
+            GST_TIME_ARGS (expected - timestamp));
+        gst_inter_surface_ring_clear (&surface->audio_ring);
+        surface->audio_epoch = timestamp;
+        surface->audio_offset = 0;
+      }
+    }
+  }
+  gst_inter_surface_ring_push (&surface->audio_ring, buffer,
+      interaudiosink->caps, timestamp, surface->audio_offset,
+      surface->audio_offset + n);
+  surface->audio_offset += n;
+  g_mutex_unlock (&surface->mutex);
 
   return GST_FLOW_OK;
 }
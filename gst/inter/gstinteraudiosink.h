@@ -21,6 +21,7 @@
 #define _GST_INTER_AUDIO_SINK_H_
 
 #include <gst/base/gstbasesink.h>
+#include <gst/audio/audio.h>
 #include "gstintersurface.h"
 
 G_BEGIN_DECLS
@@ -43,6 +44,9 @@ struct _GstInterAudioSink
 
   int fps_n;
   int fps_d;
+
+  GstCaps *caps;
+  GstAudioInfo info;
 };
 
 struct _GstInterAudioSinkClass
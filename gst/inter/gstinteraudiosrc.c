@@ -22,6 +22,10 @@
  * The interaudiosrc element is an audio source element.  It is used
  * in connection with a interaudiosink element in a different pipeline.
  *
+ * Any number of interaudiosrc elements can read from the same channel, each
+ * one reading the samples the sink rendered at its running time minus the
+ * reported latency. The format is taken over from the interaudiosink.
+ *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
@@ -69,6 +73,8 @@ static GstFlowReturn
 gst_inter_audio_src_create (GstBaseSrc * src, guint64 offset, guint size,
     GstBuffer ** buf);
 static gboolean gst_inter_audio_src_query (GstBaseSrc * src, GstQuery * query);
+static GstCaps *gst_inter_audio_src_get_caps (GstBaseSrc * src,
+    GstCaps * filter);
 static GstCaps *gst_inter_audio_src_fixate (GstBaseSrc * src, GstCaps * caps);
 
 enum
@@ -83,8 +89,7 @@ static GstStaticPadTemplate gst_inter_audio_src_src_template =
 GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS ("audio/x-raw, format = (string) " GST_AUDIO_NE (S16) ", "
-        "rate = (int) 48000, channels = (int) 2")
+    GST_STATIC_CAPS (GST_AUDIO_CAPS_MAKE (GST_AUDIO_FORMATS_ALL))
     );
 
 
@@ -120,6 +125,7 @@ gst_inter_audio_src_class_init (GstInterAudioSrcClass * klass)
   base_src_class->get_times = GST_DEBUG_FUNCPTR (gst_inter_audio_src_get_times);
   base_src_class->create = GST_DEBUG_FUNCPTR (gst_inter_audio_src_create);
   base_src_class->query = GST_DEBUG_FUNCPTR (gst_inter_audio_src_query);
+  base_src_class->get_caps = GST_DEBUG_FUNCPTR (gst_inter_audio_src_get_caps);
   base_src_class->fixate = GST_DEBUG_FUNCPTR (gst_inter_audio_src_fixate);
 
   g_object_class_install_property (gobject_class, PROP_CHANNEL,
@@ -186,27 +192,27 @@ static gboolean
 gst_inter_audio_src_set_caps (GstBaseSrc * src, GstCaps * caps)
 {
   GstInterAudioSrc *interaudiosrc = GST_INTER_AUDIO_SRC (src);
-  const GstStructure *structure;
   GstAudioInfo info;
-  gboolean ret;
-  int sample_rate;
 
   GST_DEBUG_OBJECT (interaudiosrc, "set_caps");
 
-  structure = gst_caps_get_structure (caps, 0);
-
-  ret = gst_structure_get_int (structure, "rate", &sample_rate);
-  if (ret) {
-    interaudiosrc->sample_rate = sample_rate;
-
-    ret = gst_pad_set_caps (src->srcpad, caps);
+  if (!gst_audio_info_from_caps (&info, caps)) {
+    GST_ERROR_OBJECT (interaudiosrc, "Failed to parse caps %" GST_PTR_FORMAT,
+        caps);
+    return FALSE;
   }
 
-  if (gst_audio_info_from_caps (&info, caps)) {
-    interaudiosrc->finfo = info.finfo;
+  /* keep the timestamps continuous if the rate changes */
+  if (GST_AUDIO_INFO_RATE (&interaudiosrc->info) > 0) {
+    interaudiosrc->timestamp_offset +=
+        gst_util_uint64_scale_int (interaudiosrc->n_samples, GST_SECOND,
+        GST_AUDIO_INFO_RATE (&interaudiosrc->info));
+    interaudiosrc->n_samples = 0;
   }
+  interaudiosrc->info = info;
+  interaudiosrc->have_offset = FALSE;
 
-  return ret;
+  return gst_pad_set_caps (src->srcpad, caps);
 }
 
 
@@ -218,6 +224,10 @@ gst_inter_audio_src_start (GstBaseSrc * src)
   GST_DEBUG_OBJECT (interaudiosrc, "start");
 
   interaudiosrc->surface = gst_inter_surface_get (interaudiosrc->channel);
+  gst_audio_info_init (&interaudiosrc->info);
+  interaudiosrc->timestamp_offset = 0;
+  interaudiosrc->n_samples = 0;
+  interaudiosrc->have_offset = FALSE;
 
   return TRUE;
 }
@@ -231,7 +241,7 @@ gst_inter_audio_src_stop (GstBaseSrc * src)
 
   gst_inter_surface_unref (interaudiosrc->surface);
   interaudiosrc->surface = NULL;
-  interaudiosrc->finfo = NULL;
+  gst_caps_replace (&interaudiosrc->surface_caps, NULL);
 
   return TRUE;
 }
@@ -262,62 +272,157 @@ gst_inter_audio_src_get_times (GstBaseSrc * src, GstBuffer * buffer,
 }
 
 
-#define SIZE 1600
+/* one buffer per 1/30 s, i.e. 1600 samples at 48kHz */
+#define BUFFERS_PER_SECOND GST_INTER_SURFACE_AUDIO_BUFFERS_PER_SECOND
+
+/* how far behind the sink we read */
+#define LATENCY GST_INTER_SURFACE_AUDIO_LATENCY
+
+/* Copies @n samples at our read cursor from the surface into @data and
+ * returns the number of samples that were available. Leaves the rest of
+ * @data untouched.
+ * Must be called with the surface mutex */
+static guint64
+gst_inter_audio_src_read (GstInterAudioSrc * interaudiosrc,
+    GstClockTime target, guint8 * data, guint64 n)
+{
+  GstInterSurface *surface = interaudiosrc->surface;
+  GstInterSurfaceRing *ring = &surface->audio_ring;
+  GstInterSurfaceSlot *slot;
+  int rate = GST_AUDIO_INFO_RATE (&interaudiosrc->info);
+  int bpf = GST_AUDIO_INFO_BPF (&interaudiosrc->info);
+  guint64 latency = gst_util_uint64_scale_int (LATENCY, rate, GST_SECOND);
+  guint64 threshold = gst_util_uint64_scale_int
+      (GST_INTER_SURFACE_AUDIO_RESYNC_THRESHOLD, rate, GST_SECOND);
+  guint64 read_offset, wanted, seqnum, newest_end;
+  guint64 copied = 0;
+  gboolean resync;
+
+  if (ring->seqnum == 0)
+    return 0;
+  slot = gst_inter_surface_ring_get (ring, ring->seqnum - 1);
+  if (slot->buffer == NULL)
+    return 0;
+  newest_end = slot->offset_end;
+
+  /* Select the samples by running time if both sides have a clock,
+   * otherwise just stay a fixed distance behind the sink */
+  if (GST_CLOCK_TIME_IS_VALID (target)
+      && GST_CLOCK_TIME_IS_VALID (surface->audio_epoch)) {
+    wanted = target > surface->audio_epoch ?
+        gst_util_uint64_scale_int (target - surface->audio_epoch, rate,
+        GST_SECOND) : 0;
+    resync = !interaudiosrc->have_offset
+        || interaudiosrc->read_offset > wanted + threshold
+        || interaudiosrc->read_offset + threshold < wanted;
+  } else {
+    wanted = newest_end > latency ? newest_end - latency : 0;
+    resync = !interaudiosrc->have_offset
+        || interaudiosrc->read_offset > newest_end
+        || interaudiosrc->read_offset + 2 * latency < newest_end;
+  }
+
+  if (resync) {
+    GST_DEBUG_OBJECT (interaudiosrc, "resync from offset %" G_GUINT64_FORMAT
+        " to %" G_GUINT64_FORMAT, interaudiosrc->read_offset, wanted);
+    interaudiosrc->read_offset = wanted;
+    interaudiosrc->have_offset = TRUE;
+  }
+  read_offset = interaudiosrc->read_offset;
+
+  seqnum = ring->seqnum > ring->n_slots ? ring->seqnum - ring->n_slots : 0;
+  for (; seqnum < ring->seqnum; seqnum++) {
+    guint64 start, end;
+
+    slot = gst_inter_surface_ring_get (ring, seqnum);
+    if (slot == NULL || slot->buffer == NULL)
+      continue;
+
+    start = MAX (slot->offset, read_offset);
+    end = MIN (slot->offset_end, read_offset + n);
+    if (start >= end)
+      continue;
+
+    gst_buffer_extract (slot->buffer, (start - slot->offset) * bpf,
+        data + (start - read_offset) * bpf, (end - start) * bpf);
+    copied += end - start;
+  }
+
+  interaudiosrc->read_offset += n;
+
+  return copied;
+}
 
 static GstFlowReturn
 gst_inter_audio_src_create (GstBaseSrc * src, guint64 offset, guint size,
     GstBuffer ** buf)
 {
   GstInterAudioSrc *interaudiosrc = GST_INTER_AUDIO_SRC (src);
+  GstInterSurface *surface = interaudiosrc->surface;
   GstBuffer *buffer;
-  int n;
+  GstCaps *caps = NULL;
+  GstMapInfo map;
+  GstClockTime timestamp, target;
+  guint64 n, copied = 0;
+  int rate;
 
   GST_DEBUG_OBJECT (interaudiosrc, "create");
 
-  buffer = NULL;
-
-  g_mutex_lock (&interaudiosrc->surface->mutex);
-  n = gst_adapter_available (interaudiosrc->surface->audio_adapter) / 4;
-  if (n > SIZE * 3) {
-    GST_WARNING ("flushing %d samples", SIZE / 2);
-    gst_adapter_flush (interaudiosrc->surface->audio_adapter, (SIZE / 2) * 4);
-    n -= (SIZE / 2);
-  }
-  if (n > SIZE)
-    n = SIZE;
-  if (n > 0) {
-    buffer = gst_adapter_take_buffer (interaudiosrc->surface->audio_adapter,
-        n * 4);
-  } else {
-    buffer = gst_buffer_new ();
+  /* follow format changes of the sink */
+  g_mutex_lock (&surface->mutex);
+  if (surface->audio_caps && surface->audio_caps != interaudiosrc->surface_caps)
+    caps = gst_caps_ref (surface->audio_caps);
+  g_mutex_unlock (&surface->mutex);
+
+  if (caps) {
+    if (interaudiosrc->surface_caps == NULL
+        || !gst_caps_is_equal (caps, interaudiosrc->surface_caps)) {
+      GST_DEBUG_OBJECT (interaudiosrc, "renegotiating to %" GST_PTR_FORMAT,
+          caps);
+      if (!gst_base_src_set_caps (src, caps)) {
+        gst_caps_unref (caps);
+        return GST_FLOW_NOT_NEGOTIATED;
+      }
+    }
+    gst_caps_replace (&interaudiosrc->surface_caps, caps);
+    gst_caps_unref (caps);
   }
-  g_mutex_unlock (&interaudiosrc->surface->mutex);
 
-  if (n < SIZE) {
-    GstMapInfo map;
-    GstMemory *mem;
-
-    GST_WARNING ("creating %d samples of silence", SIZE - n);
-    mem = gst_allocator_alloc (NULL, (SIZE - n) * 4, NULL);
-    if (gst_memory_map (mem, &map, GST_MAP_WRITE)) {
-      gst_audio_format_fill_silence (interaudiosrc->finfo, map.data, map.size);
-      gst_memory_unmap (mem, &map);
-    }
-    buffer = gst_buffer_make_writable (buffer);
-    gst_buffer_prepend_memory (buffer, mem);
+  rate = GST_AUDIO_INFO_RATE (&interaudiosrc->info);
+  n = MAX (1, rate / BUFFERS_PER_SECOND);
+
+  timestamp = interaudiosrc->timestamp_offset +
+      gst_util_uint64_scale_int (interaudiosrc->n_samples, GST_SECOND, rate);
+  target = gst_inter_surface_clock_time (GST_ELEMENT (src), &src->segment,
+      timestamp);
+  if (GST_CLOCK_TIME_IS_VALID (target))
+    target = target > LATENCY ? target - LATENCY : 0;
+
+  buffer = gst_buffer_new_allocate (NULL, n * GST_AUDIO_INFO_BPF
+      (&interaudiosrc->info), NULL);
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  gst_audio_format_fill_silence (interaudiosrc->info.finfo, map.data,
+      map.size);
+
+  g_mutex_lock (&surface->mutex);
+  /* the ring only holds samples in the format of the surface caps */
+  if (surface->audio_caps == interaudiosrc->surface_caps)
+    copied = gst_inter_audio_src_read (interaudiosrc, target, map.data, n);
+  g_mutex_unlock (&surface->mutex);
+
+  gst_buffer_unmap (buffer, &map);
+
+  if (copied < n) {
+    GST_LOG_OBJECT (interaudiosrc, "created %" G_GUINT64_FORMAT
+        " samples of silence", n - copied);
   }
-  n = SIZE;
 
-  GST_BUFFER_OFFSET (buffer) = interaudiosrc->n_samples;
-  GST_BUFFER_OFFSET_END (buffer) = interaudiosrc->n_samples + n;
-  GST_BUFFER_TIMESTAMP (buffer) =
-      gst_util_uint64_scale_int (interaudiosrc->n_samples, GST_SECOND,
-      interaudiosrc->sample_rate);
+  GST_BUFFER_TIMESTAMP (buffer) = timestamp;
   GST_DEBUG_OBJECT (interaudiosrc, "create ts %" GST_TIME_FORMAT,
       GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buffer)));
-  GST_BUFFER_DURATION (buffer) =
+  GST_BUFFER_DURATION (buffer) = interaudiosrc->timestamp_offset +
       gst_util_uint64_scale_int (interaudiosrc->n_samples + n, GST_SECOND,
-      interaudiosrc->sample_rate) - GST_BUFFER_TIMESTAMP (buffer);
+      rate) - GST_BUFFER_TIMESTAMP (buffer);
   GST_BUFFER_OFFSET (buffer) = interaudiosrc->n_samples;
   GST_BUFFER_OFFSET_END (buffer) = -1;
   GST_BUFFER_FLAG_UNSET (buffer, GST_BUFFER_FLAG_DISCONT);
@@ -343,7 +448,7 @@ gst_inter_audio_src_query (GstBaseSrc * src, GstQuery * query)
     case GST_QUERY_LATENCY:{
       GstClockTime min_latency, max_latency;
 
-      min_latency = 30 * gst_util_uint64_scale_int (GST_SECOND, SIZE, 48000);
+      min_latency = LATENCY;
 
       max_latency = min_latency;
 
@@ -366,6 +471,33 @@ gst_inter_audio_src_query (GstBaseSrc * src, GstQuery * query)
   return ret;
 }
 
+/* Offers the format of the surface if a sink has already configured it */
+static GstCaps *
+gst_inter_audio_src_get_caps (GstBaseSrc * src, GstCaps * filter)
+{
+  GstInterAudioSrc *interaudiosrc = GST_INTER_AUDIO_SRC (src);
+  GstCaps *caps = NULL;
+  GstCaps *tmp;
+
+  if (interaudiosrc->surface) {
+    g_mutex_lock (&interaudiosrc->surface->mutex);
+    if (interaudiosrc->surface->audio_caps)
+      caps = gst_caps_ref (interaudiosrc->surface->audio_caps);
+    g_mutex_unlock (&interaudiosrc->surface->mutex);
+  }
+
+  if (caps == NULL)
+    caps = gst_pad_get_pad_template_caps (GST_BASE_SRC_PAD (src));
+
+  if (filter) {
+    tmp = gst_caps_intersect_full (filter, caps, GST_CAPS_INTERSECT_FIRST);
+    gst_caps_unref (caps);
+    caps = tmp;
+  }
+
+  return caps;
+}
+
 static GstCaps *
 gst_inter_audio_src_fixate (GstBaseSrc * src, GstCaps * caps)
 {
@@ -379,6 +511,11 @@ gst_inter_audio_src_fixate (GstBaseSrc * src, GstCaps * caps)
 
   gst_structure_fixate_field_nearest_int (structure, "channels", 2);
   gst_structure_fixate_field_nearest_int (structure, "rate", 48000);
+  if (gst_structure_has_field (structure, "format"))
+    gst_structure_fixate_field_string (structure, "format",
+        GST_AUDIO_NE (S16));
+
+  caps = gst_caps_fixate (caps);
 
   return caps;
 }
@@ -42,10 +42,15 @@ struct _GstInterAudioSrc
   GstInterSurface *surface;
   char *channel;
 
+  GstAudioInfo info;
   guint64 n_samples;
-  int sample_rate;
+  GstClockTime timestamp_offset;
 
-  const GstAudioFormatInfo *finfo;
+  /* caps of the surface the negotiated caps were derived from */
+  GstCaps *surface_caps;
+  /* position in the sample timeline of the surface */
+  guint64 read_offset;
+  gboolean have_offset;
 };
 
 struct _GstInterAudioSrcClass
@@ -29,6 +29,14 @@ static GList *list;
 static GMutex mutex;
 
 
+static void
+gst_inter_surface_ring_init (GstInterSurfaceRing * ring, guint n_slots)
+{
+  ring->slots = g_new0 (GstInterSurfaceSlot, n_slots);
+  ring->n_slots = n_slots;
+  ring->seqnum = 0;
+}
+
 GstInterSurface *
 gst_inter_surface_get (const char *name)
 {
@@ -40,6 +48,7 @@ gst_inter_surface_get (const char *name)
   for (g = list; g; g = g_list_next (g)) {
     surface = (GstInterSurface *) g->data;
     if (strcmp (name, surface->name) == 0) {
+      surface->ref_count++;
       g_mutex_unlock (&mutex);
       return surface;
     }
@@ -47,8 +56,13 @@ gst_inter_surface_get (const char *name)
 
   surface = g_malloc0 (sizeof (GstInterSurface));
   surface->name = g_strdup (name);
+  surface->ref_count = 1;
   g_mutex_init (&surface->mutex);
-  surface->audio_adapter = gst_adapter_new ();
+  gst_inter_surface_ring_init (&surface->video_ring,
+      GST_INTER_SURFACE_VIDEO_SLOTS);
+  gst_inter_surface_ring_init (&surface->audio_ring,
+      GST_INTER_SURFACE_AUDIO_SLOTS);
+  surface->audio_epoch = GST_CLOCK_TIME_NONE;
 
   list = g_list_append (list, surface);
   g_mutex_unlock (&mutex);
@@ -59,5 +73,111 @@ gst_inter_surface_get (const char *name)
 void
 gst_inter_surface_unref (GstInterSurface * surface)
 {
+  g_mutex_lock (&mutex);
+  if (--surface->ref_count > 0) {
+    g_mutex_unlock (&mutex);
+    return;
+  }
+  list = g_list_remove (list, surface);
+  g_mutex_unlock (&mutex);
+
+  gst_inter_surface_ring_clear (&surface->video_ring);
+  gst_inter_surface_ring_clear (&surface->audio_ring);
+  g_free (surface->video_ring.slots);
+  g_free (surface->audio_ring.slots);
+  gst_caps_replace (&surface->video_caps, NULL);
+  gst_caps_replace (&surface->audio_caps, NULL);
+  gst_buffer_replace (&surface->sub_buffer, NULL);
+  g_mutex_clear (&surface->mutex);
+  g_free (surface->name);
+  g_free (surface);
+}
+
+/* Converts a buffer timestamp of @element into the clock time it is
+ * rendered at */
+GstClockTime
+gst_inter_surface_clock_time (GstElement * element, const GstSegment * segment,
+    GstClockTime timestamp)
+{
+  GstClockTime running_time;
+  GstClock *clock;
+
+  if (!GST_CLOCK_TIME_IS_VALID (timestamp))
+    return GST_CLOCK_TIME_NONE;
+
+  clock = gst_element_get_clock (element);
+  if (clock == NULL)
+    return GST_CLOCK_TIME_NONE;
+  gst_object_unref (clock);
+
+  running_time = gst_segment_to_running_time (segment, GST_FORMAT_TIME,
+      timestamp);
+  if (!GST_CLOCK_TIME_IS_VALID (running_time))
+    return GST_CLOCK_TIME_NONE;
+
+  return running_time + gst_element_get_base_time (element);
+}
+
+/* Must be called with the surface mutex */
+void
+gst_inter_surface_ring_push (GstInterSurfaceRing * ring, GstBuffer * buffer,
+    GstCaps * caps, GstClockTime timestamp, guint64 offset, guint64 offset_end)
+{
+  GstInterSurfaceSlot *slot = &ring->slots[ring->seqnum % ring->n_slots];
+
+  gst_buffer_replace (&slot->buffer, buffer);
+  gst_caps_replace (&slot->caps, caps);
+  slot->timestamp = timestamp;
+  slot->offset = offset;
+  slot->offset_end = offset_end;
+
+  ring->seqnum++;
+}
+
+/* Returns the slot holding the buffer with @seqnum, or NULL if it was not
+ * written yet or was already overwritten.
+ * Must be called with the surface mutex */
+GstInterSurfaceSlot *
+gst_inter_surface_ring_get (GstInterSurfaceRing * ring, guint64 seqnum)
+{
+  if (seqnum >= ring->seqnum || seqnum + ring->n_slots < ring->seqnum)
+    return NULL;
+
+  return &ring->slots[seqnum % ring->n_slots];
+}
+
+/* Must be called with the surface mutex */
+void
+gst_inter_surface_ring_clear (GstInterSurfaceRing * ring)
+{
+  guint i;
+
+  for (i = 0; i < ring->n_slots; i++) {
+    gst_buffer_replace (&ring->slots[i].buffer, NULL);
+    gst_caps_replace (&ring->slots[i].caps, NULL);
+  }
+
+  /* keep counting so that readers notice their cursors are stale */
+  ring->seqnum += ring->n_slots;
+}
+
+/* Grows the ring to at least @n_slots, keeping the buffers it holds.
+ * Must be called with the surface mutex */
+void
+gst_inter_surface_ring_reserve (GstInterSurfaceRing * ring, guint n_slots)
+{
+  GstInterSurfaceSlot *slots;
+  guint64 seqnum;
+
+  if (n_slots <= ring->n_slots)
+    return;
+
+  slots = g_new0 (GstInterSurfaceSlot, n_slots);
+  seqnum = ring->seqnum > ring->n_slots ? ring->seqnum - ring->n_slots : 0;
+  for (; seqnum < ring->seqnum; seqnum++)
+    slots[seqnum % n_slots] = ring->slots[seqnum % ring->n_slots];
 
+  g_free (ring->slots);
+  ring->slots = slots;
+  ring->n_slots = n_slots;
 }
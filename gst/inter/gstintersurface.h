@@ -20,40 +20,97 @@
 #ifndef _GST_INTER_SURFACE_H_
 #define _GST_INTER_SURFACE_H_
 
-#include <gst/base/gstadapter.h>
+#include <gst/gst.h>
 #include <gst/video/video.h>
 
 G_BEGIN_DECLS
 
 typedef struct _GstInterSurface GstInterSurface;
+typedef struct _GstInterSurfaceSlot GstInterSurfaceSlot;
+typedef struct _GstInterSurfaceRing GstInterSurfaceRing;
+
+/* Number of buffers kept per stream. The audio ring grows beyond this when
+ * the sink gets small buffers, see GST_INTER_SURFACE_AUDIO_SPAN */
+#define GST_INTER_SURFACE_VIDEO_SLOTS 8
+#define GST_INTER_SURFACE_AUDIO_SLOTS 64
+
+/* How far behind the sink the audio sources read and how many buffers
+ * they output per second */
+#define GST_INTER_SURFACE_AUDIO_LATENCY (200 * GST_MSECOND)
+#define GST_INTER_SURFACE_AUDIO_BUFFERS_PER_SECOND 30
+
+/* Duration of audio the ring must hold. Without a clock sources may fall
+ * up to twice the latency behind before they resync */
+#define GST_INTER_SURFACE_AUDIO_SPAN (2 * GST_INTER_SURFACE_AUDIO_LATENCY + \
+    GST_SECOND / GST_INTER_SURFACE_AUDIO_BUFFERS_PER_SECOND)
+
+/* Maximum drift between the audio timestamps and the sample count */
+#define GST_INTER_SURFACE_AUDIO_RESYNC_THRESHOLD (40 * GST_MSECOND)
+
+struct _GstInterSurfaceSlot
+{
+  GstBuffer *buffer;
+  GstCaps *caps;
+
+  /* running time of the writer plus its base time, so that readers in
+   * other pipelines using the same clock can compare it against their own
+   * running time. GST_CLOCK_TIME_NONE if the writer has no clock */
+  GstClockTime timestamp;
+
+  /* audio: sample offsets of the buffer in the surface sample timeline */
+  guint64 offset;
+  guint64 offset_end;
+};
+
+/* Ring of the last n_slots buffers written to the surface. Readers don't
+ * consume from the ring, each one keeps its own cursor so that any number
+ * of sources can read the same surface */
+struct _GstInterSurfaceRing
+{
+  GstInterSurfaceSlot *slots;
+  guint n_slots;
+
+  /* number of buffers ever written, the newest buffer is in slot
+   * (seqnum - 1) % n_slots */
+  guint64 seqnum;
+};
 
 struct _GstInterSurface
 {
   GMutex mutex;
   char *name;
+  int ref_count;
 
   /* video */
-  GstVideoFormat format;
-  int fps_n;
-  int fps_d;
-  int width;
-  int height;
-  int n_frames;
-  int video_buffer_count;
+  GstCaps *video_caps;
+  GstInterSurfaceRing video_ring;
 
   /* audio */
-  int sample_rate;
-  int n_channels;
+  GstCaps *audio_caps;
+  GstInterSurfaceRing audio_ring;
+  /* clock time of sample offset 0 and offset of the next sample */
+  GstClockTime audio_epoch;
+  guint64 audio_offset;
 
-  GstBuffer *video_buffer;
   GstBuffer *sub_buffer;
-  GstAdapter *audio_adapter;
 };
 
 
 GstInterSurface * gst_inter_surface_get (const char *name);
 void gst_inter_surface_unref (GstInterSurface *surface);
 
+GstClockTime gst_inter_surface_clock_time (GstElement * element,
+    const GstSegment * segment, GstClockTime timestamp);
+
+void gst_inter_surface_ring_push (GstInterSurfaceRing * ring,
+    GstBuffer * buffer, GstCaps * caps, GstClockTime timestamp,
+    guint64 offset, guint64 offset_end);
+GstInterSurfaceSlot * gst_inter_surface_ring_get (GstInterSurfaceRing * ring,
+    guint64 seqnum);
+void gst_inter_surface_ring_clear (GstInterSurfaceRing * ring);
+void gst_inter_surface_ring_reserve (GstInterSurfaceRing * ring,
+    guint n_slots);
+
 
 G_END_DECLS
 
@@ -59,6 +59,8 @@ static void gst_inter_video_sink_finalize (GObject * object);
 
 static void gst_inter_video_sink_get_times (GstBaseSink * sink,
     GstBuffer * buffer, GstClockTime * start, GstClockTime * end);
+static gboolean gst_inter_video_sink_set_caps (GstBaseSink * sink,
+    GstCaps * caps);
 static gboolean gst_inter_video_sink_start (GstBaseSink * sink);
 static gboolean gst_inter_video_sink_stop (GstBaseSink * sink);
 static GstFlowReturn gst_inter_video_sink_render (GstBaseSink * sink,
@@ -76,7 +78,7 @@ static GstStaticPadTemplate gst_inter_video_sink_sink_template =
 GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("I420"))
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE (GST_VIDEO_FORMATS_ALL))
     );
 
 
@@ -108,6 +110,7 @@ gst_inter_video_sink_class_init (GstInterVideoSinkClass * klass)
   gobject_class->finalize = gst_inter_video_sink_finalize;
   base_sink_class->get_times =
       GST_DEBUG_FUNCPTR (gst_inter_video_sink_get_times);
+  base_sink_class->set_caps = GST_DEBUG_FUNCPTR (gst_inter_video_sink_set_caps);
   base_sink_class->start = GST_DEBUG_FUNCPTR (gst_inter_video_sink_start);
   base_sink_class->stop = GST_DEBUG_FUNCPTR (gst_inter_video_sink_stop);
   base_sink_class->render = GST_DEBUG_FUNCPTR (gst_inter_video_sink_render);
@@ -191,6 +194,28 @@ gst_inter_video_sink_get_times (GstBaseSink * sink, GstBuffer * buffer,
 
 }
 
+static gboolean
+gst_inter_video_sink_set_caps (GstBaseSink * sink, GstCaps * caps)
+{
+  GstInterVideoSink *intervideosink = GST_INTER_VIDEO_SINK (sink);
+  GstVideoInfo info;
+
+  if (!gst_video_info_from_caps (&info, caps)) {
+    GST_ERROR_OBJECT (sink, "Failed to parse caps %" GST_PTR_FORMAT, caps);
+    return FALSE;
+  }
+
+  intervideosink->fps_n = GST_VIDEO_INFO_FPS_N (&info);
+  intervideosink->fps_d = GST_VIDEO_INFO_FPS_D (&info);
+  gst_caps_replace (&intervideosink->caps, caps);
+
+  g_mutex_lock (&intervideosink->surface->mutex);
+  gst_caps_replace (&intervideosink->surface->video_caps, caps);
+  g_mutex_unlock (&intervideosink->surface->mutex);
+
+  return TRUE;
+}
+
 static gboolean
 gst_inter_video_sink_start (GstBaseSink * sink)
 {
@@ -207,15 +232,15 @@ gst_inter_video_sink_stop (GstBaseSink * sink)
   GstInterVideoSink *intervideosink = GST_INTER_VIDEO_SINK (sink);
 
   g_mutex_lock (&intervideosink->surface->mutex);
-  if (intervideosink->surface->video_buffer) {
-    gst_buffer_unref (intervideosink->surface->video_buffer);
-  }
-  intervideosink->surface->video_buffer = NULL;
+  gst_inter_surface_ring_clear (&intervideosink->surface->video_ring);
+  gst_caps_replace (&intervideosink->surface->video_caps, NULL);
   g_mutex_unlock (&intervideosink->surface->mutex);
 
   gst_inter_surface_unref (intervideosink->surface);
   intervideosink->surface = NULL;
 
+  gst_caps_replace (&intervideosink->caps, NULL);
+
   return TRUE;
 }
 
@@ -223,13 +248,19 @@ static GstFlowReturn
 gst_inter_video_sink_render (GstBaseSink * sink, GstBuffer * buffer)
 {
   GstInterVideoSink *intervideosink = GST_INTER_VIDEO_SINK (sink);
+  GstClockTime timestamp;
+
+  timestamp = gst_inter_surface_clock_time (GST_ELEMENT (sink),
+      &sink->segment, GST_BUFFER_PTS (buffer));
+
+  GST_LOG_OBJECT (sink, "render %" GST_TIME_FORMAT " at clock time %"
+      GST_TIME_FORMAT, GST_TIME_ARGS (GST_BUFFER_PTS (buffer)),
+      GST_TIME_ARGS (timestamp));
 
   g_mutex_lock (&intervideosink->surface->mutex);
-  if (intervideosink->surface->video_buffer) {
-    gst_buffer_unref (intervideosink->surface->video_buffer);
-  }
-  intervideosink->surface->video_buffer = gst_buffer_ref (buffer);
-  intervideosink->surface->video_buffer_count = 0;
+  gst_inter_surface_ring_push (&intervideosink->surface->video_ring, buffer,
+      intervideosink->caps, timestamp, GST_BUFFER_OFFSET_NONE,
+      GST_BUFFER_OFFSET_NONE);
   g_mutex_unlock (&intervideosink->surface->mutex);
 
   return GST_FLOW_OK;
@@ -41,6 +41,7 @@ struct _GstInterVideoSink
   GstInterSurface *surface;
   char *channel;
 
+  GstCaps *caps;
   int fps_n;
   int fps_d;
 };
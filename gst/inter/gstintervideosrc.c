@@ -23,6 +23,10 @@
  * in connection with a intervideosink element in a different pipeline,
  * similar to interaudiosink and interaudiosrc.
  *
+ * Any number of intervideosrc elements can read from the same channel. Each
+ * one outputs, at its own framerate, the newest frame the sink rendered
+ * before the running time of the output frame.
+ *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
@@ -65,6 +69,8 @@ gst_inter_video_src_get_times (GstBaseSrc * src, GstBuffer * buffer,
 static GstFlowReturn
 gst_inter_video_src_create (GstBaseSrc * src, guint64 offset, guint size,
     GstBuffer ** buf);
+static GstCaps *gst_inter_video_src_get_caps (GstBaseSrc * src,
+    GstCaps * filter);
 static GstCaps *gst_inter_video_src_fixate (GstBaseSrc * src, GstCaps * caps);
 
 enum
@@ -79,7 +85,7 @@ static GstStaticPadTemplate gst_inter_video_src_src_template =
 GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("I420"))
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE (GST_VIDEO_FORMATS_ALL))
     );
 
 
@@ -114,6 +120,7 @@ gst_inter_video_src_class_init (GstInterVideoSrcClass * klass)
   base_src_class->stop = GST_DEBUG_FUNCPTR (gst_inter_video_src_stop);
   base_src_class->get_times = GST_DEBUG_FUNCPTR (gst_inter_video_src_get_times);
   base_src_class->create = GST_DEBUG_FUNCPTR (gst_inter_video_src_create);
+  base_src_class->get_caps = GST_DEBUG_FUNCPTR (gst_inter_video_src_get_caps);
   base_src_class->fixate = GST_DEBUG_FUNCPTR (gst_inter_video_src_fixate);
 
   g_object_class_install_property (gobject_class, PROP_CHANNEL,
@@ -200,6 +207,8 @@ gst_inter_video_src_start (GstBaseSrc * src)
   GST_DEBUG_OBJECT (intervideosrc, "start");
 
   intervideosrc->surface = gst_inter_surface_get (intervideosrc->channel);
+  intervideosrc->seqnum = G_MAXUINT64;
+  intervideosrc->n_repeats = 0;
 
   return TRUE;
 }
@@ -213,6 +222,7 @@ gst_inter_video_src_stop (GstBaseSrc * src)
 
   gst_inter_surface_unref (intervideosrc->surface);
   intervideosrc->surface = NULL;
+  gst_caps_replace (&intervideosrc->surface_caps, NULL);
 
   return TRUE;
 }
@@ -243,51 +253,152 @@ gst_inter_video_src_get_times (GstBaseSrc * src, GstBuffer * buffer,
 }
 
 
+/* Fills a frame with black, or zeros for formats that are not 8 bit per
+ * component */
+static GstBuffer *
+gst_inter_video_src_create_black (GstInterVideoSrc * intervideosrc)
+{
+  GstVideoInfo *info = &intervideosrc->info;
+  GstVideoFrame frame;
+  GstBuffer *buffer;
+  int c, x, y;
+
+  buffer = gst_buffer_new_and_alloc (GST_VIDEO_INFO_SIZE (info));
+
+  if (!gst_video_frame_map (&frame, info, buffer, GST_MAP_WRITE))
+    return buffer;
+
+  for (c = 0; c < GST_VIDEO_FRAME_N_COMPONENTS (&frame); c++) {
+    if (GST_VIDEO_FORMAT_INFO_DEPTH (info->finfo, c) != 8
+        || GST_VIDEO_FRAME_COMP_PSTRIDE (&frame, c) == 0)
+      break;
+  }
+
+  if (c < GST_VIDEO_FRAME_N_COMPONENTS (&frame)) {
+    for (c = 0; c < GST_VIDEO_FRAME_N_PLANES (&frame); c++)
+      memset (GST_VIDEO_FRAME_PLANE_DATA (&frame, c), 0,
+          GST_VIDEO_FRAME_PLANE_STRIDE (&frame, c) *
+          GST_VIDEO_FRAME_COMP_HEIGHT (&frame, c));
+  } else {
+    for (c = 0; c < GST_VIDEO_FRAME_N_COMPONENTS (&frame); c++) {
+      guint8 *data = GST_VIDEO_FRAME_COMP_DATA (&frame, c);
+      int stride = GST_VIDEO_FRAME_COMP_STRIDE (&frame, c);
+      int pstride = GST_VIDEO_FRAME_COMP_PSTRIDE (&frame, c);
+      guint8 value;
+
+      if (c == GST_VIDEO_COMP_A)
+        value = 0xff;
+      else if (GST_VIDEO_INFO_IS_YUV (info))
+        value = c == GST_VIDEO_COMP_Y ? 16 : 128;
+      else
+        value = 0;
+
+      for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT (&frame, c); y++)
+        for (x = 0; x < GST_VIDEO_FRAME_COMP_WIDTH (&frame, c); x++)
+          data[y * stride + x * pstride] = value;
+    }
+  }
+
+  gst_video_frame_unmap (&frame);
+
+  return buffer;
+}
+
+/* Switches to the format of the surface, keeping our own framerate */
+static gboolean
+gst_inter_video_src_renegotiate (GstInterVideoSrc * intervideosrc,
+    GstCaps * surface_caps)
+{
+  GstCaps *caps;
+  gboolean ret;
+
+  caps = gst_caps_copy (surface_caps);
+  gst_caps_set_simple (caps, "framerate", GST_TYPE_FRACTION,
+      GST_VIDEO_INFO_FPS_N (&intervideosrc->info),
+      GST_VIDEO_INFO_FPS_D (&intervideosrc->info), NULL);
+
+  GST_DEBUG_OBJECT (intervideosrc, "renegotiating to %" GST_PTR_FORMAT, caps);
+
+  ret = gst_base_src_set_caps (GST_BASE_SRC (intervideosrc), caps);
+  gst_caps_unref (caps);
+
+  gst_caps_replace (&intervideosrc->surface_caps, surface_caps);
+
+  return ret;
+}
+
 static GstFlowReturn
 gst_inter_video_src_create (GstBaseSrc * src, guint64 offset, guint size,
     GstBuffer ** buf)
 {
   GstInterVideoSrc *intervideosrc = GST_INTER_VIDEO_SRC (src);
+  GstInterSurfaceRing *ring;
+  GstCaps *caps;
   GstBuffer *buffer;
+  GstClockTime timestamp, target;
+  guint64 seqnum;
 
   GST_DEBUG_OBJECT (intervideosrc, "create");
 
   buffer = NULL;
+  caps = NULL;
+
+  timestamp = gst_util_uint64_scale_int (GST_SECOND * intervideosrc->n_frames,
+      GST_VIDEO_INFO_FPS_D (&intervideosrc->info),
+      GST_VIDEO_INFO_FPS_N (&intervideosrc->info));
+  /* the clock time this frame is going to be shown at */
+  target = gst_inter_surface_clock_time (GST_ELEMENT (src), &src->segment,
+      timestamp);
 
+  /* pick the newest buffer that is not in the future, other readers of the
+   * surface are not affected by this */
   g_mutex_lock (&intervideosrc->surface->mutex);
-  if (intervideosrc->surface->video_buffer) {
-    buffer = gst_buffer_ref (intervideosrc->surface->video_buffer);
-    intervideosrc->surface->video_buffer_count++;
-    if (intervideosrc->surface->video_buffer_count >= 30) {
-      gst_buffer_unref (intervideosrc->surface->video_buffer);
-      intervideosrc->surface->video_buffer = NULL;
+  ring = &intervideosrc->surface->video_ring;
+  for (seqnum = ring->seqnum; seqnum > 0; seqnum--) {
+    GstInterSurfaceSlot *slot = gst_inter_surface_ring_get (ring, seqnum - 1);
+
+    if (slot == NULL || slot->buffer == NULL)
+      break;
+
+    if (!GST_CLOCK_TIME_IS_VALID (target)
+        || !GST_CLOCK_TIME_IS_VALID (slot->timestamp)
+        || slot->timestamp <= target) {
+      if (seqnum - 1 == intervideosrc->seqnum)
+        intervideosrc->n_repeats++;
+      else
+        intervideosrc->n_repeats = 0;
+      intervideosrc->seqnum = seqnum - 1;
+
+      /* stop repeating a stale frame at some point */
+      if (intervideosrc->n_repeats < 30) {
+        buffer = gst_buffer_ref (slot->buffer);
+        if (slot->caps)
+          caps = gst_caps_ref (slot->caps);
+      }
+      break;
     }
   }
   g_mutex_unlock (&intervideosrc->surface->mutex);
 
-  if (buffer == NULL) {
-    GstMapInfo map;
-
-    buffer =
-        gst_buffer_new_and_alloc (GST_VIDEO_INFO_SIZE (&intervideosrc->info));
-
-    gst_buffer_map (buffer, &map, GST_MAP_WRITE);
-    memset (map.data, 16, GST_VIDEO_INFO_COMP_STRIDE (&intervideosrc->info, 0) *
-        GST_VIDEO_INFO_COMP_HEIGHT (&intervideosrc->info, 0));
-
-    memset (map.data + GST_VIDEO_INFO_COMP_OFFSET (&intervideosrc->info, 1),
-        128,
-        2 * GST_VIDEO_INFO_COMP_STRIDE (&intervideosrc->info, 1) *
-        GST_VIDEO_INFO_COMP_HEIGHT (&intervideosrc->info, 1));
-    gst_buffer_unmap (buffer, &map);
+  if (caps) {
+    if (caps != intervideosrc->surface_caps
+        && (intervideosrc->surface_caps == NULL
+            || !gst_caps_is_equal (caps, intervideosrc->surface_caps))) {
+      if (!gst_inter_video_src_renegotiate (intervideosrc, caps)) {
+        gst_caps_unref (caps);
+        gst_buffer_unref (buffer);
+        return GST_FLOW_NOT_NEGOTIATED;
+      }
+    }
+    gst_caps_unref (caps);
   }
 
+  if (buffer == NULL)
+    buffer = gst_inter_video_src_create_black (intervideosrc);
+
   buffer = gst_buffer_make_writable (buffer);
 
-  GST_BUFFER_PTS (buffer) =
-      gst_util_uint64_scale_int (GST_SECOND * intervideosrc->n_frames,
-      GST_VIDEO_INFO_FPS_D (&intervideosrc->info),
-      GST_VIDEO_INFO_FPS_N (&intervideosrc->info));
+  GST_BUFFER_PTS (buffer) = timestamp;
   GST_BUFFER_DTS (buffer) = GST_CLOCK_TIME_NONE;
   GST_DEBUG_OBJECT (intervideosrc, "create ts %" GST_TIME_FORMAT,
       GST_TIME_ARGS (GST_BUFFER_PTS (buffer)));
@@ -308,6 +419,38 @@ gst_inter_video_src_create (GstBaseSrc * src, guint64 offset, guint size,
   return GST_FLOW_OK;
 }
 
+/* Offers the format of the surface if a sink has already configured it.
+ * The framerate is left open, frames are selected by running time */
+static GstCaps *
+gst_inter_video_src_get_caps (GstBaseSrc * src, GstCaps * filter)
+{
+  GstInterVideoSrc *intervideosrc = GST_INTER_VIDEO_SRC (src);
+  GstCaps *caps = NULL;
+  GstCaps *tmp;
+
+  if (intervideosrc->surface) {
+    g_mutex_lock (&intervideosrc->surface->mutex);
+    if (intervideosrc->surface->video_caps)
+      caps = gst_caps_copy (intervideosrc->surface->video_caps);
+    g_mutex_unlock (&intervideosrc->surface->mutex);
+  }
+
+  if (caps) {
+    gst_caps_set_simple (caps, "framerate", GST_TYPE_FRACTION_RANGE, 1, 1,
+        G_MAXINT, 1, NULL);
+  } else {
+    caps = gst_pad_get_pad_template_caps (GST_BASE_SRC_PAD (src));
+  }
+
+  if (filter) {
+    tmp = gst_caps_intersect_full (filter, caps, GST_CAPS_INTERSECT_FIRST);
+    gst_caps_unref (caps);
+    caps = tmp;
+  }
+
+  return caps;
+}
+
 static GstCaps *
 gst_inter_video_src_fixate (GstBaseSrc * src, GstCaps * caps)
 {
@@ -319,6 +462,8 @@ gst_inter_video_src_fixate (GstBaseSrc * src, GstCaps * caps)
 
   structure = gst_caps_get_structure (caps, 0);
 
+  if (gst_structure_has_field (structure, "format"))
+    gst_structure_fixate_field_string (structure, "format", "I420");
   gst_structure_fixate_field_nearest_int (structure, "width", 320);
   gst_structure_fixate_field_nearest_int (structure, "height", 240);
   gst_structure_fixate_field_nearest_fraction (structure, "framerate", 30, 1);
@@ -333,5 +478,8 @@ gst_inter_video_src_fixate (GstBaseSrc * src, GstCaps * caps)
   if (gst_structure_has_field (structure, "interlaced"))
     gst_structure_fixate_field_boolean (structure, "interlaced", FALSE);
 
+  /* anything else the surface or downstream left open */
+  caps = gst_caps_fixate (caps);
+
   return caps;
 }
@@ -45,6 +45,12 @@ struct _GstInterVideoSrc
 
   GstVideoInfo info;
   int n_frames;
+
+  /* caps of the surface the negotiated caps were derived from */
+  GstCaps *surface_caps;
+  /* seqnum of the last surface buffer that was output, and how often */
+  guint64 seqnum;
+  int n_repeats;
 };
 
 struct _GstInterVideoSrcClass
@@ -91,6 +91,7 @@ enum
 {
   ARG_0,
   ARG_SYNC,
+  ARG_INDEX_LOCATION,
   /* FILL ME */
 };
 
@@ -138,6 +139,10 @@ static void gst_flups_demux_base_init (GstFluPSDemuxClass * klass);
 static void gst_flups_demux_class_init (GstFluPSDemuxClass * klass);
 static void gst_flups_demux_init (GstFluPSDemux * demux);
 static void gst_flups_demux_finalize (GstFluPSDemux * demux);
+static void gst_flups_demux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_flups_demux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
 static void gst_flups_demux_reset (GstFluPSDemux * demux);
 
 static gboolean gst_flups_demux_sink_event (GstPad * pad, GstObject * parent,
@@ -245,6 +250,14 @@ gst_flups_demux_class_init (GstFluPSDemuxClass * klass)
   gstelement_class = (GstElementClass *) klass;
 
   gobject_class->finalize = (GObjectFinalizeFunc) gst_flups_demux_finalize;
+  gobject_class->set_property = gst_flups_demux_set_property;
+  gobject_class->get_property = gst_flups_demux_get_property;
+
+  g_object_class_install_property (gobject_class, ARG_INDEX_LOCATION,
+      g_param_spec_string ("index-location", "Index location",
+          "Location of an SCR/offset index file used for seeking in pull "
+          "mode. It is updated while playing and seeking", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gstelement_class->change_state = gst_flups_demux_change_state;
 }
@@ -288,9 +301,45 @@ gst_flups_demux_finalize (GstFluPSDemux * demux)
   g_object_unref (demux->adapter);
   g_object_unref (demux->rev_adapter);
 
+  gst_flups_index_free (demux->index);
+  g_free (demux->index_location);
+
   G_OBJECT_CLASS (parent_class)->finalize (G_OBJECT (demux));
 }
 
+static void
+gst_flups_demux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstFluPSDemux *demux = GST_FLUPS_DEMUX (object);
+
+  switch (prop_id) {
+    case ARG_INDEX_LOCATION:
+      g_free (demux->index_location);
+      demux->index_location = g_value_dup_string (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_flups_demux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstFluPSDemux *demux = GST_FLUPS_DEMUX (object);
+
+  switch (prop_id) {
+    case ARG_INDEX_LOCATION:
+      g_value_set_string (value, demux->index_location);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static void
 gst_flups_demux_reset (GstFluPSDemux * demux)
 {
@@ -326,6 +375,9 @@ gst_flups_demux_reset (GstFluPSDemux * demux)
   demux->scr_rate_d = G_MAXUINT64;
   demux->first_pts = G_MAXUINT64;
   demux->last_pts = G_MAXUINT64;
+  if (demux->index)
+    gst_flups_index_free (demux->index);
+  demux->index = gst_flups_index_new ();
   demux->mux_rate = G_MAXUINT64;
   demux->next_pts = G_MAXUINT64;
   demux->next_dts = G_MAXUINT64;
@@ -1107,6 +1159,9 @@ find_offset (GstFluPSDemux * demux, guint64 scr,
     return -1;
   }
 
+  if (scr_rate_d == 0 || scr <= min_scr)
+    return min_scr_offset;
+
   offset = min_scr_offset +
       MIN (gst_util_uint64_scale (scr - min_scr, scr_rate_n,
           scr_rate_d), demux->sink_segment.stop);
@@ -1118,6 +1173,10 @@ find_offset (GstFluPSDemux * demux, guint64 scr,
         gst_flups_demux_scan_backward_ts (demux, &offset, SCAN_SCR, &fscr, 0);
   }
 
+  /* remember what we found for the next seeks */
+  if (found)
+    gst_flups_index_add (demux->index, fscr, offset);
+
   if (fscr == scr || fscr == min_scr || fscr == max_scr) {
     return offset;
   }
@@ -1137,6 +1196,9 @@ gst_flups_demux_do_seek (GstFluPSDemux * demux, GstSegment * seeksegment)
   gboolean found = FALSE;
   guint64 fscr, offset;
   guint64 scr = GSTTIME_TO_MPEGTIME (seeksegment->position + demux->base_time);
+  guint64 min_scr, min_scr_offset, max_scr, max_scr_offset;
+  const GstFluPSIndexEntry *entry;
+  gint i;
 
   /* In some clips the PTS values are completely unaligned with SCR values.
    * To improve the seek in that situation we apply a factor considering the
@@ -1151,9 +1213,35 @@ gst_flups_demux_do_seek (GstFluPSDemux * demux, GstSegment * seeksegment)
   GST_INFO_OBJECT (demux, "sink segment configured %" GST_SEGMENT_FORMAT
       ", trying to go at SCR: %" G_GUINT64_FORMAT, &demux->sink_segment, scr);
 
+  /* Start the search from the closest known SCRs around the target */
+  min_scr = demux->first_scr;
+  min_scr_offset = demux->first_scr_offset;
+  max_scr = demux->last_scr;
+  max_scr_offset = demux->last_scr_offset;
+
+  i = gst_flups_index_lookup (demux->index, scr);
+  if (i >= 0) {
+    entry = &demux->index->entries[i];
+    if (entry->scr > min_scr && entry->offset > min_scr_offset) {
+      min_scr = entry->scr;
+      min_scr_offset = entry->offset;
+    }
+  }
+  if (i + 1 < (gint) demux->index->n_entries) {
+    entry = &demux->index->entries[i + 1];
+    if (entry->scr < max_scr && entry->offset < max_scr_offset) {
+      max_scr = entry->scr;
+      max_scr_offset = entry->offset;
+    }
+  }
+
+  GST_DEBUG_OBJECT (demux, "searching between SCR %" G_GUINT64_FORMAT " at %"
+      G_GUINT64_FORMAT " and %" G_GUINT64_FORMAT " at %" G_GUINT64_FORMAT,
+      min_scr, min_scr_offset, max_scr, max_scr_offset);
+
   offset =
-      find_offset (demux, scr, demux->first_scr, demux->first_scr_offset,
-      demux->last_scr, demux->last_scr_offset, 0);
+      find_offset (demux, scr, min_scr, min_scr_offset, max_scr,
+      max_scr_offset, 0);
 
   if (offset == (guint64) - 1) {
     return FALSE;
@@ -1690,6 +1778,15 @@ gst_flups_demux_parse_pack_start (GstFluPSDemux * demux)
       scr, scr_adjusted, new_rate,
       GST_TIME_ARGS (MPEGTIME_TO_GSTTIME ((guint64) scr)));
 
+  /* index the pack for later seeks */
+  if (demux->random_access && demux->sink_segment.rate >= 0.0) {
+    guint64 distance;
+    guint64 offset = gst_adapter_prev_offset (demux->adapter, &distance);
+
+    if (offset != GST_BUFFER_OFFSET_NONE)
+      gst_flups_index_add (demux->index, scr, offset + distance);
+  }
+
   /* keep the first src in order to calculate delta time */
   if (G_UNLIKELY (demux->first_scr == G_MAXUINT64)) {
     gint64 diff;
@@ -2672,6 +2769,24 @@ gst_flups_demux_scan_backward_ts (GstFluPSDemux * demux, guint64 * pos,
   return found;
 }
 
+/* Writes the index to index_location if it got new entries since it was
+ * loaded. Only possible once the length of the file is known */
+static void
+gst_flups_demux_save_index (GstFluPSDemux * demux)
+{
+  if (demux->index_location == NULL || !demux->index->dirty)
+    return;
+
+  if (demux->sink_segment.format != GST_FORMAT_BYTES ||
+      demux->sink_segment.stop == (guint64) - 1)
+    return;
+
+  GST_DEBUG_OBJECT (demux, "saving index with %u entries to %s",
+      demux->index->n_entries, demux->index_location);
+  gst_flups_index_save (demux->index, demux->index_location,
+      demux->sink_segment.stop);
+}
+
 static inline gboolean
 gst_flups_sink_get_duration (GstFluPSDemux * demux)
 {
@@ -2698,6 +2813,19 @@ gst_flups_sink_get_duration (GstFluPSDemux * demux)
 
   GST_DEBUG_OBJECT (demux, "file length %" G_GINT64_FORMAT, length);
 
+  /* reuse the index of an earlier run on the same file */
+  if (demux->index_location) {
+    GstFluPSIndex *index;
+
+    index = gst_flups_index_load (demux->index_location, length);
+    if (index) {
+      GST_DEBUG_OBJECT (demux, "using index %s with %u entries",
+          demux->index_location, index->n_entries);
+      gst_flups_index_free (demux->index);
+      demux->index = index;
+    }
+  }
+
   /* update the sink segment */
   demux->sink_segment.stop = length;
   gst_segment_set_duration (&demux->sink_segment, format, length);
@@ -2761,6 +2889,15 @@ gst_flups_sink_get_duration (GstFluPSDemux * demux)
       }
     }
   }
+  /* Seed the seek index with the SCRs found at both ends */
+  if (demux->first_scr != G_MAXUINT64 && demux->last_scr != G_MAXUINT64 &&
+      demux->first_scr < demux->last_scr) {
+    gst_flups_index_add (demux->index, demux->first_scr,
+        demux->first_scr_offset);
+    gst_flups_index_add (demux->index, demux->last_scr,
+        demux->last_scr_offset);
+  }
+
   /* Set the base_time and avg rate */
   demux->base_time = MPEGTIME_TO_GSTTIME (demux->first_scr);
   demux->scr_rate_n = demux->last_scr_offset - demux->first_scr_offset;
@@ -2905,6 +3042,7 @@ pause:
     if (ret == GST_FLOW_EOS) {
       /* perform EOS logic */
       gst_element_no_more_pads (GST_ELEMENT_CAST (demux));
+      gst_flups_demux_save_index (demux);
       if (demux->src_segment.flags & GST_SEEK_FLAG_SEGMENT) {
         gint64 stop;
 
@@ -3237,6 +3375,7 @@ gst_flups_demux_change_state (GstElement * element, GstStateChange transition)
 
   switch (transition) {
     case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_flups_demux_save_index (demux);
       gst_flups_demux_reset (demux);
       break;
     case GST_STATE_CHANGE_READY_TO_NULL:
@@ -49,6 +49,7 @@
 #include <gst/base/gstadapter.h>
 
 #include "gstpesfilter.h"
+#include "gstpsindex.h"
 
 G_BEGIN_DECLS
 
@@ -137,6 +138,11 @@ struct _GstFluPSDemux
   guint64 first_pts;
   guint64 last_pts;
 
+  /* sparse SCR -> pack offset index, filled while demuxing and seeking in
+   * pull mode. Loaded from and saved to index_location if set */
+  GstFluPSIndex *index;
+  gchar *index_location;
+
   gint16 psm[GST_FLUPS_DEMUX_MAX_PSM];
 
   GstSegment sink_segment;
@@ -0,0 +1,252 @@
+/*
+ * gstpsindex.c : MPEG-PS SCR/offset sidecar index
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "gstmpegdefs.h"
+#include "gstpsindex.h"
+
+GST_DEBUG_CATEGORY (mpegpsindex_debug);
+#define GST_CAT_DEFAULT (mpegpsindex_debug)
+
+/* Minimum SCR distance between two entries of the index */
+#define SCR_INDEX_INTERVAL (CLOCK_FREQ / 2)
+
+/*
+ * Index file layout (all values in host byte order, which is recorded in
+ * the header so that files from other hosts are rejected):
+ *
+ *   GstFluPSIndexHeader
+ *   GstFluPSIndexEntry[n_entries]     sorted on scr, with growing offsets
+ *
+ * Every entry is 8-byte aligned so the file can be used as-is once
+ * mapped.
+ */
+#define GST_FLUPS_INDEX_MAGIC "GSTPSIDX"
+#define GST_FLUPS_INDEX_VERSION 1
+
+typedef struct
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 byte_order;
+  guint64 upstream_size;
+  guint32 n_entries;
+  guint32 _padding;
+} GstFluPSIndexHeader;
+
+GstFluPSIndex *
+gst_flups_index_new (void)
+{
+  GstFluPSIndex *index = g_slice_new0 (GstFluPSIndex);
+
+  index->array = g_array_new (FALSE, FALSE, sizeof (GstFluPSIndexEntry));
+
+  return index;
+}
+
+GstFluPSIndex *
+gst_flups_index_load (const gchar * location, guint64 upstream_size)
+{
+  const GstFluPSIndexHeader *header;
+  const GstFluPSIndexEntry *entries;
+  GstFluPSIndex *index;
+  GMappedFile *mapped;
+  GError *err = NULL;
+  const gchar *data;
+  gsize size;
+  guint i;
+
+  mapped = g_mapped_file_new (location, FALSE, &err);
+  if (mapped == NULL) {
+    GST_DEBUG ("Can't map index %s: %s", location, err->message);
+    g_error_free (err);
+    return NULL;
+  }
+
+  data = g_mapped_file_get_contents (mapped);
+  size = g_mapped_file_get_length (mapped);
+  header = (const GstFluPSIndexHeader *) data;
+
+  if (size < sizeof (GstFluPSIndexHeader)
+      || memcmp (header->magic, GST_FLUPS_INDEX_MAGIC, 8))
+    goto invalid;
+  if (header->version != GST_FLUPS_INDEX_VERSION
+      || header->byte_order != G_BYTE_ORDER)
+    goto invalid;
+  if (size != sizeof (GstFluPSIndexHeader) +
+      (gsize) header->n_entries * sizeof (GstFluPSIndexEntry))
+    goto invalid;
+  if (header->upstream_size != upstream_size)
+    goto outdated;
+
+  /* lookups bisect the entries, make sure they can */
+  entries = (const GstFluPSIndexEntry *) (data + sizeof (GstFluPSIndexHeader));
+  for (i = 1; i < header->n_entries; i++) {
+    if (entries[i].scr <= entries[i - 1].scr
+        || entries[i].offset <= entries[i - 1].offset)
+      goto invalid;
+  }
+
+  index = g_slice_new0 (GstFluPSIndex);
+  index->mapped = mapped;
+  index->entries = entries;
+  index->n_entries = header->n_entries;
+
+  GST_DEBUG ("Loaded index %s: %u entries", location, index->n_entries);
+
+  return index;
+
+  /* ERRORS */
+invalid:
+  {
+    GST_WARNING ("Invalid index %s", location);
+    g_mapped_file_unref (mapped);
+    return NULL;
+  }
+outdated:
+  {
+    GST_DEBUG ("Index %s is for a file of %" G_GUINT64_FORMAT " bytes, not %"
+        G_GUINT64_FORMAT, location, header->upstream_size, upstream_size);
+    g_mapped_file_unref (mapped);
+    return NULL;
+  }
+}
+
+/* Writes the index atomically to @location */
+gboolean
+gst_flups_index_save (GstFluPSIndex * index, const gchar * location,
+    guint64 upstream_size)
+{
+  GstFluPSIndexHeader header;
+  GByteArray *data;
+  GError *err = NULL;
+  gboolean res;
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, GST_FLUPS_INDEX_MAGIC, 8);
+  header.version = GST_FLUPS_INDEX_VERSION;
+  header.byte_order = G_BYTE_ORDER;
+  header.upstream_size = upstream_size;
+  header.n_entries = index->n_entries;
+
+  data = g_byte_array_sized_new (sizeof (header) +
+      index->n_entries * sizeof (GstFluPSIndexEntry));
+  g_byte_array_append (data, (const guint8 *) &header, sizeof (header));
+  g_byte_array_append (data, (const guint8 *) index->entries,
+      index->n_entries * sizeof (GstFluPSIndexEntry));
+
+  res = g_file_set_contents (location, (const gchar *) data->data, data->len,
+      &err);
+  if (!res) {
+    GST_WARNING ("Couldn't write index %s: %s", location, err->message);
+    g_error_free (err);
+  } else {
+    GST_DEBUG ("Wrote index %s: %u entries", location, index->n_entries);
+    index->dirty = FALSE;
+  }
+
+  g_byte_array_unref (data);
+
+  return res;
+}
+
+void
+gst_flups_index_free (GstFluPSIndex * index)
+{
+  if (index->mapped)
+    g_mapped_file_unref (index->mapped);
+  if (index->array)
+    g_array_free (index->array, TRUE);
+
+  g_slice_free (GstFluPSIndex, index);
+}
+
+/* Returns the position of the last entry of the index with an SCR smaller
+ * or equal to @scr, or -1 if there is none */
+gint
+gst_flups_index_lookup (GstFluPSIndex * index, guint64 scr)
+{
+  gint low = 0, high = (gint) index->n_entries - 1, mid;
+
+  while (low <= high) {
+    mid = (low + high) / 2;
+    if (index->entries[mid].scr <= scr)
+      low = mid + 1;
+    else
+      high = mid - 1;
+  }
+
+  return high;
+}
+
+/* Adds the pack at @offset with @scr to the index, unless it is close to an
+ * existing entry or out of order. Returns TRUE if the entry was added */
+gboolean
+gst_flups_index_add (GstFluPSIndex * index, guint64 scr, guint64 offset)
+{
+  const GstFluPSIndexEntry *prev = NULL, *next = NULL;
+  GstFluPSIndexEntry entry;
+  gint i;
+
+  i = gst_flups_index_lookup (index, scr);
+  if (i >= 0)
+    prev = &index->entries[i];
+  if (i + 1 < (gint) index->n_entries)
+    next = &index->entries[i + 1];
+
+  /* keep the index sparse */
+  if (prev && scr - prev->scr < SCR_INDEX_INTERVAL)
+    return FALSE;
+  if (next && next->scr - scr < SCR_INDEX_INTERVAL)
+    return FALSE;
+
+  /* the index is only usable for bisection if SCR and offsets grow together,
+   * ignore entries around SCR discontinuities */
+  if ((prev && offset <= prev->offset) || (next && offset >= next->offset)) {
+    GST_LOG ("not indexing SCR %" G_GUINT64_FORMAT " at %" G_GUINT64_FORMAT
+        ", out of order", scr, offset);
+    return FALSE;
+  }
+
+  /* the mapped entries are read-only, continue on a copy */
+  if (G_UNLIKELY (index->array == NULL)) {
+    index->array = g_array_sized_new (FALSE, FALSE,
+        sizeof (GstFluPSIndexEntry), index->n_entries + 1);
+    g_array_append_vals (index->array, index->entries, index->n_entries);
+    g_mapped_file_unref (index->mapped);
+    index->mapped = NULL;
+  }
+
+  GST_LOG ("indexing SCR %" G_GUINT64_FORMAT " at %" G_GUINT64_FORMAT,
+      scr, offset);
+
+  entry.scr = scr;
+  entry.offset = offset;
+  g_array_insert_val (index->array, i + 1, entry);
+  index->entries = (const GstFluPSIndexEntry *) index->array->data;
+  index->n_entries = index->array->len;
+  index->dirty = TRUE;
+
+  return TRUE;
+}
@@ -0,0 +1,65 @@
+/*
+ * gstpsindex.h : MPEG-PS SCR/offset sidecar index
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_PS_INDEX_H__
+#define __GST_PS_INDEX_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Entry of the sparse SCR -> byte offset seek index */
+typedef struct
+{
+  guint64 scr;
+  guint64 offset;
+} GstFluPSIndexEntry;
+
+typedef struct _GstFluPSIndex GstFluPSIndex;
+
+struct _GstFluPSIndex
+{
+  /* Entries, sorted on SCR with growing offsets. Either point into the
+   * mapped file or into the array below */
+  const GstFluPSIndexEntry *entries;
+  guint n_entries;
+
+  /* Set when the index was loaded from a file, until it is modified */
+  GMappedFile *mapped;
+  GArray *array;
+
+  /* Set when entries were added since the index was created or loaded */
+  gboolean dirty;
+};
+
+G_GNUC_INTERNAL GstFluPSIndex *gst_flups_index_new (void);
+G_GNUC_INTERNAL GstFluPSIndex *gst_flups_index_load (const gchar * location,
+    guint64 upstream_size);
+G_GNUC_INTERNAL gboolean gst_flups_index_save (GstFluPSIndex * index,
+    const gchar * location, guint64 upstream_size);
+G_GNUC_INTERNAL void gst_flups_index_free (GstFluPSIndex * index);
+
+G_GNUC_INTERNAL gint gst_flups_index_lookup (GstFluPSIndex * index,
+    guint64 scr);
+G_GNUC_INTERNAL gboolean gst_flups_index_add (GstFluPSIndex * index,
+    guint64 scr, guint64 offset);
+
+G_END_DECLS
+
+#endif /* __GST_PS_INDEX_H__ */
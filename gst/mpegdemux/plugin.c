@@ -48,12 +48,15 @@
 #include "gstmpegdemux.h"
 
 GST_DEBUG_CATEGORY_EXTERN (mpegpspesfilter_debug);
+GST_DEBUG_CATEGORY_EXTERN (mpegpsindex_debug);
 
 static gboolean
 plugin_init (GstPlugin * plugin)
 {
   GST_DEBUG_CATEGORY_INIT (mpegpspesfilter_debug, "mpegpspesfilter", 0,
       "MPEG-PS PES filter");
+  GST_DEBUG_CATEGORY_INIT (mpegpsindex_debug, "mpegpsindex", 0,
+      "MPEG-PS seek index");
 
   if (!gst_element_register (plugin, "mpegpsdemux", GST_RANK_PRIMARY,
           GST_TYPE_FLUPS_DEMUX))
@@ -66,6 +66,8 @@ enum
 {
   PROP_0,
   PROP_PARSE_PRIVATE_SECTIONS,
+  PROP_INDEX_LOCATION,
+  PROP_BUILD_INDEX,
   /* FILL ME */
 };
 
@@ -129,6 +131,18 @@ mpegts_base_class_init (MpegTSBaseClass * klass)
           "Parse private sections", FALSE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_INDEX_LOCATION,
+      g_param_spec_string ("index-location", "Index location",
+          "Location of a PCR/offset index file used for seeking in pull "
+          "mode. It is written while playing if missing", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_BUILD_INDEX,
+      g_param_spec_boolean ("build-index", "Build index",
+          "Index the whole file when opening it if there is no complete "
+          "index at index-location", FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
 }
 
 static void
@@ -141,6 +155,13 @@ mpegts_base_set_property (GObject * object, guint prop_id,
     case PROP_PARSE_PRIVATE_SECTIONS:
       base->parse_private_sections = g_value_get_boolean (value);
       break;
+    case PROP_INDEX_LOCATION:
+      g_free (base->index_location);
+      base->index_location = g_value_dup_string (value);
+      break;
+    case PROP_BUILD_INDEX:
+      base->build_index = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -156,6 +177,12 @@ mpegts_base_get_property (GObject * object, guint prop_id,
     case PROP_PARSE_PRIVATE_SECTIONS:
       g_value_set_boolean (value, base->parse_private_sections);
       break;
+    case PROP_INDEX_LOCATION:
+      g_value_set_string (value, base->index_location);
+      break;
+    case PROP_BUILD_INDEX:
+      g_value_set_boolean (value, base->build_index);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -186,6 +213,8 @@ mpegts_base_reset (MpegTSBase * base)
   /* ATSC */
   MPEGTS_BIT_SET (base->known_psi, 0x1ffb);
 
+  base->pid_actions_dirty = TRUE;
+
   if (base->pat) {
     g_ptr_array_unref (base->pat);
     base->pat = NULL;
@@ -227,6 +256,8 @@ mpegts_base_init (MpegTSBase * base)
   base->parse_private_sections = FALSE;
   base->is_pes = g_new0 (guint8, 1024);
   base->known_psi = g_new0 (guint8, 1024);
+  base->pid_actions = g_new0 (guint8, 0x2000);
+  base->packetizer->pid_actions = base->pid_actions;
   base->program_size = sizeof (MpegTSBaseProgram);
   base->stream_size = sizeof (MpegTSBaseStream);
 
@@ -246,6 +277,7 @@ mpegts_base_dispose (GObject * object)
     base->disposed = TRUE;
     g_free (base->known_psi);
     g_free (base->is_pes);
+    g_free (base->pid_actions);
   }
 
   if (G_OBJECT_CLASS (parent_class)->dispose)
@@ -263,6 +295,12 @@ mpegts_base_finalize (GObject * object)
   }
   g_hash_table_destroy (base->programs);
 
+  if (base->index_builder)
+    mpegts_index_free (base->index_builder);
+  if (base->index)
+    mpegts_index_free (base->index);
+  g_free (base->index_location);
+
   if (G_OBJECT_CLASS (parent_class)->finalize)
     G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -898,6 +936,9 @@ mpegts_base_handle_psi (MpegTSBase * base, GstMpegTsSection * section)
   GST_DEBUG ("Handling PSI (pid: 0x%04x , table_id: 0x%02x)",
       section->pid, section->table_id);
 
+  /* Programs and streams might come and go */
+  base->pid_actions_dirty = TRUE;
+
   switch (section->section_type) {
     case GST_MPEGTS_SECTION_PAT:
       post_message = mpegts_base_apply_pat (base, section);
@@ -1086,6 +1127,83 @@ query_upstream_latency (MpegTSBase * base)
   base->queried_latency = TRUE;
 }
 
+static inline void
+mpegts_base_index_packet (MpegTSIndex * index, MpegTSPacketizerPacket * packet)
+{
+  if (!FLAGS_HAS_AFC (packet->scram_afc_cc))
+    return;
+
+  if (packet->afc_flags & MPEGTS_AFC_PCR_FLAG)
+    mpegts_index_add_pcr (index, packet->pid, packet->pcr, packet->offset);
+  if (packet->payload_unit_start_indicator &&
+      (packet->afc_flags & MPEGTS_AFC_RANDOM_ACCES_FLAGS))
+    mpegts_index_add_keyframe (index, packet->pid, packet->offset);
+}
+
+/* Save the index built while playing and use it for lookups from now on.
+ * @complete is set when playback reached the end of the file */
+static void
+mpegts_base_finish_index (MpegTSBase * base, gboolean complete)
+{
+  MpegTSIndex *index = base->index_builder;
+
+  if (index == NULL)
+    return;
+  base->index_builder = NULL;
+
+  if (complete)
+    index->indexed_size = base->index_upstream_size;
+
+  if (index->pcr_array->len == 0) {
+    mpegts_index_free (index);
+    return;
+  }
+
+  GST_DEBUG_OBJECT (base, "Saving index of %" G_GUINT64_FORMAT " bytes",
+      index->indexed_size);
+  mpegts_index_save (index, base->index_location, base->index_upstream_size);
+
+  if (base->index)
+    mpegts_index_free (base->index);
+  base->index = index;
+}
+
+/* Rebuild the per-pid action table used by the packetizer to skip the
+ * packets we don't care about right after their header */
+static void
+mpegts_base_update_pid_actions (MpegTSBase * base)
+{
+  guint8 pes_action;
+  guint i, pid;
+
+  base->pid_actions_dirty = FALSE;
+  base->pid_actions_push_data = base->push_data;
+
+  /* PES packets are only needed for their PCR if we don't push data */
+  if (base->push_data)
+    pes_action = MPEGTS_PID_ACTION_PES;
+  else
+    pes_action = MPEGTS_PID_ACTION_PCR;
+
+  for (i = 0; i < 1024; i++) {
+    guint8 *actions = &base->pid_actions[i * 8];
+
+    if (G_LIKELY ((base->is_pes[i] | base->known_psi[i]) == 0)) {
+      memset (actions, MPEGTS_PID_ACTION_DROP, 8);
+      continue;
+    }
+
+    for (pid = i * 8; pid < i * 8 + 8; pid++) {
+      if (MPEGTS_BIT_IS_SET (base->is_pes, pid))
+        *actions++ = pes_action;
+      else if (MPEGTS_BIT_IS_SET (base->known_psi, pid))
+        *actions++ = MPEGTS_PID_ACTION_PSI;
+      else
+        *actions++ = MPEGTS_PID_ACTION_DROP;
+    }
+  }
+}
+
 static GstFlowReturn
 mpegts_base_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
 {
@@ -1121,6 +1239,10 @@ mpegts_base_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
   mpegts_packetizer_push (base->packetizer, buf);
 
   while (res == GST_FLOW_OK) {
+    if (G_UNLIKELY (base->pid_actions_dirty
+            || base->pid_actions_push_data != base->push_data))
+      mpegts_base_update_pid_actions (base);
+
     pret = mpegts_packetizer_next_packet (base->packetizer, &packet);
 
     /* If we don't have enough data, return */
@@ -1133,13 +1255,15 @@ mpegts_base_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
       goto next;
     }
 
-    /* If it's a known PES, push it */
-    if (MPEGTS_BIT_IS_SET (base->is_pes, packet.pid)) {
+    if (G_UNLIKELY (base->index_builder))
+      mpegts_base_index_packet (base->index_builder, &packet);
+
+    /* Packets of pids we don't handle were already skipped by the
+     * packetizer, only PES and PSI ones make it here */
+    if (base->pid_actions[packet.pid] == MPEGTS_PID_ACTION_PES) {
       /* push the packet downstream */
-      if (base->push_data)
-        res = klass->push (base, &packet, NULL);
-    } else if (packet.payload
-        && MPEGTS_BIT_IS_SET (base->known_psi, packet.pid)) {
+      res = klass->push (base, &packet, NULL);
+    } else if (packet.payload) {
       /* base PSI data */
       GList *others, *tmp;
       GstMpegTsSection *section;
@@ -1156,9 +1280,7 @@ mpegts_base_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
       /* we need to push section packet downstream */
       if (base->push_section)
         res = klass->push (base, &packet, section);
-
-    } else if (packet.payload && packet.pid != 0x1fff)
-      GST_LOG ("PID 0x%04x Saw packet on a pid we don't handle", packet.pid);
+    }
 
   next:
     mpegts_packetizer_clear_packet (base->packetizer, &packet);
@@ -1174,6 +1296,91 @@ mpegts_base_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
   return res;
 }
 
+/* Index the whole file in one go */
+static GstFlowReturn
+mpegts_base_build_index (MpegTSBase * base)
+{
+  MpegTSPacketizer2 *packetizer = base->packetizer;
+  MpegTSPacketizerPacketReturn pret;
+  MpegTSPacketizerPacket packet;
+  GstFlowReturn ret = GST_FLOW_OK;
+  gboolean calculate_offset;
+  MpegTSIndex *index;
+  GstBuffer *buf = NULL;
+  guint64 offset = 0;
+
+  GST_DEBUG_OBJECT (base, "Indexing %" G_GUINT64_FORMAT " bytes",
+      base->index_upstream_size);
+
+  index = mpegts_index_new ();
+
+  /* No need to keep the PCR observations of the whole file around */
+  calculate_offset = packetizer->calculate_offset;
+  packetizer->calculate_offset = FALSE;
+
+  while (offset < base->index_upstream_size) {
+    ret = gst_pad_pull_range (base->sinkpad, offset, 1024 * 1024, &buf);
+    if (G_UNLIKELY (ret == GST_FLOW_EOS))
+      break;
+    if (G_UNLIKELY (ret != GST_FLOW_OK))
+      goto beach;
+    offset += gst_buffer_get_size (buf);
+
+    mpegts_packetizer_push (packetizer, buf);
+    buf = NULL;
+
+    while ((pret = mpegts_packetizer_next_packet (packetizer, &packet)) !=
+        PACKET_NEED_MORE) {
+      if (pret != PACKET_BAD)
+        mpegts_base_index_packet (index, &packet);
+      mpegts_packetizer_clear_packet (packetizer, &packet);
+    }
+  }
+
+  index->indexed_size = base->index_upstream_size;
+  mpegts_index_save (index, base->index_location, base->index_upstream_size);
+
+  if (base->index)
+    mpegts_index_free (base->index);
+  base->index = index;
+  index = NULL;
+  ret = GST_FLOW_OK;
+
+beach:
+  if (index)
+    mpegts_index_free (index);
+  mpegts_packetizer_clear (packetizer);
+  packetizer->calculate_offset = calculate_offset;
+  return ret;
+}
+
+static GstFlowReturn
+mpegts_base_setup_index (MpegTSBase * base)
+{
+  gint64 upstream_size;
+
+  if (base->index || base->index_builder)
+    return GST_FLOW_OK;
+
+  if (!gst_pad_peer_query_duration (base->sinkpad, GST_FORMAT_BYTES,
+          &upstream_size) || upstream_size <= 0)
+    return GST_FLOW_OK;
+  base->index_upstream_size = upstream_size;
+
+  base->index = mpegts_index_load (base->index_location, upstream_size);
+  if (base->index && base->index->indexed_size >= upstream_size)
+    return GST_FLOW_OK;
+
+  if (base->build_index)
+    return mpegts_base_build_index (base);
+
+  /* Index while playing, unless we have a partial index already */
+  if (base->index == NULL)
+    base->index_builder = mpegts_index_new ();
+
+  return GST_FLOW_OK;
+}
+
 static GstFlowReturn
 mpegts_base_scan (MpegTSBase * base)
 {
@@ -1189,6 +1396,15 @@ mpegts_base_scan (MpegTSBase * base)
 
   GST_DEBUG ("Scanning for initial sync point");
 
+  /* We want the PCR of all pids, whichever program they belong to */
+  base->packetizer->pid_actions = NULL;
+
+  if (base->index_location) {
+    ret = mpegts_base_setup_index (base);
+    if (G_UNLIKELY (ret != GST_FLOW_OK))
+      goto beach;
+  }
+
   /* Find initial sync point and at least 5 PCR values */
   for (i = 0; i < 10 && !done; i++) {
     GST_DEBUG ("Grabbing %d => %d", i * 65536, 65536);
@@ -1232,6 +1448,12 @@ mpegts_base_scan (MpegTSBase * base)
   /* Now send data from the end */
   mpegts_packetizer_clear (base->packetizer);
 
+  /* Unless the index tells us all about it */
+  if (base->index && base->index->indexed_size >= base->index_upstream_size) {
+    GST_DEBUG ("Using index instead of looking for the last PCR");
+    goto beach;
+  }
+
   /* Get the size of upstream */
   format = GST_FORMAT_BYTES;
   if (!gst_pad_peer_query_duration (base->sinkpad, format, &tmpval))
@@ -1272,10 +1494,12 @@ mpegts_base_scan (MpegTSBase * base)
 
 beach:
   mpegts_packetizer_clear (base->packetizer);
+  base->packetizer->pid_actions = base->pid_actions;
   return ret;
 
 no_initial_pcr:
   mpegts_packetizer_clear (base->packetizer);
+  base->packetizer->pid_actions = base->pid_actions;
   GST_WARNING_OBJECT (base, "Couldn't find any PCR within the first %d bytes",
       10 * 65536);
   return GST_FLOW_ERROR;
@@ -1328,6 +1552,7 @@ error:
     const gchar *reason = gst_flow_get_name (ret);
     GST_DEBUG_OBJECT (base, "Pausing task, reason %s", reason);
     if (ret == GST_FLOW_EOS) {
+      mpegts_base_finish_index (base, TRUE);
       if (!GST_MPEGTS_BASE_GET_CLASS (base)->push_event (base,
               gst_event_new_eos ()))
         GST_ELEMENT_ERROR (base, STREAM, FAILED,
@@ -1438,6 +1663,8 @@ mpegts_base_handle_seek_event (MpegTSBase * base, GstPad * pad,
     goto done;
   }
 
+  /* We only index contiguously from the start, keep what we have */
+  mpegts_base_finish_index (base, FALSE);
 
   /* If the subclass can seek, do that */
   if (klass->seek) {
@@ -1550,6 +1777,11 @@ mpegts_base_change_state (GstElement * element, GstStateChange transition)
 
   switch (transition) {
     case GST_STATE_CHANGE_PAUSED_TO_READY:
+      mpegts_base_finish_index (base, FALSE);
+      if (base->index) {
+        mpegts_index_free (base->index);
+        base->index = NULL;
+      }
       mpegts_base_reset (base);
       if (base->mode != BASE_MODE_PUSHING)
         base->mode = BASE_MODE_SCANNING;
@@ -1566,6 +1798,7 @@ gst_mpegtsbase_plugin_init (GstPlugin * plugin)
 {
   GST_DEBUG_CATEGORY_INIT (mpegts_base_debug, "mpegtsbase", 0,
       "MPEG transport stream base class");
+  init_mpegts_index ();
 
   return TRUE;
 }
@@ -32,6 +32,7 @@
 
 #include <gst/gst.h>
 #include "mpegtspacketizer.h"
+#include "mpegtsindex.h"
 
 G_BEGIN_DECLS
 
@@ -128,6 +129,13 @@ struct _MpegTSBase {
   guint8 *known_psi;
   guint8 *is_pes;
 
+  /* MpegTSPacketizerPidAction of each pid, derived from the above and
+   * handed to the packetizer. Rebuilt when pid_actions_dirty is set or
+   * push_data changed */
+  guint8 *pid_actions;
+  gboolean pid_actions_dirty;
+  gboolean pid_actions_push_data;
+
   gboolean disposed;
 
   /* size of the MpegTSBaseProgram structure, can be overridden
@@ -158,6 +166,16 @@ struct _MpegTSBase {
   /* Whether to push data and/or sections to subclasses */
   gboolean push_data;
   gboolean push_section;
+
+  /* Sidecar PCR/offset index (pull mode only) */
+  gchar *index_location;
+  /* Whether to index the whole file when opening it if needed */
+  gboolean build_index;
+  /* Index used for lookups, if any */
+  MpegTSIndex *index;
+  /* Index being built while playing from the start of the file */
+  MpegTSIndex *index_builder;
+  guint64 index_upstream_size;
 };
 
 struct _MpegTSBaseClass {
@@ -0,0 +1,422 @@
+/*
+ * mpegtsindex.c : MPEG-TS PCR/offset sidecar index
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "gstmpegdefs.h"
+#include "mpegtsindex.h"
+
+GST_DEBUG_CATEGORY_STATIC (mpegts_index_debug);
+#define GST_CAT_DEFAULT mpegts_index_debug
+
+#define PCR_MAX_VALUE (((((guint64)1)<<33) * 300) + 298)
+
+/*
+ * Index file layout (all values in host byte order, which is recorded in
+ * the header so that files from other hosts are rejected):
+ *
+ *   MpegTSIndexHeader
+ *   MpegTSIndexPCR[n_pcrs]            sorted by pid, then pcr
+ *   MpegTSIndexKeyframe[n_keyframes]  sorted by pid, then offset
+ *
+ * Every entry is 8-byte aligned so the file can be used as-is once
+ * mapped.
+ */
+#define MPEGTS_INDEX_MAGIC "GSTTSIDX"
+#define MPEGTS_INDEX_VERSION 1
+
+typedef struct
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 byte_order;
+  guint64 upstream_size;
+  guint64 indexed_size;
+  guint32 n_pcrs;
+  guint32 n_keyframes;
+} MpegTSIndexHeader;
+
+MpegTSIndex *
+mpegts_index_new (void)
+{
+  MpegTSIndex *index = g_slice_new0 (MpegTSIndex);
+
+  index->pcr_array = g_array_new (FALSE, FALSE, sizeof (MpegTSIndexPCR));
+  index->keyframe_array =
+      g_array_new (FALSE, FALSE, sizeof (MpegTSIndexKeyframe));
+  index->first_pcr = g_new (guint64, 0x2000);
+  index->last_pcr = g_new (guint64, 0x2000);
+  index->pcr_wrap = g_new0 (guint64, 0x2000);
+  index->last_indexed_pcr = g_new (guint64, 0x2000);
+  memset (index->first_pcr, 0xff, 0x2000 * sizeof (guint64));
+  memset (index->last_pcr, 0xff, 0x2000 * sizeof (guint64));
+  memset (index->last_indexed_pcr, 0xff, 0x2000 * sizeof (guint64));
+
+  return index;
+}
+
+MpegTSIndex *
+mpegts_index_load (const gchar * location, guint64 upstream_size)
+{
+  const MpegTSIndexHeader *header;
+  MpegTSIndex *index;
+  GMappedFile *mapped;
+  GError *err = NULL;
+  const gchar *data;
+  gsize size;
+
+  mapped = g_mapped_file_new (location, FALSE, &err);
+  if (mapped == NULL) {
+    GST_DEBUG ("Can't map index %s: %s", location, err->message);
+    g_error_free (err);
+    return NULL;
+  }
+
+  data = g_mapped_file_get_contents (mapped);
+  size = g_mapped_file_get_length (mapped);
+  header = (const MpegTSIndexHeader *) data;
+
+  if (size < sizeof (MpegTSIndexHeader)
+      || memcmp (header->magic, MPEGTS_INDEX_MAGIC, 8))
+    goto invalid;
+  if (header->version != MPEGTS_INDEX_VERSION
+      || header->byte_order != G_BYTE_ORDER)
+    goto invalid;
+  if (size != sizeof (MpegTSIndexHeader) +
+      (gsize) header->n_pcrs * sizeof (MpegTSIndexPCR) +
+      (gsize) header->n_keyframes * sizeof (MpegTSIndexKeyframe))
+    goto invalid;
+  if (header->upstream_size != upstream_size)
+    goto outdated;
+
+  index = g_slice_new0 (MpegTSIndex);
+  index->mapped = mapped;
+  index->upstream_size = header->upstream_size;
+  index->indexed_size = header->indexed_size;
+  index->pcrs = (const MpegTSIndexPCR *) (data + sizeof (MpegTSIndexHeader));
+  index->n_pcrs = header->n_pcrs;
+  index->keyframes = (const MpegTSIndexKeyframe *) (index->pcrs +
+      index->n_pcrs);
+  index->n_keyframes = header->n_keyframes;
+
+  GST_DEBUG ("Loaded index %s: %u PCRs, %u keyframes, %" G_GUINT64_FORMAT
+      "/%" G_GUINT64_FORMAT " bytes indexed", location, index->n_pcrs,
+      index->n_keyframes, index->indexed_size, index->upstream_size);
+
+  return index;
+
+  /* ERRORS */
+invalid:
+  {
+    GST_WARNING ("Invalid index %s", location);
+    g_mapped_file_unref (mapped);
+    return NULL;
+  }
+outdated:
+  {
+    GST_DEBUG ("Index %s is for a file of %" G_GUINT64_FORMAT " bytes, not %"
+        G_GUINT64_FORMAT, location, header->upstream_size, upstream_size);
+    g_mapped_file_unref (mapped);
+    return NULL;
+  }
+}
+
+static gint
+compare_pcr (const MpegTSIndexPCR * a, const MpegTSIndexPCR * b)
+{
+  if (a->pid != b->pid)
+    return a->pid < b->pid ? -1 : 1;
+  if (a->pcr != b->pcr)
+    return a->pcr < b->pcr ? -1 : 1;
+  return 0;
+}
+
+static gint
+compare_keyframe (const MpegTSIndexKeyframe * a, const MpegTSIndexKeyframe * b)
+{
+  if (a->pid != b->pid)
+    return a->pid < b->pid ? -1 : 1;
+  if (a->offset != b->offset)
+    return a->offset < b->offset ? -1 : 1;
+  return 0;
+}
+
+/* Writes the index atomically to @location. Entries are sorted first, after
+ * which the index can also be used for lookups */
+gboolean
+mpegts_index_save (MpegTSIndex * index, const gchar * location,
+    guint64 upstream_size)
+{
+  MpegTSIndexHeader header;
+  GByteArray *data;
+  GError *err = NULL;
+  gboolean res;
+
+  g_return_val_if_fail (index->pcr_array != NULL, FALSE);
+
+  g_array_sort (index->pcr_array, (GCompareFunc) compare_pcr);
+  g_array_sort (index->keyframe_array, (GCompareFunc) compare_keyframe);
+  index->pcrs = (const MpegTSIndexPCR *) index->pcr_array->data;
+  index->n_pcrs = index->pcr_array->len;
+  index->keyframes = (const MpegTSIndexKeyframe *) index->keyframe_array->data;
+  index->n_keyframes = index->keyframe_array->len;
+  index->upstream_size = upstream_size;
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, MPEGTS_INDEX_MAGIC, 8);
+  header.version = MPEGTS_INDEX_VERSION;
+  header.byte_order = G_BYTE_ORDER;
+  header.upstream_size = upstream_size;
+  header.indexed_size = index->indexed_size;
+  header.n_pcrs = index->n_pcrs;
+  header.n_keyframes = index->n_keyframes;
+
+  data = g_byte_array_sized_new (sizeof (header) +
+      index->n_pcrs * sizeof (MpegTSIndexPCR) +
+      index->n_keyframes * sizeof (MpegTSIndexKeyframe));
+  g_byte_array_append (data, (const guint8 *) &header, sizeof (header));
+  g_byte_array_append (data, (const guint8 *) index->pcrs,
+      index->n_pcrs * sizeof (MpegTSIndexPCR));
+  g_byte_array_append (data, (const guint8 *) index->keyframes,
+      index->n_keyframes * sizeof (MpegTSIndexKeyframe));
+
+  res = g_file_set_contents (location, (const gchar *) data->data, data->len,
+      &err);
+  if (!res) {
+    GST_WARNING ("Couldn't write index %s: %s", location, err->message);
+    g_error_free (err);
+  } else
+    GST_DEBUG ("Wrote index %s: %u PCRs, %u keyframes", location,
+        index->n_pcrs, index->n_keyframes);
+
+  g_byte_array_unref (data);
+
+  return res;
+}
+
+void
+mpegts_index_free (MpegTSIndex * index)
+{
+  if (index->mapped)
+    g_mapped_file_unref (index->mapped);
+  if (index->pcr_array)
+    g_array_free (index->pcr_array, TRUE);
+  if (index->keyframe_array)
+    g_array_free (index->keyframe_array, TRUE);
+  g_free (index->first_pcr);
+  g_free (index->last_pcr);
+  g_free (index->pcr_wrap);
+  g_free (index->last_indexed_pcr);
+
+  g_slice_free (MpegTSIndex, index);
+}
+
+/* Record a raw PCR observation. PCRs are only recorded every
+ * MPEGTS_INDEX_PCR_INTERVAL, which is plenty to interpolate offsets */
+void
+mpegts_index_add_pcr (MpegTSIndex * index, guint16 pid, guint64 pcr,
+    guint64 offset)
+{
+  MpegTSIndexPCR entry;
+  guint64 last = index->last_pcr[pid];
+
+  if (G_UNLIKELY (index->first_pcr[pid] == G_MAXUINT64)) {
+    index->first_pcr[pid] = pcr;
+  } else if (G_UNLIKELY (pcr < last)) {
+    if (last - pcr > PCR_MAX_VALUE / 2) {
+      GST_DEBUG ("PID 0x%04x PCR wraparound", pid);
+      index->pcr_wrap[pid] += PCR_MAX_VALUE;
+    } else {
+      /* Discontinuity, carry on from the last value so that the indexed
+       * PCRs stay monotonic */
+      GST_DEBUG ("PID 0x%04x PCR discontinuity", pid);
+      index->pcr_wrap[pid] += last - pcr;
+    }
+  }
+  index->last_pcr[pid] = pcr;
+  index->indexed_size = MAX (index->indexed_size, offset);
+
+  entry.pcr = pcr + index->pcr_wrap[pid] - index->first_pcr[pid];
+  if (index->last_indexed_pcr[pid] != G_MAXUINT64 &&
+      entry.pcr < index->last_indexed_pcr[pid] + MPEGTS_INDEX_PCR_INTERVAL)
+    return;
+
+  entry.offset = offset;
+  entry.pid = pid;
+  memset (entry._padding, 0, sizeof (entry._padding));
+  g_array_append_val (index->pcr_array, entry);
+  index->last_indexed_pcr[pid] = entry.pcr;
+}
+
+void
+mpegts_index_add_keyframe (MpegTSIndex * index, guint16 pid, guint64 offset)
+{
+  MpegTSIndexKeyframe entry;
+
+  entry.offset = offset;
+  entry.pid = pid;
+  memset (entry._padding, 0, sizeof (entry._padding));
+  g_array_append_val (index->keyframe_array, entry);
+  index->indexed_size = MAX (index->indexed_size, offset);
+}
+
+/* Returns the position of the first PCR entry of @pid whose pcr is
+ * greater than @pcr, and the range of entries of @pid in @first/@last */
+static guint
+find_pcr (MpegTSIndex * index, guint16 pid, guint64 pcr, guint * first,
+    guint * last)
+{
+  const MpegTSIndexPCR *pcrs = index->pcrs;
+  guint lo, hi, mid;
+
+  /* first entry of the pid */
+  lo = 0;
+  hi = index->n_pcrs;
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (pcrs[mid].pid < pid)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  *first = lo;
+
+  /* first entry after the pid */
+  hi = index->n_pcrs;
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (pcrs[mid].pid <= pid)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  *last = lo;
+
+  /* first entry of the pid with a greater pcr */
+  lo = *first;
+  hi = *last;
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (pcrs[mid].pcr <= pcr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+/* Returns the offset of @ts (relative to the first PCR of @pid), or -1 if
+ * it isn't covered by the index */
+guint64
+mpegts_index_ts_to_offset (MpegTSIndex * index, guint16 pid, GstClockTime ts)
+{
+  const MpegTSIndexPCR *prev, *next;
+  guint64 querypcr, res;
+  guint first, last, pos;
+
+  querypcr = GSTTIME_TO_PCRTIME (ts);
+  pos = find_pcr (index, pid, querypcr, &first, &last);
+
+  if (first == last)
+    return -1;
+
+  if (pos == first) {
+    res = index->pcrs[first].offset;
+  } else if (pos == last) {
+    /* Beyond the last entry, only valid if the index covers it */
+    if (index->indexed_size < index->upstream_size)
+      return -1;
+    res = index->pcrs[last - 1].offset;
+  } else {
+    prev = &index->pcrs[pos - 1];
+    next = &index->pcrs[pos];
+    res = prev->offset + gst_util_uint64_scale (querypcr - prev->pcr,
+        next->offset - prev->offset, next->pcr - prev->pcr);
+  }
+
+  GST_DEBUG ("Returning offset %" G_GUINT64_FORMAT " for ts %" GST_TIME_FORMAT,
+      res, GST_TIME_ARGS (ts));
+
+  return res;
+}
+
+/* Returns the duration of the indexed file, extrapolated from the last PCR
+ * entry of @pid, if the whole file was indexed */
+GstClockTime
+mpegts_index_get_duration (MpegTSIndex * index, guint16 pid)
+{
+  const MpegTSIndexPCR *start, *end;
+  guint first, last;
+
+  if (index->indexed_size < index->upstream_size)
+    return GST_CLOCK_TIME_NONE;
+
+  find_pcr (index, pid, 0, &first, &last);
+  if (last - first < 2)
+    return GST_CLOCK_TIME_NONE;
+
+  start = &index->pcrs[first];
+  end = &index->pcrs[last - 1];
+  if (end->offset <= start->offset)
+    return GST_CLOCK_TIME_NONE;
+
+  return PCRTIME_TO_GSTTIME (end->pcr +
+      gst_util_uint64_scale (index->upstream_size - end->offset,
+          end->pcr - start->pcr, end->offset - start->offset));
+}
+
+/* Returns the offset of the last random access point of @pid at or before
+ * @offset, or -1 if there is none */
+guint64
+mpegts_index_keyframe_before (MpegTSIndex * index, guint16 pid, guint64 offset)
+{
+  const MpegTSIndexKeyframe *keyframes = index->keyframes;
+  guint lo, hi, mid;
+
+  /* first entry greater than (pid, offset) */
+  lo = 0;
+  hi = index->n_keyframes;
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (keyframes[mid].pid < pid ||
+        (keyframes[mid].pid == pid && keyframes[mid].offset <= offset))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo == 0 || keyframes[lo - 1].pid != pid)
+    return -1;
+
+  return keyframes[lo - 1].offset;
+}
+
+void
+init_mpegts_index (void)
+{
+  GST_DEBUG_CATEGORY_INIT (mpegts_index_debug, "mpegtsindex", 0,
+      "MPEG transport stream index");
+}
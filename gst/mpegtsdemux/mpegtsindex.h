@@ -0,0 +1,102 @@
+/*
+ * mpegtsindex.h : MPEG-TS PCR/offset sidecar index
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __MPEGTS_INDEX_H__
+#define __MPEGTS_INDEX_H__
+
+#include <gst/gst.h>
+#include "gstmpegdefs.h"
+
+G_BEGIN_DECLS
+
+/* Minimum PCR distance between two indexed PCR observations of a PID */
+#define MPEGTS_INDEX_PCR_INTERVAL (250 * PCR_MSECOND)
+
+/* PCR observation. The pcr is relative to the first PCR of the PID and
+ * corrected for wraparounds (units: 1/27MHz) */
+typedef struct
+{
+  guint64 pcr;
+  guint64 offset;
+  guint16 pid;
+  guint16 _padding[3];
+} MpegTSIndexPCR;
+
+/* Random access point: offset of a packet that starts a PES and has
+ * the random_access_indicator set */
+typedef struct
+{
+  guint64 offset;
+  guint16 pid;
+  guint16 _padding[3];
+} MpegTSIndexKeyframe;
+
+typedef struct _MpegTSIndex MpegTSIndex;
+
+struct _MpegTSIndex
+{
+  /* Size of the indexed file */
+  guint64 upstream_size;
+  /* Offset up to which the file was indexed */
+  guint64 indexed_size;
+
+  /* Entries, sorted by pid and pcr (resp. offset). Either point into
+   * the mapped file or into the arrays below */
+  const MpegTSIndexPCR *pcrs;
+  guint n_pcrs;
+  const MpegTSIndexKeyframe *keyframes;
+  guint n_keyframes;
+
+  /* Set when the index was loaded from a file */
+  GMappedFile *mapped;
+
+  /* Only used while building the index */
+  GArray *pcr_array;
+  GArray *keyframe_array;
+  /* Per-pid state to make PCRs relative and monotonic */
+  guint64 *first_pcr;
+  guint64 *last_pcr;
+  guint64 *pcr_wrap;
+  guint64 *last_indexed_pcr;
+};
+
+G_GNUC_INTERNAL MpegTSIndex *mpegts_index_new (void);
+G_GNUC_INTERNAL MpegTSIndex *mpegts_index_load (const gchar * location,
+    guint64 upstream_size);
+G_GNUC_INTERNAL gboolean mpegts_index_save (MpegTSIndex * index,
+    const gchar * location, guint64 upstream_size);
+G_GNUC_INTERNAL void mpegts_index_free (MpegTSIndex * index);
+
+G_GNUC_INTERNAL void mpegts_index_add_pcr (MpegTSIndex * index, guint16 pid,
+    guint64 pcr, guint64 offset);
+G_GNUC_INTERNAL void mpegts_index_add_keyframe (MpegTSIndex * index,
+    guint16 pid, guint64 offset);
+
+G_GNUC_INTERNAL guint64 mpegts_index_ts_to_offset (MpegTSIndex * index,
+    guint16 pid, GstClockTime ts);
+G_GNUC_INTERNAL GstClockTime mpegts_index_get_duration (MpegTSIndex * index,
+    guint16 pid);
+G_GNUC_INTERNAL guint64 mpegts_index_keyframe_before (MpegTSIndex * index,
+    guint16 pid, guint64 offset);
+
+G_GNUC_INTERNAL void init_mpegts_index (void);
+
+G_END_DECLS
+
+#endif /* __MPEGTS_INDEX_H__ */
@@ -50,6 +50,7 @@ static void mpegts_packetizer_finalize (GObject * object);
 static GstClockTime calculate_skew (MpegTSPCR * pcr, guint64 pcrtime,
     GstClockTime time);
 static void _close_current_group (MpegTSPCR * pcrtable);
+static void mpegts_packetizer_reset_map (MpegTSPacketizer2 * packetizer);
 static void record_pcr (MpegTSPacketizer2 * packetizer, MpegTSPCR * pcrtable,
     guint64 pcr, guint64 offset);
 
@@ -246,6 +247,11 @@ mpegts_packetizer_init (MpegTSPacketizer2 * packetizer)
   packetizer->map_size = 0;
   packetizer->map_offset = 0;
   packetizer->need_sync = FALSE;
+  packetizer->map_buffer = NULL;
+  packetizer->leftover = NULL;
+  packetizer->batch_pos = 0;
+  packetizer->batch_len = 0;
+  packetizer->pid_actions = NULL;
 
   memset (packetizer->pcrtablelut, 0xff, 0x2000);
   memset (packetizer->observations, 0x0, sizeof (packetizer->observations));
@@ -273,6 +279,7 @@ mpegts_packetizer_dispose (GObject * object)
       g_free (packetizer->streams);
     }
 
+    mpegts_packetizer_reset_map (packetizer);
     gst_adapter_clear (packetizer->adapter);
     g_object_unref (packetizer->adapter);
     packetizer->disposed = TRUE;
@@ -425,33 +432,28 @@ mpegts_packetizer_parse_adaptation_field_control (MpegTSPacketizer2 *
 
 static MpegTSPacketizerPacketReturn
 mpegts_packetizer_parse_packet (MpegTSPacketizer2 * packetizer,
-    MpegTSPacketizerPacket * packet)
+    MpegTSPacketizerPacket * packet, const MpegTSPacketizerHeader * header)
 {
-  guint8 *data;
+  guint16 pid_flags = header->pid_flags;
   guint8 tmp;
 
-  data = packet->data_start;
-  data += 1;
-  tmp = *data;
-
   /* transport_error_indicator 1 */
-  if (G_UNLIKELY (tmp & 0x80))
+  if (G_UNLIKELY (pid_flags & 0x8000))
     return PACKET_BAD;
 
   /* payload_unit_start_indicator 1 */
-  packet->payload_unit_start_indicator = tmp & 0x40;
+  packet->payload_unit_start_indicator = (pid_flags >> 8) & 0x40;
 
   /* transport_priority 1 */
   /* PID 13 */
-  packet->pid = GST_READ_UINT16_BE (data) & 0x1FFF;
-  data += 2;
+  packet->pid = pid_flags & 0x1FFF;
 
-  packet->scram_afc_cc = tmp = *data++;
+  packet->scram_afc_cc = tmp = header->scram_afc_cc;
   /* transport_scrambling_control 2 */
   if (G_UNLIKELY (tmp & 0xc0))
     return PACKET_BAD;
 
-  packet->data = data;
+  packet->data = packet->data_start + 4;
 
   if (FLAGS_HAS_AFC (tmp))
     if (!mpegts_packetizer_parse_adaptation_field_control (packetizer, packet))
@@ -546,13 +548,11 @@ mpegts_packetizer_clear (MpegTSPacketizer2 * packetizer)
     memset (packetizer->streams, 0, 8192 * sizeof (MpegTSPacketizerStream *));
   }
 
+  mpegts_packetizer_reset_map (packetizer);
   gst_adapter_clear (packetizer->adapter);
   packetizer->offset = 0;
   packetizer->empty = TRUE;
   packetizer->need_sync = FALSE;
-  packetizer->map_data = NULL;
-  packetizer->map_size = 0;
-  packetizer->map_offset = 0;
   packetizer->last_in_time = GST_CLOCK_TIME_NONE;
 
   /* Close current PCR group */
@@ -577,14 +577,12 @@ mpegts_packetizer_flush (MpegTSPacketizer2 * packetizer, gboolean hard)
       }
     }
   }
+  mpegts_packetizer_reset_map (packetizer);
   gst_adapter_clear (packetizer->adapter);
 
   packetizer->offset = 0;
   packetizer->empty = TRUE;
   packetizer->need_sync = FALSE;
-  packetizer->map_data = NULL;
-  packetizer->map_size = 0;
-  packetizer->map_offset = 0;
   packetizer->last_in_time = GST_CLOCK_TIME_NONE;
 
   /* Close current PCR group */
@@ -643,20 +641,34 @@ mpegts_packetizer_push (MpegTSPacketizer2 * packetizer, GstBuffer * buffer)
 static void
 mpegts_packetizer_flush_bytes (MpegTSPacketizer2 * packetizer, gsize size)
 {
-  if (size > 0) {
-    GST_LOG ("flushing %" G_GSIZE_FORMAT " bytes from adapter", size);
-    gst_adapter_flush (packetizer->adapter, size);
+  GstBuffer *buffer = packetizer->map_buffer;
+
+  if (buffer) {
+    gsize left = packetizer->map_size - size;
+
+    if (size > 0)
+      GST_LOG ("flushing %" G_GSIZE_FORMAT " bytes from map", size);
+
+    gst_buffer_unmap (buffer, &packetizer->map_info);
+    /* Whatever wasn't consumed still comes before the adapter data */
+    if (left > 0)
+      packetizer->leftover =
+          gst_buffer_copy_region (buffer, GST_BUFFER_COPY_MEMORY, size, left);
+    gst_buffer_unref (buffer);
+    packetizer->map_buffer = NULL;
   }
 
   packetizer->map_data = NULL;
   packetizer->map_size = 0;
   packetizer->map_offset = 0;
+  packetizer->batch_pos = packetizer->batch_len = 0;
 }
 
 static gboolean
 mpegts_packetizer_map (MpegTSPacketizer2 * packetizer, gsize size)
 {
-  gsize available;
+  gsize available, leftover_size = 0;
+  GstBuffer *buffer;
 
   if (packetizer->map_size - packetizer->map_offset >= size)
     return TRUE;
@@ -664,22 +676,56 @@ mpegts_packetizer_map (MpegTSPacketizer2 * packetizer, gsize size)
   mpegts_packetizer_flush_bytes (packetizer, packetizer->map_offset);
 
   available = gst_adapter_available (packetizer->adapter);
-  if (available < size)
+  if (packetizer->leftover)
+    leftover_size = gst_buffer_get_size (packetizer->leftover);
+  if (leftover_size + available < size)
     return FALSE;
 
-  packetizer->map_data =
-      (guint8 *) gst_adapter_map (packetizer->adapter, available);
-  if (!packetizer->map_data)
+  if (leftover_size >= size) {
+    buffer = packetizer->leftover;
+  } else if (leftover_size) {
+    /* Only assemble what is needed to get past the leftover, the rest of
+     * the adapter can then be mapped without copying */
+    buffer = gst_buffer_append (packetizer->leftover,
+        gst_adapter_take_buffer (packetizer->adapter, size - leftover_size));
+  } else {
+    buffer = gst_adapter_take_buffer (packetizer->adapter, available);
+  }
+  packetizer->leftover = NULL;
+
+  /* buffer is writable, so mapping merges its memory in place */
+  if (!gst_buffer_map (buffer, &packetizer->map_info, GST_MAP_READ)) {
+    gst_buffer_unref (buffer);
     return FALSE;
+  }
 
-  packetizer->map_size = available;
+  packetizer->map_buffer = buffer;
+  packetizer->map_data = packetizer->map_info.data;
+  packetizer->map_size = packetizer->map_info.size;
   packetizer->map_offset = 0;
 
-  GST_LOG ("mapped %" G_GSIZE_FORMAT " bytes from adapter", available);
+  GST_LOG ("mapped %" G_GSIZE_FORMAT " bytes", packetizer->map_size);
 
   return TRUE;
 }
 
+/* Drop the mapped data and leftover, the adapter is left untouched */
+static void
+mpegts_packetizer_reset_map (MpegTSPacketizer2 * packetizer)
+{
+  if (packetizer->map_buffer) {
+    gst_buffer_unmap (packetizer->map_buffer, &packetizer->map_info);
+    gst_buffer_unref (packetizer->map_buffer);
+    packetizer->map_buffer = NULL;
+  }
+  gst_buffer_replace (&packetizer->leftover, NULL);
+
+  packetizer->map_data = NULL;
+  packetizer->map_size = 0;
+  packetizer->map_offset = 0;
+  packetizer->batch_pos = packetizer->batch_len = 0;
+}
+
 static gboolean
 mpegts_try_discover_packet_size (MpegTSPacketizer2 * packetizer)
 {
@@ -698,11 +744,19 @@ mpegts_try_discover_packet_size (MpegTSPacketizer2 * packetizer)
 
   size = packetizer->map_size - packetizer->map_offset;
   data = packetizer->map_data + packetizer->map_offset;
+  packetizer->batch_pos = packetizer->batch_len = 0;
 
   for (i = 0; i + 3 * MPEGTS_MAX_PACKETSIZE < size; i++) {
+    guint8 *sync;
+
     /* find a sync byte */
-    if (data[i] != PACKET_SYNC_BYTE)
-      continue;
+    sync = memchr (data + i, PACKET_SYNC_BYTE,
+        size - 3 * MPEGTS_MAX_PACKETSIZE - i);
+    if (sync == NULL) {
+      i = size - 3 * MPEGTS_MAX_PACKETSIZE;
+      break;
+    }
+    i = sync - data;
 
     /* check for 4 consecutive sync bytes with each possible packet size */
     for (j = 0; j < G_N_ELEMENTS (psizes); j++) {
@@ -757,9 +811,18 @@ mpegts_packetizer_sync (MpegTSPacketizer2 * packetizer)
   else
     sync_offset = 0;
 
+  /* let memchr skip over everything that can't be a sync byte */
   for (i = sync_offset; i + 2 * packet_size < size; i++) {
-    if (data[i] == PACKET_SYNC_BYTE &&
-        data[i + packet_size] == PACKET_SYNC_BYTE &&
+    guint8 *sync = memchr (data + i, PACKET_SYNC_BYTE,
+        size - 2 * packet_size - i);
+
+    if (sync == NULL) {
+      i = size - 2 * packet_size;
+      break;
+    }
+    i = sync - data;
+
+    if (data[i + packet_size] == PACKET_SYNC_BYTE &&
         data[i + 2 * packet_size] == PACKET_SYNC_BYTE) {
       found = TRUE;
       break;
@@ -767,6 +830,7 @@ mpegts_packetizer_sync (MpegTSPacketizer2 * packetizer)
   }
 
   packetizer->map_offset += i - sync_offset;
+  packetizer->batch_pos = packetizer->batch_len = 0;
 
   if (!found)
     mpegts_packetizer_flush_bytes (packetizer, packetizer->map_offset);
@@ -774,13 +838,70 @@ mpegts_packetizer_sync (MpegTSPacketizer2 * packetizer)
   return found;
 }
 
+/* Verify the sync byte of as many packets of the mapped data as fit in a
+ * batch and decode their headers in one go, stopping at the first packet
+ * that lost sync. Sync bytes sit at a fixed stride, so they are checked
+ * four packets at a time without branching on each of them.
+ * Returns the number of packets in the batch */
+static guint
+mpegts_packetizer_fill_batch (MpegTSPacketizer2 * packetizer,
+    gsize sync_offset)
+{
+  MpegTSPacketizerHeader *batch = packetizer->batch;
+  guint packet_size = packetizer->packet_size;
+  guint8 *data, *end;
+  guint i, n;
+
+  data = packetizer->map_data + packetizer->map_offset + sync_offset;
+  n = (packetizer->map_size - packetizer->map_offset) / packet_size;
+  n = MIN (n, MPEGTS_PACKETIZER_BATCH_SIZE);
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    guint8 *p = data + i * packet_size;
+
+    if ((p[0] ^ PACKET_SYNC_BYTE) | (p[packet_size] ^ PACKET_SYNC_BYTE) |
+        (p[2 * packet_size] ^ PACKET_SYNC_BYTE) |
+        (p[3 * packet_size] ^ PACKET_SYNC_BYTE))
+      break;
+  }
+  for (; i < n; i++)
+    if (data[i * packet_size] != PACKET_SYNC_BYTE)
+      break;
+
+  for (end = data + i * packet_size; data < end; data += packet_size) {
+    batch->pid_flags = GST_READ_UINT16_BE (data + 1);
+    batch->scram_afc_cc = data[3];
+    batch++;
+  }
+
+  packetizer->batch_pos = 0;
+  packetizer->batch_len = i;
+
+  return i;
+}
+
+static inline void
+mpegts_packetizer_fill_packet (MpegTSPacketizer2 * packetizer,
+    MpegTSPacketizerPacket * packet, gsize sync_offset)
+{
+  /* ALL mpeg-ts variants contain 188 bytes of data. Those with bigger
+   * packet sizes contain either extra data (timesync, FEC, ..) either
+   * before or after the data */
+  packet->data_start =
+      &packetizer->map_data[packetizer->map_offset + sync_offset];
+  packet->data_end = packet->data_start + 188;
+  packet->offset = packetizer->offset;
+  packetizer->offset += packetizer->packet_size;
+}
+
 MpegTSPacketizerPacketReturn
 mpegts_packetizer_next_packet (MpegTSPacketizer2 * packetizer,
     MpegTSPacketizerPacket * packet)
 {
-  guint8 *packet_data;
+  const MpegTSPacketizerHeader *header;
   guint packet_size;
   gsize sync_offset;
+  guint8 action;
 
   packet_size = packetizer->packet_size;
   if (G_UNLIKELY (!packet_size)) {
@@ -802,29 +923,44 @@ mpegts_packetizer_next_packet (MpegTSPacketizer2 * packetizer,
       packetizer->need_sync = FALSE;
     }
 
+    if (packetizer->batch_pos < packetizer->batch_len) {
+      if (packetizer->pid_actions == NULL)
+        break;
+
+      /* Only look further into packets of PIDs we care about */
+      header = &packetizer->batch[packetizer->batch_pos];
+      action = packetizer->pid_actions[header->pid_flags & 0x1FFF];
+      if (G_LIKELY (action >= MPEGTS_PID_ACTION_PSI))
+        break;
+
+      if (action == MPEGTS_PID_ACTION_PCR) {
+        mpegts_packetizer_fill_packet (packetizer, packet, sync_offset);
+        if (FLAGS_HAS_AFC (header->scram_afc_cc))
+          mpegts_packetizer_parse_packet (packetizer, packet, header);
+      } else {
+        packetizer->offset += packet_size;
+      }
+      mpegts_packetizer_clear_packet (packetizer, packet);
+      continue;
+    }
+
     if (!mpegts_packetizer_map (packetizer, packet_size))
       return PACKET_NEED_MORE;
 
-    packet_data = &packetizer->map_data[packetizer->map_offset + sync_offset];
+    /* Check sync bytes of the next batch of packets */
+    if (G_LIKELY (mpegts_packetizer_fill_batch (packetizer, sync_offset)))
+      continue;
 
-    /* Check sync byte */
-    if (G_UNLIKELY (*packet_data != PACKET_SYNC_BYTE)) {
-      GST_DEBUG ("lost sync");
-      packetizer->need_sync = TRUE;
-    } else {
-      /* ALL mpeg-ts variants contain 188 bytes of data. Those with bigger
-       * packet sizes contain either extra data (timesync, FEC, ..) either
-       * before or after the data */
-      packet->data_start = packet_data;
-      packet->data_end = packet->data_start + 188;
-      packet->offset = packetizer->offset;
-      GST_LOG ("offset %" G_GUINT64_FORMAT, packet->offset);
-      packetizer->offset += packet_size;
-      GST_MEMDUMP ("data_start", packet->data_start, 16);
-
-      return mpegts_packetizer_parse_packet (packetizer, packet);
-    }
+    GST_DEBUG ("lost sync");
+    packetizer->need_sync = TRUE;
   }
+
+  mpegts_packetizer_fill_packet (packetizer, packet, sync_offset);
+  GST_LOG ("offset %" G_GUINT64_FORMAT, packet->offset);
+  GST_MEMDUMP ("data_start", packet->data_start, 16);
+
+  return mpegts_packetizer_parse_packet (packetizer, packet,
+      &packetizer->batch[packetizer->batch_pos]);
 }
 
 MpegTSPacketizerPacketReturn
@@ -848,6 +984,7 @@ mpegts_packetizer_clear_packet (MpegTSPacketizer2 * packetizer,
 
   if (packetizer->map_data) {
     packetizer->map_offset += packet_size;
+    packetizer->batch_pos++;
     if (packetizer->map_size - packetizer->map_offset < packet_size)
       mpegts_packetizer_flush_bytes (packetizer, packetizer->map_offset);
   }
@@ -856,11 +993,38 @@ mpegts_packetizer_clear_packet (MpegTSPacketizer2 * packetizer,
 gboolean
 mpegts_packetizer_has_packets (MpegTSPacketizer2 * packetizer)
 {
+  gsize available;
+
   if (G_UNLIKELY (!packetizer->packet_size)) {
     if (!mpegts_try_discover_packet_size (packetizer))
       return FALSE;
   }
-  return gst_adapter_available (packetizer->adapter) >= packetizer->packet_size;
+
+  available = gst_adapter_available (packetizer->adapter);
+  available += packetizer->map_size - packetizer->map_offset;
+  if (packetizer->leftover)
+    available += gst_buffer_get_size (packetizer->leftover);
+
+  return available >= packetizer->packet_size;
+}
+
+/* Share a region of the current packet (such as its payload) without
+ * copying it. Returns NULL if the mapped data isn't backed by a single
+ * memory, in which case the caller has to copy */
+GstMemory *
+mpegts_packetizer_share_data (MpegTSPacketizer2 * packetizer, guint8 * data,
+    gsize size)
+{
+  GstBuffer *buffer = packetizer->map_buffer;
+
+  if (G_UNLIKELY (buffer == NULL || gst_buffer_n_memory (buffer) != 1))
+    return NULL;
+
+  g_return_val_if_fail (data >= packetizer->map_data &&
+      data + size <= packetizer->map_data + packetizer->map_size, NULL);
+
+  return gst_memory_share (gst_buffer_peek_memory (buffer, 0),
+      data - packetizer->map_data, size);
 }
 
 /*
@@ -211,6 +211,32 @@ typedef struct _PCROffsetCurrent
   guint64 prev_bitrate;
 } PCROffsetCurrent;
 
+/* Number of packets whose headers are decoded at once */
+#define MPEGTS_PACKETIZER_BATCH_SIZE 64
+
+/* Packet header fields, decoded ahead of the packet being parsed */
+typedef struct
+{
+  /* transport_error_indicator, payload_unit_start_indicator,
+   * transport_priority and PID */
+  guint16 pid_flags;
+  guint8  scram_afc_cc;
+} MpegTSPacketizerHeader;
+
+/* What to do with the packets of a PID, looked up right after the
+ * packet header has been decoded */
+typedef enum
+{
+  /* Skip the packet without parsing anything past the header */
+  MPEGTS_PID_ACTION_DROP = 0,
+  /* Only parse the adaptation field (for PCR), don't return the packet */
+  MPEGTS_PID_ACTION_PCR,
+  /* Return the packet, it carries sections */
+  MPEGTS_PID_ACTION_PSI,
+  /* Return the packet, it carries PES data */
+  MPEGTS_PID_ACTION_PES
+} MpegTSPacketizerPidAction;
+
 typedef struct _MpegTSPCR
 {
   guint16 pid;
@@ -267,6 +293,23 @@ struct _MpegTSPacketizer2 {
   gsize map_size;
   gboolean need_sync;
 
+  /* Buffer taken out of the adapter that map_data points into, so that
+   * payloads can be shared instead of copied */
+  GstBuffer *map_buffer;
+  GstMapInfo map_info;
+  /* Unconsumed tail of a previous map, comes before the adapter data */
+  GstBuffer *leftover;
+
+  /* Headers of the packets starting at map_offset, whose sync byte has
+   * already been verified. batch_pos is the one of the current packet */
+  MpegTSPacketizerHeader batch[MPEGTS_PACKETIZER_BATCH_SIZE];
+  guint batch_pos;
+  guint batch_len;
+
+  /* Per-PID MpegTSPacketizerPidAction table (0x2000 entries), owned by
+   * the user of the packetizer. If NULL, all packets are returned */
+  const guint8 *pid_actions;
+
   /* Reference offset */
   guint64 refoffset;
 
@@ -345,6 +388,8 @@ G_GNUC_INTERNAL MpegTSPacketizerPacketReturn
 mpegts_packetizer_process_next_packet(MpegTSPacketizer2 * packetizer);
 G_GNUC_INTERNAL void mpegts_packetizer_clear_packet (MpegTSPacketizer2 *packetizer,
 				     MpegTSPacketizerPacket *packet);
+G_GNUC_INTERNAL GstMemory *mpegts_packetizer_share_data (MpegTSPacketizer2 *packetizer,
+				     guint8 *data, gsize size);
 G_GNUC_INTERNAL void mpegts_packetizer_remove_stream(MpegTSPacketizer2 *packetizer,
   gint16 pid);
 
@@ -37,6 +37,9 @@
 #include <glib.h>
 #include <gst/tag/tag.h>
 #include <gst/pbutils/pbutils.h>
+#include <gst/codecparsers/gsth264parser.h>
+#include <gst/codecparsers/gsth265parser.h>
+#include <gst/codecparsers/gstmpegvideoparser.h>
 
 #include "mpegtsbase.h"
 #include "tsdemux.h"
@@ -54,6 +57,10 @@
 #define CONTINUITY_UNSET 255
 #define MAX_CONTINUITY 15
 
+/* Latency reported for live streams until it has been measured */
+#define TS_LATENCY (700 * GST_MSECOND)
+#define DEFAULT_LATENCY_MARGIN (100 * GST_MSECOND)
+
 /* Seeking/Scanning related variables */
 
 /* seek to SEEK_TIMESTAMP_OFFSET before the desired offset and search then
@@ -61,6 +68,10 @@
  */
 #define SEEK_TIMESTAMP_OFFSET (500 * GST_MSECOND)
 
+/* Maximum number of buffers dropped while waiting for a keyframe after a
+ * KEY_UNIT seek, in case keyframes can't be detected in the stream */
+#define KEY_UNIT_MAX_DROPPED 500
+
 #define SEGMENT_FORMAT "[format:%s, rate:%f, start:%"			\
   GST_TIME_FORMAT", stop:%"GST_TIME_FORMAT", time:%"GST_TIME_FORMAT	\
   ", base:%"GST_TIME_FORMAT", position:%"GST_TIME_FORMAT		\
@@ -102,6 +113,9 @@ typedef struct
 {
   /* The fully reconstructed buffer */
   GstBuffer *buffer;
+  /* The chunks of the PES if it is pushed in several buffers, ->buffer is
+   * then the first of them */
+  GstBufferList *list;
 
   /* Raw PTS/DTS (in 90kHz units) */
   guint64 pts, dts;
@@ -130,10 +144,19 @@ struct _TSDemuxStream
   /* Data being reconstructed (allocated) */
   guint8 *data;
 
+  /* Data being reconstructed from payloads shared with the input, used
+   * instead of ->data as long as they fit in a single buffer */
+  GstBuffer *shared;
+  /* Full ->shared buffers of the current PES, for chunked streams */
+  GstBufferList *chunks;
+  /* TRUE if PES packets can be pushed in several buffers, because a parser
+   * reassembles the elementary stream downstream */
+  gboolean chunked;
+
   /* Size of data being reconstructed (if known, else 0) */
   guint expected_size;
 
-  /* Amount of bytes in current ->data */
+  /* Amount of bytes in current ->data or ->shared */
   guint current_size;
   /* Size of ->data */
   guint allocated_size;
@@ -163,6 +186,19 @@ struct _TSDemuxStream
 
   /* if != 0, output only PES from that substream */
   guint8 target_pes_substream;
+
+  /* Running measurement of how late (compared to the input timestamp)
+   * the buffers of this stream are pushed out, for live streams */
+  GstClockTime latency;
+
+  /* Keyframe tracking (for video streams whose keyframes we can detect) */
+  gboolean detect_keyframes;
+  /* TRUE if buffers are dropped until the next keyframe (KEY_UNIT seek) */
+  gboolean need_keyframe;
+  guint dropped;
+  /* Timestamp of the last keyframe and distance to the previous one */
+  GstClockTime last_keyframe;
+  GstClockTime keyframe_interval;
 };
 
 #define VIDEO_CAPS \
@@ -232,6 +268,7 @@ enum
   ARG_0,
   PROP_PROGRAM_NUMBER,
   PROP_EMIT_STATS,
+  PROP_LATENCY_MARGIN,
   /* FILL ME */
 };
 
@@ -259,6 +296,7 @@ static void gst_ts_demux_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_ts_demux_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
+static void gst_ts_demux_finalize (GObject * object);
 static void gst_ts_demux_flush_streams (GstTSDemux * tsdemux);
 static GstFlowReturn
 gst_ts_demux_push_pending_data (GstTSDemux * demux, TSDemuxStream * stream);
@@ -292,6 +330,7 @@ gst_ts_demux_class_init (GstTSDemuxClass * klass)
   gobject_class = G_OBJECT_CLASS (klass);
   gobject_class->set_property = gst_ts_demux_set_property;
   gobject_class->get_property = gst_ts_demux_get_property;
+  gobject_class->finalize = gst_ts_demux_finalize;
 
   g_object_class_install_property (gobject_class, PROP_PROGRAM_NUMBER,
       g_param_spec_int ("program-number", "Program number",
@@ -303,6 +342,12 @@ gst_ts_demux_class_init (GstTSDemuxClass * klass)
           "Emit messages for every pcr/opcr/pts/dts", FALSE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_LATENCY_MARGIN,
+      g_param_spec_uint64 ("latency-margin", "Latency margin",
+          "Extra latency (in ns) reported on top of the measured one "
+          "for live streams", 0, G_MAXUINT64, DEFAULT_LATENCY_MARGIN,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   element_class = GST_ELEMENT_CLASS (klass);
   gst_element_class_add_pad_template (element_class,
       gst_static_pad_template_get (&video_template));
@@ -333,6 +378,19 @@ gst_ts_demux_class_init (GstTSDemuxClass * klass)
   ts_class->drain = GST_DEBUG_FUNCPTR (gst_ts_demux_drain);
 }
 
+static void
+gst_ts_demux_finalize (GObject * object)
+{
+  GstTSDemux *demux = GST_TS_DEMUX (object);
+
+  if (demux->h264parser)
+    gst_h264_nal_parser_free (demux->h264parser);
+  if (demux->h265parser)
+    gst_h265_parser_free (demux->h265parser);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 static void
 gst_ts_demux_reset (MpegTSBase * base)
 {
@@ -359,6 +417,11 @@ gst_ts_demux_reset (MpegTSBase * base)
 
   demux->have_group_id = FALSE;
   demux->group_id = G_MAXUINT;
+
+  GST_OBJECT_LOCK (demux);
+  demux->measured_latency = GST_CLOCK_TIME_NONE;
+  demux->reported_latency = GST_CLOCK_TIME_NONE;
+  GST_OBJECT_UNLOCK (demux);
 }
 
 static void
@@ -373,6 +436,7 @@ gst_ts_demux_init (GstTSDemux * demux)
 
   demux->requested_program_number = -1;
   demux->program_number = -1;
+  demux->latency_margin = DEFAULT_LATENCY_MARGIN;
   gst_ts_demux_reset (base);
 }
 
@@ -392,6 +456,11 @@ gst_ts_demux_set_property (GObject * object, guint prop_id,
     case PROP_EMIT_STATS:
       demux->emit_statistics = g_value_get_boolean (value);
       break;
+    case PROP_LATENCY_MARGIN:
+      GST_OBJECT_LOCK (demux);
+      demux->latency_margin = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -410,6 +479,11 @@ gst_ts_demux_get_property (GObject * object, guint prop_id,
     case PROP_EMIT_STATS:
       g_value_set_boolean (value, demux->emit_statistics);
       break;
+    case PROP_LATENCY_MARGIN:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_uint64 (value, demux->latency_margin);
+      GST_OBJECT_UNLOCK (demux);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -439,9 +513,14 @@ gst_ts_demux_srcpad_query (GstPad * pad, GstObject * parent, GstQuery * query)
           if (!gst_pad_peer_query_duration (base->sinkpad, format, &val))
             res = FALSE;
           else {
-            GstClockTime dur =
-                mpegts_packetizer_offset_to_ts (base->packetizer, val,
-                demux->program->pcr_pid);
+            GstClockTime dur = GST_CLOCK_TIME_NONE;
+
+            if (base->index)
+              dur = mpegts_index_get_duration (base->index,
+                  demux->program->pcr_pid);
+            if (!GST_CLOCK_TIME_IS_VALID (dur))
+              dur = mpegts_packetizer_offset_to_ts (base->packetizer, val,
+                  demux->program->pcr_pid);
             if (GST_CLOCK_TIME_IS_VALID (dur))
               gst_query_set_duration (query, GST_FORMAT_TIME, dur);
             else
@@ -459,21 +538,35 @@ gst_ts_demux_srcpad_query (GstPad * pad, GstObject * parent, GstQuery * query)
       GST_DEBUG ("query latency");
       res = gst_pad_peer_query (base->sinkpad, query);
       if (res && base->upstream_live) {
-        GstClockTime min_lat, max_lat;
+        GstClockTime min_lat, max_lat, latency;
         gboolean live;
 
-        /* According to H.222.0
+        /* Once we have pushed out buffers, we know how late they were
+         * compared to the input. Until then:
+
+           According to H.222.0
            Annex D.0.3 (System Time Clock recovery in the decoder)
            and D.0.2 (Audio and video presentation synchronization)
 
            We can end up with an interval of up to 700ms between valid
            PCR/SCR. We therefore allow a latency of 700ms for that.
          */
+        GST_OBJECT_LOCK (demux);
+        if (GST_CLOCK_TIME_IS_VALID (demux->measured_latency))
+          latency = demux->measured_latency + demux->latency_margin;
+        else
+          latency = TS_LATENCY;
+        demux->reported_latency = latency;
+        GST_OBJECT_UNLOCK (demux);
+
+        GST_DEBUG_OBJECT (demux, "Reporting latency of %" GST_TIME_FORMAT,
+            GST_TIME_ARGS (latency));
+
         gst_query_parse_latency (query, &live, &min_lat, &max_lat);
         if (min_lat != -1)
-          min_lat += 700 * GST_MSECOND;
+          min_lat += latency;
         if (max_lat != -1)
-          max_lat += 700 * GST_MSECOND;
+          max_lat += latency;
         gst_query_set_latency (query, live, min_lat, max_lat);
       }
       break;
@@ -525,6 +618,29 @@ gst_ts_demux_srcpad_query (GstPad * pad, GstObject * parent, GstQuery * query)
 
 }
 
+/* Move @offset back to the earliest of the indexed random access points
+ * preceding it in each stream, so that decoding can start right away */
+static guint64
+gst_ts_demux_index_keyframe_before (GstTSDemux * demux, guint64 offset)
+{
+  MpegTSBase *base = (MpegTSBase *) demux;
+  guint64 res = offset, keyframe;
+  GList *tmp;
+
+  for (tmp = demux->program->stream_list; tmp; tmp = tmp->next) {
+    MpegTSBaseStream *stream = (MpegTSBaseStream *) tmp->data;
+
+    keyframe = mpegts_index_keyframe_before (base->index, stream->pid, offset);
+    if (keyframe != -1 && keyframe < res)
+      res = keyframe;
+  }
+
+  GST_DEBUG_OBJECT (demux, "Using keyframe offset %" G_GUINT64_FORMAT
+      " for offset %" G_GUINT64_FORMAT, res, offset);
+
+  return res;
+}
+
 static GstFlowReturn
 gst_ts_demux_do_seek (MpegTSBase * base, GstEvent * event)
 {
@@ -538,6 +654,8 @@ gst_ts_demux_do_seek (MpegTSBase * base, GstEvent * event)
   GstSegment seeksegment;
   gboolean update;
   guint64 start_offset;
+  GstClockTime seek_back = SEEK_TIMESTAMP_OFFSET;
+  GList *tmp;
 
   gst_event_parse_seek (event, &rate, &format, &flags, &start_type, &start,
       &stop_type, &stop);
@@ -571,10 +689,36 @@ gst_ts_demux_do_seek (MpegTSBase * base, GstEvent * event)
   GST_DEBUG ("seeksegment after set_seek " SEGMENT_FORMAT,
       SEGMENT_ARGS (seeksegment));
 
-  /* Convert start/stop to offset */
-  start_offset =
-      mpegts_packetizer_ts_to_offset (base->packetizer, MAX (0,
-          start - SEEK_TIMESTAMP_OFFSET), demux->program->pcr_pid);
+  /* For KEY_UNIT seeks, go back far enough to have a keyframe before the
+   * requested position and only output data from that keyframe onwards */
+  if (flags & GST_SEEK_FLAG_KEY_UNIT) {
+    for (tmp = demux->program->stream_list; tmp; tmp = tmp->next) {
+      TSDemuxStream *stream = (TSDemuxStream *) tmp->data;
+
+      if (!stream->detect_keyframes)
+        continue;
+      stream->need_keyframe = TRUE;
+      stream->dropped = 0;
+      if (GST_CLOCK_TIME_IS_VALID (stream->keyframe_interval) &&
+          stream->keyframe_interval + SEEK_TIMESTAMP_OFFSET > seek_back)
+        seek_back = stream->keyframe_interval + SEEK_TIMESTAMP_OFFSET;
+    }
+    GST_DEBUG ("Seeking %" GST_TIME_FORMAT " before the requested position",
+        GST_TIME_ARGS (seek_back));
+  }
+
+  /* Convert start/stop to offset, preferably with the index */
+  start_offset = -1;
+  if (base->index) {
+    start_offset = mpegts_index_ts_to_offset (base->index,
+        demux->program->pcr_pid, MAX (0, start - (gint64) seek_back));
+    if (start_offset != -1)
+      start_offset = gst_ts_demux_index_keyframe_before (demux, start_offset);
+  }
+  if (start_offset == -1)
+    start_offset =
+        mpegts_packetizer_ts_to_offset (base->packetizer, MAX (0,
+            start - (gint64) seek_back), demux->program->pcr_pid);
 
   if (G_UNLIKELY (start_offset == -1)) {
     GST_WARNING ("Couldn't convert start position to an offset");
@@ -1169,6 +1313,25 @@ gst_ts_demux_stream_added (MpegTSBase * base, MpegTSBaseStream * bstream,
     stream->pending_ts = TRUE;
     stream->first_dts = GST_CLOCK_TIME_NONE;
     stream->continuity_counter = CONTINUITY_UNSET;
+    stream->latency = GST_CLOCK_TIME_NONE;
+
+    switch (bstream->stream_type) {
+      case GST_MPEG_TS_STREAM_TYPE_VIDEO_MPEG1:
+      case GST_MPEG_TS_STREAM_TYPE_VIDEO_MPEG2:
+      case ST_PS_VIDEO_MPEG2_DCII:
+      case GST_MPEG_TS_STREAM_TYPE_VIDEO_H264:
+      case GST_MPEG_TS_STREAM_TYPE_VIDEO_HEVC:
+        stream->detect_keyframes = (stream->pad != NULL);
+        stream->chunked = TRUE;
+        break;
+      default:
+        stream->detect_keyframes = FALSE;
+        stream->chunked = FALSE;
+        break;
+    }
+    stream->need_keyframe = FALSE;
+    stream->last_keyframe = GST_CLOCK_TIME_NONE;
+    stream->keyframe_interval = GST_CLOCK_TIME_NONE;
   }
   stream->flow_return = GST_FLOW_OK;
 }
@@ -1235,6 +1398,12 @@ gst_ts_demux_stream_flush (TSDemuxStream * stream)
   if (stream->data)
     g_free (stream->data);
   stream->data = NULL;
+  if (stream->shared)
+    gst_buffer_unref (stream->shared);
+  stream->shared = NULL;
+  if (stream->chunks)
+    gst_buffer_list_unref (stream->chunks);
+  stream->chunks = NULL;
   stream->state = PENDING_PACKET_EMPTY;
   stream->expected_size = 0;
   stream->allocated_size = 0;
@@ -1250,6 +1419,8 @@ gst_ts_demux_stream_flush (TSDemuxStream * stream)
     stream->flow_return = GST_FLOW_OK;
   }
   stream->continuity_counter = CONTINUITY_UNSET;
+  stream->latency = GST_CLOCK_TIME_NONE;
+  stream->last_keyframe = GST_CLOCK_TIME_NONE;
 }
 
 static void
@@ -1491,6 +1662,66 @@ check_pending_buffers (GstTSDemux * demux, TSDemuxStream * stream)
   return TRUE;
 }
 
+/* Append payload data to the PES packet being reconstructed. Payloads are
+ * shared with the input as long as they fit in one output buffer. Beyond
+ * that, chunked streams start a new buffer, the others are flattened once
+ * into ->data and copied from then on */
+static void
+gst_ts_demux_stream_append (GstTSDemux * demux, TSDemuxStream * stream,
+    guint8 * data, guint size)
+{
+  MpegTSBase *base = (MpegTSBase *) demux;
+  GstMemory *mem;
+
+  if (G_UNLIKELY (size == 0))
+    return;
+
+  if (stream->data == NULL) {
+    if (stream->shared == NULL)
+      stream->shared = gst_buffer_new ();
+
+    if (stream->chunked
+        && gst_buffer_n_memory (stream->shared) >=
+        gst_buffer_get_max_memory ()) {
+      if (stream->chunks == NULL)
+        stream->chunks = gst_buffer_list_new ();
+      gst_buffer_list_add (stream->chunks, stream->shared);
+      stream->shared = gst_buffer_new ();
+    }
+
+    if (gst_buffer_n_memory (stream->shared) < gst_buffer_get_max_memory ()) {
+      mem = mpegts_packetizer_share_data (base->packetizer, data, size);
+      /* chunked streams never flatten, copy only this payload */
+      if (G_UNLIKELY (mem == NULL) && stream->chunked) {
+        guint8 *copy = g_memdup (data, size);
+        mem = gst_memory_new_wrapped (0, copy, size, 0, size, copy, g_free);
+      }
+      if (G_LIKELY (mem)) {
+        gst_buffer_append_memory (stream->shared, mem);
+        stream->current_size += size;
+        return;
+      }
+    }
+
+    GST_LOG ("flattening %d bytes of shared payload", stream->current_size);
+    stream->allocated_size =
+        MAX (MAX (stream->expected_size, stream->current_size + size), 8192);
+    stream->data = g_malloc (stream->allocated_size);
+    gst_buffer_extract (stream->shared, 0, stream->data, stream->current_size);
+    gst_buffer_unref (stream->shared);
+    stream->shared = NULL;
+  } else if (G_UNLIKELY (stream->current_size + size > stream->allocated_size)) {
+    GST_LOG ("resizing buffer");
+    do {
+      stream->allocated_size *= 2;
+    } while (stream->current_size + size > stream->allocated_size);
+    stream->data = g_realloc (stream->data, stream->allocated_size);
+  }
+
+  memcpy (stream->data + stream->current_size, data, size);
+  stream->current_size += size;
+}
+
 static void
 gst_ts_demux_parse_pes_header (GstTSDemux * demux, TSDemuxStream * stream,
     guint8 * data, guint32 length, guint64 bufferoffset)
@@ -1549,16 +1780,19 @@ gst_ts_demux_parse_pes_header (GstTSDemux * demux, TSDemuxStream * stream,
   data += header.header_size;
   length -= header.header_size;
 
-  /* Create the output buffer */
-  if (stream->expected_size)
+  g_assert (stream->data == NULL && stream->shared == NULL
+      && stream->chunks == NULL);
+  stream->current_size = 0;
+
+  /* Create the output buffer right away if we know the payloads won't fit
+   * in a buffer of shared memories */
+  if (!stream->chunked
+      && stream->expected_size > gst_buffer_get_max_memory () * 184) {
     stream->allocated_size = MAX (stream->expected_size, length);
-  else
-    stream->allocated_size = MAX (8192, length);
+    stream->data = g_malloc (stream->allocated_size);
+  }
 
-  g_assert (stream->data == NULL);
-  stream->data = g_malloc (stream->allocated_size);
-  memcpy (stream->data, data, length);
-  stream->current_size = length;
+  gst_ts_demux_stream_append (demux, stream, data, length);
 
   stream->state = PENDING_PACKET_BUFFER;
 
@@ -1620,15 +1854,7 @@ gst_ts_demux_queue_data (GstTSDemux * demux, TSDemuxStream * stream,
     case PENDING_PACKET_BUFFER:
     {
       GST_LOG ("BUFFER: appending data");
-      if (G_UNLIKELY (stream->current_size + size > stream->allocated_size)) {
-        GST_LOG ("resizing buffer");
-        do {
-          stream->allocated_size *= 2;
-        } while (stream->current_size + size > stream->allocated_size);
-        stream->data = g_realloc (stream->data, stream->allocated_size);
-      }
-      memcpy (stream->data + stream->current_size, data, size);
-      stream->current_size += size;
+      gst_ts_demux_stream_append (demux, stream, data, size);
       break;
     }
     case PENDING_PACKET_DISCONT:
@@ -1638,6 +1864,14 @@ gst_ts_demux_queue_data (GstTSDemux * demux, TSDemuxStream * stream,
         g_free (stream->data);
         stream->data = NULL;
       }
+      if (G_UNLIKELY (stream->shared)) {
+        gst_buffer_unref (stream->shared);
+        stream->shared = NULL;
+      }
+      if (G_UNLIKELY (stream->chunks)) {
+        gst_buffer_list_unref (stream->chunks);
+        stream->chunks = NULL;
+      }
       stream->continuity_counter = CONTINUITY_UNSET;
       break;
     }
@@ -1747,6 +1981,207 @@ push_new_segment:
   stream->need_newsegment = FALSE;
 }
 
+/* Amount of data looked at for finding the first picture of a PES */
+#define KEYFRAME_PEEK_SIZE 4096
+
+/* Returns TRUE if the access unit(s) in @data start with a random access
+ * point. Only the NAL units/start codes up to the first picture are looked
+ * at */
+static gboolean
+gst_ts_demux_is_keyframe (GstTSDemux * demux, TSDemuxStream * stream,
+    const guint8 * data, gsize size)
+{
+  switch (stream->stream.stream_type) {
+    case GST_MPEG_TS_STREAM_TYPE_VIDEO_H264:
+    {
+      GstH264NalUnit nalu;
+      guint offset = 0;
+
+      if (G_UNLIKELY (demux->h264parser == NULL))
+        demux->h264parser = gst_h264_nal_parser_new ();
+
+      while (gst_h264_parser_identify_nalu_unchecked (demux->h264parser, data,
+              offset, size, &nalu) == GST_H264_PARSER_OK) {
+        /* The first slice tells */
+        if (nalu.type >= GST_H264_NAL_SLICE &&
+            nalu.type <= GST_H264_NAL_SLICE_IDR)
+          return nalu.type == GST_H264_NAL_SLICE_IDR;
+        offset = nalu.offset + 1;
+      }
+      return FALSE;
+    }
+    case GST_MPEG_TS_STREAM_TYPE_VIDEO_HEVC:
+    {
+      GstH265NalUnit nalu;
+      guint offset = 0;
+
+      if (G_UNLIKELY (demux->h265parser == NULL))
+        demux->h265parser = gst_h265_parser_new ();
+
+      while (gst_h265_parser_identify_nalu_unchecked (demux->h265parser, data,
+              offset, size, &nalu) == GST_H265_PARSER_OK) {
+        /* The first VCL NAL unit (0 to 31) tells, IRAP pictures are 16
+         * to 23 */
+        if (nalu.type < 32)
+          return nalu.type >= GST_H265_NAL_SLICE_BLA_W_LP && nalu.type <= 23;
+        offset = nalu.offset + 1;
+      }
+      return FALSE;
+    }
+    default:
+    {
+      GstMpegVideoPacket packet;
+      GstMpegVideoPictureHdr hdr;
+      guint offset = 0;
+
+      while (gst_mpeg_video_parse (&packet, data, size, offset)) {
+        if (packet.type == GST_MPEG_VIDEO_PACKET_PICTURE) {
+          if (packet.size < 0)
+            packet.size = size - packet.offset;
+          return gst_mpeg_video_packet_parse_picture_header (&packet, &hdr)
+              && hdr.pic_type == GST_MPEG_VIDEO_PICTURE_TYPE_I;
+        }
+        offset = packet.offset;
+      }
+      return FALSE;
+    }
+  }
+}
+
+/* Keep track of keyframes and of the distance between them, and tell
+ * whether the PES in @buffer, or in the buffers of @list if it was
+ * chunked, should be dropped because we are waiting for a keyframe */
+static gboolean
+gst_ts_demux_check_keyframe (GstTSDemux * demux, TSDemuxStream * stream,
+    GstBuffer * buffer, GstBufferList * list)
+{
+  GstClockTime ts;
+  guint8 data[KEYFRAME_PEEK_SIZE];
+  gsize size;
+  guint i, n;
+  gboolean keyframe;
+  GList *tmp;
+
+  /* Only peek at the start of the PES, mapping the whole buffer would merge
+   * all its memories. A chunked PES can start with chunks smaller than
+   * that, so gather from as many as needed */
+  size = gst_buffer_extract (buffer, 0, data, KEYFRAME_PEEK_SIZE);
+  n = list ? gst_buffer_list_length (list) : 0;
+  for (i = 1; i < n && size < KEYFRAME_PEEK_SIZE; i++)
+    size += gst_buffer_extract (gst_buffer_list_get (list, i), 0, data + size,
+        KEYFRAME_PEEK_SIZE - size);
+  keyframe = gst_ts_demux_is_keyframe (demux, stream, data, size);
+
+  ts = GST_CLOCK_TIME_IS_VALID (stream->dts) ? stream->dts : stream->pts;
+
+  if (keyframe && GST_CLOCK_TIME_IS_VALID (ts)) {
+    if (GST_CLOCK_TIME_IS_VALID (stream->last_keyframe) &&
+        ts > stream->last_keyframe)
+      stream->keyframe_interval = ts - stream->last_keyframe;
+    stream->last_keyframe = ts;
+  }
+
+  if (G_LIKELY (!stream->need_keyframe))
+    return FALSE;
+
+  if (!keyframe && stream->dropped < KEY_UNIT_MAX_DROPPED) {
+    GST_LOG_OBJECT (stream->pad, "Waiting for a keyframe, dropping buffer");
+    stream->dropped++;
+    return TRUE;
+  }
+
+  GST_DEBUG_OBJECT (stream->pad, "Got keyframe at %" GST_TIME_FORMAT
+      " after dropping %u buffers", GST_TIME_ARGS (ts), stream->dropped);
+  stream->need_keyframe = FALSE;
+
+  /* The segment should start from the keyframe, not from data of other
+   * streams received before it */
+  for (tmp = demux->program->stream_list; tmp; tmp = tmp->next) {
+    TSDemuxStream *other = (TSDemuxStream *) tmp->data;
+    if (other->need_newsegment)
+      other->first_dts = GST_CLOCK_TIME_NONE;
+  }
+  stream->first_dts = ts;
+
+  return FALSE;
+}
+
+/* Whether we are still waiting for a keyframe after a KEY_UNIT seek */
+static gboolean
+gst_ts_demux_waiting_keyframe (GstTSDemux * demux)
+{
+  GList *tmp;
+
+  for (tmp = demux->program->stream_list; tmp; tmp = tmp->next) {
+    if (((TSDemuxStream *) tmp->data)->need_keyframe)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+/* Measure how late @buffer is pushed out compared to the timestamp of the
+ * latest input buffer, and post a latency message if the latency we
+ * reported no longer matches */
+static void
+gst_ts_demux_update_latency (GstTSDemux * demux, TSDemuxStream * stream,
+    GstBuffer * buffer)
+{
+  MpegTSBase *base = (MpegTSBase *) demux;
+  GstClockTime in_time, out_time, sample, measured, margin, reported;
+  GList *tmp;
+
+  /* Output timestamps are only in the input clock domain when the clock
+   * skew is being tracked, which is done for live streams */
+  if (!base->upstream_live || !base->packetizer->calculate_skew)
+    return;
+
+  in_time = base->packetizer->last_in_time;
+  out_time = GST_BUFFER_DTS (buffer);
+  if (!GST_CLOCK_TIME_IS_VALID (out_time))
+    out_time = GST_BUFFER_PTS (buffer);
+  if (!GST_CLOCK_TIME_IS_VALID (in_time) || !GST_CLOCK_TIME_IS_VALID (out_time))
+    return;
+
+  sample = in_time > out_time ? in_time - out_time : 0;
+
+  /* Follow increases right away, decreases slowly */
+  if (!GST_CLOCK_TIME_IS_VALID (stream->latency) || sample > stream->latency)
+    stream->latency = sample;
+  else
+    stream->latency -= (stream->latency - sample) / 16;
+
+  measured = stream->latency;
+  for (tmp = demux->program->stream_list; tmp; tmp = tmp->next) {
+    TSDemuxStream *other = (TSDemuxStream *) tmp->data;
+
+    if (GST_CLOCK_TIME_IS_VALID (other->latency) && other->latency > measured)
+      measured = other->latency;
+  }
+
+  GST_OBJECT_LOCK (demux);
+  demux->measured_latency = measured;
+  margin = demux->latency_margin;
+  reported = demux->reported_latency;
+
+  /* Ask for a new latency if we are now later than what we reported, or
+   * if we are over-buffering by more than the margin. Don't ask again
+   * until it has been queried */
+  if (GST_CLOCK_TIME_IS_VALID (reported) && (measured + margin > reported
+          || measured + 2 * margin < reported))
+    demux->reported_latency = GST_CLOCK_TIME_NONE;
+  else
+    reported = GST_CLOCK_TIME_NONE;
+  GST_OBJECT_UNLOCK (demux);
+
+  if (GST_CLOCK_TIME_IS_VALID (reported)) {
+    GST_DEBUG_OBJECT (demux, "Measured latency %" GST_TIME_FORMAT
+        " drifted from reported %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (measured), GST_TIME_ARGS (reported));
+    gst_element_post_message (GST_ELEMENT_CAST (demux),
+        gst_message_new_latency (GST_OBJECT_CAST (demux)));
+  }
+}
+
 static GstFlowReturn
 gst_ts_demux_push_pending_data (GstTSDemux * demux, TSDemuxStream * stream)
 {
@@ -1755,12 +2190,13 @@ gst_ts_demux_push_pending_data (GstTSDemux * demux, TSDemuxStream * stream)
   MpegTSBaseStream *bs = (MpegTSBaseStream *) stream;
 #endif
   GstBuffer *buffer = NULL;
+  GstBufferList *list = NULL;
 
   GST_DEBUG_OBJECT (stream->pad,
       "stream:%p, pid:0x%04x stream_type:%d state:%d", stream, bs->pid,
       bs->stream_type, stream->state);
 
-  if (G_UNLIKELY (stream->data == NULL)) {
+  if (G_UNLIKELY (stream->data == NULL && stream->shared == NULL)) {
     GST_LOG ("stream->data == NULL");
     goto beach;
   }
@@ -1778,15 +2214,50 @@ gst_ts_demux_push_pending_data (GstTSDemux * demux, TSDemuxStream * stream)
   if (G_UNLIKELY (demux->program == NULL)) {
     GST_LOG_OBJECT (demux, "No program");
     g_free (stream->data);
+    if (stream->shared)
+      gst_buffer_unref (stream->shared);
+    if (stream->chunks)
+      gst_buffer_list_unref (stream->chunks);
     goto beach;
   }
 
-  buffer = gst_buffer_new_wrapped (stream->data, stream->current_size);
+  if (stream->data) {
+    buffer = gst_buffer_new_wrapped (stream->data, stream->current_size);
+  } else if (stream->chunks) {
+    /* the PES goes out in several buffers, the first one carries the
+     * timestamps and flags */
+    list = stream->chunks;
+    gst_buffer_list_add (list, stream->shared);
+    buffer = gst_buffer_list_get (list, 0);
+    GST_LOG ("pushing %d bytes of PES in %u buffers", stream->current_size,
+        gst_buffer_list_length (list));
+  } else {
+    buffer = stream->shared;
+  }
+
+  if (stream->detect_keyframes) {
+    if (gst_ts_demux_check_keyframe (demux, stream, buffer, list)) {
+      if (list)
+        gst_buffer_list_unref (list);
+      else
+        gst_buffer_unref (buffer);
+      goto beach;
+    }
+  } else if (G_UNLIKELY (gst_ts_demux_waiting_keyframe (demux))) {
+    /* Other streams start along with the keyframe */
+    GST_LOG_OBJECT (stream->pad, "Waiting for a keyframe, dropping buffer");
+    if (list)
+      gst_buffer_list_unref (list);
+    else
+      gst_buffer_unref (buffer);
+    goto beach;
+  }
 
   if (G_UNLIKELY (stream->pending_ts && !check_pending_buffers (demux, stream))) {
     PendingBuffer *pend;
     pend = g_slice_new0 (PendingBuffer);
     pend->buffer = buffer;
+    pend->list = list;
     pend->pts = stream->raw_pts;
     pend->dts = stream->raw_dts;
     stream->pending = g_list_append (stream->pending, pend);
@@ -1815,7 +2286,10 @@ gst_ts_demux_push_pending_data (GstTSDemux * demux, TSDemuxStream * stream)
         GST_BUFFER_FLAG_SET (pend->buffer, GST_BUFFER_FLAG_DISCONT);
       stream->discont = FALSE;
 
-      res = gst_pad_push (stream->pad, pend->buffer);
+      if (pend->list)
+        res = gst_pad_push_list (stream->pad, pend->list);
+      else
+        res = gst_pad_push (stream->pad, pend->buffer);
       g_slice_free (PendingBuffer, pend);
     }
     g_list_free (stream->pending);
@@ -1838,7 +2312,12 @@ gst_ts_demux_push_pending_data (GstTSDemux * demux, TSDemuxStream * stream)
     GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
   stream->discont = FALSE;
 
-  res = gst_pad_push (stream->pad, buffer);
+  gst_ts_demux_update_latency (demux, stream, buffer);
+
+  if (list)
+    res = gst_pad_push_list (stream->pad, list);
+  else
+    res = gst_pad_push (stream->pad, buffer);
   GST_DEBUG_OBJECT (stream->pad, "Returned %s", gst_flow_get_name (res));
   res = tsdemux_combine_flows (demux, stream, res);
   GST_DEBUG_OBJECT (stream->pad, "combined %s", gst_flow_get_name (res));
@@ -1848,6 +2327,8 @@ beach:
   GST_LOG ("Resetting to EMPTY, returning %s", gst_flow_get_name (res));
   stream->state = PENDING_PACKET_EMPTY;
   stream->data = NULL;
+  stream->shared = NULL;
+  stream->chunks = NULL;
   stream->expected_size = 0;
   stream->current_size = 0;
 
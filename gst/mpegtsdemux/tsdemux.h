@@ -31,6 +31,8 @@
 #include <gst/base/gstbytereader.h>
 #include "mpegtsbase.h"
 #include "mpegtspacketizer.h"
+#include <gst/codecparsers/gsth264parser.h>
+#include <gst/codecparsers/gsth265parser.h>
 
 G_BEGIN_DECLS
 #define GST_TYPE_TS_DEMUX \
@@ -61,6 +63,12 @@ struct _GstTSDemux
   gint requested_program_number; /* Required program number (ignore:-1) */
   guint program_number;
   gboolean emit_statistics;
+  /* Extra latency reported on top of the measured one */
+  GstClockTime latency_margin;
+  /* Maximum latency measured over all streams, and latency last reported
+   * in a LATENCY query (NONE if not reported yet) */
+  GstClockTime measured_latency;
+  GstClockTime reported_latency;
 
   /*< private >*/
   MpegTSBaseProgram *program;	/* Current program */
@@ -82,6 +90,10 @@ struct _GstTSDemux
 
   /* Pending seek rate (default 1.0) */
   gdouble rate;
+
+  /* Parsers used to detect keyframes, created when needed */
+  GstH264NalParser *h264parser;
+  GstH265Parser *h265parser;
 };
 
 struct _GstTSDemuxClass
@@ -118,6 +118,9 @@ enum
 #define MPEGTSMUX_DEFAULT_ALIGNMENT    -1
 #define MPEGTSMUX_DEFAULT_M2TS         FALSE
 
+/* slab capacity in packets when not aligning (alignment = 0) */
+#define MPEGTSMUX_SLAB_PACKETS         128
+
 static GstStaticPadTemplate mpegtsmux_sink_factory =
     GST_STATIC_PAD_TEMPLATE ("sink_%d",
     GST_PAD_SINK,
@@ -161,15 +164,14 @@ static void gst_mpegtsmux_get_property (GObject * object, guint prop_id,
 
 static void mpegtsmux_reset (MpegTsMux * mux, gboolean alloc);
 static void mpegtsmux_dispose (GObject * object);
-static void alloc_packet_cb (GstBuffer ** _buf, void *user_data);
-static gboolean new_packet_cb (GstBuffer * buf, void *user_data,
+static guint8 *alloc_packet_cb (void *user_data);
+static gboolean new_packet_cb (guint8 * packet, void *user_data,
     gint64 new_pcr);
 static void release_buffer_cb (guint8 * data, void *user_data);
-static GstFlowReturn mpegtsmux_collect_packet (MpegTsMux * mux,
-    GstBuffer * buf);
 static GstFlowReturn mpegtsmux_push_packets (MpegTsMux * mux, gboolean force);
-static gboolean new_packet_m2ts (MpegTsMux * mux, GstBuffer * buf,
+static gboolean new_packet_m2ts (MpegTsMux * mux, guint8 * data,
     gint64 new_pcr);
+static void mpegtsmux_slab_free (MpegTsMuxSlab * slab);
 
 static void mpegtsdemux_prepare_srcpad (MpegTsMux * mux);
 GstFlowReturn mpegtsmux_clip_inc_running_time (GstCollectPads * pads,
@@ -319,8 +321,7 @@ mpegtsmux_init (MpegTsMux * mux)
   mux->tsmux = tsmux_new ();
   tsmux_set_write_func (mux->tsmux, new_packet_cb, mux);
 
-  mux->adapter = gst_adapter_new ();
-  mux->out_adapter = gst_adapter_new ();
+  g_queue_init (&mux->out_slabs);
 
   /* properties */
   mux->m2ts_mode = MPEGTSMUX_DEFAULT_M2TS;
@@ -388,10 +389,14 @@ mpegtsmux_reset (MpegTsMux * mux, gboolean alloc)
     mux->element_index = NULL;
   }
 #endif
-  if (mux->adapter)
-    gst_adapter_clear (mux->adapter);
-  if (mux->out_adapter)
-    gst_adapter_clear (mux->out_adapter);
+  mux->m2ts_pending = 0;
+  while (!g_queue_is_empty (&mux->out_slabs))
+    mpegtsmux_slab_free (g_queue_pop_head (&mux->out_slabs));
+  if (mux->out_pool) {
+    gst_buffer_pool_set_active (mux->out_pool, FALSE);
+    gst_object_unref (mux->out_pool);
+    mux->out_pool = NULL;
+  }
 
   if (mux->tsmux) {
     tsmux_free (mux->tsmux);
@@ -414,7 +419,6 @@ mpegtsmux_reset (MpegTsMux * mux, gboolean alloc)
     mux->streamheader = NULL;
   }
   gst_event_replace (&mux->force_key_unit_event, NULL);
-  gst_buffer_replace (&mux->out_buffer, NULL);
 
   if (mux->collect) {
     GST_COLLECT_PADS_STREAM_LOCK (mux->collect);
@@ -437,14 +441,6 @@ mpegtsmux_dispose (GObject * object)
 
   mpegtsmux_reset (mux, FALSE);
 
-  if (mux->adapter) {
-    g_object_unref (mux->adapter);
-    mux->adapter = NULL;
-  }
-  if (mux->out_adapter) {
-    g_object_unref (mux->out_adapter);
-    mux->out_adapter = NULL;
-  }
   if (mux->collect) {
     gst_object_unref (mux->collect);
     mux->collect = NULL;
@@ -1325,23 +1321,17 @@ mpegtsmux_release_pad (GstElement * element, GstPad * pad)
 
 static void
 new_packet_common_init (MpegTsMux * mux, GstBuffer * buf, guint8 * data,
-    guint len)
+    guint offset)
 {
-  /* Packets should be at least 188 bytes, but check anyway */
-  g_return_if_fail (len >= 2 || !data);
-
-  if (!mux->streamheader_sent && data) {
-    guint pid = ((data[1] & 0x1f) << 8) | data[2];
+  /* @data is a complete packet including @offset bytes of m2ts prefix */
+  if (!mux->streamheader_sent) {
+    guint pid = ((data[offset + 1] & 0x1f) << 8) | data[offset + 2];
     /* if it's a PAT or a PMT */
     if (pid == 0x00 || (pid >= TSMUX_START_PMT_PID && pid < TSMUX_START_ES_PID)) {
       GstBuffer *hbuf;
 
-      if (!buf) {
-        hbuf = gst_buffer_new_and_alloc (len);
-        gst_buffer_fill (hbuf, 0, data, len);
-      } else {
-        hbuf = gst_buffer_copy (buf);
-      }
+      hbuf = gst_buffer_new_and_alloc (NORMAL_TS_PACKET_LENGTH + offset);
+      gst_buffer_fill (hbuf, 0, data, NORMAL_TS_PACKET_LENGTH + offset);
       mux->streamheader = g_list_append (mux->streamheader, hbuf);
     } else if (mux->streamheader) {
       mpegtsdemux_set_header_on_caps (mux);
@@ -1349,136 +1339,233 @@ new_packet_common_init (MpegTsMux * mux, GstBuffer * buf, guint8 * data,
     }
   }
 
-  if (buf) {
-    if (mux->is_delta) {
+  /* only the first packet of a slab determines the flags of the buffer */
+  if (mux->is_delta) {
+    if (buf) {
       GST_LOG_OBJECT (mux, "marking as delta unit");
       GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
-    } else {
+    }
+  } else {
+    if (buf) {
       GST_DEBUG_OBJECT (mux, "marking as non-delta unit");
-      mux->is_delta = TRUE;
+      GST_BUFFER_FLAG_UNSET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
     }
+    mux->is_delta = TRUE;
   }
 }
 
-static GstFlowReturn
-mpegtsmux_push_packets (MpegTsMux * mux, gboolean force)
+static void
+mpegtsmux_get_packet_layout (MpegTsMux * mux, gint * packet_size,
+    gint * align)
 {
-  gint align = mux->alignment;
-  gint av, packet_size;
-  GstBuffer *buf;
-  GstFlowReturn ret = GST_FLOW_OK;
-  GstClockTime ts;
+  gint a = mux->alignment;
 
   if (mux->m2ts_mode) {
-    packet_size = M2TS_PACKET_LENGTH;
-    if (align < 0)
-      align = 32;
+    *packet_size = M2TS_PACKET_LENGTH;
+    if (a < 0)
+      a = 32;
   } else {
-    packet_size = NORMAL_TS_PACKET_LENGTH;
-    if (align < 0)
-      align = 0;
+    *packet_size = NORMAL_TS_PACKET_LENGTH;
+    if (a < 0)
+      a = 0;
   }
 
-  av = gst_adapter_available (mux->out_adapter);
-  GST_LOG_OBJECT (mux, "align %d, av %d", align, av);
+  *align = a;
+}
 
-  if (!align)
-    align = av;
-  else
-    align *= packet_size;
+static MpegTsMuxSlab *
+mpegtsmux_slab_new (MpegTsMux * mux)
+{
+  MpegTsMuxSlab *slab;
+  GstBuffer *buf = NULL;
+  gint packet_size, align;
+  guint size;
+
+  mpegtsmux_get_packet_layout (mux, &packet_size, &align);
+  size = packet_size * (align ? align : MPEGTSMUX_SLAB_PACKETS);
+
+  if (mux->out_pool && mux->out_slab_size != size) {
+    gst_buffer_pool_set_active (mux->out_pool, FALSE);
+    gst_object_unref (mux->out_pool);
+    mux->out_pool = NULL;
+  }
 
-  /* FIXME: what about DTS here? */
-  GST_LOG_OBJECT (mux, "aligning to %d bytes", align);
-  if (G_LIKELY ((align <= av) && av)) {
-    GST_LOG_OBJECT (mux, "pushing %d aligned bytes", av - (av % align));
-    ts = gst_adapter_prev_pts (mux->out_adapter, NULL);
-    buf = gst_adapter_take_buffer (mux->out_adapter, av - (av % align));
-    g_assert (buf);
-    GST_BUFFER_PTS (buf) = ts;
+  if (!mux->out_pool) {
+    GstStructure *config;
+
+    GST_DEBUG_OBJECT (mux, "creating pool for slabs of %u bytes", size);
+    mux->out_pool = gst_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (mux->out_pool);
+    gst_buffer_pool_config_set_params (config, NULL, size, 0, 0);
+    if (!gst_buffer_pool_set_config (mux->out_pool, config) ||
+        !gst_buffer_pool_set_active (mux->out_pool, TRUE)) {
+      gst_object_unref (mux->out_pool);
+      mux->out_pool = NULL;
+      goto no_buffer;
+    }
+    mux->out_slab_size = size;
+  }
 
-    ret = gst_pad_push (mux->srcpad, buf);
-    av = av % align;
+  if (gst_buffer_pool_acquire_buffer (mux->out_pool, &buf,
+          NULL) != GST_FLOW_OK)
+    goto no_buffer;
+
+  /* a partial slab pushed on drain may come back shrunk */
+  gst_buffer_set_size (buf, size);
+
+  slab = g_slice_new (MpegTsMuxSlab);
+  slab->buffer = buf;
+  slab->size = 0;
+  if (!gst_buffer_map (buf, &slab->map, GST_MAP_WRITE)) {
+    gst_buffer_unref (buf);
+    g_slice_free (MpegTsMuxSlab, slab);
+    goto no_buffer;
   }
 
-  if (av && force) {
-    guint8 *data;
-    guint32 header;
-    gint dummy;
-    GstMapInfo map;
+  return slab;
 
-    GST_LOG_OBJECT (mux, "handling %d leftover bytes", av);
-    buf = gst_buffer_new_and_alloc (align);
-    gst_buffer_map (buf, &map, GST_MAP_READ);
-    data = map.data;
-    ts = gst_adapter_prev_pts (mux->out_adapter, NULL);
+  /* ERRORS */
+no_buffer:
+  {
+    GST_WARNING_OBJECT (mux, "failed to get output slab of %u bytes", size);
+    return NULL;
+  }
+}
 
-    gst_adapter_copy (mux->out_adapter, data, 0, av);
-    gst_adapter_clear (mux->out_adapter);
-    GST_BUFFER_PTS (buf) = ts;
+static void
+mpegtsmux_slab_free (MpegTsMuxSlab * slab)
+{
+  gst_buffer_unmap (slab->buffer, &slab->map);
+  gst_buffer_unref (slab->buffer);
+  g_slice_free (MpegTsMuxSlab, slab);
+}
 
-    data += av;
-    header = GST_READ_UINT32_BE (data - packet_size);
+/* Unmap @slab and return its buffer, trimmed to the written packets */
+static GstBuffer *
+mpegtsmux_slab_take_buffer (MpegTsMuxSlab * slab)
+{
+  GstBuffer *buf = slab->buffer;
+  gsize size = slab->size;
 
-    dummy = (map.size - av) / packet_size;
-    GST_LOG_OBJECT (mux, "adding %d null packets", dummy);
+  gst_buffer_unmap (buf, &slab->map);
+  if (size < gst_buffer_get_size (buf))
+    gst_buffer_set_size (buf, size);
+  g_slice_free (MpegTsMuxSlab, slab);
 
-    for (; dummy > 0; dummy--) {
-      gint offset;
+  return buf;
+}
 
-      if (packet_size > NORMAL_TS_PACKET_LENGTH) {
-        GST_WRITE_UINT32_BE (data, header);
-        /* simply increase header a bit and never mind too much */
-        header++;
-        offset = 4;
-      } else {
-        offset = 0;
-      }
-      GST_WRITE_UINT8 (data + offset, TSMUX_SYNC_BYTE);
-      /* null packet PID */
-      GST_WRITE_UINT16_BE (data + offset + 1, 0x1FFF);
-      /* no adaptation field exists | continuity counter undefined */
-      GST_WRITE_UINT8 (data + offset + 3, 0x10);
-      /* payload */
-      memset (data + offset + 4, 0, NORMAL_TS_PACKET_LENGTH - 4);
-      data += packet_size;
-    }
+/* Fill up the rest of @slab with null packets */
+static void
+mpegtsmux_slab_pad (MpegTsMux * mux, MpegTsMuxSlab * slab, gint packet_size)
+{
+  guint8 *data;
+  guint32 header;
+  gint dummy;
 
-    gst_buffer_unmap (buf, &map);
+  data = slab->map.data + slab->size;
+  header = GST_READ_UINT32_BE (data - packet_size);
 
-    ret = gst_pad_push (mux->srcpad, buf);
+  dummy = (slab->map.size - slab->size) / packet_size;
+  GST_LOG_OBJECT (mux, "adding %d null packets", dummy);
+
+  for (; dummy > 0; dummy--) {
+    gint offset;
+
+    if (packet_size > NORMAL_TS_PACKET_LENGTH) {
+      GST_WRITE_UINT32_BE (data, header);
+      /* simply increase header a bit and never mind too much */
+      header++;
+      offset = 4;
+    } else {
+      offset = 0;
+    }
+    GST_WRITE_UINT8 (data + offset, TSMUX_SYNC_BYTE);
+    /* null packet PID */
+    GST_WRITE_UINT16_BE (data + offset + 1, 0x1FFF);
+    /* no adaptation field exists | continuity counter undefined */
+    GST_WRITE_UINT8 (data + offset + 3, 0x10);
+    /* payload */
+    memset (data + offset + 4, 0, NORMAL_TS_PACKET_LENGTH - 4);
+    data += packet_size;
   }
 
-  return ret;
+  slab->size = data - slab->map.data;
 }
 
 static GstFlowReturn
-mpegtsmux_collect_packet (MpegTsMux * mux, GstBuffer * buf)
+mpegtsmux_push_packets (MpegTsMux * mux, gboolean force)
 {
-  GST_LOG_OBJECT (mux, "collecting packet size %" G_GSIZE_FORMAT,
-      gst_buffer_get_size (buf));
-  gst_adapter_push (mux->out_adapter, buf);
+  MpegTsMuxSlab *slab;
+  GstBufferList *list = NULL;
+  GstBuffer *buf = NULL;
+  GstFlowReturn ret = GST_FLOW_OK;
+  gint packet_size, align;
+  guint complete = 0;
+  GList *walk;
 
-  return GST_FLOW_OK;
+  mpegtsmux_get_packet_layout (mux, &packet_size, &align);
+
+  /* packets still waiting for their m2ts timestamp are the most recent
+   * ones, everything written before them is ready to go */
+  for (walk = mux->out_slabs.head; walk; walk = walk->next)
+    complete += ((MpegTsMuxSlab *) walk->data)->size / packet_size;
+  complete -= mux->m2ts_pending;
+
+  GST_LOG_OBJECT (mux, "align %d, %u complete packets", align, complete);
+
+  while ((slab = g_queue_peek_head (&mux->out_slabs))) {
+    guint n_packets = slab->size / packet_size;
+    gboolean full = (slab->size == slab->map.size);
+
+    if (slab->size == 0 || n_packets > complete)
+      break;
+    if (!full && align && !force)
+      break;
+
+    g_queue_pop_head (&mux->out_slabs);
+    complete -= n_packets;
+
+    if (!full && align)
+      mpegtsmux_slab_pad (mux, slab, packet_size);
+
+    /* several slabs ready at once go out in one list */
+    if (buf) {
+      if (!list)
+        list = gst_buffer_list_new ();
+      gst_buffer_list_add (list, buf);
+    }
+    buf = mpegtsmux_slab_take_buffer (slab);
+    GST_LOG_OBJECT (mux, "pushing slab of %" G_GSIZE_FORMAT " bytes",
+        gst_buffer_get_size (buf));
+  }
+
+  if (list) {
+    gst_buffer_list_add (list, buf);
+    ret = gst_pad_push_list (mux->srcpad, list);
+  } else if (buf) {
+    ret = gst_pad_push (mux->srcpad, buf);
+  }
+
+  return ret;
 }
 
 static gboolean
-new_packet_m2ts (MpegTsMux * mux, GstBuffer * buf, gint64 new_pcr)
+new_packet_m2ts (MpegTsMux * mux, guint8 * data, gint64 new_pcr)
 {
-  GstBuffer *out_buf;
-  int chunk_bytes;
-  GstMapInfo map;
+  gint chunk_bytes;
 
-  GST_LOG_OBJECT (mux, "Have buffer %p with new_pcr=%" G_GINT64_FORMAT,
-      buf, new_pcr);
+  GST_LOG_OBJECT (mux, "Have packet %p with new_pcr=%" G_GINT64_FORMAT,
+      data, new_pcr);
 
-  chunk_bytes = gst_adapter_available (mux->adapter);
+  chunk_bytes = mux->m2ts_pending * M2TS_PACKET_LENGTH;
 
-  if (G_LIKELY (buf)) {
+  if (G_LIKELY (data)) {
     if (new_pcr < 0) {
-      /* If there is no pcr in current ts packet then just add the packet
-         to the adapter for later output when we see a PCR */
+      /* If there is no pcr in current ts packet then just leave the packet
+         pending in the slab until we see a PCR */
       GST_LOG_OBJECT (mux, "Accumulating non-PCR packet");
-      gst_adapter_push (mux->adapter, buf);
+      mux->m2ts_pending++;
       goto exit;
     }
 
@@ -1488,7 +1575,7 @@ new_packet_m2ts (MpegTsMux * mux, GstBuffer * buf, gint64 new_pcr)
       mux->previous_pcr = new_pcr;
       mux->previous_offset = chunk_bytes;
       GST_LOG_OBJECT (mux, "Accumulating non-PCR packet");
-      gst_adapter_push (mux->adapter, buf);
+      mux->m2ts_pending++;
       goto exit;
     }
   } else {
@@ -1498,6 +1585,10 @@ new_packet_m2ts (MpegTsMux * mux, GstBuffer * buf, gint64 new_pcr)
   /* interpolate if needed, and 2 points available */
   if (chunk_bytes && (new_pcr != mux->previous_pcr)) {
     gint64 offset = 0;
+    GList *walk;
+    MpegTsMuxSlab *slab;
+    gsize pos;
+    guint n;
 
     GST_LOG_OBJECT (mux, "Processing pending packets; "
         "previous pcr %" G_GINT64_FORMAT ", previous offset %d, "
@@ -1512,11 +1603,30 @@ new_packet_m2ts (MpegTsMux * mux, GstBuffer * buf, gint64 new_pcr)
       mux->pcr_rate_den = chunk_bytes - mux->previous_offset;
     }
 
-    while (offset < chunk_bytes) {
-      guint64 cur_pcr, ts;
+    /* the pending packets are the last ones committed to the slabs,
+     * rewind to the first of them */
+    walk = mux->out_slabs.tail;
+    slab = walk->data;
+    pos = slab->size;
+    for (n = mux->m2ts_pending; n > 0; n--) {
+      if (pos == 0) {
+        walk = walk->prev;
+        slab = walk->data;
+        pos = slab->size;
+      }
+      pos -= M2TS_PACKET_LENGTH;
+    }
 
-      /* Loop, pulling packets of the adapter, updating their 4 byte
-       * timestamp header and pushing */
+    while (offset < chunk_bytes) {
+      guint64 cur_pcr;
+
+      /* Loop over the pending packets, updating their 4 byte
+       * timestamp header in place */
+      if (pos == slab->size) {
+        walk = walk->next;
+        slab = walk->data;
+        pos = 0;
+      }
 
       /* interpolate PCR */
       if (G_LIKELY (offset >= mux->previous_offset))
@@ -1528,41 +1638,28 @@ new_packet_m2ts (MpegTsMux * mux, GstBuffer * buf, gint64 new_pcr)
             gst_util_uint64_scale (mux->previous_offset - offset,
             mux->pcr_rate_num, mux->pcr_rate_den);
 
-      /* FIXME: what about DTS here? */
-      ts = gst_adapter_prev_pts (mux->adapter, NULL);
-      out_buf = gst_adapter_take_buffer (mux->adapter, M2TS_PACKET_LENGTH);
-      g_assert (out_buf);
-      offset += M2TS_PACKET_LENGTH;
-
-      GST_BUFFER_PTS (out_buf) = ts;
-
-      gst_buffer_map (out_buf, &map, GST_MAP_WRITE);
-
       /* The header is the bottom 30 bits of the PCR, apparently not
        * encoded into base + ext as in the packets themselves */
-      GST_WRITE_UINT32_BE (map.data, cur_pcr & 0x3FFFFFFF);
-      gst_buffer_unmap (out_buf, &map);
+      GST_WRITE_UINT32_BE (slab->map.data + pos, cur_pcr & 0x3FFFFFFF);
+      pos += M2TS_PACKET_LENGTH;
+      offset += M2TS_PACKET_LENGTH;
 
       GST_LOG_OBJECT (mux, "Outputting a packet of length %d PCR %"
           G_GUINT64_FORMAT, M2TS_PACKET_LENGTH, cur_pcr);
-      mpegtsmux_collect_packet (mux, out_buf);
     }
+
+    mux->m2ts_pending = 0;
   }
 
-  if (G_UNLIKELY (!buf))
+  if (G_UNLIKELY (!data))
     goto exit;
 
-  gst_buffer_map (buf, &map, GST_MAP_WRITE);
-
   /* Finally, output the passed in packet */
   /* Only write the bottom 30 bits of the PCR */
-  GST_WRITE_UINT32_BE (map.data, new_pcr & 0x3FFFFFFF);
-
-  gst_buffer_unmap (buf, &map);
+  GST_WRITE_UINT32_BE (data, new_pcr & 0x3FFFFFFF);
 
   GST_LOG_OBJECT (mux, "Outputting a packet of length %d PCR %"
       G_GUINT64_FORMAT, M2TS_PACKET_LENGTH, new_pcr);
-  mpegtsmux_collect_packet (mux, buf);
 
   if (new_pcr != mux->previous_pcr) {
     mux->previous_pcr = new_pcr;
@@ -1573,62 +1670,69 @@ exit:
   return TRUE;
 }
 
-/* Called when the TsMux has prepared a packet for output. Return FALSE
- * on error */
+/* Called when the TsMux has written a packet into the storage handed out
+ * by alloc_packet_cb. Return FALSE on error */
 static gboolean
-new_packet_cb (GstBuffer * buf, void *user_data, gint64 new_pcr)
+new_packet_cb (guint8 * packet, void *user_data, gint64 new_pcr)
 {
   MpegTsMux *mux = (MpegTsMux *) user_data;
+  MpegTsMuxSlab *slab;
   gint offset = 0;
-  GstMapInfo map;
+  gboolean ret = TRUE;
 
 #if 0
   GST_LOG_OBJECT (mux, "handling packet %d", mux->spn_count);
   mux->spn_count++;
 #endif
 
-  if (mux->m2ts_mode) {
+  if (mux->m2ts_mode)
     offset = 4;
-    gst_buffer_set_size (buf, NORMAL_TS_PACKET_LENGTH + offset);
-  }
 
-  gst_buffer_map (buf, &map, GST_MAP_READWRITE);
+  slab = g_queue_peek_tail (&mux->out_slabs);
+  g_assert (slab && packet == slab->map.data + slab->size + offset);
 
-  if (offset) {
-    /* there should be a better way to do this */
-    memmove (map.data + offset, map.data, map.size - offset);
-  }
+  if (slab->size == 0)
+    GST_BUFFER_PTS (slab->buffer) = mux->last_ts;
 
-  GST_BUFFER_PTS (buf) = mux->last_ts;
   /* do common init (flags and streamheaders) */
-  new_packet_common_init (mux, buf, map.data + offset, map.size);
-
-  gst_buffer_unmap (buf, &map);
+  new_packet_common_init (mux, slab->size == 0 ? slab->buffer : NULL,
+      packet - offset, offset);
 
   /* all is meant for downstream, including any prefix */
   if (offset)
-    return new_packet_m2ts (mux, buf, new_pcr);
-  else
-    mpegtsmux_collect_packet (mux, buf);
+    ret = new_packet_m2ts (mux, packet - offset, new_pcr);
 
-  return TRUE;
+  slab->size += NORMAL_TS_PACKET_LENGTH + offset;
+
+  return ret;
 }
 
-/* called when TsMux needs new packet to write into */
-static void
-alloc_packet_cb (GstBuffer ** _buf, void *user_data)
+/* called when TsMux needs storage for a new packet to write into */
+static guint8 *
+alloc_packet_cb (void *user_data)
 {
   MpegTsMux *mux = (MpegTsMux *) user_data;
-  GstBuffer *buf;
+  MpegTsMuxSlab *slab;
+  guint8 *data;
   gint offset = 0;
 
   if (mux->m2ts_mode == TRUE)
     offset = 4;
 
-  buf = gst_buffer_new_and_alloc (NORMAL_TS_PACKET_LENGTH + offset);
-  gst_buffer_set_size (buf, NORMAL_TS_PACKET_LENGTH);
+  slab = g_queue_peek_tail (&mux->out_slabs);
+  if (!slab || slab->size + NORMAL_TS_PACKET_LENGTH + offset > slab->map.size) {
+    slab = mpegtsmux_slab_new (mux);
+    if (G_UNLIKELY (slab == NULL))
+      return NULL;
+    g_queue_push_tail (&mux->out_slabs, slab);
+  }
+
+  data = slab->map.data + slab->size;
+  /* reserve the m2ts prefix, filled in once the timestamp is known */
+  if (offset)
+    memset (data, 0, offset);
 
-  *_buf = buf;
+  return data + offset;
 }
 
 static void
@@ -118,6 +118,7 @@ G_BEGIN_DECLS
 typedef struct MpegTsMux MpegTsMux;
 typedef struct MpegTsMuxClass MpegTsMuxClass;
 typedef struct MpegTsPadData MpegTsPadData;
+typedef struct MpegTsMuxSlab MpegTsMuxSlab;
 
 typedef GstBuffer * (*MpegTsPadDataPrepareFunction) (GstBuffer * buf,
     MpegTsPadData * data, MpegTsMux * mux);
@@ -159,11 +160,14 @@ struct MpegTsMux {
   gint64 previous_offset;
   gint64 pcr_rate_num;
   gint64 pcr_rate_den;
-  GstAdapter *adapter;
+  /* number of most recent packets still waiting for their timestamp */
+  guint m2ts_pending;
 
-  /* output buffer aggregation */
-  GstAdapter *out_adapter;
-  GstBuffer *out_buffer;
+  /* output buffer aggregation: packets are written straight into pooled
+   * slabs of alignment packets, the tail of out_slabs is being filled */
+  GstBufferPool *out_pool;
+  guint out_slab_size;
+  GQueue out_slabs;
 
 #if 0
   /* SPN/PTS index handling */
@@ -172,6 +176,14 @@ struct MpegTsMux {
 #endif
 };
 
+struct MpegTsMuxSlab {
+  GstBuffer *buffer;
+  /* kept mapped while TsMux writes into it */
+  GstMapInfo map;
+  /* bytes of complete packets written so far */
+  gsize size;
+};
+
 struct MpegTsMuxClass {
   GstElementClass parent_class;
 };
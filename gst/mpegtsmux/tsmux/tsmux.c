@@ -181,7 +181,9 @@ tsmux_set_write_func (TsMux * mux, TsMuxWriteFunc func, void *user_data)
  * @user_data: user data passed to @func
  *
  * Set the callback function and user data to be called when @mux needs
- * a new buffer to write a packet into.
+ * storage to write a packet into. The returned memory must hold at least
+ * TSMUX_PACKET_LENGTH bytes and stay valid until it has been handed to the
+ * write function.
  * @user_data will be passed as user data in @func.
  */
 void
@@ -565,33 +567,22 @@ tsmux_find_stream (TsMux * mux, guint16 pid)
   return found;
 }
 
-static gboolean
-tsmux_get_buffer (TsMux * mux, GstBuffer ** buf)
+static guint8 *
+tsmux_get_packet (TsMux * mux)
 {
-  g_return_val_if_fail (buf, FALSE);
-
   if (G_UNLIKELY (!mux->alloc_func))
-    return FALSE;
-
-  mux->alloc_func (buf, mux->alloc_func_data);
-
-  if (!*buf)
-    return FALSE;
+    return NULL;
 
-  g_assert (gst_buffer_get_size (*buf) == TSMUX_PACKET_LENGTH);
-  return TRUE;
+  return mux->alloc_func (mux->alloc_func_data);
 }
 
 static gboolean
-tsmux_packet_out (TsMux * mux, GstBuffer * buf, gint64 pcr)
+tsmux_packet_out (TsMux * mux, guint8 * packet, gint64 pcr)
 {
-  if (G_UNLIKELY (mux->write_func == NULL)) {
-    if (buf)
-      gst_buffer_unref (buf);
+  if (G_UNLIKELY (mux->write_func == NULL))
     return TRUE;
-  }
 
-  return mux->write_func (buf, mux->write_func_data, pcr);
+  return mux->write_func (packet, mux->write_func_data, pcr);
 }
 
 /*
@@ -845,9 +836,6 @@ static gboolean
 tsmux_section_write_packet (GstMpegTsSectionType * type,
     TsMuxSection * section, TsMux * mux)
 {
-  GstBuffer *section_buffer;
-  GstBuffer *packet_buffer = NULL;
-  GstMemory *mem;
   guint8 *packet;
   guint8 *data;
   gsize data_size = 0;
@@ -860,6 +848,7 @@ tsmux_section_write_packet (GstMpegTsSectionType * type,
   /* Mark the start of new PES unit */
   section->pi.packet_start_unit_indicator = TRUE;
 
+  /* The data will be freed when the GstMpegTsSection is destroyed */
   data = gst_mpegts_section_packetize (section->section, &data_size);
 
   if (!data) {
@@ -871,24 +860,20 @@ tsmux_section_write_packet (GstMpegTsSectionType * type,
   section->pi.stream_avail = data_size;
   payload_written = 0;
 
-  /* Wrap section data in a buffer without free function.
-     The data will be freed when the GstMpegTsSection is destroyed. */
-  section_buffer = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
-      data, data_size, 0, data_size, NULL, NULL);
-
-  TS_DEBUG ("Section buffer with size %" G_GSIZE_FORMAT " created",
-      gst_buffer_get_size (section_buffer));
+  TS_DEBUG ("Section data with size %" G_GSIZE_FORMAT " created", data_size);
 
   while (section->pi.stream_avail > 0) {
 
-    packet = g_malloc (TSMUX_PACKET_LENGTH);
+    packet = tsmux_get_packet (mux);
+    if (G_UNLIKELY (packet == NULL))
+      return FALSE;
 
     if (section->pi.packet_start_unit_indicator) {
       /* Wee need room for a pointer byte */
       section->pi.stream_avail++;
 
       if (!tsmux_write_ts_header (packet, &section->pi, &len, &offset))
-        goto fail;
+        return FALSE;
 
       /* Write the pointer byte */
       packet[offset++] = 0x00;
@@ -896,50 +881,28 @@ tsmux_section_write_packet (GstMpegTsSectionType * type,
 
     } else {
       if (!tsmux_write_ts_header (packet, &section->pi, &len, &offset))
-        goto fail;
+        return FALSE;
       payload_len = len;
     }
 
-    /* Wrap the TS header and adaption field in a GstMemory */
-    mem = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY,
-        packet, TSMUX_PACKET_LENGTH, 0, offset, packet, g_free);
-
-    TS_DEBUG ("Creating packet buffer at offset "
+    TS_DEBUG ("Creating packet at offset "
         "%" G_GSIZE_FORMAT " with length %u", payload_written, payload_len);
 
-    packet_buffer = gst_buffer_copy_region (section_buffer, GST_BUFFER_COPY_ALL,
-        payload_written, payload_len);
-
-    /* Prepend the header to the section data */
-    gst_buffer_prepend_memory (packet_buffer, mem);
+    memcpy (packet + offset, data + payload_written, payload_len);
 
     TS_DEBUG ("Writing %d bytes to section. %d bytes remaining",
         len, section->pi.stream_avail - len);
 
     /* Push the packet without PCR */
-    if G_UNLIKELY
-      (!tsmux_packet_out (mux, packet_buffer, -1)) {
-      /* Buffer given away */
-      packet_buffer = NULL;
-      goto fail;
-      }
+    if (G_UNLIKELY (!tsmux_packet_out (mux, packet, -1)))
+      return FALSE;
 
-    packet_buffer = NULL;
     section->pi.stream_avail -= len;
     payload_written += payload_len;
     section->pi.packet_start_unit_indicator = FALSE;
   }
 
-  gst_buffer_unref (section_buffer);
-
   return TRUE;
-
-fail:
-  if (packet)
-    g_free (packet);
-  if (section_buffer)
-    gst_buffer_unref (section_buffer);
-  return FALSE;
 }
 
 static gboolean
@@ -970,8 +933,7 @@ tsmux_write_stream_packet (TsMux * mux, TsMuxStream * stream)
   TsMuxPacketInfo *pi = &stream->pi;
   gboolean res;
   gint64 cur_pcr = -1;
-  GstBuffer *buf = NULL;
-  GstMapInfo map;
+  guint8 *packet;
 
   g_return_val_if_fail (mux != NULL, FALSE);
   g_return_val_if_fail (stream != NULL, FALSE);
@@ -1067,36 +1029,23 @@ tsmux_write_stream_packet (TsMux * mux, TsMuxStream * stream)
   }
   pi->stream_avail = tsmux_stream_bytes_avail (stream);
 
-  /* obtain buffer */
-  if (!tsmux_get_buffer (mux, &buf))
+  /* obtain packet storage */
+  packet = tsmux_get_packet (mux);
+  if (G_UNLIKELY (packet == NULL))
     return FALSE;
 
-  gst_buffer_map (buf, &map, GST_MAP_READ);
-
-  if (!tsmux_write_ts_header (map.data, pi, &payload_len, &payload_offs))
-    goto fail;
-
-
-  if (!tsmux_stream_get_data (stream, map.data + payload_offs, payload_len))
-    goto fail;
+  if (!tsmux_write_ts_header (packet, pi, &payload_len, &payload_offs))
+    return FALSE;
 
-  gst_buffer_unmap (buf, &map);
+  if (!tsmux_stream_get_data (stream, packet + payload_offs, payload_len))
+    return FALSE;
 
-  res = tsmux_packet_out (mux, buf, cur_pcr);
+  res = tsmux_packet_out (mux, packet, cur_pcr);
 
   /* Reset all dynamic flags */
   stream->pi.flags &= TSMUX_PACKET_FLAG_PES_FULL_HEADER;
 
   return res;
-
-  /* ERRORS */
-fail:
-  {
-    gst_buffer_unmap (buf, &map);
-    if (buf)
-      gst_buffer_unref (buf);
-    return FALSE;
-  }
 }
 
 /**
@@ -100,8 +100,11 @@ G_BEGIN_DECLS
 typedef struct TsMuxSection TsMuxSection;
 typedef struct TsMux TsMux;
 
-typedef gboolean (*TsMuxWriteFunc) (GstBuffer * buf, void *user_data, gint64 new_pcr);
-typedef void (*TsMuxAllocFunc) (GstBuffer ** buf, void *user_data);
+/* Packets are written in place: the alloc function hands out storage for
+ * one TSMUX_PACKET_LENGTH packet, which is only considered written once it
+ * is passed back to the write function */
+typedef gboolean (*TsMuxWriteFunc) (guint8 * packet, void *user_data, gint64 new_pcr);
+typedef guint8 * (*TsMuxAllocFunc) (void *user_data);
 
 struct TsMuxSection {
   TsMuxPacketInfo pi;
@@ -172,7 +175,7 @@ struct TsMux {
   /* callback to write finished packet */
   TsMuxWriteFunc write_func;
   void *write_func_data;
-  /* callback to alloc new packet buffer */
+  /* callback to get storage for the next packet */
   TsMuxAllocFunc alloc_func;
   void *alloc_func_data;
 
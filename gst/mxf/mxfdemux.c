@@ -31,7 +31,7 @@
  */
 
 /* TODO:
- *   - Seeking support: Use IndexTableSegments
+ *   - Use IndexTableSegments for seeking in push mode too
  *   - Handle timecode tracks correctly (where is this documented?)
  *   - Handle drop-frame field of timecode tracks
  *   - Handle Generic container system items
@@ -112,7 +112,8 @@ enum
   PROP_0,
   PROP_PACKAGE,
   PROP_MAX_DRIFT,
-  PROP_STRUCTURE
+  PROP_STRUCTURE,
+  PROP_LAZY_METADATA
 };
 
 static gboolean gst_mxf_demux_sink_event (GstPad * pad, GstObject * parent,
@@ -148,6 +149,30 @@ gst_mxf_demux_partition_free (GstMXFDemuxPartition * partition)
   g_free (partition);
 }
 
+typedef struct
+{
+  MXFUL key;
+  GstBuffer *buffer;
+  guint64 offset;
+  GstMXFDemuxPartition *partition;
+} GstMXFDemuxDeferredMetadata;
+
+static void
+gst_mxf_demux_deferred_metadata_free (GstMXFDemuxDeferredMetadata * deferred)
+{
+  gst_buffer_unref (deferred->buffer);
+  g_free (deferred);
+}
+
+static void
+gst_mxf_demux_clear_deferred_metadata (GstMXFDemux * demux)
+{
+  g_list_foreach (demux->deferred_descriptive_metadata,
+      (GFunc) gst_mxf_demux_deferred_metadata_free, NULL);
+  g_list_free (demux->deferred_descriptive_metadata);
+  demux->deferred_descriptive_metadata = NULL;
+}
+
 static void
 gst_mxf_demux_reset_mxf_state (GstMXFDemux * demux)
 {
@@ -223,6 +248,8 @@ gst_mxf_demux_reset_metadata (GstMXFDemux * demux)
   }
   demux->metadata = mxf_metadata_hash_table_new ();
 
+  gst_mxf_demux_clear_deferred_metadata (demux);
+
   if (demux->tags) {
     gst_tag_list_unref (demux->tags);
     demux->tags = NULL;
@@ -242,6 +269,7 @@ gst_mxf_demux_reset (GstMXFDemux * demux)
   demux->offset = 0;
 
   demux->pull_footer_metadata = TRUE;
+  demux->metadata_deferred = TRUE;
 
   demux->run_in = -1;
 
@@ -263,17 +291,18 @@ gst_mxf_demux_reset (GstMXFDemux * demux)
     demux->random_index_pack = NULL;
   }
 
-  if (demux->pending_index_table_segments) {
+  if (demux->index_table_segments) {
     GList *l;
 
-    for (l = demux->pending_index_table_segments; l; l = l->next) {
+    for (l = demux->index_table_segments; l; l = l->next) {
       MXFIndexTableSegment *s = l->data;
       mxf_index_table_segment_reset (s);
       g_free (s);
     }
-    g_list_free (demux->pending_index_table_segments);
-    demux->pending_index_table_segments = NULL;
+    g_list_free (demux->index_table_segments);
+    demux->index_table_segments = NULL;
   }
+  demux->index_table_segments_collected = FALSE;
 
   gst_mxf_demux_reset_mxf_state (demux);
   gst_mxf_demux_reset_metadata (demux);
@@ -528,7 +557,29 @@ gst_mxf_demux_resolve_references (GstMXFDemux * demux)
 
   g_hash_table_iter_init (&iter, demux->metadata);
   while (g_hash_table_iter_next (&iter, NULL, (gpointer) & m)) {
-    m->resolved = MXF_METADATA_BASE_RESOLVE_STATE_NONE;
+    /* The DM frameworks referenced by DM segments are not parsed yet,
+     * don't try to resolve them before the deferred metadata is */
+    if (demux->lazy_metadata && demux->metadata_deferred
+        && MXF_IS_METADATA_DM_SEGMENT (m))
+      m->resolved = MXF_METADATA_BASE_RESOLVE_STATE_SUCCESS;
+    else
+      m->resolved = MXF_METADATA_BASE_RESOLVE_STATE_NONE;
+  }
+
+  if (demux->lazy_metadata && demux->metadata_deferred) {
+    /* Only resolve what is reachable from the preface, that is everything
+     * required to set up the essence tracks */
+    if (!demux->preface
+        || !mxf_metadata_base_resolve (MXF_METADATA_BASE (demux->preface),
+            demux->metadata)) {
+      ret = GST_FLOW_ERROR;
+      goto error;
+    }
+
+    demux->metadata_resolved = TRUE;
+    g_rw_lock_writer_unlock (&demux->metadata_lock);
+
+    return ret;
   }
 
   g_hash_table_iter_init (&iter, demux->metadata);
@@ -557,6 +608,23 @@ gst_mxf_demux_resolve_references (GstMXFDemux * demux)
 
   gst_structure_free (structure);
 
+  /* With lazy-metadata the pads were created before the structure
+   * was known, send it with the next buffer */
+  if (demux->lazy_metadata) {
+    guint i;
+
+    for (i = 0; i < demux->src->len; i++) {
+      GstMXFDemuxPad *pad = g_ptr_array_index (demux->src, i);
+
+      if (pad->tags)
+        gst_tag_list_unref (pad->tags);
+      pad->tags = gst_tag_list_copy (demux->tags);
+      if (pad->current_essence_track && pad->current_essence_track->tags)
+        gst_tag_list_insert (pad->tags, pad->current_essence_track->tags,
+            GST_TAG_MERGE_REPLACE);
+    }
+  }
+
   g_rw_lock_writer_unlock (&demux->metadata_lock);
 
   return ret;
@@ -1376,7 +1444,7 @@ gst_mxf_demux_handle_metadata (GstMXFDemux * demux, const MXFUL * key,
 }
 
 static GstFlowReturn
-gst_mxf_demux_handle_descriptive_metadata (GstMXFDemux * demux,
+gst_mxf_demux_add_descriptive_metadata (GstMXFDemux * demux,
     const MXFUL * key, GstBuffer * buffer)
 {
   guint32 type;
@@ -1388,26 +1456,6 @@ gst_mxf_demux_handle_descriptive_metadata (GstMXFDemux * demux,
   scheme = GST_READ_UINT8 (key->u + 12);
   type = GST_READ_UINT24_BE (key->u + 13);
 
-  GST_DEBUG_OBJECT (demux,
-      "Handling descriptive metadata of size %" G_GSIZE_FORMAT " at offset %"
-      G_GUINT64_FORMAT " with scheme 0x%02x and type 0x%06x",
-      gst_buffer_get_size (buffer), demux->offset, scheme, type);
-
-  if (G_UNLIKELY (!demux->current_partition)) {
-    GST_ERROR_OBJECT (demux, "Partition pack doesn't exist");
-    return GST_FLOW_ERROR;
-  }
-
-  if (G_UNLIKELY (!demux->current_partition->primer.mappings)) {
-    GST_ERROR_OBJECT (demux, "Primer pack doesn't exists");
-    return GST_FLOW_ERROR;
-  }
-
-  if (demux->current_partition->parsed_metadata) {
-    GST_DEBUG_OBJECT (demux, "Metadata of this partition was already parsed");
-    return GST_FLOW_OK;
-  }
-
   gst_buffer_map (buffer, &map, GST_MAP_READ);
   m = mxf_descriptive_metadata_new (scheme, type,
       &demux->current_partition->primer, demux->offset, map.data, map.size);
@@ -1463,6 +1511,98 @@ gst_mxf_demux_handle_descriptive_metadata (GstMXFDemux * demux,
   return ret;
 }
 
+static GstFlowReturn
+gst_mxf_demux_handle_descriptive_metadata (GstMXFDemux * demux,
+    const MXFUL * key, GstBuffer * buffer)
+{
+  guint32 type;
+  guint8 scheme;
+
+  scheme = GST_READ_UINT8 (key->u + 12);
+  type = GST_READ_UINT24_BE (key->u + 13);
+
+  GST_DEBUG_OBJECT (demux,
+      "Handling descriptive metadata of size %" G_GSIZE_FORMAT " at offset %"
+      G_GUINT64_FORMAT " with scheme 0x%02x and type 0x%06x",
+      gst_buffer_get_size (buffer), demux->offset, scheme, type);
+
+  if (G_UNLIKELY (!demux->current_partition)) {
+    GST_ERROR_OBJECT (demux, "Partition pack doesn't exist");
+    return GST_FLOW_ERROR;
+  }
+
+  if (G_UNLIKELY (!demux->current_partition->primer.mappings)) {
+    GST_ERROR_OBJECT (demux, "Primer pack doesn't exists");
+    return GST_FLOW_ERROR;
+  }
+
+  if (demux->current_partition->parsed_metadata) {
+    GST_DEBUG_OBJECT (demux, "Metadata of this partition was already parsed");
+    return GST_FLOW_OK;
+  }
+
+  if (demux->lazy_metadata && demux->metadata_deferred) {
+    GstMXFDemuxDeferredMetadata *deferred =
+        g_new0 (GstMXFDemuxDeferredMetadata, 1);
+
+    GST_DEBUG_OBJECT (demux, "Deferring descriptive metadata");
+
+    memcpy (&deferred->key, key, sizeof (MXFUL));
+    deferred->buffer = gst_buffer_ref (buffer);
+    deferred->offset = demux->offset;
+    deferred->partition = demux->current_partition;
+    demux->deferred_descriptive_metadata =
+        g_list_prepend (demux->deferred_descriptive_metadata, deferred);
+
+    return GST_FLOW_OK;
+  }
+
+  return gst_mxf_demux_add_descriptive_metadata (demux, key, buffer);
+}
+
+/* Called after essence was output. Once every pad has output its first
+ * buffer the deferred descriptive metadata is parsed and all metadata is
+ * resolved again with the next packet */
+static void
+gst_mxf_demux_resolve_deferred_metadata (GstMXFDemux * demux)
+{
+  guint64 old_offset = demux->offset;
+  GstMXFDemuxPartition *old_partition = demux->current_partition;
+  GList *l;
+  guint i;
+
+  for (i = 0; i < demux->src->len; i++) {
+    GstMXFDemuxPad *p = g_ptr_array_index (demux->src, i);
+
+    if (p->need_segment && !p->eos)
+      return;
+  }
+
+  GST_DEBUG_OBJECT (demux, "Resolving deferred metadata");
+
+  demux->metadata_deferred = FALSE;
+
+  demux->deferred_descriptive_metadata =
+      g_list_reverse (demux->deferred_descriptive_metadata);
+  for (l = demux->deferred_descriptive_metadata; l; l = l->next) {
+    GstMXFDemuxDeferredMetadata *deferred = l->data;
+
+    demux->offset = deferred->offset;
+    demux->current_partition = deferred->partition;
+    gst_mxf_demux_add_descriptive_metadata (demux, &deferred->key,
+        deferred->buffer);
+  }
+  gst_mxf_demux_clear_deferred_metadata (demux);
+
+  demux->offset = old_offset;
+  demux->current_partition = old_partition;
+
+  g_rw_lock_writer_lock (&demux->metadata_lock);
+  demux->update_metadata = TRUE;
+  gst_mxf_demux_reset_linked_metadata (demux);
+  g_rw_lock_writer_unlock (&demux->metadata_lock);
+}
+
 static GstFlowReturn
 gst_mxf_demux_handle_generic_container_system_item (GstMXFDemux * demux,
     const MXFUL * key, GstBuffer * buffer)
@@ -1619,6 +1759,42 @@ gst_mxf_demux_pad_set_component (GstMXFDemux * demux, GstMXFDemuxPad * pad,
   return ret;
 }
 
+/* Returns the position of the element at @offset in @offsets or -1 */
+static gint64
+gst_mxf_demux_find_index_position (GArray * offsets, guint64 offset)
+{
+  guint lo = 0, hi = offsets->len;
+  guint i;
+
+  /* The offsets grow with the position, but entries that are not
+   * known yet are 0 and require a linear search */
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+    GstMXFDemuxIndex *idx = &g_array_index (offsets, GstMXFDemuxIndex, mid);
+
+    if (idx->offset == 0)
+      break;
+    else if (idx->offset == offset)
+      return mid;
+    else if (idx->offset < offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo >= hi)
+    return -1;
+
+  for (i = 0; i < offsets->len; i++) {
+    GstMXFDemuxIndex *idx = &g_array_index (offsets, GstMXFDemuxIndex, i);
+
+    if (idx->offset != 0 && idx->offset == offset)
+      return i;
+  }
+
+  return -1;
+}
+
 static GstFlowReturn
 gst_mxf_demux_handle_generic_container_essence_element (GstMXFDemux * demux,
     const MXFUL * key, GstBuffer * buffer, gboolean peek)
@@ -1683,17 +1859,10 @@ gst_mxf_demux_handle_generic_container_essence_element (GstMXFDemux * demux,
   if (etrack->position == -1) {
     GST_DEBUG_OBJECT (demux,
         "Unknown essence track position, looking into index");
-    if (etrack->offsets) {
-      for (i = 0; i < etrack->offsets->len; i++) {
-        GstMXFDemuxIndex *idx =
-            &g_array_index (etrack->offsets, GstMXFDemuxIndex, i);
-
-        if (idx->offset != 0 && idx->offset == demux->offset - demux->run_in) {
-          etrack->position = i;
-          break;
-        }
-      }
-    }
+    if (etrack->offsets)
+      etrack->position =
+          gst_mxf_demux_find_index_position (etrack->offsets,
+          demux->offset - demux->run_in);
 
     if (etrack->position == -1) {
       GST_WARNING_OBJECT (demux, "Essence track position not in index");
@@ -1990,6 +2159,17 @@ gst_mxf_demux_handle_random_index_pack (GstMXFDemux * demux, const MXFUL * key,
   return GST_FLOW_OK;
 }
 
+static gint
+gst_mxf_demux_index_table_segment_compare (MXFIndexTableSegment * a,
+    MXFIndexTableSegment * b)
+{
+  if (a->body_sid != b->body_sid)
+    return (a->body_sid < b->body_sid) ? -1 : 1;
+  if (a->index_start_position != b->index_start_position)
+    return (a->index_start_position < b->index_start_position) ? -1 : 1;
+  return 0;
+}
+
 static GstFlowReturn
 gst_mxf_demux_handle_index_table_segment (GstMXFDemux * demux,
     const MXFUL * key, GstBuffer * buffer)
@@ -1997,6 +2177,8 @@ gst_mxf_demux_handle_index_table_segment (GstMXFDemux * demux,
   MXFIndexTableSegment *segment;
   GstMapInfo map;
   gboolean ret;
+  GList *l;
+  guint i;
 
   GST_DEBUG_OBJECT (demux,
       "Handling index table segment of size %" G_GSIZE_FORMAT " at offset %"
@@ -2015,24 +2197,57 @@ gst_mxf_demux_handle_index_table_segment (GstMXFDemux * demux,
 
   if (!ret) {
     GST_ERROR_OBJECT (demux, "Parsing index table segment failed");
+    g_free (segment);
     return GST_FLOW_ERROR;
   }
 
-  demux->pending_index_table_segments =
-      g_list_prepend (demux->pending_index_table_segments, segment);
+  /* Index table segments are usually repeated in later partitions,
+   * only keep the most complete copy of each */
+  for (l = demux->index_table_segments; l; l = l->next) {
+    MXFIndexTableSegment *tmp = l->data;
+
+    if (gst_mxf_demux_index_table_segment_compare (tmp, segment) != 0)
+      continue;
+
+    if (tmp->n_index_entries >= segment->n_index_entries &&
+        tmp->index_duration >= segment->index_duration) {
+      GST_DEBUG_OBJECT (demux, "Index table segment already known");
+      mxf_index_table_segment_reset (segment);
+      g_free (segment);
+      return GST_FLOW_OK;
+    }
 
+    GST_DEBUG_OBJECT (demux, "Replacing incomplete index table segment");
+    mxf_index_table_segment_reset (tmp);
+    g_free (tmp);
+    demux->index_table_segments =
+        g_list_delete_link (demux->index_table_segments, l);
+    break;
+  }
+
+  demux->index_table_segments =
+      g_list_insert_sorted (demux->index_table_segments, segment,
+      (GCompareFunc) gst_mxf_demux_index_table_segment_compare);
+
+  /* Resolve the index of the affected tracks again on the next lookup */
+  for (i = 0; i < demux->essence_tracks->len; i++) {
+    GstMXFDemuxEssenceTrack *etrack =
+        &g_array_index (demux->essence_tracks, GstMXFDemuxEssenceTrack, i);
+
+    if (etrack->body_sid == segment->body_sid)
+      etrack->index_resolved = FALSE;
+  }
 
   return GST_FLOW_OK;
 }
 
+/* Pulls the key and the BER encoded length of the KLV packet at @offset */
 static GstFlowReturn
-gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
-    GstBuffer ** outbuf, guint * read)
+gst_mxf_demux_peek_klv_packet (GstMXFDemux * demux, guint64 offset,
+    MXFUL * key, guint * data_offset, guint64 * length)
 {
   GstBuffer *buffer = NULL;
   const guint8 *data;
-  guint64 data_offset = 0;
-  guint64 length;
   GstFlowReturn ret = GST_FLOW_OK;
   GstMapInfo map;
 #ifndef GST_DISABLE_GST_DEBUG
@@ -2055,12 +2270,12 @@ gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
 
   /* Decode BER encoded packet length */
   if ((map.data[16] & 0x80) == 0) {
-    length = map.data[16];
-    data_offset = 17;
+    *length = map.data[16];
+    *data_offset = 17;
   } else {
     guint slen = map.data[16] & 0x7f;
 
-    data_offset = 16 + 1 + slen;
+    *data_offset = 16 + 1 + slen;
 
     gst_buffer_unmap (buffer, &map);
     gst_buffer_unref (buffer);
@@ -2081,17 +2296,39 @@ gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
     gst_buffer_map (buffer, &map, GST_MAP_READ);
 
     data = map.data;
-    length = 0;
+    *length = 0;
     while (slen) {
-      length = (length << 8) | *data;
+      *length = (*length << 8) | *data;
       data++;
       slen--;
     }
   }
 
   gst_buffer_unmap (buffer, &map);
-  gst_buffer_unref (buffer);
-  buffer = NULL;
+
+beach:
+  if (buffer)
+    gst_buffer_unref (buffer);
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
+    GstBuffer ** outbuf, guint * read)
+{
+  GstBuffer *buffer = NULL;
+  guint data_offset = 0;
+  guint64 length;
+  GstFlowReturn ret = GST_FLOW_OK;
+#ifndef GST_DISABLE_GST_DEBUG
+  gchar str[48];
+#endif
+
+  if ((ret =
+          gst_mxf_demux_peek_klv_packet (demux, offset, key, &data_offset,
+              &length)) != GST_FLOW_OK)
+    goto beach;
 
   /* GStreamer's buffer sizes are stored in a guint so we
    * limit ourself to G_MAXUINT large buffers */
@@ -2430,6 +2667,9 @@ gst_mxf_demux_handle_klv_packet (GstMXFDemux * demux, const MXFUL * key,
     ret =
         gst_mxf_demux_handle_generic_container_essence_element (demux, key,
         buffer, peek);
+    if (ret == GST_FLOW_OK && !peek && demux->lazy_metadata
+        && demux->metadata_deferred)
+      gst_mxf_demux_resolve_deferred_metadata (demux);
   } else if (mxf_is_random_index_pack (key)) {
     ret = gst_mxf_demux_handle_random_index_pack (demux, key, buffer);
   } else if (mxf_is_index_table_segment (key)) {
@@ -2458,6 +2698,11 @@ gst_mxf_demux_handle_klv_packet (GstMXFDemux * demux, const MXFUL * key,
     gst_mxf_demux_parse_footer_metadata (demux);
     demux->pull_footer_metadata = FALSE;
 
+    /* The header metadata is superseded by the footer metadata, don't
+     * parse it again */
+    if (demux->lazy_metadata && demux->metadata_resolved)
+      demux->current_partition->parsed_metadata = TRUE;
+
     if (demux->current_partition->partition.body_sid != 0 &&
         demux->current_partition->partition.body_offset == 0) {
       guint i;
@@ -2492,6 +2737,487 @@ gst_mxf_demux_set_partition_for_offset (GstMXFDemux * demux, guint64 offset)
   }
 }
 
+/* Skips all fill packets starting at @offset */
+static GstFlowReturn
+gst_mxf_demux_skip_fill (GstMXFDemux * demux, guint64 * offset)
+{
+  GstFlowReturn ret;
+  MXFUL key;
+  guint data_offset;
+  guint64 length;
+
+  while ((ret =
+          gst_mxf_demux_peek_klv_packet (demux, *offset, &key, &data_offset,
+              &length)) == GST_FLOW_OK) {
+    if (!mxf_is_fill (&key))
+      break;
+    *offset += data_offset + length;
+  }
+
+  return ret;
+}
+
+/* Parses the partition pack of @p if necessary, collects the index table
+ * segments of the partition and remembers where its essence starts */
+static GstFlowReturn
+gst_mxf_demux_scan_partition (GstMXFDemux * demux, GstMXFDemuxPartition * p)
+{
+  GstFlowReturn ret;
+  GstBuffer *buffer = NULL;
+  MXFUL key;
+  guint read = 0;
+  guint64 offset = p->partition.this_partition + demux->run_in;
+  guint64 end;
+
+  ret = gst_mxf_demux_pull_klv_packet (demux, offset, &key, &buffer, &read);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  if (!mxf_is_partition_pack (&key)) {
+    GST_WARNING_OBJECT (demux, "No partition pack at offset %" G_GUINT64_FORMAT,
+        offset);
+    gst_buffer_unref (buffer);
+    return GST_FLOW_ERROR;
+  }
+
+  demux->offset = offset;
+  ret = gst_mxf_demux_handle_partition_pack (demux, &key, buffer);
+  gst_buffer_unref (buffer);
+  if (ret != GST_FLOW_OK)
+    return ret;
+  offset += read;
+
+  if (p->partition.index_byte_count == 0 && (p->partition.body_sid == 0
+          || p->essence_container_offset != 0))
+    return GST_FLOW_OK;
+
+  /* Header metadata and index table segments follow the partition pack,
+   * both possibly preceded by fill */
+  if ((ret = gst_mxf_demux_skip_fill (demux, &offset)) != GST_FLOW_OK)
+    return ret;
+
+  if (p->partition.header_byte_count) {
+    offset += p->partition.header_byte_count;
+    if ((ret = gst_mxf_demux_skip_fill (demux, &offset)) != GST_FLOW_OK)
+      return ret;
+  }
+
+  end = offset + p->partition.index_byte_count;
+  while (offset < end) {
+    ret = gst_mxf_demux_pull_klv_packet (demux, offset, &key, &buffer, &read);
+    if (ret != GST_FLOW_OK)
+      return ret;
+
+    if (mxf_is_index_table_segment (&key)) {
+      demux->offset = offset;
+      gst_mxf_demux_handle_index_table_segment (demux, &key, buffer);
+    }
+    gst_buffer_unref (buffer);
+    offset += read;
+  }
+
+  if (p->partition.body_sid != 0 && p->essence_container_offset == 0) {
+    if ((ret = gst_mxf_demux_skip_fill (demux, &offset)) != GST_FLOW_OK)
+      return ret;
+
+    p->essence_container_offset =
+        offset - demux->run_in - p->partition.this_partition;
+  }
+
+  return GST_FLOW_OK;
+}
+
+/* Follows the previous partition links from the footer partition to find
+ * all partitions of files without random index pack */
+static void
+gst_mxf_demux_pull_partition_chain (GstMXFDemux * demux)
+{
+  guint64 offset = demux->footer_partition_pack_offset;
+
+  while (offset != 0) {
+    GstBuffer *buffer = NULL;
+    MXFPartitionPack partition;
+    GstMXFDemuxPartition *p = NULL;
+    GstMapInfo map;
+    MXFUL key;
+    gboolean ret;
+    GList *l;
+
+    if (gst_mxf_demux_pull_klv_packet (demux, offset + demux->run_in, &key,
+            &buffer, NULL) != GST_FLOW_OK)
+      break;
+
+    if (!mxf_is_partition_pack (&key)) {
+      gst_buffer_unref (buffer);
+      break;
+    }
+
+    gst_buffer_map (buffer, &map, GST_MAP_READ);
+    ret = mxf_partition_pack_parse (&key, &partition, map.data, map.size);
+    gst_buffer_unmap (buffer, &map);
+    gst_buffer_unref (buffer);
+    if (!ret)
+      break;
+
+    for (l = demux->partitions; l; l = l->next) {
+      GstMXFDemuxPartition *tmp = l->data;
+
+      if (tmp->partition.this_partition == offset) {
+        p = tmp;
+        break;
+      }
+    }
+
+    if (!p) {
+      p = g_new0 (GstMXFDemuxPartition, 1);
+      p->partition.this_partition = offset;
+      p->partition.body_sid = partition.body_sid;
+      demux->partitions =
+          g_list_insert_sorted (demux->partitions, p,
+          (GCompareFunc) gst_mxf_demux_partition_compare);
+    }
+
+    if (partition.prev_partition >= offset) {
+      mxf_partition_pack_reset (&partition);
+      break;
+    }
+    offset = partition.prev_partition;
+    mxf_partition_pack_reset (&partition);
+  }
+}
+
+/* Collects the index table segments of all partitions */
+static void
+gst_mxf_demux_pull_index_table_segments (GstMXFDemux * demux)
+{
+  guint64 old_offset = demux->offset;
+  GstMXFDemuxPartition *old_partition = demux->current_partition;
+  GList *l;
+
+  if (demux->index_table_segments_collected)
+    return;
+  demux->index_table_segments_collected = TRUE;
+
+  GST_DEBUG_OBJECT (demux, "Collecting index table segments");
+
+  if (!demux->random_index_pack)
+    gst_mxf_demux_pull_partition_chain (demux);
+
+  for (l = demux->partitions; l; l = l->next) {
+    GstMXFDemuxPartition *p = l->data;
+
+    demux->current_partition = p;
+    if (gst_mxf_demux_scan_partition (demux, p) != GST_FLOW_OK) {
+      GST_WARNING_OBJECT (demux, "Failed to scan partition at offset %"
+          G_GUINT64_FORMAT, p->partition.this_partition);
+    }
+  }
+
+  demux->offset = old_offset;
+  demux->current_partition = old_partition;
+
+  GST_DEBUG_OBJECT (demux, "Have %u index table segments",
+      g_list_length (demux->index_table_segments));
+}
+
+/* Returns the offset of the first edit unit of @segment in the essence
+ * container stream. This only matters with constant bytes per element, the
+ * segments of a stream then follow each other so it is where the previous
+ * segment ends */
+static guint64
+gst_mxf_demux_index_table_segment_get_body_offset (GstMXFDemux * demux,
+    MXFIndexTableSegment * segment)
+{
+  MXFIndexTableSegment *prev = NULL;
+  guint64 body_offset = 0;
+  GList *l;
+
+  /* The segments are sorted by body SID and start position */
+  for (l = demux->index_table_segments; l; l = l->next) {
+    MXFIndexTableSegment *tmp = l->data;
+
+    if (tmp->body_sid != segment->body_sid)
+      continue;
+
+    if (prev)
+      body_offset += (tmp->index_start_position -
+          prev->index_start_position) * prev->edit_unit_byte_count;
+    if (tmp == segment)
+      break;
+    prev = tmp;
+  }
+
+  return body_offset;
+}
+
+/* Computes the offset of the @delta-th element of the content package at
+ * @position in the essence container stream. @body_offset is the offset of
+ * the first edit unit of @segment */
+static gboolean
+gst_mxf_demux_index_table_segment_get_offset (MXFIndexTableSegment * segment,
+    guint64 body_offset, gint64 position, gint delta, guint64 * offset,
+    gboolean * keyframe)
+{
+  gint64 i = position - segment->index_start_position;
+  MXFDeltaEntry *d = NULL;
+
+  if (i < 0)
+    return FALSE;
+
+  if (delta >= 0 && delta < segment->n_delta_entries)
+    d = &segment->delta_entries[delta];
+  else if (delta > 0)
+    return FALSE;
+
+  if (segment->n_index_entries > 0) {
+    MXFIndexEntry *entry;
+
+    if (i >= segment->n_index_entries)
+      return FALSE;
+
+    entry = &segment->index_entries[i];
+    *offset = entry->stream_offset;
+    *keyframe = ! !(entry->flags & 0x80);
+
+    if (d && d->slice > 0) {
+      if (d->slice > segment->slice_count || !entry->slice_offset)
+        return FALSE;
+      *offset += entry->slice_offset[d->slice - 1];
+    }
+  } else if (segment->edit_unit_byte_count > 0) {
+    if (segment->index_duration > 0 && i >= segment->index_duration)
+      return FALSE;
+
+    *offset = body_offset + i * segment->edit_unit_byte_count;
+    *keyframe = TRUE;
+  } else {
+    return FALSE;
+  }
+
+  if (d)
+    *offset += d->element_delta;
+
+  return TRUE;
+}
+
+typedef struct
+{
+  guint64 body_offset;
+  guint64 offset;
+} GstMXFDemuxBodyPartition;
+
+/* Translates an offset in the essence container stream into a file offset
+ * (without run-in) using the partitions of the essence container */
+static guint64
+gst_mxf_demux_body_offset_to_offset (GArray * body_partitions,
+    guint64 body_offset)
+{
+  GstMXFDemuxBodyPartition *bp;
+  guint lo = 0, hi = body_partitions->len;
+
+  /* Find the last partition starting at or before body_offset */
+  while (hi - lo > 1) {
+    guint mid = lo + (hi - lo) / 2;
+
+    bp = &g_array_index (body_partitions, GstMXFDemuxBodyPartition, mid);
+    if (bp->body_offset <= body_offset)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  bp = &g_array_index (body_partitions, GstMXFDemuxBodyPartition, lo);
+  if (bp->body_offset > body_offset)
+    return -1;
+
+  return bp->offset + (body_offset - bp->body_offset);
+}
+
+static gboolean
+gst_mxf_demux_get_element_offset (GstMXFDemux * demux,
+    GArray * body_partitions, guint32 body_sid, gint64 position, gint delta,
+    guint64 * offset, gboolean * keyframe)
+{
+  GList *l;
+
+  for (l = demux->index_table_segments; l; l = l->next) {
+    MXFIndexTableSegment *segment = l->data;
+    guint64 body_offset;
+
+    if (segment->body_sid != body_sid)
+      continue;
+
+    if (gst_mxf_demux_index_table_segment_get_offset (segment,
+            gst_mxf_demux_index_table_segment_get_body_offset (demux, segment),
+            position, delta, &body_offset, keyframe)) {
+      *offset = gst_mxf_demux_body_offset_to_offset (body_partitions,
+          body_offset);
+      return *offset != -1;
+    }
+  }
+
+  return FALSE;
+}
+
+/* Resolves the index table segments into the offsets of all edit units of
+ * @etrack. Which element of the content package belongs to the track is
+ * found by comparing with the first two content packages in the file */
+static void
+gst_mxf_demux_resolve_index_table (GstMXFDemux * demux,
+    GstMXFDemuxEssenceTrack * etrack)
+{
+  GArray *body_partitions;
+  GList *l;
+  guint64 offset, element_offsets[2];
+  guint n_elements = 0, n_klvs = 0, n_segments = 0;
+  gint delta, n_deltas = 0;
+  gint64 position, first_position = 0, duration = 0;
+
+  if (etrack->index_resolved)
+    return;
+
+  gst_mxf_demux_pull_index_table_segments (demux);
+  etrack->index_resolved = TRUE;
+
+  body_partitions = g_array_new (FALSE, FALSE,
+      sizeof (GstMXFDemuxBodyPartition));
+  for (l = demux->partitions; l; l = l->next) {
+    GstMXFDemuxPartition *p = l->data;
+    GstMXFDemuxBodyPartition bp;
+
+    if (p->partition.body_sid != etrack->body_sid
+        || p->essence_container_offset == 0)
+      continue;
+
+    bp.body_offset = p->partition.body_offset;
+    bp.offset = p->partition.this_partition + p->essence_container_offset;
+    g_array_append_val (body_partitions, bp);
+  }
+
+  for (l = demux->index_table_segments; l; l = l->next) {
+    MXFIndexTableSegment *segment = l->data;
+
+    if (segment->body_sid != etrack->body_sid)
+      continue;
+
+    /* the essence container starts with the first indexed edit unit */
+    if (n_segments == 0)
+      first_position = segment->index_start_position;
+    n_segments++;
+    n_deltas = MAX (n_deltas, segment->n_delta_entries);
+  }
+
+  if (n_segments == 0 || body_partitions->len == 0 ||
+      g_array_index (body_partitions, GstMXFDemuxBodyPartition,
+          0).body_offset != 0) {
+    GST_DEBUG_OBJECT (demux, "No index for track %u", etrack->track_number);
+    goto out;
+  }
+
+  /* Find the first two elements of this track in the essence */
+  offset = g_array_index (body_partitions, GstMXFDemuxBodyPartition, 0).offset;
+  while (n_elements < 2 && n_klvs < 64) {
+    MXFUL key;
+    guint data_offset;
+    guint64 length;
+
+    if (gst_mxf_demux_peek_klv_packet (demux, offset + demux->run_in, &key,
+            &data_offset, &length) != GST_FLOW_OK)
+      break;
+
+    if ((mxf_is_generic_container_essence_element (&key) ||
+            mxf_is_avid_essence_container_essence_element (&key)) &&
+        (etrack->track_number == 0
+            || GST_READ_UINT32_BE (&key.u[12]) == etrack->track_number))
+      element_offsets[n_elements++] = offset;
+
+    offset += data_offset + length;
+    n_klvs++;
+  }
+
+  if (n_elements < 2) {
+    GST_DEBUG_OBJECT (demux, "Can't find essence of track %u",
+        etrack->track_number);
+    goto out;
+  }
+
+  /* Find the delta entry that describes this track */
+  for (delta = 0; delta < MAX (n_deltas, 1); delta++) {
+    guint64 offset0, offset1;
+    gboolean keyframe;
+
+    if (gst_mxf_demux_get_element_offset (demux, body_partitions,
+            etrack->body_sid, first_position, delta, &offset0, &keyframe)
+        && gst_mxf_demux_get_element_offset (demux, body_partitions,
+            etrack->body_sid, first_position + 1, delta, &offset1, &keyframe)
+        && offset0 == element_offsets[0] && offset1 == element_offsets[1])
+      break;
+  }
+
+  if (delta == MAX (n_deltas, 1)) {
+    GST_WARNING_OBJECT (demux, "Index table doesn't match essence of track %u",
+        etrack->track_number);
+    goto out;
+  }
+
+  if (!etrack->offsets)
+    etrack->offsets = g_array_new (FALSE, TRUE, sizeof (GstMXFDemuxIndex));
+
+  for (l = demux->index_table_segments; l; l = l->next) {
+    MXFIndexTableSegment *segment = l->data;
+    guint64 segment_body_offset;
+    gint64 end;
+
+    if (segment->body_sid != etrack->body_sid)
+      continue;
+
+    if (segment->n_index_entries > 0)
+      end = segment->index_start_position + segment->n_index_entries;
+    else if (segment->index_duration > 0)
+      end = segment->index_start_position + segment->index_duration;
+    else if (etrack->duration > 0)
+      end = etrack->duration;
+    else
+      continue;
+
+    segment_body_offset =
+        gst_mxf_demux_index_table_segment_get_body_offset (demux, segment);
+    for (position = segment->index_start_position; position < end; position++) {
+      GstMXFDemuxIndex *idx;
+      guint64 body_offset;
+      gboolean keyframe;
+
+      if (!gst_mxf_demux_index_table_segment_get_offset (segment,
+              segment_body_offset, position, delta, &body_offset, &keyframe))
+        break;
+
+      offset = gst_mxf_demux_body_offset_to_offset (body_partitions,
+          body_offset);
+      if (offset == -1)
+        break;
+
+      if (etrack->offsets->len <= position)
+        g_array_set_size (etrack->offsets, position + 1);
+
+      idx = &g_array_index (etrack->offsets, GstMXFDemuxIndex, position);
+      if (idx->offset == 0) {
+        idx->offset = offset;
+        idx->keyframe = keyframe;
+      }
+      duration = MAX (duration, position + 1);
+    }
+  }
+
+  GST_DEBUG_OBJECT (demux, "Resolved %" G_GINT64_FORMAT " index entries for "
+      "track %u", duration, etrack->track_number);
+
+  if (etrack->duration <= 0)
+    etrack->duration = duration;
+
+out:
+  g_array_free (body_partitions, TRUE);
+}
+
 static guint64
 gst_mxf_demux_find_essence_element (GstMXFDemux * demux,
     GstMXFDemuxEssenceTrack * etrack, gint64 * position, gboolean keyframe)
@@ -2505,6 +3231,9 @@ gst_mxf_demux_find_essence_element (GstMXFDemux * demux,
       " of track %u with body_sid %u (keyframe %d)", *position,
       etrack->track_number, etrack->body_sid, keyframe);
 
+  if (demux->random_access)
+    gst_mxf_demux_resolve_index_table (demux, etrack);
+
 from_index:
 
   if (etrack->duration > 0 && *position >= etrack->duration) {
@@ -3630,6 +4359,11 @@ gst_mxf_demux_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
       if (duration <= -1)
         duration = -1;
 
+      /* Fall back to the essence duration known from the index */
+      if (duration == -1 && mxfpad->current_essence_track
+          && mxfpad->current_essence_track->duration > 0)
+        duration = mxfpad->current_essence_track->duration;
+
       if (duration != -1 && format == GST_FORMAT_TIME) {
         if (mxfpad->material_track->edit_rate.n == 0 ||
             mxfpad->material_track->edit_rate.d == 0) {
@@ -3922,6 +4656,9 @@ gst_mxf_demux_query (GstElement * element, GstQuery * query)
           continue;
 
         pdur = pad->material_track->parent.sequence->duration;
+        if (pdur <= -1 && pad->current_essence_track
+            && pad->current_essence_track->duration > 0)
+          pdur = pad->current_essence_track->duration;
         if (pad->material_track->edit_rate.n == 0 ||
             pad->material_track->edit_rate.d == 0 || pdur <= -1)
           continue;
@@ -4052,6 +4789,9 @@ gst_mxf_demux_set_property (GObject * object, guint prop_id,
     case PROP_MAX_DRIFT:
       demux->max_drift = g_value_get_uint64 (value);
       break;
+    case PROP_LAZY_METADATA:
+      demux->lazy_metadata = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -4071,6 +4811,9 @@ gst_mxf_demux_get_property (GObject * object, guint prop_id,
     case PROP_MAX_DRIFT:
       g_value_set_uint64 (value, demux->max_drift);
       break;
+    case PROP_LAZY_METADATA:
+      g_value_set_boolean (value, demux->lazy_metadata);
+      break;
     case PROP_STRUCTURE:{
       GstStructure *s;
 
@@ -4158,6 +4901,13 @@ gst_mxf_demux_class_init (GstMXFDemuxClass * klass)
           "Structural metadata of the MXF file",
           GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_LAZY_METADATA,
+      g_param_spec_boolean ("lazy-metadata", "Lazy metadata",
+          "Only resolve the metadata required for the essence tracks before "
+          "outputting the first buffers, descriptive metadata and the "
+          "structure tag are handled afterwards", FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gstelement_class->change_state =
       GST_DEBUG_FUNCPTR (gst_mxf_demux_change_state);
   gstelement_class->query = GST_DEBUG_FUNCPTR (gst_mxf_demux_query);
@@ -4189,6 +4939,7 @@ gst_mxf_demux_init (GstMXFDemux * demux)
   gst_element_add_pad (GST_ELEMENT (demux), demux->sinkpad);
 
   demux->max_drift = 500 * GST_MSECOND;
+  demux->lazy_metadata = FALSE;
 
   demux->adapter = gst_adapter_new ();
   g_rw_lock_init (&demux->metadata_lock);
@@ -73,6 +73,8 @@ typedef struct
   gint64 duration;
 
   GArray *offsets;
+  /* TRUE once the index table segments were resolved into offsets */
+  gboolean index_resolved;
 
   MXFMetadataSourcePackage *source_package;
   MXFMetadataTimelineTrack *source_track;
@@ -151,7 +153,10 @@ struct _GstMXFDemux
   GstMXFDemuxPartition *current_partition;
 
   GArray *essence_tracks;
-  GList *pending_index_table_segments;
+
+  /* Index table segments, sorted by body sid and start position */
+  GList *index_table_segments;
+  gboolean index_table_segments_collected;
 
   GArray *random_index_pack;
 
@@ -164,6 +169,12 @@ struct _GstMXFDemux
   MXFMetadataPreface *preface;
   GHashTable *metadata;
 
+  /* With lazy-metadata only the structural metadata is resolved while
+   * this is TRUE, i.e. until every pad has output its first buffer.
+   * Descriptive metadata KLV packets are kept here until then */
+  gboolean metadata_deferred;
+  GList *deferred_descriptive_metadata;
+
   MXFUMID current_package_uid;
   MXFMetadataGenericPackage *current_package;
   gchar *current_package_string;
@@ -173,6 +184,7 @@ struct _GstMXFDemux
   /* Properties */
   gchar *requested_package_string;
   GstClockTime max_drift;
+  gboolean lazy_metadata;
 };
 
 struct _GstMXFDemuxClass
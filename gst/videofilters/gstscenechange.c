@@ -30,6 +30,15 @@
  * can be used to align the synchronization points among multiple
  * video encoders, which is useful for segmented streaming.
  *
+ * Each detected scene change is also posted on the bus as a "scenechange"
+ * element message containing the "timestamp" of the picture (#guint64), its
+ * "score" and the "threshold" it was compared against (#gdouble).  Every
+ * analysed picture gets a #GstSceneChangeMeta with the same information,
+ * the first one has a score of 0 as it has nothing to be compared with.
+ * Setting the #GstSceneChange:downsample property compares only a subsampled
+ * luma plane, which considerably lowers the CPU usage for high resolution
+ * video.
+ *
  * The scenechange element does not work with compressed video.
  *
  * <refsect2>
@@ -80,8 +89,10 @@
 #include <gst/gst.h>
 #include <gst/video/video.h>
 #include <gst/video/gstvideofilter.h>
+#include <gst/video/gstscenechangemeta.h>
 #include <string.h>
 #include "gstscenechange.h"
+#include "gstvideofiltersbadorc.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_scene_change_debug_category);
 #define GST_CAT_DEFAULT gst_scene_change_debug_category
@@ -89,6 +100,15 @@ GST_DEBUG_CATEGORY_STATIC (gst_scene_change_debug_category);
 /* prototypes */
 
 
+static void gst_scene_change_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_scene_change_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_scene_change_finalize (GObject * object);
+static gboolean gst_scene_change_stop (GstBaseTransform * trans);
+static gboolean gst_scene_change_set_info (GstVideoFilter * filter,
+    GstCaps * incaps, GstVideoInfo * in_info, GstCaps * outcaps,
+    GstVideoInfo * out_info);
 static GstFlowReturn gst_scene_change_transform_frame_ip (GstVideoFilter *
     filter, GstVideoFrame * frame);
 
@@ -99,9 +119,13 @@ static gboolean is_shot_change (int frame_number);
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_DOWNSAMPLE
 };
 
+#define DEFAULT_DOWNSAMPLE 1
+#define MAX_DOWNSAMPLE 16
+
 #define VIDEO_CAPS \
     GST_VIDEO_CAPS_MAKE("{ I420, Y42B, Y41B, Y444 }")
 
@@ -115,6 +139,9 @@ G_DEFINE_TYPE_WITH_CODE (GstSceneChange, gst_scene_change,
 static void
 gst_scene_change_class_init (GstSceneChangeClass * klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBaseTransformClass *base_transform_class =
+      GST_BASE_TRANSFORM_CLASS (klass);
   GstVideoFilterClass *video_filter_class = GST_VIDEO_FILTER_CLASS (klass);
 
   gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
@@ -129,39 +156,135 @@ gst_scene_change_class_init (GstSceneChangeClass * klass)
       "Video/Filter", "Detects scene changes in video",
       "David Schleef <ds@entropywave.com>");
 
+  gobject_class->set_property = gst_scene_change_set_property;
+  gobject_class->get_property = gst_scene_change_get_property;
+  gobject_class->finalize = gst_scene_change_finalize;
+  base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_scene_change_stop);
+  video_filter_class->set_info = GST_DEBUG_FUNCPTR (gst_scene_change_set_info);
   video_filter_class->transform_frame_ip =
       GST_DEBUG_FUNCPTR (gst_scene_change_transform_frame_ip);
 
+  g_object_class_install_property (gobject_class, PROP_DOWNSAMPLE,
+      g_param_spec_uint ("downsample", "Downsample",
+          "Only compare every Nth luma sample horizontally and vertically",
+          1, MAX_DOWNSAMPLE, DEFAULT_DOWNSAMPLE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
 gst_scene_change_init (GstSceneChange * scenechange)
 {
+  scenechange->downsample = DEFAULT_DOWNSAMPLE;
 }
 
+static void
+gst_scene_change_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstSceneChange *scenechange = GST_SCENE_CHANGE (object);
+
+  switch (property_id) {
+    case PROP_DOWNSAMPLE:
+      GST_OBJECT_LOCK (scenechange);
+      scenechange->downsample = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (scenechange);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
 
-static double
-get_frame_score (GstVideoFrame * f1, GstVideoFrame * f2)
+static void
+gst_scene_change_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
 {
-  int i;
-  int j;
-  int score = 0;
-  int width, height;
-  guint8 *s1;
-  guint8 *s2;
+  GstSceneChange *scenechange = GST_SCENE_CHANGE (object);
+
+  switch (property_id) {
+    case PROP_DOWNSAMPLE:
+      GST_OBJECT_LOCK (scenechange);
+      g_value_set_uint (value, scenechange->downsample);
+      GST_OBJECT_UNLOCK (scenechange);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
 
-  width = f1->info.width;
-  height = f1->info.height;
+/* forget the previous picture, the next one will start a new history */
+static void
+gst_scene_change_reset (GstSceneChange * scenechange)
+{
+  g_free (scenechange->oldluma);
+  scenechange->oldluma = NULL;
+  g_free (scenechange->tmprow);
+  scenechange->tmprow = NULL;
+  scenechange->luma_factor = 0;
+  scenechange->luma_width = 0;
+  scenechange->luma_height = 0;
+}
+
+static void
+gst_scene_change_finalize (GObject * object)
+{
+  gst_scene_change_reset (GST_SCENE_CHANGE (object));
+
+  G_OBJECT_CLASS (gst_scene_change_parent_class)->finalize (object);
+}
+
+static gboolean
+gst_scene_change_stop (GstBaseTransform * trans)
+{
+  gst_scene_change_reset (GST_SCENE_CHANGE (trans));
+
+  return TRUE;
+}
+
+static gboolean
+gst_scene_change_set_info (GstVideoFilter * filter, GstCaps * incaps,
+    GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
+{
+  gst_scene_change_reset (GST_SCENE_CHANGE (filter));
+
+  return TRUE;
+}
+
+/* Returns the sum of absolute differences between the decimated luma plane
+ * of @frame and the one of the previous picture, and replaces the latter
+ * with the former. */
+static guint64
+get_frame_sad (GstSceneChange * scenechange, GstVideoFrame * frame)
+{
+  guint factor = scenechange->luma_factor;
+  int width = scenechange->luma_width;
+  int height = scenechange->luma_height;
+  gint stride = GST_VIDEO_FRAME_COMP_STRIDE (frame, 0);
+  guint8 *old = scenechange->oldluma;
+  guint8 *src;
+  guint32 sad;
+  guint64 score = 0;
+  int i, j;
 
   for (j = 0; j < height; j++) {
-    s1 = (guint8 *) f1->data[0] + f1->info.stride[0] * j;
-    s2 = (guint8 *) f2->data[0] + f2->info.stride[0] * j;
-    for (i = 0; i < width; i++) {
-      score += ABS (s1[i] - s2[i]);
+    src = GST_VIDEO_FRAME_COMP_DATA (frame, 0);
+    src += stride * j * factor;
+
+    if (factor > 1) {
+      for (i = 0; i < width; i++)
+        scenechange->tmprow[i] = src[i * factor];
+      src = scenechange->tmprow;
     }
+
+    video_filters_bad_orc_sad_u8 (&sad, old, src, width);
+    memcpy (old, src, width);
+
+    score += sad;
+    old += width;
   }
 
-  return ((double) score) / (width * height);
+  return score;
 }
 
 static GstFlowReturn
@@ -169,52 +292,62 @@ gst_scene_change_transform_frame_ip (GstVideoFilter * filter,
     GstVideoFrame * frame)
 {
   GstSceneChange *scenechange = GST_SCENE_CHANGE (filter);
-  GstVideoFrame oldframe;
   double score_min;
   double score_max;
   double threshold;
   double score;
   gboolean change;
-  gboolean ret;
+  guint factor;
   int i;
 
   GST_DEBUG_OBJECT (scenechange, "transform_frame_ip");
 
-  if (!scenechange->oldbuf) {
+  GST_OBJECT_LOCK (scenechange);
+  factor = scenechange->downsample;
+  GST_OBJECT_UNLOCK (scenechange);
+
+  if (!scenechange->oldluma || factor != scenechange->luma_factor) {
+    int width = GST_VIDEO_FRAME_COMP_WIDTH (frame, 0);
+    int height = GST_VIDEO_FRAME_COMP_HEIGHT (frame, 0);
+
+    gst_scene_change_reset (scenechange);
+
+    scenechange->luma_factor = factor;
+    scenechange->luma_width = (width + factor - 1) / factor;
+    scenechange->luma_height = (height + factor - 1) / factor;
+    scenechange->oldluma =
+        g_malloc0 (scenechange->luma_width * scenechange->luma_height);
+    scenechange->tmprow = g_malloc (scenechange->luma_width);
+
     scenechange->n_diffs = 0;
     memset (scenechange->diffs, 0, sizeof (double) * SC_N_DIFFS);
-    scenechange->oldbuf = gst_buffer_ref (frame->buffer);
-    return GST_FLOW_OK;
-  }
+    scenechange->diff_pos = 0;
 
-  ret =
-      gst_video_frame_map (&oldframe, &scenechange->oldinfo,
-      scenechange->oldbuf, GST_MAP_READ);
-  if (!ret) {
-    GST_ERROR_OBJECT (scenechange, "failed to map old video frame");
-    return GST_FLOW_ERROR;
+    /* only keeps the decimated picture for next time */
+    get_frame_sad (scenechange, frame);
+    gst_buffer_add_scene_change_meta (frame->buffer, 0.0, 0.0, FALSE);
+    return GST_FLOW_OK;
   }
 
-  score = get_frame_score (&oldframe, frame);
+  score = ((double) get_frame_sad (scenechange, frame)) /
+      (scenechange->luma_width * scenechange->luma_height);
 
-  gst_video_frame_unmap (&oldframe);
+  /* compare with the previous scores, i.e. all but the oldest one which is
+   * replaced by the new score */
+  score_min = G_MAXDOUBLE;
+  score_max = -G_MAXDOUBLE;
+  for (i = 1; i < SC_N_DIFFS; i++) {
+    double diff =
+        scenechange->diffs[(scenechange->diff_pos + i) % SC_N_DIFFS];
 
-  gst_buffer_unref (scenechange->oldbuf);
-  scenechange->oldbuf = gst_buffer_ref (frame->buffer);
-  memcpy (&scenechange->oldinfo, &frame->info, sizeof (GstVideoInfo));
+    score_min = MIN (score_min, diff);
+    score_max = MAX (score_max, diff);
+  }
 
-  memmove (scenechange->diffs, scenechange->diffs + 1,
-      sizeof (double) * (SC_N_DIFFS - 1));
-  scenechange->diffs[SC_N_DIFFS - 1] = score;
+  scenechange->diffs[scenechange->diff_pos] = score;
+  scenechange->diff_pos = (scenechange->diff_pos + 1) % SC_N_DIFFS;
   scenechange->n_diffs++;
 
-  score_min = scenechange->diffs[0];
-  score_max = scenechange->diffs[0];
-  for (i = 1; i < SC_N_DIFFS - 1; i++) {
-    score_min = MIN (score_min, scenechange->diffs[i]);
-    score_max = MAX (score_max, scenechange->diffs[i]);
-  }
-
   threshold = 1.8 * score_max - 0.8 * score_min;
 
   if (scenechange->n_diffs > 2) {
@@ -240,12 +373,21 @@ gst_scene_change_transform_frame_ip (GstVideoFilter * filter,
   }
 #endif
 
+  gst_buffer_add_scene_change_meta (frame->buffer, score, threshold, change);
+
   if (change) {
     GstEvent *event;
 
     GST_INFO_OBJECT (scenechange, "%d %g %g %g %d",
         scenechange->n_diffs, score / threshold, score, threshold, change);
 
+    gst_element_post_message (GST_ELEMENT_CAST (scenechange),
+        gst_message_new_element (GST_OBJECT_CAST (scenechange),
+            gst_structure_new ("scenechange",
+                "timestamp", G_TYPE_UINT64, GST_BUFFER_PTS (frame->buffer),
+                "score", G_TYPE_DOUBLE, score,
+                "threshold", G_TYPE_DOUBLE, threshold, NULL)));
+
     event =
         gst_video_event_new_downstream_force_key_unit (GST_BUFFER_PTS
         (frame->buffer), GST_CLOCK_TIME_NONE, GST_CLOCK_TIME_NONE, FALSE,
@@ -40,10 +40,21 @@ struct _GstSceneChange
 {
   GstVideoFilter base_scenechange;
 
+  /* properties */
+  guint downsample;
+
+  /* ring buffer of the last picture difference scores, diff_pos is the
+   * oldest one */
   int n_diffs;
   double diffs[SC_N_DIFFS];
-  GstBuffer *oldbuf;
-  GstVideoInfo oldinfo;
+  int diff_pos;
+
+  /* decimated luma plane of the previous picture */
+  guint8 *oldluma;
+  guint8 *tmprow;
+  guint luma_factor;
+  int luma_width;
+  int luma_height;
   int count;
 };
 
@@ -145,6 +145,7 @@ static void
 gst_h264_parse_init (GstH264Parse * h264parse)
 {
   h264parse->frame_out = gst_adapter_new ();
+  h264parse->inplace_sizes = g_array_new (FALSE, FALSE, sizeof (guint));
   gst_base_parse_set_pts_interpolation (GST_BASE_PARSE (h264parse), FALSE);
   GST_PAD_SET_ACCEPT_INTERSECT (GST_BASE_PARSE_SINK_PAD (h264parse));
 }
@@ -156,10 +157,19 @@ gst_h264_parse_finalize (GObject * object)
   GstH264Parse *h264parse = GST_H264_PARSE (object);
 
   g_object_unref (h264parse->frame_out);
+  g_array_free (h264parse->inplace_sizes, TRUE);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static void
+gst_h264_parse_reset_inplace (GstH264Parse * h264parse)
+{
+  h264parse->inplace = TRUE;
+  h264parse->inplace_end = 0;
+  g_array_set_size (h264parse->inplace_sizes, 0);
+}
+
 static void
 gst_h264_parse_reset_frame (GstH264Parse * h264parse)
 {
@@ -175,6 +185,7 @@ gst_h264_parse_reset_frame (GstH264Parse * h264parse)
   h264parse->keyframe = FALSE;
   h264parse->frame_start = FALSE;
   gst_adapter_clear (h264parse->frame_out);
+  gst_h264_parse_reset_inplace (h264parse);
 }
 
 static void
@@ -375,9 +386,11 @@ gst_h264_parse_negotiate (GstH264Parse * h264parse, gint in_format,
   h264parse->transform = (in_format != h264parse->format);
 }
 
+/* Prefixes the NAL at @offset in @src according to @format. Only the
+ * prefix is newly allocated, the payload memory is shared with @src */
 static GstBuffer *
-gst_h264_parse_wrap_nal (GstH264Parse * h264parse, guint format, guint8 * data,
-    guint size)
+gst_h264_parse_wrap_nal (GstH264Parse * h264parse, guint format,
+    GstBuffer * src, guint offset, guint size)
 {
   GstBuffer *buf;
   guint nl = h264parse->nal_length_size;
@@ -385,7 +398,6 @@ gst_h264_parse_wrap_nal (GstH264Parse * h264parse, guint format, guint8 * data,
 
   GST_DEBUG_OBJECT (h264parse, "nal length %d", size);
 
-  buf = gst_buffer_new_allocate (NULL, 4 + size, NULL);
   if (format == GST_H264_PARSE_FORMAT_AVC
       || format == GST_H264_PARSE_FORMAT_AVC3) {
     tmp = GUINT32_TO_BE (size << (32 - 8 * nl));
@@ -397,9 +409,9 @@ gst_h264_parse_wrap_nal (GstH264Parse * h264parse, guint format, guint8 * data,
     tmp = GUINT32_TO_BE (1);
   }
 
-  gst_buffer_fill (buf, 0, &tmp, sizeof (guint32));
-  gst_buffer_fill (buf, nl, data, size);
-  gst_buffer_set_size (buf, size + nl);
+  buf = gst_buffer_new_allocate (NULL, nl, NULL);
+  gst_buffer_fill (buf, 0, &tmp, nl);
+  gst_buffer_copy_into (buf, src, GST_BUFFER_COPY_MEMORY, offset, size);
 
   return buf;
 }
@@ -508,7 +520,8 @@ gst_h264_parse_process_sei (GstH264Parse * h264parse, GstH264NalUnit * nalu)
 
 /* caller guarantees 2 bytes of nal payload */
 static void
-gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
+gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu,
+    GstBuffer * buffer)
 {
   guint nal_type;
   GstH264PPS pps = { 0, };
@@ -642,10 +655,25 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
    * and use that to replace outgoing buffer data later on */
   if (h264parse->transform) {
     GstBuffer *buf;
+    guint nl;
+
+    /* the input frame can be rewritten in place as long as all NALs are
+     * contiguous and already have a prefix of the output size */
+    if (h264parse->inplace) {
+      nl = h264parse->format == GST_H264_PARSE_FORMAT_BYTE ?
+          4 : h264parse->nal_length_size;
+      if (nalu->sc_offset == h264parse->inplace_end
+          && nalu->offset - nalu->sc_offset == nl) {
+        g_array_append_val (h264parse->inplace_sizes, nalu->size);
+        h264parse->inplace_end = nalu->offset + nalu->size;
+      } else {
+        h264parse->inplace = FALSE;
+      }
+    }
 
     GST_LOG_OBJECT (h264parse, "collecting NAL in AVC frame");
-    buf = gst_h264_parse_wrap_nal (h264parse, h264parse->format,
-        nalu->data + nalu->offset, nalu->size);
+    buf = gst_h264_parse_wrap_nal (h264parse, h264parse->format, buffer,
+        nalu->offset, nalu->size);
     gst_adapter_push (h264parse->frame_out, buf);
   }
 }
@@ -722,6 +750,10 @@ gst_h264_parse_handle_frame_packetized (GstBaseParse * parse,
   if (h264parse->split_packetized)
     buffer = gst_buffer_copy (frame->buffer);
 
+  /* the in-place state is per frame, and the packetized path doesn't go
+   * through reset_frame */
+  gst_h264_parse_reset_inplace (h264parse);
+
   gst_buffer_map (buffer, &map, GST_MAP_READ);
 
   left = map.size;
@@ -736,7 +768,7 @@ gst_h264_parse_handle_frame_packetized (GstBaseParse * parse,
     GST_DEBUG_OBJECT (h264parse, "AVC nal offset %d", nalu.offset + nalu.size);
 
     /* either way, have a look at it */
-    gst_h264_parse_process_nal (h264parse, &nalu);
+    gst_h264_parse_process_nal (h264parse, &nalu, buffer);
 
     /* dispatch per NALU if needed */
     if (h264parse->split_packetized) {
@@ -958,7 +990,7 @@ gst_h264_parse_handle_frame (GstBaseParse * parse,
     if (nalu.type == GST_H264_NAL_SPS ||
         nalu.type == GST_H264_NAL_PPS ||
         (h264parse->have_sps && h264parse->have_pps)) {
-      gst_h264_parse_process_nal (h264parse, &nalu);
+      gst_h264_parse_process_nal (h264parse, &nalu, buffer);
     } else {
       GST_WARNING_OBJECT (h264parse,
           "no SPS/PPS yet, nal Type: %d %s, Size: %u will be dropped",
@@ -1440,6 +1472,86 @@ exit:
     h264parse->dts += *out_dur;
 }
 
+/* Collects the prefixed NALs of the frame into one buffer. The NAL
+ * payloads stay shared with the input, nothing is copied unless the
+ * buffer runs out of memory slots */
+static GstBuffer *
+gst_h264_parse_take_frame_out (GstH264Parse * h264parse, guint av)
+{
+  GList *list, *l;
+  GstBuffer *buf;
+  GstMapInfo map;
+  guint n_memories = 0;
+  gsize pos = 0;
+
+  list = gst_adapter_take_list (h264parse->frame_out, av);
+  for (l = list; l; l = l->next)
+    n_memories += gst_buffer_n_memory (l->data);
+
+  if (n_memories <= gst_buffer_get_max_memory ()) {
+    buf = list->data;
+    for (l = list->next; l; l = l->next)
+      buf = gst_buffer_append (buf, l->data);
+  } else {
+    /* every NAL has a memory for its prefix and one for its data, appending
+     * them all would merge the memories of the frame again and again, so
+     * copy the frame once instead */
+    buf = gst_buffer_new_allocate (NULL, av, NULL);
+    gst_buffer_map (buf, &map, GST_MAP_WRITE);
+    for (l = list; l; l = l->next) {
+      pos += gst_buffer_extract (l->data, 0, map.data + pos, av - pos);
+      gst_buffer_unref (l->data);
+    }
+    gst_buffer_unmap (buf, &map);
+  }
+  g_list_free (list);
+
+  return buf;
+}
+
+/* Replaces the NAL prefixes of the input frame by those of the output
+ * format, which have the same size */
+static void
+gst_h264_parse_transform_inplace (GstH264Parse * h264parse,
+    GstBaseParseFrame * frame)
+{
+  GstMapInfo map;
+  guint i, j, pos;
+  guint nl = h264parse->nal_length_size;
+  const gboolean bs = h264parse->format == GST_H264_PARSE_FORMAT_BYTE;
+
+  /* length prefixed to length prefixed, the input is already fine */
+  if (!bs && h264parse->packetized)
+    return;
+
+  GST_LOG_OBJECT (h264parse, "rewriting %u NAL prefixes in place",
+      h264parse->inplace_sizes->len);
+
+  /* only copies if the memory is shared with someone else */
+  frame->buffer = gst_buffer_make_writable (frame->buffer);
+  if (!gst_buffer_map (frame->buffer, &map, GST_MAP_READWRITE)) {
+    GST_WARNING_OBJECT (h264parse, "failed to map frame writable");
+    return;
+  }
+
+  if (bs)
+    nl = 4;
+
+  for (i = 0, pos = 0; i < h264parse->inplace_sizes->len; i++) {
+    guint size = g_array_index (h264parse->inplace_sizes, guint, i);
+
+    for (j = 0; j < nl; j++) {
+      if (bs)
+        map.data[pos + j] = j == nl - 1 ? 1 : 0;
+      else
+        map.data[pos + j] = size >> (8 * (nl - 1 - j));
+    }
+    pos += nl + size;
+  }
+
+  gst_buffer_unmap (frame->buffer, &map);
+}
+
 static GstFlowReturn
 gst_h264_parse_parse_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
 {
@@ -1474,11 +1586,18 @@ gst_h264_parse_parse_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
   if (av) {
     GstBuffer *buf;
 
-    buf = gst_adapter_take_buffer (h264parse->frame_out, av);
-    gst_buffer_copy_into (buf, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
-    gst_buffer_replace (&frame->out_buffer, buf);
-    gst_buffer_unref (buf);
+    if (h264parse->inplace
+        && h264parse->inplace_end == gst_buffer_get_size (buffer)) {
+      gst_adapter_clear (h264parse->frame_out);
+      gst_h264_parse_transform_inplace (h264parse, frame);
+    } else {
+      buf = gst_h264_parse_take_frame_out (h264parse, av);
+      gst_buffer_copy_into (buf, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
+      gst_buffer_replace (&frame->out_buffer, buf);
+      gst_buffer_unref (buf);
+    }
   }
+  gst_h264_parse_reset_inplace (h264parse);
 
   return GST_FLOW_OK;
 }
@@ -1489,12 +1608,8 @@ static GstFlowReturn
 gst_h264_parse_push_codec_buffer (GstH264Parse * h264parse,
     GstBuffer * nal, GstClockTime ts)
 {
-  GstMapInfo map;
-
-  gst_buffer_map (nal, &map, GST_MAP_READ);
-  nal = gst_h264_parse_wrap_nal (h264parse, h264parse->format,
-      map.data, map.size);
-  gst_buffer_unmap (nal, &map);
+  nal = gst_h264_parse_wrap_nal (h264parse, h264parse->format, nal, 0,
+      gst_buffer_get_size (nal));
 
   GST_BUFFER_TIMESTAMP (nal) = ts;
   GST_BUFFER_DURATION (nal) = 0;
@@ -1846,7 +1961,7 @@ gst_h264_parse_set_caps (GstBaseParse * parse, GstCaps * caps)
         goto avcc_too_small;
       }
 
-      gst_h264_parse_process_nal (h264parse, &nalu);
+      gst_h264_parse_process_nal (h264parse, &nalu, codec_data);
       off = nalu.offset + nalu.size;
     }
 
@@ -1861,7 +1976,7 @@ gst_h264_parse_set_caps (GstBaseParse * parse, GstCaps * caps)
         goto avcc_too_small;
       }
 
-      gst_h264_parse_process_nal (h264parse, &nalu);
+      gst_h264_parse_process_nal (h264parse, &nalu, codec_data);
       off = nalu.offset + nalu.size;
     }
 
@@ -140,6 +140,7 @@ static void
 gst_h265_parse_init (GstH265Parse * h265parse)
 {
   h265parse->frame_out = gst_adapter_new ();
+  h265parse->inplace_sizes = g_array_new (FALSE, FALSE, sizeof (guint));
   gst_base_parse_set_pts_interpolation (GST_BASE_PARSE (h265parse), FALSE);
   GST_PAD_SET_ACCEPT_INTERSECT (GST_BASE_PARSE_SINK_PAD (h265parse));
 }
@@ -151,10 +152,19 @@ gst_h265_parse_finalize (GObject * object)
   GstH265Parse *h265parse = GST_H265_PARSE (object);
 
   g_object_unref (h265parse->frame_out);
+  g_array_free (h265parse->inplace_sizes, TRUE);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static void
+gst_h265_parse_reset_inplace (GstH265Parse * h265parse)
+{
+  h265parse->inplace = TRUE;
+  h265parse->inplace_end = 0;
+  g_array_set_size (h265parse->inplace_sizes, 0);
+}
+
 static void
 gst_h265_parse_reset_frame (GstH265Parse * h265parse)
 {
@@ -169,6 +179,7 @@ gst_h265_parse_reset_frame (GstH265Parse * h265parse)
   h265parse->sei_pos = -1;
   h265parse->keyframe = FALSE;
   gst_adapter_clear (h265parse->frame_out);
+  gst_h265_parse_reset_inplace (h265parse);
 }
 
 static void
@@ -360,9 +371,11 @@ gst_h265_parse_negotiate (GstH265Parse * h265parse, gint in_format,
   h265parse->transform = (in_format != h265parse->format);
 }
 
+/* Prefixes the NAL at @offset in @src according to @format. Only the
+ * prefix is newly allocated, the payload memory is shared with @src */
 static GstBuffer *
-gst_h265_parse_wrap_nal (GstH265Parse * h265parse, guint format, guint8 * data,
-    guint size)
+gst_h265_parse_wrap_nal (GstH265Parse * h265parse, guint format,
+    GstBuffer * src, guint offset, guint size)
 {
   GstBuffer *buf;
   guint nl = h265parse->nal_length_size;
@@ -370,7 +383,6 @@ gst_h265_parse_wrap_nal (GstH265Parse * h265parse, guint format, guint8 * data,
 
   GST_DEBUG_OBJECT (h265parse, "nal length %d", size);
 
-  buf = gst_buffer_new_allocate (NULL, 4 + size, NULL);
   if (format == GST_H265_PARSE_FORMAT_HVC1
       || format == GST_H265_PARSE_FORMAT_HEV1) {
     tmp = GUINT32_TO_BE (size << (32 - 8 * nl));
@@ -382,9 +394,9 @@ gst_h265_parse_wrap_nal (GstH265Parse * h265parse, guint format, guint8 * data,
     tmp = GUINT32_TO_BE (1);
   }
 
-  gst_buffer_fill (buf, 0, &tmp, sizeof (guint32));
-  gst_buffer_fill (buf, nl, data, size);
-  gst_buffer_set_size (buf, size + nl);
+  buf = gst_buffer_new_allocate (NULL, nl, NULL);
+  gst_buffer_fill (buf, 0, &tmp, nl);
+  gst_buffer_copy_into (buf, src, GST_BUFFER_COPY_MEMORY, offset, size);
 
   return buf;
 }
@@ -481,7 +493,8 @@ _nal_name (GstH265NalUnitType nal_type)
 
 /* caller guarantees 2 bytes of nal payload */
 static void
-gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
+gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu,
+    GstBuffer * buffer)
 {
   GstH265PPS pps = { 0, };
   GstH265SPS sps = { 0, };
@@ -655,10 +668,25 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
    * and use that to replace outgoing buffer data later on */
   if (h265parse->transform) {
     GstBuffer *buf;
+    guint nl;
+
+    /* the input frame can be rewritten in place as long as all NALs are
+     * contiguous and already have a prefix of the output size */
+    if (h265parse->inplace) {
+      nl = h265parse->format == GST_H265_PARSE_FORMAT_BYTE ?
+          4 : h265parse->nal_length_size;
+      if (nalu->sc_offset == h265parse->inplace_end
+          && nalu->offset - nalu->sc_offset == nl) {
+        g_array_append_val (h265parse->inplace_sizes, nalu->size);
+        h265parse->inplace_end = nalu->offset + nalu->size;
+      } else {
+        h265parse->inplace = FALSE;
+      }
+    }
 
     GST_LOG_OBJECT (h265parse, "collecting NAL in HEVC frame");
-    buf = gst_h265_parse_wrap_nal (h265parse, h265parse->format,
-        nalu->data + nalu->offset, nalu->size);
+    buf = gst_h265_parse_wrap_nal (h265parse, h265parse->format, buffer,
+        nalu->offset, nalu->size);
     gst_adapter_push (h265parse->frame_out, buf);
   }
 }
@@ -735,6 +763,10 @@ gst_h265_parse_handle_frame_packetized (GstBaseParse * parse,
   if (h265parse->split_packetized)
     buffer = gst_buffer_copy (frame->buffer);
 
+  /* the in-place state is per frame, and the packetized path doesn't go
+   * through reset_frame */
+  gst_h265_parse_reset_inplace (h265parse);
+
   gst_buffer_map (buffer, &map, GST_MAP_READ);
 
   left = map.size;
@@ -749,7 +781,7 @@ gst_h265_parse_handle_frame_packetized (GstBaseParse * parse,
     GST_DEBUG_OBJECT (h265parse, "HEVC nal offset %d", nalu.offset + nalu.size);
 
     /* either way, have a look at it */
-    gst_h265_parse_process_nal (h265parse, &nalu);
+    gst_h265_parse_process_nal (h265parse, &nalu, buffer);
 
     /* dispatch per NALU if needed */
     if (h265parse->split_packetized) {
@@ -958,7 +990,7 @@ gst_h265_parse_handle_frame (GstBaseParse * parse,
         nalu.type == GST_H265_NAL_SPS ||
         nalu.type == GST_H265_NAL_PPS ||
         (h265parse->have_sps && h265parse->have_pps)) {
-      gst_h265_parse_process_nal (h265parse, &nalu);
+      gst_h265_parse_process_nal (h265parse, &nalu, buffer);
     } else {
       GST_WARNING_OBJECT (h265parse,
           "no SPS/PPS yet, nal Type: %d %s, Size: %u will be dropped",
@@ -1375,6 +1407,86 @@ gst_h265_parse_update_src_caps (GstH265Parse * h265parse, GstCaps * caps)
 
 }
 
+/* Collects the prefixed NALs of the frame into one buffer. The NAL
+ * payloads stay shared with the input, nothing is copied unless the
+ * buffer runs out of memory slots */
+static GstBuffer *
+gst_h265_parse_take_frame_out (GstH265Parse * h265parse, guint av)
+{
+  GList *list, *l;
+  GstBuffer *buf;
+  GstMapInfo map;
+  guint n_memories = 0;
+  gsize pos = 0;
+
+  list = gst_adapter_take_list (h265parse->frame_out, av);
+  for (l = list; l; l = l->next)
+    n_memories += gst_buffer_n_memory (l->data);
+
+  if (n_memories <= gst_buffer_get_max_memory ()) {
+    buf = list->data;
+    for (l = list->next; l; l = l->next)
+      buf = gst_buffer_append (buf, l->data);
+  } else {
+    /* every NAL has a memory for its prefix and one for its data, appending
+     * them all would merge the memories of the frame again and again, so
+     * copy the frame once instead */
+    buf = gst_buffer_new_allocate (NULL, av, NULL);
+    gst_buffer_map (buf, &map, GST_MAP_WRITE);
+    for (l = list; l; l = l->next) {
+      pos += gst_buffer_extract (l->data, 0, map.data + pos, av - pos);
+      gst_buffer_unref (l->data);
+    }
+    gst_buffer_unmap (buf, &map);
+  }
+  g_list_free (list);
+
+  return buf;
+}
+
+/* Replaces the NAL prefixes of the input frame by those of the output
+ * format, which have the same size */
+static void
+gst_h265_parse_transform_inplace (GstH265Parse * h265parse,
+    GstBaseParseFrame * frame)
+{
+  GstMapInfo map;
+  guint i, j, pos;
+  guint nl = h265parse->nal_length_size;
+  const gboolean bs = h265parse->format == GST_H265_PARSE_FORMAT_BYTE;
+
+  /* length prefixed to length prefixed, the input is already fine */
+  if (!bs && h265parse->packetized)
+    return;
+
+  GST_LOG_OBJECT (h265parse, "rewriting %u NAL prefixes in place",
+      h265parse->inplace_sizes->len);
+
+  /* only copies if the memory is shared with someone else */
+  frame->buffer = gst_buffer_make_writable (frame->buffer);
+  if (!gst_buffer_map (frame->buffer, &map, GST_MAP_READWRITE)) {
+    GST_WARNING_OBJECT (h265parse, "failed to map frame writable");
+    return;
+  }
+
+  if (bs)
+    nl = 4;
+
+  for (i = 0, pos = 0; i < h265parse->inplace_sizes->len; i++) {
+    guint size = g_array_index (h265parse->inplace_sizes, guint, i);
+
+    for (j = 0; j < nl; j++) {
+      if (bs)
+        map.data[pos + j] = j == nl - 1 ? 1 : 0;
+      else
+        map.data[pos + j] = size >> (8 * (nl - 1 - j));
+    }
+    pos += nl + size;
+  }
+
+  gst_buffer_unmap (frame->buffer, &map);
+}
+
 static GstFlowReturn
 gst_h265_parse_parse_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
 {
@@ -1401,11 +1513,18 @@ gst_h265_parse_parse_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
   if (av) {
     GstBuffer *buf;
 
-    buf = gst_adapter_take_buffer (h265parse->frame_out, av);
-    gst_buffer_copy_into (buf, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
-    gst_buffer_replace (&frame->out_buffer, buf);
-    gst_buffer_unref (buf);
+    if (h265parse->inplace
+        && h265parse->inplace_end == gst_buffer_get_size (buffer)) {
+      gst_adapter_clear (h265parse->frame_out);
+      gst_h265_parse_transform_inplace (h265parse, frame);
+    } else {
+      buf = gst_h265_parse_take_frame_out (h265parse, av);
+      gst_buffer_copy_into (buf, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
+      gst_buffer_replace (&frame->out_buffer, buf);
+      gst_buffer_unref (buf);
+    }
   }
+  gst_h265_parse_reset_inplace (h265parse);
 
   return GST_FLOW_OK;
 }
@@ -1416,12 +1535,8 @@ static GstFlowReturn
 gst_h265_parse_push_codec_buffer (GstH265Parse * h265parse, GstBuffer * nal,
     GstClockTime ts)
 {
-  GstMapInfo map;
-
-  gst_buffer_map (nal, &map, GST_MAP_READ);
-  nal = gst_h265_parse_wrap_nal (h265parse, h265parse->format,
-      map.data, map.size);
-  gst_buffer_unmap (nal, &map);
+  nal = gst_h265_parse_wrap_nal (h265parse, h265parse->format, nal, 0,
+      gst_buffer_get_size (nal));
 
   GST_BUFFER_TIMESTAMP (nal) = ts;
   GST_BUFFER_DURATION (nal) = 0;
@@ -1794,7 +1909,7 @@ gst_h265_parse_set_caps (GstBaseParse * parse, GstCaps * caps)
           goto hvcc_too_small;
         }
 
-        gst_h265_parse_process_nal (h265parse, &nalu);
+        gst_h265_parse_process_nal (h265parse, &nalu, codec_data);
         off = nalu.offset + nalu.size;
       }
     }
@@ -82,6 +82,11 @@ struct _GstH265Parse
   gint idr_pos, sei_pos;
   gboolean update_caps;
   GstAdapter *frame_out;
+  /* while TRUE, the transform can be done in the input frame: sizes of
+   * the NALs collected so far, which end at inplace_end */
+  gboolean inplace;
+  guint inplace_end;
+  GArray *inplace_sizes;
   gboolean keyframe;
   /* AU state */
   gboolean picture_start;
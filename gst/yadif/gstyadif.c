@@ -26,6 +26,10 @@
  * inverse telecine and deinterlace cases that are handled by the
  * deinterlace element.
  *
+ * Each output frame is interpolated from the previous, current and next
+ * input frame, so the output is delayed by one frame. With
+ * #GstYadif:double-rate one frame is output per field.
+ *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
@@ -68,14 +72,25 @@ static gboolean gst_yadif_start (GstBaseTransform * trans);
 static gboolean gst_yadif_stop (GstBaseTransform * trans);
 static GstFlowReturn gst_yadif_transform (GstBaseTransform * trans,
     GstBuffer * inbuf, GstBuffer * outbuf);
+static gboolean gst_yadif_sink_event (GstBaseTransform * trans,
+    GstEvent * event);
+static gboolean gst_yadif_query (GstBaseTransform * trans,
+    GstPadDirection direction, GstQuery * query);
 
 enum
 {
   PROP_0,
-  PROP_MODE
+  PROP_MODE,
+  PROP_DOUBLE_RATE,
+  PROP_N_THREADS
 };
 
 #define DEFAULT_MODE GST_DEINTERLACE_MODE_AUTO
+#define DEFAULT_DOUBLE_RATE FALSE
+#define DEFAULT_N_THREADS 0
+
+/* Minimum number of rows of a band that is filtered by one thread */
+#define MIN_SLICE_HEIGHT 16
 
 /* pad templates */
 
@@ -152,6 +167,8 @@ gst_yadif_class_init (GstYadifClass * klass)
   base_transform_class->start = GST_DEBUG_FUNCPTR (gst_yadif_start);
   base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_yadif_stop);
   base_transform_class->transform = GST_DEBUG_FUNCPTR (gst_yadif_transform);
+  base_transform_class->sink_event = GST_DEBUG_FUNCPTR (gst_yadif_sink_event);
+  base_transform_class->query = GST_DEBUG_FUNCPTR (gst_yadif_query);
 
   g_object_class_install_property (gobject_class, PROP_MODE,
       g_param_spec_enum ("mode", "Deinterlace Mode",
@@ -160,6 +177,17 @@ gst_yadif_class_init (GstYadifClass * klass)
           DEFAULT_MODE,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_DOUBLE_RATE,
+      g_param_spec_boolean ("double-rate", "Double rate",
+          "Output one frame per field at twice the input framerate",
+          DEFAULT_DOUBLE_RATE,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Number of threads",
+          "Number of threads used for filtering (0 = number of processors)",
+          0, G_MAXINT, DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -171,6 +199,9 @@ gst_yadif_init (GstYadif * yadif)
 
   yadif->srcpad = gst_pad_new_from_static_template (&gst_yadif_src_template,
       "src");
+
+  g_mutex_init (&yadif->lock);
+  g_cond_init (&yadif->cond);
 }
 
 void
@@ -183,6 +214,13 @@ gst_yadif_set_property (GObject * object, guint property_id,
     case PROP_MODE:
       yadif->mode = g_value_get_enum (value);
       break;
+    case PROP_DOUBLE_RATE:
+      yadif->double_rate = g_value_get_boolean (value);
+      gst_base_transform_reconfigure_src (GST_BASE_TRANSFORM (yadif));
+      break;
+    case PROP_N_THREADS:
+      yadif->n_threads = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -199,6 +237,12 @@ gst_yadif_get_property (GObject * object, guint property_id,
     case PROP_MODE:
       g_value_set_enum (value, yadif->mode);
       break;
+    case PROP_DOUBLE_RATE:
+      g_value_set_boolean (value, yadif->double_rate);
+      break;
+    case PROP_N_THREADS:
+      g_value_set_uint (value, yadif->n_threads);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -218,13 +262,48 @@ gst_yadif_dispose (GObject * object)
 void
 gst_yadif_finalize (GObject * object)
 {
-  /* GstYadif *yadif = GST_YADIF (object); */
+  GstYadif *yadif = GST_YADIF (object);
 
-  /* clean up object here */
+  g_mutex_clear (&yadif->lock);
+  g_cond_clear (&yadif->cond);
 
   G_OBJECT_CLASS (gst_yadif_parent_class)->finalize (object);
 }
 
+static void
+gst_yadif_scale_framerate (GstStructure * structure, gint num, gint den)
+{
+  const GValue *value;
+
+  value = gst_structure_get_value (structure, "framerate");
+  if (!value)
+    return;
+
+  if (GST_VALUE_HOLDS_FRACTION (value)) {
+    gint n, d;
+
+    if (gst_util_fraction_multiply (gst_value_get_fraction_numerator (value),
+            gst_value_get_fraction_denominator (value), num, den, &n, &d))
+      gst_structure_set (structure, "framerate", GST_TYPE_FRACTION, n, d,
+          NULL);
+  } else if (GST_VALUE_HOLDS_FRACTION_RANGE (value)) {
+    const GValue *min, *max;
+    gint min_n, min_d, max_n, max_d;
+
+    min = gst_value_get_fraction_range_min (value);
+    max = gst_value_get_fraction_range_max (value);
+
+    if (gst_util_fraction_multiply (gst_value_get_fraction_numerator (min),
+            gst_value_get_fraction_denominator (min), num, den, &min_n,
+            &min_d)
+        && gst_util_fraction_multiply (gst_value_get_fraction_numerator (max),
+            gst_value_get_fraction_denominator (max), num, den, &max_n,
+            &max_d))
+      gst_structure_set (structure, "framerate", GST_TYPE_FRACTION_RANGE,
+          min_n, min_d, max_n, max_d, NULL);
+  }
+}
+
 
 static GstCaps *
 gst_yadif_transform_caps (GstBaseTransform * trans,
@@ -256,16 +335,66 @@ gst_yadif_transform_caps (GstBaseTransform * trans,
         "progressive", NULL);
   }
 
+  if (GST_YADIF (trans)->double_rate) {
+    guint i;
+
+    for (i = 0; i < gst_caps_get_size (othercaps); i++) {
+      GstStructure *structure = gst_caps_get_structure (othercaps, i);
+
+      if (direction == GST_PAD_SINK)
+        gst_yadif_scale_framerate (structure, 2, 1);
+      else
+        gst_yadif_scale_framerate (structure, 1, 2);
+    }
+  }
+
+  if (filter) {
+    GstCaps *tmp;
+
+    tmp = gst_caps_intersect_full (filter, othercaps,
+        GST_CAPS_INTERSECT_FIRST);
+    gst_caps_unref (othercaps);
+    othercaps = tmp;
+  }
+
   return othercaps;
 }
 
+static void
+gst_yadif_clear_history (GstYadif * yadif)
+{
+  gst_buffer_replace (&yadif->prev_buf, NULL);
+  gst_buffer_replace (&yadif->cur_buf, NULL);
+  gst_buffer_replace (&yadif->next_buf, NULL);
+}
+
+/* Shifts @buffer into the history, NULL when draining */
+static void
+gst_yadif_push_history (GstYadif * yadif, GstBuffer * buffer)
+{
+  if (yadif->prev_buf)
+    gst_buffer_unref (yadif->prev_buf);
+  yadif->prev_buf = yadif->cur_buf;
+  yadif->cur_buf = yadif->next_buf;
+  yadif->next_buf = buffer ? gst_buffer_ref (buffer) : NULL;
+}
+
 static gboolean
 gst_yadif_set_caps (GstBaseTransform * trans, GstCaps * incaps,
     GstCaps * outcaps)
 {
   GstYadif *yadif = GST_YADIF (trans);
 
-  gst_video_info_from_caps (&yadif->video_info, incaps);
+  if (!gst_video_info_from_caps (&yadif->video_info, incaps))
+    return FALSE;
+
+  gst_yadif_clear_history (yadif);
+
+  /* The streaming thread filters one of the bands itself */
+  yadif->n_slices = yadif->pool ?
+      g_thread_pool_get_max_threads (yadif->pool) + 1 : 1;
+  yadif->n_slices = MAX (1, MIN (yadif->n_slices,
+          GST_VIDEO_INFO_HEIGHT (&yadif->video_info) / MIN_SLICE_HEIGHT));
 
   return TRUE;
 }
@@ -283,9 +412,43 @@ gst_yadif_get_unit_size (GstBaseTransform * trans, GstCaps * caps, gsize * size)
   return FALSE;
 }
 
+void yadif_filter (GstYadif * yadif, int parity, int tff, int slice,
+    int n_slices);
+
+static void
+gst_yadif_filter_slice (gpointer data, GstYadif * yadif)
+{
+  guint slice = GPOINTER_TO_UINT (data);
+
+  yadif_filter (yadif, yadif->parity, yadif->tff, slice, yadif->n_slices);
+
+  g_mutex_lock (&yadif->lock);
+  if (--yadif->pending_slices == 0)
+    g_cond_signal (&yadif->cond);
+  g_mutex_unlock (&yadif->lock);
+}
+
 static gboolean
 gst_yadif_start (GstBaseTransform * trans)
 {
+  GstYadif *yadif = GST_YADIF (trans);
+  guint n_threads = yadif->n_threads;
+
+  if (n_threads == 0) {
+#if GLIB_CHECK_VERSION (2, 36, 0)
+    n_threads = g_get_num_processors ();
+#else
+    n_threads = 1;
+#endif
+  }
+
+  if (n_threads > 1) {
+    yadif->pool =
+        g_thread_pool_new ((GFunc) gst_yadif_filter_slice, yadif,
+        n_threads - 1, FALSE, NULL);
+  }
+
+  GST_DEBUG_OBJECT (yadif, "Filtering with %u threads", n_threads);
 
   return TRUE;
 }
@@ -293,35 +456,103 @@ gst_yadif_start (GstBaseTransform * trans)
 static gboolean
 gst_yadif_stop (GstBaseTransform * trans)
 {
+  GstYadif *yadif = GST_YADIF (trans);
+
+  if (yadif->pool) {
+    g_thread_pool_free (yadif->pool, FALSE, TRUE);
+    yadif->pool = NULL;
+  }
+
+  gst_yadif_clear_history (yadif);
 
   return TRUE;
 }
 
-void yadif_filter (GstYadif * yadif, int parity, int tff);
+static void
+gst_yadif_filter (GstYadif * yadif, int parity, int tff)
+{
+  guint i;
+
+  if (!yadif->pool || yadif->n_slices < 2) {
+    yadif_filter (yadif, parity, tff, 0, 1);
+    return;
+  }
 
+  yadif->parity = parity;
+  yadif->tff = tff;
+  yadif->pending_slices = yadif->n_slices - 1;
+
+  for (i = 1; i < yadif->n_slices; i++)
+    g_thread_pool_push (yadif->pool, GUINT_TO_POINTER (i), NULL);
+
+  yadif_filter (yadif, parity, tff, 0, yadif->n_slices);
+
+  g_mutex_lock (&yadif->lock);
+  while (yadif->pending_slices > 0)
+    g_cond_wait (&yadif->cond, &yadif->lock);
+  g_mutex_unlock (&yadif->lock);
+}
+
+/* Renders the first (@is_second = FALSE) or second field of cur_buf
+ * into @outbuf */
 static GstFlowReturn
-gst_yadif_transform (GstBaseTransform * trans, GstBuffer * inbuf,
-    GstBuffer * outbuf)
+gst_yadif_render (GstYadif * yadif, GstBuffer * outbuf, gboolean is_second)
 {
-  GstYadif *yadif = GST_YADIF (trans);
-  int parity;
+  GstBuffer *cur = yadif->cur_buf;
+  GstBuffer *prev = yadif->prev_buf ? yadif->prev_buf : cur;
+  GstBuffer *next = yadif->next_buf ? yadif->next_buf : cur;
+  GstVideoInterlaceMode interlace_mode =
+      GST_VIDEO_INFO_INTERLACE_MODE (&yadif->video_info);
+  gboolean interlaced;
   int tff;
 
-  parity = 0;
-  tff = 0;
+  if (yadif->mode == GST_DEINTERLACE_MODE_DISABLED) {
+    interlaced = FALSE;
+  } else if (yadif->mode == GST_DEINTERLACE_MODE_INTERLACED) {
+    interlaced = TRUE;
+  } else {
+    interlaced = interlace_mode == GST_VIDEO_INTERLACE_MODE_INTERLEAVED ||
+        (interlace_mode == GST_VIDEO_INTERLACE_MODE_MIXED &&
+        GST_BUFFER_FLAG_IS_SET (cur, GST_VIDEO_BUFFER_FLAG_INTERLACED));
+  }
+
+  /* Progressive frames are treated as top field first */
+  if (interlace_mode == GST_VIDEO_INTERLACE_MODE_INTERLEAVED ||
+      GST_BUFFER_FLAG_IS_SET (cur, GST_VIDEO_BUFFER_FLAG_INTERLACED))
+    tff = GST_BUFFER_FLAG_IS_SET (cur, GST_VIDEO_BUFFER_FLAG_TFF) ? 1 : 0;
+  else
+    tff = 1;
 
   if (!gst_video_frame_map (&yadif->dest_frame, &yadif->video_info, outbuf,
           GST_MAP_WRITE))
     goto dest_map_failed;
 
-  if (!gst_video_frame_map (&yadif->cur_frame, &yadif->video_info, inbuf,
+  if (!gst_video_frame_map (&yadif->cur_frame, &yadif->video_info, cur,
           GST_MAP_READ))
     goto src_map_failed;
 
-  yadif->next_frame = yadif->cur_frame;
-  yadif->prev_frame = yadif->cur_frame;
-
-  yadif_filter (yadif, parity, tff);
+  if (interlaced) {
+    if (!gst_video_frame_map (&yadif->prev_frame, &yadif->video_info, prev,
+            GST_MAP_READ)) {
+      gst_video_frame_unmap (&yadif->cur_frame);
+      goto src_map_failed;
+    }
+    if (!gst_video_frame_map (&yadif->next_frame, &yadif->video_info, next,
+            GST_MAP_READ)) {
+      gst_video_frame_unmap (&yadif->prev_frame);
+      gst_video_frame_unmap (&yadif->cur_frame);
+      goto src_map_failed;
+    }
+
+    /* The first field in time is kept from the current frame for the first
+     * output frame, the other field for the second one */
+    gst_yadif_filter (yadif, tff ^ !is_second, tff);
+
+    gst_video_frame_unmap (&yadif->next_frame);
+    gst_video_frame_unmap (&yadif->prev_frame);
+  } else {
+    gst_video_frame_copy (&yadif->dest_frame, &yadif->cur_frame);
+  }
 
   gst_video_frame_unmap (&yadif->dest_frame);
   gst_video_frame_unmap (&yadif->cur_frame);
@@ -340,6 +571,187 @@ src_map_failed:
   }
 }
 
+static void
+gst_yadif_set_metadata (GstYadif * yadif, GstBuffer * outbuf,
+    GstClockTime timestamp, GstClockTime duration, gboolean discont)
+{
+  GST_BUFFER_PTS (outbuf) = timestamp;
+  GST_BUFFER_DTS (outbuf) = GST_CLOCK_TIME_NONE;
+  GST_BUFFER_DURATION (outbuf) = duration;
+  GST_BUFFER_OFFSET (outbuf) = GST_BUFFER_OFFSET_NONE;
+  GST_BUFFER_OFFSET_END (outbuf) = GST_BUFFER_OFFSET_NONE;
+
+  GST_BUFFER_FLAG_UNSET (outbuf, GST_VIDEO_BUFFER_FLAG_INTERLACED |
+      GST_VIDEO_BUFFER_FLAG_TFF | GST_VIDEO_BUFFER_FLAG_RFF |
+      GST_VIDEO_BUFFER_FLAG_ONEFIELD);
+  if (discont)
+    GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
+  else
+    GST_BUFFER_FLAG_UNSET (outbuf, GST_BUFFER_FLAG_DISCONT);
+}
+
+/* Produces the output for cur_buf into @outbuf. In double rate mode the
+ * frame of the first field is pushed from here */
+static GstFlowReturn
+gst_yadif_output (GstYadif * yadif, GstBuffer * outbuf)
+{
+  GstBaseTransform *trans = GST_BASE_TRANSFORM (yadif);
+  GstBuffer *cur = yadif->cur_buf;
+  GstClockTime timestamp = GST_BUFFER_PTS (cur);
+  GstClockTime duration = GST_BUFFER_DURATION (cur);
+  gboolean discont = GST_BUFFER_FLAG_IS_SET (cur, GST_BUFFER_FLAG_DISCONT);
+  GstFlowReturn ret;
+
+  if (!GST_CLOCK_TIME_IS_VALID (duration)) {
+    if (yadif->next_buf && GST_CLOCK_TIME_IS_VALID (timestamp)
+        && GST_BUFFER_PTS (yadif->next_buf) > timestamp)
+      duration = GST_BUFFER_PTS (yadif->next_buf) - timestamp;
+    else if (GST_VIDEO_INFO_FPS_N (&yadif->video_info) > 0)
+      duration = gst_util_uint64_scale_int (GST_SECOND,
+          GST_VIDEO_INFO_FPS_D (&yadif->video_info),
+          GST_VIDEO_INFO_FPS_N (&yadif->video_info));
+  }
+
+  if (yadif->double_rate) {
+    GstBufferPool *pool;
+    GstBuffer *first = NULL;
+    GstClockTime field_duration = GST_CLOCK_TIME_NONE;
+
+    if (GST_CLOCK_TIME_IS_VALID (duration))
+      field_duration = duration / 2;
+
+    pool = gst_base_transform_get_buffer_pool (trans);
+    if (pool) {
+      ret = gst_buffer_pool_acquire_buffer (pool, &first, NULL);
+      gst_object_unref (pool);
+      if (ret != GST_FLOW_OK)
+        return ret;
+    } else {
+      first = gst_buffer_new_allocate (NULL,
+          GST_VIDEO_INFO_SIZE (&yadif->video_info), NULL);
+    }
+
+    ret = gst_yadif_render (yadif, first, FALSE);
+    if (ret != GST_FLOW_OK) {
+      gst_buffer_unref (first);
+      return ret;
+    }
+    gst_yadif_set_metadata (yadif, first, timestamp, field_duration, discont);
+
+    ret = gst_pad_push (GST_BASE_TRANSFORM_SRC_PAD (trans), first);
+    if (ret != GST_FLOW_OK)
+      return ret;
+
+    ret = gst_yadif_render (yadif, outbuf, TRUE);
+    if (GST_CLOCK_TIME_IS_VALID (timestamp)
+        && GST_CLOCK_TIME_IS_VALID (field_duration))
+      timestamp += field_duration;
+    gst_yadif_set_metadata (yadif, outbuf, timestamp,
+        GST_CLOCK_TIME_IS_VALID (duration) ? duration - field_duration :
+        GST_CLOCK_TIME_NONE, FALSE);
+  } else {
+    ret = gst_yadif_render (yadif, outbuf, FALSE);
+    gst_yadif_set_metadata (yadif, outbuf, timestamp, duration, discont);
+  }
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_yadif_transform (GstBaseTransform * trans, GstBuffer * inbuf,
+    GstBuffer * outbuf)
+{
+  GstYadif *yadif = GST_YADIF (trans);
+
+  gst_yadif_push_history (yadif, inbuf);
+
+  /* Wait for the next frame */
+  if (!yadif->cur_buf)
+    return GST_BASE_TRANSFORM_FLOW_DROPPED;
+
+  return gst_yadif_output (yadif, outbuf);
+}
+
+/* Outputs the last frame, which has no next frame */
+static GstFlowReturn
+gst_yadif_drain (GstYadif * yadif)
+{
+  GstBaseTransform *trans = GST_BASE_TRANSFORM (yadif);
+  GstBuffer *outbuf;
+  GstFlowReturn ret;
+
+  if (!yadif->next_buf)
+    return GST_FLOW_OK;
+
+  gst_yadif_push_history (yadif, NULL);
+
+  outbuf = gst_buffer_new_allocate (NULL,
+      GST_VIDEO_INFO_SIZE (&yadif->video_info), NULL);
+  ret = gst_yadif_output (yadif, outbuf);
+  if (ret == GST_FLOW_OK)
+    ret = gst_pad_push (GST_BASE_TRANSFORM_SRC_PAD (trans), outbuf);
+  else
+    gst_buffer_unref (outbuf);
+
+  gst_yadif_clear_history (yadif);
+
+  return ret;
+}
+
+static gboolean
+gst_yadif_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstYadif *yadif = GST_YADIF (trans);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_EOS:
+    case GST_EVENT_CAPS:
+      /* Output the last frame before EOS or with the old caps */
+      gst_yadif_drain (yadif);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      gst_yadif_clear_history (yadif);
+      break;
+    default:
+      break;
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (gst_yadif_parent_class)->sink_event (trans,
+      event);
+}
+
+static gboolean
+gst_yadif_query (GstBaseTransform * trans, GstPadDirection direction,
+    GstQuery * query)
+{
+  GstYadif *yadif = GST_YADIF (trans);
+  gboolean ret;
+
+  ret = GST_BASE_TRANSFORM_CLASS (gst_yadif_parent_class)->query (trans,
+      direction, query);
+
+  /* Output is delayed by one frame */
+  if (ret && direction == GST_PAD_SRC
+      && GST_QUERY_TYPE (query) == GST_QUERY_LATENCY
+      && GST_VIDEO_INFO_FPS_N (&yadif->video_info) > 0) {
+    GstClockTime min, max, latency;
+    gboolean live;
+
+    gst_query_parse_latency (query, &live, &min, &max);
+
+    latency = gst_util_uint64_scale_int (GST_SECOND,
+        GST_VIDEO_INFO_FPS_D (&yadif->video_info),
+        GST_VIDEO_INFO_FPS_N (&yadif->video_info));
+    min += latency;
+    if (GST_CLOCK_TIME_IS_VALID (max))
+      max += latency;
+
+    gst_query_set_latency (query, live, min, max);
+  }
+
+  return ret;
+}
+
 
 static gboolean
 plugin_init (GstPlugin * plugin)
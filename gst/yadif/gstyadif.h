@@ -49,13 +49,30 @@ struct _GstYadif
   GstPad *srcpad;
 
   GstDeinterlaceMode mode;
+  gboolean double_rate;
+  guint n_threads;
 
   GstVideoInfo video_info;
 
+  /* Input history, output is produced for cur_buf once next_buf
+   * arrived */
+  GstBuffer *prev_buf;
+  GstBuffer *cur_buf;
+  GstBuffer *next_buf;
+
   GstVideoFrame prev_frame;
   GstVideoFrame cur_frame;
   GstVideoFrame next_frame;
   GstVideoFrame dest_frame;
+
+  /* Row bands of the frames are filtered in parallel */
+  GThreadPool *pool;
+  guint n_slices;
+  int parity;
+  int tff;
+  GMutex lock;
+  GCond cond;
+  guint pending_slices;
 };
 
 struct _GstYadifClass
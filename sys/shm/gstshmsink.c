@@ -472,7 +472,12 @@ gst_shm_sink_set_property (GObject * object, guint prop_id,
     case PROP_SHM_SIZE:
       GST_OBJECT_LOCK (object);
       if (self->pipe) {
-        if (sp_writer_resize (self->pipe, g_value_get_uint (value)) < 0) {
+        /* The old area is closed through the rings of the clients, wait
+         * until they have room for it */
+        while (sp_writer_ring_full (self->pipe) && !self->unlock)
+          g_cond_wait (&self->cond, GST_OBJECT_GET_LOCK (self));
+
+        if (sp_writer_resize (self->pipe, g_value_get_uint (value)) >= 0) {
           /* Swap allocators, so we can know immediately if the memory is
            * ours */
           gst_object_unref (self->allocator);
@@ -482,7 +487,9 @@ gst_shm_sink_set_property (GObject * object, guint prop_id,
               "%u bytes", self->size, g_value_get_uint (value));
         } else {
           GST_WARNING_OBJECT (self, "Could not resize shared memory area from"
-              "%u to %u bytes", self->size, g_value_get_uint (value));
+              " %u to %u bytes", self->size, g_value_get_uint (value));
+          GST_OBJECT_UNLOCK (object);
+          break;
         }
       }
       self->size = g_value_get_uint (value);
@@ -732,6 +739,17 @@ gst_shm_sink_render (GstBaseSink * bsink, GstBuffer * buf)
     sendbuf = gst_buffer_ref (buf);
   }
 
+  /* Clients reading through the ring wake up the poll thread once they
+   * have room for more buffers */
+  while (sp_writer_ring_full (self->pipe)) {
+    g_cond_wait (&self->cond, GST_OBJECT_GET_LOCK (self));
+    if (self->unlock) {
+      GST_OBJECT_UNLOCK (self);
+      gst_buffer_unref (sendbuf);
+      return GST_FLOW_FLUSHING;
+    }
+  }
+
   gst_buffer_map (sendbuf, &map, GST_MAP_READ);
   /* Make the memory readonly as of now as we've sent it to the other side
    * We know it's not mapped for writing anywhere as we just mapped it for
@@ -849,22 +867,20 @@ pollthread_func (gpointer data)
 
       if (gst_poll_fd_can_read (self->poll, &gclient->pollfd)) {
         int rv;
-        gpointer tag = NULL;
+        GSList *list = NULL;
 
+        /* Clients using the ring can acknowledge many buffers at once */
         GST_OBJECT_LOCK (self);
-        rv = sp_writer_recv (self->pipe, gclient->client, &tag);
+        rv = sp_writer_recv (self->pipe, gclient->client,
+            (sp_buffer_free_callback) free_buffer_locked, (void **) &list);
         GST_OBJECT_UNLOCK (self);
+        g_slist_free_full (list, (GDestroyNotify) gst_buffer_unref);
 
         if (rv < 0) {
           GST_WARNING_OBJECT (self, "One client has read error,"
               " closing (retval: %d errno: %d)", rv, errno);
           goto close_client;
         }
-
-        g_assert (rv == 0 || tag == NULL);
-
-        if (rv == 0)
-          gst_buffer_unref (tag);
       }
       continue;
     close_client:
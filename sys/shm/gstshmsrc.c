@@ -314,6 +314,18 @@ gst_shm_src_create (GstPushSrc * psrc, GstBuffer ** outbuf)
   struct GstShmBuffer *gsb;
 
   do {
+    /* Buffers queued in the ring don't make the socket readable */
+    GST_OBJECT_LOCK (self);
+    rv = sp_client_recv_pending (self->pipe->pipe, &buf);
+    GST_OBJECT_UNLOCK (self);
+    if (rv < 0) {
+      GST_ELEMENT_ERROR (self, RESOURCE, READ, ("Failed to read from shmsrc"),
+          ("Error reading control data: %d", rv));
+      return GST_FLOW_ERROR;
+    } else if (buf) {
+      break;
+    }
+
     if (gst_poll_wait (self->poll, GST_CLOCK_TIME_NONE) < 0) {
       if (errno == EBUSY)
         return GST_FLOW_FLUSHING;
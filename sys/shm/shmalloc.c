@@ -31,21 +31,57 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <assert.h>
 
+/*
+ * Blocks, free or not, tile the space exactly: an allocated block is as
+ * big as requested, so the space holds as many blocks as a plain first
+ * fit allocator would. All blocks are chained in address order, which
+ * gives the neighbours of a block to merge free blocks.
+ *
+ * Free blocks are kept in lists segregated by size class (the log2 of
+ * their size), with a bitmap of the non-empty classes, so that finding a
+ * free block big enough is a constant time operation. Blocks of the same
+ * size, like raw video frames, are reused from the head of their class.
+ *
+ * To find the block containing an offset, the space is divided in
+ * granules of a fixed size and a map holds, for each granule, the block
+ * containing its first byte. The block containing the offset is that one
+ * or one of the few blocks starting later in the same granule. Keeping
+ * the map up to date costs one store per granule of the smaller block
+ * when blocks are split or merged.
+ */
+
+#define SHM_ALLOC_MIN_GRANULE_SHIFT 8
+#define SHM_ALLOC_MAX_GRANULES (1 << 16)
+#define SHM_ALLOC_NUM_CLASSES 32
+
 /* This is the allocated space to hold multiple blocks */
 struct _ShmAllocSpace
 {
   /* The total size of this space */
   size_t size;
 
-  /* chained list of the blocks contained in this space */
-  ShmAllocBlock *blocks;
+  /* The size of the granules is 1 << granule_shift */
+  unsigned int granule_shift;
+  unsigned long n_granules;
+
+  /* For each granule, the block containing its first byte */
+  ShmAllocBlock **map;
+
+  /* Lists of free blocks per size class, and which ones are non-empty */
+  ShmAllocBlock *free_lists[SHM_ALLOC_NUM_CLASSES];
+  unsigned int free_classes;
+
+  /* Number of blocks currently allocated */
+  int n_allocated;
 };
 
 /* A single block of data */
 struct _ShmAllocBlock
 {
+  /* 0 if this block is free */
   int use_count;
 
   /* Pointer back to the AllocSpace where this block is */
@@ -56,10 +92,88 @@ struct _ShmAllocBlock
   /* The size of the block */
   unsigned long size;
 
-  /* Pointer to the next block in the chain */
+  /* Neighbours in address order */
+  ShmAllocBlock *prev;
   ShmAllocBlock *next;
+
+  /* Chaining in the free list of the size class, for free blocks */
+  ShmAllocBlock *prev_free;
+  ShmAllocBlock *next_free;
+
+  void *user_data;
 };
 
+static unsigned int
+shm_alloc_size_class (unsigned long size)
+{
+  unsigned int cls = 0;
+
+  while ((size >>= 1) && cls < SHM_ALLOC_NUM_CLASSES - 1)
+    cls++;
+
+  return cls;
+}
+
+/* Makes the granules whose first byte is in [@offset, @offset + @size)
+ * point to @block */
+static void
+shm_alloc_space_map_range (ShmAllocSpace * self, unsigned long offset,
+    unsigned long size, ShmAllocBlock * block)
+{
+  unsigned long granule, last;
+
+  if (size == 0)
+    return;
+
+  granule = (offset + (1UL << self->granule_shift) - 1) >> self->granule_shift;
+  last = (offset + size - 1) >> self->granule_shift;
+  for (; granule <= last; granule++)
+    self->map[granule] = block;
+}
+
+static void
+shm_alloc_space_insert_free (ShmAllocSpace * self, ShmAllocBlock * block)
+{
+  unsigned int cls = shm_alloc_size_class (block->size);
+
+  block->prev_free = NULL;
+  block->next_free = self->free_lists[cls];
+  if (block->next_free)
+    block->next_free->prev_free = block;
+  self->free_lists[cls] = block;
+  self->free_classes |= 1u << cls;
+}
+
+static void
+shm_alloc_space_remove_free (ShmAllocSpace * self, ShmAllocBlock * block)
+{
+  unsigned int cls = shm_alloc_size_class (block->size);
+
+  if (block->prev_free)
+    block->prev_free->next_free = block->next_free;
+  else
+    self->free_lists[cls] = block->next_free;
+  if (block->next_free)
+    block->next_free->prev_free = block->prev_free;
+  block->prev_free = block->next_free = NULL;
+
+  if (self->free_lists[cls] == NULL)
+    self->free_classes &= ~(1u << cls);
+}
+
+static ShmAllocBlock *
+shm_alloc_block_new (ShmAllocSpace * self, unsigned long offset,
+    unsigned long size)
+{
+  ShmAllocBlock *block = spalloc_new (ShmAllocBlock);
+
+  memset (block, 0, sizeof (ShmAllocBlock));
+  block->space = self;
+  block->offset = offset;
+  block->size = size;
+
+  return block;
+}
 
 ShmAllocSpace *
 shm_alloc_space_new (size_t size)
@@ -70,57 +184,112 @@ shm_alloc_space_new (size_t size)
 
   self->size = size;
 
+  self->granule_shift = SHM_ALLOC_MIN_GRANULE_SHIFT;
+  while ((size >> self->granule_shift) >= SHM_ALLOC_MAX_GRANULES)
+    self->granule_shift++;
+  self->n_granules = (size + (1UL << self->granule_shift) - 1) >>
+      self->granule_shift;
+
+  if (self->n_granules > 0) {
+    ShmAllocBlock *block;
+
+    self->map = spalloc_alloc (self->n_granules * sizeof (ShmAllocBlock *));
+
+    block = shm_alloc_block_new (self, 0, size);
+    shm_alloc_space_map_range (self, 0, size, block);
+    shm_alloc_space_insert_free (self, block);
+  }
+
   return self;
 }
 
 void
 shm_alloc_space_free (ShmAllocSpace * self)
 {
-  assert (self && self->blocks == NULL);
+  ShmAllocBlock *block, *next;
+
+  assert (self && self->n_allocated == 0);
+
+  /* Only free blocks are left */
+  for (block = self->map ? self->map[0] : NULL; block; block = next) {
+    assert (block->use_count == 0);
+    next = block->next;
+    spalloc_free (ShmAllocBlock, block);
+  }
+
+  if (self->map)
+    spalloc_free1 (self->n_granules * sizeof (ShmAllocBlock *), self->map);
   spalloc_free (ShmAllocSpace, self);
 }
 
-
 ShmAllocBlock *
 shm_alloc_space_alloc_block (ShmAllocSpace * self, unsigned long size)
 {
   ShmAllocBlock *block;
-  ShmAllocBlock *item = NULL;
-  ShmAllocBlock *prev_item = NULL;
-  unsigned long prev_end_offset = 0;
-
-
-  for (item = self->blocks; item; item = item->next) {
-    unsigned long max_size = 0;
-
-    max_size = item->offset - prev_end_offset;
+  unsigned int cls;
+  unsigned int classes;
 
-    if (max_size >= size)
-      break;
+  if (size > self->size)
+    return NULL;
 
-    prev_end_offset = item->offset + item->size;
-    prev_item = item;
+  /* Empty blocks would share their offset with another block */
+  if (size == 0)
+    size = 1;
+  cls = shm_alloc_size_class (size);
+
+  /* Blocks of the exact same size are the common case */
+  block = self->free_lists[cls];
+  if (!block || block->size < size) {
+    /* Any block of a bigger class is big enough */
+    classes = self->free_classes & ~((2u << cls) - 1);
+    if (classes) {
+      block = self->free_lists[ffs (classes) - 1];
+    } else {
+      /* Last resort, look at the whole list of our class */
+      for (block = self->free_lists[cls]; block; block = block->next_free)
+        if (block->size >= size)
+          break;
+      if (!block)
+        return NULL;
+    }
   }
 
-  /* Return NULL if there is no big enough space, otherwise, there is space
-   * at the end */
-  assert (prev_end_offset <= self->size);
-  if (!item && self->size - prev_end_offset < size)
-    return NULL;
+  shm_alloc_space_remove_free (self, block);
+
+  /* Carve the new block from the start of the free block and put what we
+   * don't need back in the free lists. The bigger part keeps the block
+   * structure, so that only the granules of the smaller one are mapped
+   * again */
+  if (block->size - size > size) {
+    ShmAllocBlock *rest = block;
+
+    block = shm_alloc_block_new (self, rest->offset, size);
+    block->prev = rest->prev;
+    block->next = rest;
+    if (block->prev)
+      block->prev->next = block;
+    rest->prev = block;
+    rest->offset += size;
+    rest->size -= size;
+    shm_alloc_space_map_range (self, block->offset, block->size, block);
+    shm_alloc_space_insert_free (self, rest);
+  } else if (block->size > size) {
+    ShmAllocBlock *rest = shm_alloc_block_new (self, block->offset + size,
+        block->size - size);
+
+    rest->prev = block;
+    rest->next = block->next;
+    if (rest->next)
+      rest->next->prev = rest;
+    block->next = rest;
+    block->size = size;
+    shm_alloc_space_map_range (self, rest->offset, rest->size, rest);
+    shm_alloc_space_insert_free (self, rest);
+  }
 
-  block = spalloc_new (ShmAllocBlock);
-  memset (block, 0, sizeof (ShmAllocBlock));
-  block->offset = prev_end_offset;
-  block->size = size;
   block->use_count = 1;
-  block->space = self;
-
-  if (prev_item)
-    prev_item->next = block;
-  else
-    self->blocks = block;
-
-  block->next = item;
+  block->user_data = NULL;
+  self->n_allocated++;
 
   return block;
 }
@@ -131,40 +300,89 @@ shm_alloc_space_alloc_block_get_offset (ShmAllocBlock * block)
   return block->offset;
 }
 
+/* Merges @right into @left, both being adjacent, and returns the block
+ * that remains. The map of the smaller one is updated */
+static ShmAllocBlock *
+shm_alloc_space_merge_blocks (ShmAllocSpace * self, ShmAllocBlock * left,
+    ShmAllocBlock * right)
+{
+  if (left->size >= right->size) {
+    shm_alloc_space_map_range (self, right->offset, right->size, left);
+    left->size += right->size;
+    left->next = right->next;
+    if (left->next)
+      left->next->prev = left;
+    spalloc_free (ShmAllocBlock, right);
+    return left;
+  } else {
+    shm_alloc_space_map_range (self, left->offset, left->size, right);
+    right->offset = left->offset;
+    right->size += left->size;
+    right->prev = left->prev;
+    if (right->prev)
+      right->prev->next = right;
+    spalloc_free (ShmAllocBlock, left);
+    return right;
+  }
+}
+
 static void
 shm_alloc_space_free_block (ShmAllocBlock * block)
 {
-  ShmAllocBlock *item = NULL;
-  ShmAllocBlock *prev_item = NULL;
   ShmAllocSpace *self = block->space;
+  ShmAllocBlock *neighbour;
 
-  for (item = self->blocks; item; item = item->next) {
-    if (item == block) {
-      if (prev_item)
-        prev_item->next = item->next;
-      else
-        self->blocks = item->next;
-      break;
-    }
-    prev_item = item;
+  block->use_count = 0;
+  block->user_data = NULL;
+  self->n_allocated--;
+
+  neighbour = block->prev;
+  if (neighbour && neighbour->use_count == 0) {
+    shm_alloc_space_remove_free (self, neighbour);
+    block = shm_alloc_space_merge_blocks (self, neighbour, block);
+  }
+
+  neighbour = block->next;
+  if (neighbour && neighbour->use_count == 0) {
+    shm_alloc_space_remove_free (self, neighbour);
+    block = shm_alloc_space_merge_blocks (self, block, neighbour);
   }
 
-  spalloc_free (ShmAllocBlock, block);
+  shm_alloc_space_insert_free (self, block);
 }
 
 ShmAllocBlock *
 shm_alloc_space_block_get (ShmAllocSpace * self, unsigned long offset)
 {
-  ShmAllocBlock *block = NULL;
+  ShmAllocBlock *block;
 
-  for (block = self->blocks; block; block = block->next) {
-    if (block->offset <= offset && (block->offset + block->size) > offset)
-      return block;
-  }
+  if (offset >= self->size)
+    return NULL;
+
+  /* Start from the block containing the start of the granule, blocks
+   * starting later in the granule follow it */
+  block = self->map[offset >> self->granule_shift];
+  while (block->next && block->next->offset <= offset)
+    block = block->next;
+
+  if (block->use_count > 0)
+    return block;
 
   return NULL;
 }
 
+void *
+shm_alloc_space_block_get_user_data (ShmAllocBlock * block)
+{
+  return block->user_data;
+}
+
+void
+shm_alloc_space_block_set_user_data (ShmAllocBlock * block, void *user_data)
+{
+  block->user_data = user_data;
+}
+
 
 void
 shm_alloc_space_block_inc (ShmAllocBlock * block)
@@ -66,6 +66,10 @@ void shm_alloc_space_block_dec (ShmAllocBlock * block);
 ShmAllocBlock * shm_alloc_space_block_get (ShmAllocSpace * space,
     unsigned long offset);
 
+void *shm_alloc_space_block_get_user_data (ShmAllocBlock * block);
+void shm_alloc_space_block_set_user_data (ShmAllocBlock * block,
+    void *user_data);
+
 
 #ifdef __cplusplus
 }
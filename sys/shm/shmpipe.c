@@ -70,6 +70,37 @@
  * Type 4 goes from the client to the server
  * The rest are from the server to the client
  * The client should never write in the SHM
+ *
+ * Ring extension:
+ *
+ * The server advertises it by appending RING_CAPABILITY after the NUL
+ * terminating the path of the first new shm area, which older clients
+ * ignore. A client supporting it replies with:
+ *
+ * type 5: ring request
+ * No payload
+ *
+ * The server then creates a ring area for that client and sends:
+ *
+ * type 6: ring area
+ * Same payload as type 1
+ *
+ * The client maps it (it is the only shm area a client writes to) and
+ * replies with type 7: ring ready, after which the server sends
+ * type 8: ring start. Old style buffers can arrive until then, so the
+ * client only looks at the ring once it got type 8.
+ *
+ * From then on, the server puts types 2 and 3 in the descriptor ring and
+ * the client puts its acks in the ack ring. New shm areas are still sent
+ * over the socket. Each side only wakes up the other with
+ *
+ * type 9: doorbell
+ * No payload
+ *
+ * when the other side said it was going to sleep by setting the wakeup
+ * flag of the ring, so many buffers and acks can be exchanged per
+ * syscall. If the ring area can't be used, the client doesn't reply and
+ * the old protocol is used.
  */
 
 
@@ -80,7 +111,83 @@ enum
   COMMAND_NEW_SHM_AREA = 1,
   COMMAND_CLOSE_SHM_AREA = 2,
   COMMAND_NEW_BUFFER = 3,
-  COMMAND_ACK_BUFFER = 4
+  COMMAND_ACK_BUFFER = 4,
+  COMMAND_RING_REQUEST = 5,
+  COMMAND_RING_AREA = 6,
+  COMMAND_RING_READY = 7,
+  COMMAND_RING_START = 8,
+  COMMAND_DOORBELL = 9
+};
+
+#define RING_CAPABILITY "ring1"
+#define RING_MAGIC 0x53485252   /* "SHRR" */
+#define RING_VERSION 1
+#define RING_CAPACITY 1024      /* entries in each ring, a power of two */
+#define RING_CACHE_LINE 64
+
+/* Full memory barrier, the rings are shared between processes */
+#define RING_BARRIER() __sync_synchronize ()
+
+typedef struct
+{
+  unsigned int type;
+  int area_id;
+  unsigned long offset;
+  unsigned long size;
+} RingEntry;
+
+/* Each index is only written by one side, and lives in its own cache line.
+ * Indexes are free running, the entry is at index % capacity */
+typedef struct
+{
+  unsigned int magic;
+  unsigned int version;
+  unsigned int capacity;
+  char _pad0[RING_CACHE_LINE - 3 * sizeof (unsigned int)];
+
+  /* Written by the server */
+  volatile unsigned int desc_head;
+  volatile unsigned int ack_tail;
+  char _pad1[RING_CACHE_LINE - 2 * sizeof (unsigned int)];
+
+  /* Written by the client */
+  volatile unsigned int desc_tail;
+  volatile unsigned int ack_head;
+  char _pad2[RING_CACHE_LINE - 2 * sizeof (unsigned int)];
+
+  /* Set by the side going to sleep, cleared by the side waking it up */
+  volatile unsigned int desc_wakeup;
+  volatile unsigned int ack_wakeup;
+  /* Set by the server when the descriptor ring is full */
+  volatile unsigned int space_wakeup;
+  char _pad3[RING_CACHE_LINE - 3 * sizeof (unsigned int)];
+
+  /* Followed by the descriptor ring and the ack ring */
+} RingHeader;
+
+#define RING_AREA_SIZE \
+  (sizeof (RingHeader) + 2 * RING_CAPACITY * sizeof (RingEntry))
+
+typedef struct _ShmRing ShmRing;
+
+struct _ShmRing
+{
+  int fd;
+  char *name;
+
+  RingHeader *header;
+  size_t len;
+
+  RingEntry *desc;
+  RingEntry *acks;
+};
+
+enum
+{
+  RING_STATE_NONE = 0,
+  /* Ring area sent to the client, waiting for it to be ready */
+  RING_STATE_SENT,
+  RING_STATE_ACTIVE
 };
 
 typedef struct _ShmArea ShmArea;
@@ -113,7 +220,13 @@ struct _ShmBuffer
 
   ShmAllocBlock *ablock;
 
+  /* Pending buffers list */
   ShmBuffer *next;
+  ShmBuffer *prev;
+
+  /* Other pending buffers sent from the same block, the head of this
+   * chain is the user data of the block */
+  ShmBuffer *block_next;
 
   void *tag;
 
@@ -140,12 +253,23 @@ struct _ShmPipe
   ShmClient *clients;
 
   mode_t perms;
+
+  /* Server: whether clients are offered the ring protocol */
+  int use_ring;
+
+  /* Client: the ring, and whether buffers come from it */
+  ShmRing *ring;
+  int ring_requested;
+  int ring_active;
 };
 
 struct _ShmClient
 {
   int fd;
 
+  ShmRing *ring;
+  int ring_state;
+
   ShmClient *next;
 };
 
@@ -184,8 +308,9 @@ struct CommandBuffer
 static ShmArea *sp_open_shm (char *path, int id, mode_t perms, size_t size);
 static void sp_close_shm (ShmArea * area);
 static int sp_shmbuf_dec (ShmPipe * self, ShmBuffer * buf,
-    ShmBuffer * prev_buf, ShmClient * client, void **tag);
+    ShmClient * client, void **tag);
 static void sp_shm_area_dec (ShmPipe * self, ShmArea * area);
+static void sp_close_ring (ShmRing * ring);
 
 
 
@@ -246,6 +371,7 @@ sp_writer_create (const char *path, size_t size, mode_t perms)
   self->shm_area = sp_open_shm (NULL, ++self->next_area_id, perms, size);
 
   self->perms = perms;
+  self->use_ring = 1;
 
   if (!self->shm_area)
     RETURN_ERROR ("Could not open shm area (%d): %s", errno, strerror (errno));
@@ -360,6 +486,92 @@ sp_close_shm (ShmArea * area)
   spalloc_free (ShmArea, area);
 }
 
+/**
+ * sp_open_ring:
+ * @path: Path of the ring area for a client,
+ *  NULL for the server (then it will allocate its own path)
+ *
+ * Opens a ShmRing, both sides map it for writing
+ */
+
+static ShmRing *
+sp_open_ring (const char *path, mode_t perms)
+{
+  ShmRing *ring = spalloc_new (ShmRing);
+  char tmppath[32];
+  void *buf;
+  int i = 0;
+
+  memset (ring, 0, sizeof (ShmRing));
+  ring->len = RING_AREA_SIZE;
+
+  if (path) {
+    ring->fd = shm_open (path, O_RDWR, 0);
+  } else {
+    do {
+      snprintf (tmppath, sizeof (tmppath), "/shmring.%5d.%5d", getpid (),
+          i++);
+      ring->fd = shm_open (tmppath, O_RDWR | O_CREAT | O_EXCL, perms);
+    } while (ring->fd < 0 && errno == EEXIST);
+  }
+
+  if (ring->fd < 0)
+    goto error;
+
+  if (!path) {
+    ring->name = strdup (tmppath);
+    /* fchmod() as the umask applies to shm_open() */
+    if (fchmod (ring->fd, perms) < 0 || ftruncate (ring->fd, ring->len) < 0)
+      goto error;
+  }
+
+  buf = mmap (NULL, ring->len, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd,
+      0);
+  if (buf == MAP_FAILED)
+    goto error;
+
+  ring->header = buf;
+  ring->desc = (RingEntry *) ((char *) buf + sizeof (RingHeader));
+  ring->acks = ring->desc + RING_CAPACITY;
+
+  if (!path) {
+    memset (ring->header, 0, sizeof (RingHeader));
+    ring->header->magic = RING_MAGIC;
+    ring->header->version = RING_VERSION;
+    ring->header->capacity = RING_CAPACITY;
+    /* Both sides start waiting */
+    ring->header->desc_wakeup = 1;
+    ring->header->ack_wakeup = 1;
+  } else if (ring->header->magic != RING_MAGIC ||
+      ring->header->version != RING_VERSION ||
+      ring->header->capacity != RING_CAPACITY) {
+    goto error;
+  }
+
+  return ring;
+
+error:
+  sp_close_ring (ring);
+  return NULL;
+}
+
+static void
+sp_close_ring (ShmRing * ring)
+{
+  if (ring->header)
+    munmap (ring->header, ring->len);
+
+  if (ring->fd >= 0)
+    close (ring->fd);
+
+  if (ring->name) {
+    shm_unlink (ring->name);
+    free (ring->name);
+  }
+
+  spalloc_free (ShmRing, ring);
+}
+
 static void
 sp_shm_area_inc (ShmArea * area)
 {
@@ -441,9 +653,20 @@ sp_writer_close (ShmPipe * self, sp_buffer_free_callback callback,
   while (self->clients)
     sp_writer_close_client (self, self->clients, callback, user_data);
 
+  if (self->ring) {
+    sp_close_ring (self->ring);
+    self->ring = NULL;
+  }
+
   sp_dec (self);
 }
 
+void
+sp_writer_set_use_ring (ShmPipe * self, int use_ring)
+{
+  self->use_ring = use_ring;
+}
+
 void
 sp_client_close (ShmPipe * self)
 {
@@ -480,6 +703,78 @@ send_command (int fd, struct CommandBuffer *cb, unsigned short int type,
   return 1;
 }
 
+static int
+send_doorbell (int fd)
+{
+  struct CommandBuffer cb = { 0 };
+
+  return send_command (fd, &cb, COMMAND_DOORBELL, 0);
+}
+
+static int
+sp_writer_ring_is_full (ShmClient * client)
+{
+  RingHeader *header = client->ring->header;
+
+  return header->desc_head - header->desc_tail >= RING_CAPACITY;
+}
+
+/* Returns 1 if the descriptor ring of a client is full. The client then
+ * sends a doorbell once it has taken a descriptor, so the caller can wait
+ * for the client socket to become readable before trying again */
+int
+sp_writer_ring_full (ShmPipe * self)
+{
+  ShmClient *client;
+  RingHeader *header;
+
+  for (client = self->clients; client; client = client->next) {
+    if (client->ring_state != RING_STATE_ACTIVE ||
+        !sp_writer_ring_is_full (client))
+      continue;
+
+    /* Ask to be woken up, and check again in case the client took
+     * something in the meantime */
+    header = client->ring->header;
+    header->space_wakeup = 1;
+    RING_BARRIER ();
+    if (sp_writer_ring_is_full (client))
+      return 1;
+    __sync_bool_compare_and_swap (&header->space_wakeup, 1, 0);
+  }
+
+  return 0;
+}
+
+/* Puts a descriptor in the ring of @client and wakes it up if needed,
+ * fails if the ring is full */
+static int
+sp_writer_ring_push (ShmClient * client, unsigned int type, int area_id,
+    unsigned long offset, unsigned long size)
+{
+  RingHeader *header = client->ring->header;
+  RingEntry *entry;
+
+  if (sp_writer_ring_is_full (client))
+    return 0;
+
+  entry = &client->ring->desc[header->desc_head % RING_CAPACITY];
+  entry->type = type;
+  entry->area_id = area_id;
+  entry->offset = offset;
+  entry->size = size;
+
+  RING_BARRIER ();
+  header->desc_head++;
+  RING_BARRIER ();
+
+  if (header->desc_wakeup &&
+      __sync_bool_compare_and_swap (&header->desc_wakeup, 1, 0))
+    return send_doorbell (client->fd);
+
+  return 1;
+}
+
 int
 sp_writer_resize (ShmPipe * self, size_t size)
 {
@@ -492,6 +787,15 @@ sp_writer_resize (ShmPipe * self, size_t size)
   if (self->shm_area->shm_area_len == size)
     return 0;
 
+  /* The close of the old area is queued in the ring of the clients using
+   * it, behind the buffers already there. Don't resize if it can't be, the
+   * caller can wait for room with sp_writer_ring_full() */
+  for (client = self->clients; client; client = client->next) {
+    if (client->ring_state == RING_STATE_ACTIVE &&
+        sp_writer_ring_is_full (client))
+      return -1;
+  }
+
   newarea = sp_open_shm (NULL, ++self->next_area_id, self->perms, size);
 
   if (!newarea)
@@ -506,7 +810,9 @@ sp_writer_resize (ShmPipe * self, size_t size)
   for (client = self->clients; client; client = client->next) {
     struct CommandBuffer cb = { 0 };
 
-    if (!send_command (client->fd, &cb, COMMAND_CLOSE_SHM_AREA,
+    /* With the ring, the close must come after the buffers in the ring */
+    if (client->ring_state != RING_STATE_ACTIVE &&
+        !send_command (client->fd, &cb, COMMAND_CLOSE_SHM_AREA,
             old_current->id))
       continue;
 
@@ -518,6 +824,11 @@ sp_writer_resize (ShmPipe * self, size_t size)
     if (send (client->fd, newarea->shm_area_name, pathlen, MSG_NOSIGNAL) !=
         pathlen)
       continue;
+
+    if (client->ring_state == RING_STATE_ACTIVE &&
+        !sp_writer_ring_push (client, COMMAND_CLOSE_SHM_AREA, old_current->id,
+            0, 0))
+      continue;
     c++;
   }
 
@@ -610,10 +921,18 @@ sp_writer_send_buf (ShmPipe * self, char *buf, size_t size, void *tag)
 
   for (client = self->clients; client; client = client->next) {
     struct CommandBuffer cb = { 0 };
-    cb.payload.buffer.offset = offset;
-    cb.payload.buffer.size = bsize;
-    if (!send_command (client->fd, &cb, COMMAND_NEW_BUFFER, self->shm_area->id))
-      continue;
+
+    if (client->ring_state == RING_STATE_ACTIVE) {
+      if (!sp_writer_ring_push (client, COMMAND_NEW_BUFFER, area->id, offset,
+              bsize))
+        continue;
+    } else {
+      cb.payload.buffer.offset = offset;
+      cb.payload.buffer.size = bsize;
+      if (!send_command (client->fd, &cb, COMMAND_NEW_BUFFER,
+              self->shm_area->id))
+        continue;
+    }
     sb->clients[i++] = client->fd;
     c++;
   }
@@ -629,17 +948,22 @@ sp_writer_send_buf (ShmPipe * self, char *buf, size_t size, void *tag)
   sb->use_count = c;
 
   sb->next = self->buffers;
+  if (self->buffers)
+    self->buffers->prev = sb;
   self->buffers = sb;
 
+  sb->block_next = shm_alloc_space_block_get_user_data (ablock);
+  shm_alloc_space_block_set_user_data (ablock, sb);
+
   return c;
 }
 
 static int
-recv_command (int fd, struct CommandBuffer *cb)
+recv_command (int fd, struct CommandBuffer *cb, int flags)
 {
   int retval;
 
-  retval = recv (fd, cb, sizeof (struct CommandBuffer), MSG_DONTWAIT);
+  retval = recv (fd, cb, sizeof (struct CommandBuffer), flags);
   if (retval == sizeof (struct CommandBuffer)) {
     return 1;
   } else {
@@ -647,33 +971,75 @@ recv_command (int fd, struct CommandBuffer *cb)
   }
 }
 
-long int
-sp_client_recv (ShmPipe * self, char **buf)
+static ShmArea *
+sp_find_area (ShmPipe * self, int id)
 {
-  char *area_name = NULL;
-  ShmArea *newarea;
   ShmArea *area;
-  struct CommandBuffer cb;
+
+  for (area = self->shm_area; area; area = area->next) {
+    if (area->id == id)
+      return area;
+  }
+
+  return NULL;
+}
+
+/* Receives the path following a new area command. If @extra is not NULL,
+ * it is set to the data after the NUL of the path, if any */
+static char *
+recv_area_path (ShmPipe * self, struct CommandBuffer *cb, char **extra)
+{
+  char *area_name;
+  size_t len;
   int retval;
 
-  if (!recv_command (self->main_socket, &cb))
-    return -1;
+  if (cb->payload.new_shm_area.path_size == 0 ||
+      cb->payload.new_shm_area.size == 0)
+    return NULL;
 
-  switch (cb.type) {
+  area_name = malloc (cb->payload.new_shm_area.path_size + 1);
+  retval = recv (self->main_socket, area_name,
+      cb->payload.new_shm_area.path_size, MSG_WAITALL);
+  if (retval != cb->payload.new_shm_area.path_size) {
+    free (area_name);
+    return NULL;
+  }
+  area_name[cb->payload.new_shm_area.path_size] = '\0';
+
+  if (extra) {
+    len = strlen (area_name) + 1;
+    *extra = len < cb->payload.new_shm_area.path_size ? area_name + len : NULL;
+  }
+
+  return area_name;
+}
+
+static int
+sp_client_handle_command (ShmPipe * self, struct CommandBuffer *cb,
+    char **buf)
+{
+  char *area_name = NULL;
+  char *extra = NULL;
+  ShmArea *newarea;
+  ShmArea *area;
+
+  switch (cb->type) {
     case COMMAND_NEW_SHM_AREA:
-      assert (cb.payload.new_shm_area.path_size > 0);
-      assert (cb.payload.new_shm_area.size > 0);
-
-      area_name = malloc (cb.payload.new_shm_area.path_size);
-      retval = recv (self->main_socket, area_name,
-          cb.payload.new_shm_area.path_size, 0);
-      if (retval != cb.payload.new_shm_area.path_size) {
-        free (area_name);
+      area_name = recv_area_path (self, cb, &extra);
+      if (!area_name)
         return -3;
-      }
 
-      newarea = sp_open_shm (area_name, cb.area_id, 0,
-          cb.payload.new_shm_area.size);
+      newarea = sp_open_shm (area_name, cb->area_id, 0,
+          cb->payload.new_shm_area.size);
+
+      /* The server offers the ring protocol */
+      if (newarea && extra && !strcmp (extra, RING_CAPABILITY) &&
+          !self->ring_requested) {
+        struct CommandBuffer req = { 0 };
+
+        self->ring_requested = 1;
+        send_command (self->main_socket, &req, COMMAND_RING_REQUEST, 0);
+      }
       free (area_name);
       if (!newarea)
         return -4;
@@ -683,24 +1049,46 @@ sp_client_recv (ShmPipe * self, char **buf)
       break;
 
     case COMMAND_CLOSE_SHM_AREA:
-      for (area = self->shm_area; area; area = area->next) {
-        if (area->id == cb.area_id) {
-          sp_shm_area_dec (self, area);
-          break;
-        }
-      }
+      area = sp_find_area (self, cb->area_id);
+      if (area)
+        sp_shm_area_dec (self, area);
       break;
 
     case COMMAND_NEW_BUFFER:
       assert (buf);
-      for (area = self->shm_area; area; area = area->next) {
-        if (area->id == cb.area_id) {
-          *buf = area->shm_area_buf + cb.payload.buffer.offset;
-          sp_shm_area_inc (area);
-          return cb.payload.buffer.size;
-        }
-      }
-      return -23;
+      area = sp_find_area (self, cb->area_id);
+      if (!area)
+        return -23;
+      *buf = area->shm_area_buf + cb->payload.buffer.offset;
+      sp_shm_area_inc (area);
+      return cb->payload.buffer.size;
+
+    case COMMAND_RING_AREA:
+    {
+      struct CommandBuffer ready = { 0 };
+
+      area_name = recv_area_path (self, cb, NULL);
+      if (!area_name)
+        return -3;
+
+      /* If we can't use the ring, stay with the old protocol */
+      if (!self->ring)
+        self->ring = sp_open_ring (area_name, 0);
+      free (area_name);
+      if (self->ring &&
+          !send_command (self->main_socket, &ready, COMMAND_RING_READY, 0))
+        return -5;
+      break;
+    }
+
+    case COMMAND_RING_START:
+      if (!self->ring)
+        return -99;
+      self->ring_active = 1;
+      break;
+
+    case COMMAND_DOORBELL:
+      break;
 
     default:
       return -99;
@@ -709,32 +1097,244 @@ sp_client_recv (ShmPipe * self, char **buf)
   return 0;
 }
 
+long int
+sp_client_recv (ShmPipe * self, char **buf)
+{
+  struct CommandBuffer cb;
+  long int ret;
+
+  if (!recv_command (self->main_socket, &cb, MSG_DONTWAIT))
+    return -1;
+
+  ret = sp_client_handle_command (self, &cb, buf);
+
+  /* The doorbell means there is something in the ring */
+  if (ret == 0 && cb.type == COMMAND_DOORBELL && buf)
+    ret = sp_client_recv_pending (self, buf);
+
+  return ret;
+}
+
+/* Releases the descriptor at the tail of the ring, and wakes up the
+ * server if it is waiting for room */
+static void
+sp_client_ring_next (ShmPipe * self)
+{
+  RingHeader *header = self->ring->header;
+
+  RING_BARRIER ();
+  header->desc_tail++;
+  RING_BARRIER ();
+
+  /* A failure shows up on the next read of the socket */
+  if (header->space_wakeup &&
+      __sync_bool_compare_and_swap (&header->space_wakeup, 1, 0))
+    send_doorbell (self->main_socket);
+}
+
+long int
+sp_client_recv_pending (ShmPipe * self, char **buf)
+{
+  RingHeader *header;
+  RingEntry *entry;
+  ShmArea *area;
+  long int ret;
+
+  if (!self->ring_active)
+    return 0;
+
+  header = self->ring->header;
+
+  for (;;) {
+    if (header->desc_tail == header->desc_head) {
+      /* Ask to be woken up, and check again in case the server added
+       * something in the meantime */
+      header->desc_wakeup = 1;
+      RING_BARRIER ();
+      if (header->desc_tail == header->desc_head)
+        return 0;
+      __sync_bool_compare_and_swap (&header->desc_wakeup, 1, 0);
+    }
+
+    RING_BARRIER ();
+    entry = &self->ring->desc[header->desc_tail % RING_CAPACITY];
+
+    area = sp_find_area (self, entry->area_id);
+    while (!area && entry->type == COMMAND_NEW_BUFFER) {
+      struct CommandBuffer cb;
+
+      /* New areas are sent over the socket before they are used in the
+       * ring. If the command isn't there yet, the socket becomes readable
+       * once it is, and the entry is retried after sp_client_recv() */
+      errno = 0;
+      if (!recv_command (self->main_socket, &cb, MSG_DONTWAIT))
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+      if (cb.type != COMMAND_NEW_SHM_AREA && cb.type != COMMAND_DOORBELL)
+        return -99;
+      ret = sp_client_handle_command (self, &cb, NULL);
+      if (ret < 0)
+        return ret;
+      area = sp_find_area (self, entry->area_id);
+    }
+
+    switch (entry->type) {
+      case COMMAND_NEW_BUFFER:
+        if (entry->offset > area->shm_area_len ||
+            entry->size > area->shm_area_len - entry->offset)
+          return -23;
+        *buf = area->shm_area_buf + entry->offset;
+        sp_shm_area_inc (area);
+        ret = entry->size;
+        sp_client_ring_next (self);
+        return ret;
+      case COMMAND_CLOSE_SHM_AREA:
+        if (area)
+          sp_shm_area_dec (self, area);
+        break;
+      default:
+        return -99;
+    }
+
+    sp_client_ring_next (self);
+  }
+}
+
+static int
+sp_writer_ack_buffer (ShmPipe * self, ShmClient * client, int area_id,
+    unsigned long offset, sp_buffer_free_callback callback, void *user_data)
+{
+  ShmBuffer *buf = NULL;
+  ShmArea *area = NULL;
+  ShmAllocBlock *ablock = NULL;
+  void *tag = NULL;
+
+  area = sp_find_area (self, area_id);
+  if (!area || !area->allocspace)
+    return -2;
+
+  /* Only the buffers sent from the block containing the offset can
+   * match, most recently sent first */
+  ablock = shm_alloc_space_block_get (area->allocspace, offset);
+  if (!ablock)
+    return -2;
+
+  for (buf = shm_alloc_space_block_get_user_data (ablock); buf;
+      buf = buf->block_next) {
+    if (buf->shm_area == area && buf->offset == offset) {
+      if (!sp_shmbuf_dec (self, buf, client, &tag) && callback)
+        callback (tag, user_data);
+      return 0;
+    }
+  }
+
+  return -2;
+}
+
+/* Processes the acks from the ring of @client */
+static int
+sp_writer_recv_ring (ShmPipe * self, ShmClient * client,
+    sp_buffer_free_callback callback, void *user_data)
+{
+  RingHeader *header = client->ring->header;
+  RingEntry *entry;
+  int ret = 0;
+
+  for (;;) {
+    while (header->ack_tail != header->ack_head) {
+      RING_BARRIER ();
+      entry = &client->ring->acks[header->ack_tail % RING_CAPACITY];
+      ret = sp_writer_ack_buffer (self, client, entry->area_id, entry->offset,
+          callback, user_data);
+      RING_BARRIER ();
+      header->ack_tail++;
+      if (ret < 0)
+        return ret;
+    }
+
+    /* Ask to be woken up, and check again in case the client added
+     * something in the meantime */
+    header->ack_wakeup = 1;
+    RING_BARRIER ();
+    if (header->ack_tail == header->ack_head)
+      return 0;
+    __sync_bool_compare_and_swap (&header->ack_wakeup, 1, 0);
+  }
+}
+
 int
-sp_writer_recv (ShmPipe * self, ShmClient * client, void **tag)
+sp_writer_recv (ShmPipe * self, ShmClient * client,
+    sp_buffer_free_callback callback, void *user_data)
 {
-  ShmBuffer *buf = NULL, *prev_buf = NULL;
   struct CommandBuffer cb;
+  int ret = 0;
 
-  if (!recv_command (client->fd, &cb))
+  if (!recv_command (client->fd, &cb, MSG_DONTWAIT))
     return -1;
 
   switch (cb.type) {
     case COMMAND_ACK_BUFFER:
+      ret = sp_writer_ack_buffer (self, client, cb.area_id,
+          cb.payload.ack_buffer.offset, callback, user_data);
+      break;
 
-      for (buf = self->buffers; buf; buf = buf->next) {
-        if (buf->shm_area->id == cb.area_id &&
-            buf->offset == cb.payload.ack_buffer.offset) {
-          return sp_shmbuf_dec (self, buf, prev_buf, client, tag);
-        }
-        prev_buf = buf;
-      }
+    case COMMAND_RING_REQUEST:
+    {
+      struct CommandBuffer area_cb = { 0 };
+      int pathlen;
+
+      if (client->ring)
+        return -99;
+      if (!self->use_ring)
+        break;
+
+      /* Whoever can read the buffers needs to write in its ring */
+      client->ring = sp_open_ring (NULL,
+          self->perms | ((self->perms & (S_IRGRP | S_IROTH)) >> 1));
+      /* Not fatal, the client will keep using the socket */
+      if (!client->ring)
+        break;
+
+      pathlen = strlen (client->ring->name) + 1;
+      area_cb.payload.new_shm_area.size = client->ring->len;
+      area_cb.payload.new_shm_area.path_size = pathlen;
+      if (!send_command (client->fd, &area_cb, COMMAND_RING_AREA, 0) ||
+          send (client->fd, client->ring->name, pathlen, MSG_NOSIGNAL) !=
+          pathlen)
+        return -5;
+      client->ring_state = RING_STATE_SENT;
+      break;
+    }
+
+    case COMMAND_RING_READY:
+    {
+      struct CommandBuffer start = { 0 };
+
+      if (client->ring_state != RING_STATE_SENT)
+        return -99;
+
+      /* Both sides have it mapped now */
+      shm_unlink (client->ring->name);
+      free (client->ring->name);
+      client->ring->name = NULL;
+
+      /* Buffers sent from now on go in the ring */
+      if (!send_command (client->fd, &start, COMMAND_RING_START, 0))
+        return -5;
+      client->ring_state = RING_STATE_ACTIVE;
+      break;
+    }
+
+    case COMMAND_DOORBELL:
+      break;
 
-      return -2;
     default:
       return -99;
   }
 
-  return 0;
+  if (ret >= 0 && client->ring_state == RING_STATE_ACTIVE)
+    ret = sp_writer_recv_ring (self, client, callback, user_data);
+
+  return ret < 0 ? ret : 0;
 }
 
 int
@@ -754,6 +1354,31 @@ sp_client_recv_finish (ShmPipe * self, char *buf)
 
   offset = buf - shm_area->shm_area_buf;
 
+  if (self->ring_active) {
+    RingHeader *header = self->ring->header;
+
+    /* If the ack ring is full, just use the socket */
+    if (header->ack_head - header->ack_tail < RING_CAPACITY) {
+      RingEntry *entry = &self->ring->acks[header->ack_head % RING_CAPACITY];
+      int area_id = shm_area->id;
+
+      sp_shm_area_dec (self, shm_area);
+
+      entry->type = COMMAND_ACK_BUFFER;
+      entry->area_id = area_id;
+      entry->offset = offset;
+      entry->size = 0;
+      RING_BARRIER ();
+      header->ack_head++;
+      RING_BARRIER ();
+
+      if (header->ack_wakeup &&
+          __sync_bool_compare_and_swap (&header->ack_wakeup, 1, 0))
+        return send_doorbell (self->main_socket);
+      return 1;
+    }
+  }
+
   sp_shm_area_dec (self, shm_area);
 
   cb.payload.ack_buffer.offset = offset;
@@ -805,7 +1430,17 @@ sp_writer_accept_client (ShmPipe * self)
   int fd;
   struct CommandBuffer cb = { 0 };
   int pathlen = strlen (self->shm_area->shm_area_name) + 1;
+  /* Area names are at most 32 bytes */
+  char path[32 + sizeof (RING_CAPABILITY)];
+
+  assert (pathlen <= 32);
+  memcpy (path, self->shm_area->shm_area_name, pathlen);
 
+  /* Older clients stop at the NUL of the path, and ignore the rest */
+  if (self->use_ring) {
+    memcpy (path + pathlen, RING_CAPABILITY, sizeof (RING_CAPABILITY));
+    pathlen += sizeof (RING_CAPABILITY);
+  }
 
   fd = accept (self->main_socket, NULL, NULL);
 
@@ -821,13 +1456,13 @@ sp_writer_accept_client (ShmPipe * self)
     goto error;
   }
 
-  if (send (fd, self->shm_area->shm_area_name, pathlen, MSG_NOSIGNAL) !=
-      pathlen) {
+  if (send (fd, path, pathlen, MSG_NOSIGNAL) != pathlen) {
     fprintf (stderr, "Sending new shm area path failed: %s", strerror (errno));
     goto error;
   }
 
   client = spalloc_new (ShmClient);
+  memset (client, 0, sizeof (ShmClient));
   client->fd = fd;
 
   /* Prepend ot linked list */
@@ -844,8 +1479,8 @@ error:
 }
 
 static int
-sp_shmbuf_dec (ShmPipe * self, ShmBuffer * buf, ShmBuffer * prev_buf,
-    ShmClient * client, void **tag)
+sp_shmbuf_dec (ShmPipe * self, ShmBuffer * buf, ShmClient * client,
+    void **tag)
 {
   int i;
   int had_client = 0;
@@ -868,11 +1503,28 @@ sp_shmbuf_dec (ShmPipe * self, ShmBuffer * buf, ShmBuffer * prev_buf,
   buf->use_count--;
 
   if (buf->use_count == 0) {
+    ShmBuffer *item, *prev_item = NULL;
+
     /* Remove from linked list */
-    if (prev_buf)
-      prev_buf->next = buf->next;
+    if (buf->prev)
+      buf->prev->next = buf->next;
     else
       self->buffers = buf->next;
+    if (buf->next)
+      buf->next->prev = buf->prev;
+
+    /* Remove from the buffers of the block */
+    for (item = shm_alloc_space_block_get_user_data (buf->ablock); item;
+        item = item->block_next) {
+      if (item == buf) {
+        if (prev_item)
+          prev_item->block_next = item->block_next;
+        else
+          shm_alloc_space_block_set_user_data (buf->ablock, item->block_next);
+        break;
+      }
+      prev_item = item;
+    }
 
     if (tag)
       *tag = buf->tag;
@@ -888,7 +1540,7 @@ void
 sp_writer_close_client (ShmPipe * self, ShmClient * client,
     sp_buffer_free_callback callback, void *user_data)
 {
-  ShmBuffer *buffer = NULL, *prev_buf = NULL;
+  ShmBuffer *buffer = NULL;
   ShmClient *item = NULL, *prev_item = NULL;
 
   shutdown (client->fd, SHUT_RDWR);
@@ -901,7 +1553,7 @@ again:
 
     for (i = 0; i < buffer->num_clients; i++) {
       if (buffer->clients[i] == client->fd) {
-        if (!sp_shmbuf_dec (self, buffer, prev_buf, client, &tag)) {
+        if (!sp_shmbuf_dec (self, buffer, client, &tag)) {
           if (callback)
             callback (tag, user_data);
           goto again;
@@ -909,7 +1561,6 @@ again:
         break;
       }
     }
-    prev_buf = buffer;
   }
 
   for (item = self->clients; item; item = item->next) {
@@ -926,6 +1577,9 @@ again:
 
   self->num_clients--;
 
+  if (client->ring)
+    sp_close_ring (client->ring);
+
   spalloc_free (ShmClient, client);
 }
 
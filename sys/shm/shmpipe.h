@@ -103,7 +103,10 @@ size_t sp_writer_get_max_buf_size (ShmPipe * self);
 ShmClient * sp_writer_accept_client (ShmPipe * self);
 void sp_writer_close_client (ShmPipe *self, ShmClient * client,
     sp_buffer_free_callback callback, void * user_data);
-int sp_writer_recv (ShmPipe * self, ShmClient * client, void ** tag);
+int sp_writer_recv (ShmPipe * self, ShmClient * client,
+    sp_buffer_free_callback callback, void * user_data);
+void sp_writer_set_use_ring (ShmPipe * self, int use_ring);
+int sp_writer_ring_full (ShmPipe * self);
 
 int sp_writer_pending_writes (ShmPipe * self);
 
@@ -113,6 +116,7 @@ void *sp_writer_buf_get_tag (ShmBuffer * buffer);
 
 ShmPipe *sp_client_open (const char *path);
 long int sp_client_recv (ShmPipe * self, char **buf);
+long int sp_client_recv_pending (ShmPipe * self, char **buf);
 int sp_client_recv_finish (ShmPipe * self, char *buf);
 void sp_client_close (ShmPipe * self);
 
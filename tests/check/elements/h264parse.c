@@ -36,6 +36,13 @@ GstStaticPadTemplate sinktemplate_bs_nal = GST_STATIC_PAD_TEMPLATE ("sink",
         ", stream-format = (string) byte-stream, alignment = (string) nal")
     );
 
+GstStaticPadTemplate sinktemplate_bs_au = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (SINK_CAPS_TMPL
+        ", stream-format = (string) byte-stream, alignment = (string) au")
+    );
+
 GstStaticPadTemplate sinktemplate_avc_au = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
@@ -101,6 +108,11 @@ static guint8 h264_idrframe[] = {
   0x56, 0x04, 0x50, 0x96, 0x7b, 0x3f, 0x53, 0xe1
 };
 
+/* access unit delimiter */
+static guint8 h264_aud[] = {
+  0x00, 0x00, 0x00, 0x01, 0x09, 0xf0
+};
+
 /* truncated nal */
 static guint8 garbage_frame[] = {
   0x00, 0x00, 0x00, 0x01, 0x05
@@ -357,6 +369,144 @@ h264parse_packetized_suite (void)
 }
 
 
+/* Appends @nal, which starts with a 4 byte start code, to @data with a
+ * start code or a 4 byte length prefix */
+static void
+append_nal (GByteArray * data, const guint8 * nal, guint size, gboolean avc)
+{
+  guint8 prefix[4] = { 0x00, 0x00, 0x00, 0x01 };
+
+  if (avc)
+    GST_WRITE_UINT32_BE (prefix, size - 4);
+  g_byte_array_append (data, prefix, 4);
+  g_byte_array_append (data, nal + 4, size - 4);
+}
+
+/* Converts frames with several NALs, and checks the bytes of all of them.
+ * The NAL prefixes of the frames are rewritten in place, which must work
+ * for every frame and not only for the first one */
+static void
+run_convert_test (gboolean avc_in, GstStaticPadTemplate * sink_template)
+{
+  GstElement *h264parse;
+  GstPad *src, *sink;
+  GstCaps *caps;
+  GByteArray *expected, *output;
+  GList *l;
+  guint i, j;
+  const guint n_frames = 5, n_slices = 3;
+
+  h264parse = gst_check_setup_element ("h264parse");
+  src = gst_check_setup_src_pad (h264parse, &srctemplate);
+  sink = gst_check_setup_sink_pad (h264parse, sink_template);
+  gst_pad_set_active (src, TRUE);
+  gst_pad_set_active (sink, TRUE);
+  fail_unless_equals_int (gst_element_set_state (h264parse, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_SUCCESS);
+
+  expected = g_byte_array_new ();
+  append_nal (expected, h264_sps, sizeof (h264_sps), !avc_in);
+  append_nal (expected, h264_pps, sizeof (h264_pps), !avc_in);
+
+  if (avc_in) {
+    GstBuffer *cdata;
+
+    caps = gst_caps_from_string (SRC_CAPS_TMPL
+        ", stream-format = (string) avc, alignment = (string) au");
+    cdata = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
+        h264_avc_codec_data, sizeof (h264_avc_codec_data), 0,
+        sizeof (h264_avc_codec_data), NULL, NULL);
+    gst_caps_set_simple (caps, "codec_data", GST_TYPE_BUFFER, cdata, NULL);
+    gst_buffer_unref (cdata);
+  } else {
+    caps = gst_caps_from_string (SRC_CAPS_TMPL
+        ", stream-format = (string) byte-stream");
+  }
+  gst_check_setup_events (src, h264parse, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  /* the SPS and PPS come from the codec data for AVC input, they are
+   * inserted in front of the first frame */
+  for (i = 0; i < n_frames; i++) {
+    GByteArray *frame = g_byte_array_new ();
+    GstBuffer *buffer;
+    gsize size;
+
+    if (!avc_in && i == 0) {
+      append_nal (frame, h264_sps, sizeof (h264_sps), FALSE);
+      append_nal (frame, h264_pps, sizeof (h264_pps), FALSE);
+    }
+    /* byte-stream AUs are delimited by the AUD */
+    if (!avc_in) {
+      append_nal (frame, h264_aud, sizeof (h264_aud), FALSE);
+      append_nal (expected, h264_aud, sizeof (h264_aud), TRUE);
+    }
+    for (j = 0; j < n_slices; j++) {
+      append_nal (frame, h264_idrframe, sizeof (h264_idrframe), avc_in);
+      append_nal (expected, h264_idrframe, sizeof (h264_idrframe), !avc_in);
+      /* only one slice per byte-stream AU, any other would start a new
+       * picture */
+      if (!avc_in)
+        break;
+    }
+
+    size = frame->len;
+    buffer = gst_buffer_new_wrapped (g_byte_array_free (frame, FALSE), size);
+    fail_unless_equals_int (gst_pad_push (src, buffer), GST_FLOW_OK);
+  }
+  fail_unless (gst_pad_push_event (src, gst_event_new_eos ()));
+
+  /* AVC input gives one output buffer per input buffer, the SPS and the PPS
+   * of the byte-stream are part of the first AU */
+  fail_unless_equals_int (g_list_length (buffers), n_frames);
+  output = g_byte_array_new ();
+  for (l = buffers; l; l = l->next) {
+    GstMapInfo map;
+
+    gst_buffer_map (l->data, &map, GST_MAP_READ);
+    g_byte_array_append (output, map.data, map.size);
+    gst_buffer_unmap (l->data, &map);
+  }
+  fail_unless_equals_int (output->len, expected->len);
+  fail_unless (memcmp (output->data, expected->data, expected->len) == 0);
+
+  g_byte_array_free (output, TRUE);
+  g_byte_array_free (expected, TRUE);
+  gst_check_drop_buffers ();
+  gst_element_set_state (h264parse, GST_STATE_NULL);
+  gst_check_teardown_src_pad (h264parse);
+  gst_check_teardown_sink_pad (h264parse);
+  gst_check_teardown_element (h264parse);
+}
+
+GST_START_TEST (test_parse_avc_to_bs_frames)
+{
+  run_convert_test (TRUE, &sinktemplate_bs_au);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parse_bs_to_avc_frames)
+{
+  run_convert_test (FALSE, &sinktemplate_avc_au);
+}
+
+GST_END_TEST;
+
+static Suite *
+h264parse_convert_suite (void)
+{
+  Suite *s = suite_create ("h264parse_convert");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_parse_avc_to_bs_frames);
+  tcase_add_test (tc_chain, test_parse_bs_to_avc_frames);
+
+  return s;
+}
+
+
 /*
  * TODO:
  *   - Both push- and pull-modes need to be tested
@@ -446,5 +596,11 @@ main (int argc, char **argv)
   nf += srunner_ntests_failed (sr);
   srunner_free (sr);
 
+  s = h264parse_convert_suite ();
+  sr = srunner_create (s);
+  srunner_run_all (sr, CK_NORMAL);
+  nf += srunner_ntests_failed (sr);
+  srunner_free (sr);
+
   return nf;
 }
@@ -0,0 +1,241 @@
+/*
+ * GStreamer
+ *
+ * unit test for h265parse
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+
+#define SRC_CAPS_TMPL   "video/x-h265, parsed=(boolean)false"
+#define SINK_CAPS_TMPL  "video/x-h265, parsed=(boolean)true"
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (SRC_CAPS_TMPL)
+    );
+
+static GstStaticPadTemplate sinktemplate_bs_au =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (SINK_CAPS_TMPL
+        ", stream-format = (string) byte-stream, alignment = (string) au")
+    );
+
+static GstStaticPadTemplate sinktemplate_hvc1_au =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (SINK_CAPS_TMPL
+        ", stream-format = (string) hvc1, alignment = (string) au")
+    );
+
+/* Main profile 128x64 parameter sets, with 64x64 CTBs */
+static guint8 h265_vps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x40, 0x01, 0x0c, 0x01,
+  0xff, 0xff, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00,
+  0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00,
+  0x5d, 0xf0, 0x24
+};
+
+static guint8 h265_sps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x42, 0x01, 0x01, 0x01,
+  0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00,
+  0x03, 0x00, 0x00, 0x03, 0x00, 0x5d, 0xa0, 0x10,
+  0x20, 0x41, 0x65, 0xf9, 0x24, 0xc2, 0x08
+};
+
+static guint8 h265_pps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x44, 0x01, 0xc0, 0x71,
+  0x80, 0x12
+};
+
+/* access unit delimiter */
+static guint8 h265_aud[] = {
+  0x00, 0x00, 0x00, 0x01, 0x46, 0x01, 0x10
+};
+
+/* IDR I slice segment starting the picture */
+static guint8 h265_idr_first[] = {
+  0x00, 0x00, 0x00, 0x01, 0x26, 0x01, 0xaf, 0xaf,
+  0x27, 0x5c, 0x11, 0x8e, 0xd0
+};
+
+/* IDR I slice segment of the same picture at the second CTB */
+static guint8 h265_idr_next[] = {
+  0x00, 0x00, 0x00, 0x01, 0x26, 0x01, 0x37, 0x80,
+  0xaf, 0x27, 0x5c, 0x11, 0x8e, 0xd0
+};
+
+/* hvcC with the VPS, SPS and PPS above, 4 byte NAL lengths */
+static guint8 h265_hvcc_codec_data[] = {
+  0x01, 0x01, 0x60, 0x00, 0x00, 0x00, 0x90, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x5d, 0xf0, 0x00, 0xfc,
+  0xfd, 0xf8, 0xf8, 0x00, 0x00, 0x0f, 0x03, 0xa0,
+  0x00, 0x01, 0x00, 0x17, 0x40, 0x01, 0x0c, 0x01,
+  0xff, 0xff, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00,
+  0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00,
+  0x5d, 0xf0, 0x24, 0xa1, 0x00, 0x01, 0x00, 0x1b,
+  0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03,
+  0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03,
+  0x00, 0x5d, 0xa0, 0x10, 0x20, 0x41, 0x65, 0xf9,
+  0x24, 0xc2, 0x08, 0xa2, 0x00, 0x01, 0x00, 0x06,
+  0x44, 0x01, 0xc0, 0x71, 0x80, 0x12
+};
+
+/* Appends @nal, which starts with a 4 byte start code, to @data with a
+ * start code or a 4 byte length prefix */
+static void
+append_nal (GByteArray * data, const guint8 * nal, guint size, gboolean hvc)
+{
+  guint8 prefix[4] = { 0x00, 0x00, 0x00, 0x01 };
+
+  if (hvc)
+    GST_WRITE_UINT32_BE (prefix, size - 4);
+  g_byte_array_append (data, prefix, 4);
+  g_byte_array_append (data, nal + 4, size - 4);
+}
+
+/* Converts frames with several NALs, and checks the bytes of all of them.
+ * The NAL prefixes of the frames are rewritten in place, which must work
+ * for every frame and not only for the first one */
+static void
+run_convert_test (gboolean hvc_in, GstStaticPadTemplate * sink_template)
+{
+  GstElement *h265parse;
+  GstPad *src, *sink;
+  GstCaps *caps;
+  GByteArray *expected, *output;
+  GList *l;
+  guint i, j;
+  const guint n_frames = 5, n_slices = 3;
+
+  h265parse = gst_check_setup_element ("h265parse");
+  src = gst_check_setup_src_pad (h265parse, &srctemplate);
+  sink = gst_check_setup_sink_pad (h265parse, sink_template);
+  gst_pad_set_active (src, TRUE);
+  gst_pad_set_active (sink, TRUE);
+  fail_unless_equals_int (gst_element_set_state (h265parse, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_SUCCESS);
+
+  expected = g_byte_array_new ();
+  append_nal (expected, h265_vps, sizeof (h265_vps), !hvc_in);
+  append_nal (expected, h265_sps, sizeof (h265_sps), !hvc_in);
+  append_nal (expected, h265_pps, sizeof (h265_pps), !hvc_in);
+
+  if (hvc_in) {
+    GstBuffer *cdata;
+
+    caps = gst_caps_from_string (SRC_CAPS_TMPL
+        ", stream-format = (string) hvc1, alignment = (string) au");
+    cdata = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
+        h265_hvcc_codec_data, sizeof (h265_hvcc_codec_data), 0,
+        sizeof (h265_hvcc_codec_data), NULL, NULL);
+    gst_caps_set_simple (caps, "codec_data", GST_TYPE_BUFFER, cdata, NULL);
+    gst_buffer_unref (cdata);
+  } else {
+    caps = gst_caps_from_string (SRC_CAPS_TMPL
+        ", stream-format = (string) byte-stream");
+  }
+  gst_check_setup_events (src, h265parse, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  /* the parameter sets come from the codec data for hvc1 input, they are
+   * inserted in front of the first frame */
+  for (i = 0; i < n_frames; i++) {
+    GByteArray *frame = g_byte_array_new ();
+    GstBuffer *buffer;
+    gsize size;
+
+    if (!hvc_in && i == 0) {
+      append_nal (frame, h265_vps, sizeof (h265_vps), FALSE);
+      append_nal (frame, h265_sps, sizeof (h265_sps), FALSE);
+      append_nal (frame, h265_pps, sizeof (h265_pps), FALSE);
+    }
+    /* byte-stream AUs are delimited by the AUD */
+    if (!hvc_in) {
+      append_nal (frame, h265_aud, sizeof (h265_aud), FALSE);
+      append_nal (expected, h265_aud, sizeof (h265_aud), TRUE);
+    }
+    for (j = 0; j < n_slices; j++) {
+      const guint8 *slice = j == 0 ? h265_idr_first : h265_idr_next;
+      guint slice_size =
+          j == 0 ? sizeof (h265_idr_first) : sizeof (h265_idr_next);
+
+      append_nal (frame, slice, slice_size, hvc_in);
+      append_nal (expected, slice, slice_size, !hvc_in);
+    }
+
+    size = frame->len;
+    buffer = gst_buffer_new_wrapped (g_byte_array_free (frame, FALSE), size);
+    fail_unless_equals_int (gst_pad_push (src, buffer), GST_FLOW_OK);
+  }
+  fail_unless (gst_pad_push_event (src, gst_event_new_eos ()));
+
+  /* one output buffer per input AU, the parameter sets of the byte-stream
+   * are part of the first AU */
+  fail_unless_equals_int (g_list_length (buffers), n_frames);
+  output = g_byte_array_new ();
+  for (l = buffers; l; l = l->next) {
+    GstMapInfo map;
+
+    gst_buffer_map (l->data, &map, GST_MAP_READ);
+    g_byte_array_append (output, map.data, map.size);
+    gst_buffer_unmap (l->data, &map);
+  }
+  fail_unless_equals_int (output->len, expected->len);
+  fail_unless (memcmp (output->data, expected->data, expected->len) == 0);
+
+  g_byte_array_free (output, TRUE);
+  g_byte_array_free (expected, TRUE);
+  gst_check_drop_buffers ();
+  gst_element_set_state (h265parse, GST_STATE_NULL);
+  gst_check_teardown_src_pad (h265parse);
+  gst_check_teardown_sink_pad (h265parse);
+  gst_check_teardown_element (h265parse);
+}
+
+GST_START_TEST (test_parse_hvc1_to_bs_frames)
+{
+  run_convert_test (TRUE, &sinktemplate_bs_au);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parse_bs_to_hvc1_frames)
+{
+  run_convert_test (FALSE, &sinktemplate_hvc1_au);
+}
+
+GST_END_TEST;
+
+static Suite *
+h265parse_suite (void)
+{
+  Suite *s = suite_create ("h265parse");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_parse_hvc1_to_bs_frames);
+  tcase_add_test (tc_chain, test_parse_bs_to_hvc1_frames);
+
+  return s;
+}
+
+GST_CHECK_MAIN (h265parse);
@@ -0,0 +1,389 @@
+/* GStreamer
+ *
+ * unit test for the inter audio elements
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/check/gstcheck.h>
+
+/* the source reads this far behind the sink and outputs this many buffers
+ * per second, see gstinteraudiosrc.c */
+#define LATENCY_MS 200
+#define BUFFERS_PER_SECOND 30
+
+/* small buffers, the ring has to hold more than 64 of them to cover the
+ * latency of the sources */
+#define SINK_BUFFER_SAMPLES 128
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("audio/x-raw, format = (string) S16LE, "
+        "layout = (string) interleaved, channels = (int) 1, "
+        "rate = (int) [ 1, MAX ]"));
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("audio/x-raw, format = (string) S16LE, "
+        "layout = (string) interleaved, channels = (int) 1, "
+        "rate = (int) [ 1, MAX ]"));
+
+/* An interaudiosrc with its own sink pad. The pad only accepts two buffers
+ * at a time, so the source doesn't run ahead of the test */
+typedef struct
+{
+  GstElement *src;
+  GstPad *pad;
+  GAsyncQueue *queue;
+  gint stopping;
+} Reader;
+
+static GstCaps *
+make_caps (gint rate)
+{
+  return gst_caps_new_simple ("audio/x-raw",
+      "format", G_TYPE_STRING, "S16LE",
+      "layout", G_TYPE_STRING, "interleaved",
+      "channels", G_TYPE_INT, 1, "rate", G_TYPE_INT, rate, NULL);
+}
+
+/* sample @offset of the test signal, never silence */
+static gint16
+pattern_value (guint64 offset, gint16 base)
+{
+  return (gint16) (offset % 8192) + base;
+}
+
+static GstBuffer *
+make_buffer (guint64 offset, guint n, gint16 base, gint rate)
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+  gint16 *samples;
+  guint i;
+
+  buffer = gst_buffer_new_allocate (NULL, n * sizeof (gint16), NULL);
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  samples = (gint16 *) map.data;
+  for (i = 0; i < n; i++)
+    samples[i] = GINT16_TO_LE (pattern_value (offset + i, base));
+  gst_buffer_unmap (buffer, &map);
+
+  GST_BUFFER_PTS (buffer) = gst_util_uint64_scale_int (offset, GST_SECOND,
+      rate);
+  GST_BUFFER_DURATION (buffer) = gst_util_uint64_scale_int (offset + n,
+      GST_SECOND, rate) - GST_BUFFER_PTS (buffer);
+
+  return buffer;
+}
+
+/* pushes @n samples starting at @offset in small buffers */
+static void
+push_samples (GstPad * srcpad, guint64 offset, guint64 n, gint16 base,
+    gint rate)
+{
+  guint64 end = offset + n;
+
+  while (offset < end) {
+    guint size = MIN (SINK_BUFFER_SAMPLES, end - offset);
+
+    fail_unless_equals_int (gst_pad_push (srcpad, make_buffer (offset, size,
+                base, rate)), GST_FLOW_OK);
+    offset += size;
+  }
+}
+
+static void
+check_samples (GstSample * sample, guint64 offset, gint16 base, gint rate)
+{
+  GstBuffer *buffer = gst_sample_get_buffer (sample);
+  GstMapInfo map;
+  const gint16 *samples;
+  guint i, n = rate / BUFFERS_PER_SECOND;
+
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  fail_unless_equals_int (map.size, n * sizeof (gint16));
+  samples = (const gint16 *) map.data;
+  for (i = 0; i < n; i++) {
+    fail_unless_equals_int (GINT16_FROM_LE (samples[i]),
+        pattern_value (offset + i, base));
+  }
+  gst_buffer_unmap (buffer, &map);
+}
+
+static gboolean
+sample_is_silent (GstSample * sample)
+{
+  GstBuffer *buffer = gst_sample_get_buffer (sample);
+  GstMapInfo map;
+  gboolean silent = TRUE;
+  gsize i;
+
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  for (i = 0; i < map.size && silent; i++)
+    silent = map.data[i] == 0;
+  gst_buffer_unmap (buffer, &map);
+
+  return silent;
+}
+
+static GstFlowReturn
+reader_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  Reader *reader = GST_PAD_ELEMENT_PRIVATE (pad);
+  GstCaps *caps = gst_pad_get_current_caps (pad);
+  GstSample *sample;
+
+  sample = gst_sample_new (buffer, caps, NULL, NULL);
+  gst_buffer_unref (buffer);
+  gst_caps_unref (caps);
+
+  while (g_async_queue_length (reader->queue) >= 2) {
+    if (g_atomic_int_get (&reader->stopping)) {
+      gst_sample_unref (sample);
+      return GST_FLOW_FLUSHING;
+    }
+    g_usleep (G_USEC_PER_SEC / 1000);
+  }
+  g_async_queue_push (reader->queue, sample);
+
+  return GST_FLOW_OK;
+}
+
+static Reader *
+reader_new (GstClock * clock, GstClockTime base_time)
+{
+  Reader *reader = g_new0 (Reader, 1);
+  GstPad *srcpad;
+
+  reader->src = gst_check_setup_element ("interaudiosrc");
+  g_object_set (reader->src, "channel", "test", NULL);
+  reader->queue = g_async_queue_new_full ((GDestroyNotify) gst_sample_unref);
+
+  reader->pad = gst_pad_new_from_static_template (&sinktemplate, "sink");
+  GST_PAD_ELEMENT_PRIVATE (reader->pad) = reader;
+  gst_pad_set_chain_function (reader->pad, reader_chain);
+  gst_pad_set_active (reader->pad, TRUE);
+
+  srcpad = gst_element_get_static_pad (reader->src, "src");
+  fail_unless_equals_int (gst_pad_link (srcpad, reader->pad), GST_PAD_LINK_OK);
+  gst_object_unref (srcpad);
+
+  if (clock) {
+    gst_element_set_clock (reader->src, clock);
+    gst_element_set_base_time (reader->src, base_time);
+  }
+
+  fail_unless (gst_element_set_state (reader->src, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+
+  return reader;
+}
+
+static GstSample *
+reader_pop (Reader * reader)
+{
+  GstSample *sample;
+
+  sample = g_async_queue_timeout_pop (reader->queue, 5 * G_USEC_PER_SEC);
+  fail_unless (sample != NULL);
+
+  return sample;
+}
+
+static void
+reader_free (Reader * reader)
+{
+  GstPad *srcpad;
+
+  g_atomic_int_set (&reader->stopping, 1);
+  gst_element_set_state (reader->src, GST_STATE_NULL);
+
+  srcpad = gst_element_get_static_pad (reader->src, "src");
+  gst_pad_unlink (srcpad, reader->pad);
+  gst_object_unref (srcpad);
+  gst_pad_set_active (reader->pad, FALSE);
+  gst_object_unref (reader->pad);
+  gst_check_teardown_element (reader->src);
+  g_async_queue_unref (reader->queue);
+  g_free (reader);
+}
+
+static GstElement *
+setup_interaudiosink (GstPad ** srcpad, gint rate)
+{
+  GstElement *sink;
+  GstCaps *caps;
+
+  sink = gst_check_setup_element ("interaudiosink");
+  g_object_set (sink, "channel", "test", "sync", FALSE, NULL);
+  *srcpad = gst_check_setup_src_pad (sink, &srctemplate);
+  gst_pad_set_active (*srcpad, TRUE);
+
+  fail_unless (gst_element_set_state (sink, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+
+  caps = make_caps (rate);
+  gst_check_setup_events (*srcpad, sink, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  return sink;
+}
+
+static void
+cleanup_interaudiosink (GstElement * sink)
+{
+  gst_element_set_state (sink, GST_STATE_NULL);
+  gst_check_teardown_src_pad (sink);
+  gst_check_teardown_element (sink);
+}
+
+GST_START_TEST (test_audio_fan_out)
+{
+  GstElement *sink;
+  GstPad *srcpad;
+  Reader *readers[2];
+  guint64 written = 100 * SINK_BUFFER_SAMPLES;
+  guint64 latency = 48000 * LATENCY_MS / 1000;
+  guint i;
+
+  sink = setup_interaudiosink (&srcpad, 48000);
+  push_samples (srcpad, 0, written, 1, 48000);
+
+  /* without a clock both sources start reading the latency behind the
+   * newest sample, all of which must still be in the ring */
+  for (i = 0; i < G_N_ELEMENTS (readers); i++)
+    readers[i] = reader_new (NULL, 0);
+
+  for (i = 0; i < G_N_ELEMENTS (readers); i++) {
+    GstSample *sample = reader_pop (readers[i]);
+
+    check_samples (sample, written - latency, 1, 48000);
+    gst_sample_unref (sample);
+  }
+
+  for (i = 0; i < G_N_ELEMENTS (readers); i++)
+    reader_free (readers[i]);
+  cleanup_interaudiosink (sink);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_audio_renegotiation)
+{
+  GstElement *sink;
+  GstPad *srcpad;
+  Reader *reader;
+  GstSample *sample;
+  GstCaps *caps;
+  guint64 written = 100 * SINK_BUFFER_SAMPLES;
+  guint i;
+
+  sink = setup_interaudiosink (&srcpad, 48000);
+  push_samples (srcpad, 0, written, 1, 48000);
+
+  reader = reader_new (NULL, 0);
+  sample = reader_pop (reader);
+  caps = make_caps (48000);
+  fail_unless (gst_caps_is_equal (gst_sample_get_caps (sample), caps));
+  gst_caps_unref (caps);
+  check_samples (sample, written - 48000 * LATENCY_MS / 1000, 1, 48000);
+  gst_sample_unref (sample);
+
+  /* the sink switches to another rate and starts a new sample timeline,
+   * pushed in one buffer so that the source either sees all or nothing */
+  caps = make_caps (44100);
+  fail_unless (gst_pad_set_caps (srcpad, caps));
+  fail_unless_equals_int (gst_pad_push (srcpad, make_buffer (0, written,
+              10000, 44100)), GST_FLOW_OK);
+
+  /* buffers created before the new samples arrived are old or silent */
+  for (i = 0; i < 10; i++) {
+    sample = reader_pop (reader);
+    if (gst_caps_is_equal (gst_sample_get_caps (sample), caps)
+        && !sample_is_silent (sample))
+      break;
+    gst_sample_unref (sample);
+    sample = NULL;
+  }
+  fail_unless (sample != NULL);
+  check_samples (sample, written - 44100 * LATENCY_MS / 1000, 10000, 44100);
+  gst_sample_unref (sample);
+  gst_caps_unref (caps);
+
+  reader_free (reader);
+  cleanup_interaudiosink (sink);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_audio_resync)
+{
+  GstElement *sink;
+  GstPad *srcpad;
+  Reader *reader;
+  GstSample *sample;
+  GstClock *clock;
+  GstClockTime now;
+
+  clock = gst_system_clock_obtain ();
+  now = gst_clock_get_time (clock);
+
+  /* the sink started 1.2 s ago, so that the source running time 0 maps to
+   * the sink running time 1.0 s */
+  sink = setup_interaudiosink (&srcpad, 48000);
+  gst_element_set_clock (sink, clock);
+  gst_element_set_base_time (sink, now - 1200 * GST_MSECOND);
+
+  /* 100 ms of audio, a gap, and 200 ms of audio from 1.0 s on. The samples
+   * after the gap must be placed at their timestamp */
+  push_samples (srcpad, 0, 4800, 1, 48000);
+  push_samples (srcpad, 48000, 9600, 1, 48000);
+
+  reader = reader_new (clock, now);
+  sample = reader_pop (reader);
+  check_samples (sample, 48000, 1, 48000);
+  gst_sample_unref (sample);
+
+  reader_free (reader);
+  cleanup_interaudiosink (sink);
+  gst_object_unref (clock);
+}
+
+GST_END_TEST;
+
+static Suite *
+inter_suite (void)
+{
+  Suite *s = suite_create ("inter");
+  TCase *tc_chain = tcase_create ("audio");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_audio_fan_out);
+  tcase_add_test (tc_chain, test_audio_renegotiation);
+  tcase_add_test (tc_chain, test_audio_resync);
+
+  return s;
+}
+
+GST_CHECK_MAIN (inter);
@@ -0,0 +1,466 @@
+/* GStreamer
+ *
+ * unit test for mpegpsdemux
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gst/check/gstcheck.h>
+
+/* The generated file: N_PACKS packs of PACK_SIZE bytes, each holding an MPEG
+ * audio PES with a PTS equal to the SCR of the pack */
+#define PACK_SIZE 2048
+#define N_PACKS 250
+#define FIRST_SCR 90000
+#define SCR_STEP 3600           /* 40ms */
+#define MUX_RATE (PACK_SIZE * 90000 / SCR_STEP / 50)
+
+#define SEEK_POSITION (5 * GST_SECOND)
+
+/* sidecar index file layout, see gst/mpegdemux/gstpsindex.c */
+#define INDEX_HEADER_SIZE 32
+#define INDEX_ENTRY_SIZE 16
+
+static guint8 *ps_file;
+static gsize ps_file_size;
+static gchar *index_location;
+
+static GstPad *mysrcpad, *mysinkpad;
+
+static GMutex lock;
+static GCond cond;
+static GstSegment segment;
+static gboolean have_eos;
+static gboolean have_first;
+static GstClockTime first_time;
+static gboolean flushing;
+static gboolean block;
+
+static GstStaticPadTemplate mysrctemplate =
+GST_STATIC_PAD_TEMPLATE ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/mpeg, mpegversion = (int) 2, "
+        "systemstream = (boolean) TRUE"));
+
+static GstStaticPadTemplate mysinktemplate =
+GST_STATIC_PAD_TEMPLATE ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static void
+write_timestamp (guint8 * data, guint8 prefix, guint64 ts)
+{
+  data[0] = prefix | ((ts >> 29) & 0x0e) | 0x01;
+  data[1] = (ts >> 22) & 0xff;
+  data[2] = ((ts >> 14) & 0xfe) | 0x01;
+  data[3] = (ts >> 7) & 0xff;
+  data[4] = ((ts << 1) & 0xfe) | 0x01;
+}
+
+static void
+write_pack (guint8 * data, guint64 scr)
+{
+  guint pes_length = PACK_SIZE - 14 - 6;
+
+  /* MPEG-2 pack header without stuffing */
+  GST_WRITE_UINT32_BE (data, 0x000001ba);
+  data[4] = 0x40 | ((scr >> 27) & 0x38) | 0x04 | ((scr >> 28) & 0x03);
+  data[5] = (scr >> 20) & 0xff;
+  data[6] = ((scr >> 12) & 0xf8) | 0x04 | ((scr >> 13) & 0x03);
+  data[7] = (scr >> 5) & 0xff;
+  data[8] = ((scr << 3) & 0xf8) | 0x04;
+  data[9] = 0x01;
+  data[10] = (MUX_RATE >> 14) & 0xff;
+  data[11] = (MUX_RATE >> 6) & 0xff;
+  data[12] = ((MUX_RATE << 2) & 0xfc) | 0x03;
+  data[13] = 0xf8;
+  data += 14;
+
+  /* MPEG audio PES filling the rest of the pack */
+  GST_WRITE_UINT32_BE (data, 0x000001c0);
+  GST_WRITE_UINT16_BE (data + 4, pes_length);
+  data[6] = 0x80;
+  data[7] = 0x80;
+  data[8] = 5;
+  write_timestamp (data + 9, 0x20, scr);
+  memset (data + 14, 0xaa, pes_length - 8);
+}
+
+static void
+setup (void)
+{
+  GError *err = NULL;
+  gint fd;
+  guint i;
+
+  ps_file_size = N_PACKS * PACK_SIZE;
+  ps_file = g_malloc (ps_file_size);
+  for (i = 0; i < N_PACKS; i++)
+    write_pack (ps_file + i * PACK_SIZE, FIRST_SCR + i * SCR_STEP);
+
+  /* only reserve the name, the demuxer creates the index */
+  fd = g_file_open_tmp ("mpegpsdemux-XXXXXX", &index_location, &err);
+  fail_unless (fd >= 0, "could not create temporary file");
+  close (fd);
+  g_unlink (index_location);
+
+  g_mutex_init (&lock);
+  g_cond_init (&cond);
+}
+
+static void
+teardown (void)
+{
+  g_unlink (index_location);
+  g_free (index_location);
+  g_free (ps_file);
+
+  g_mutex_clear (&lock);
+  g_cond_clear (&cond);
+}
+
+static GstFlowReturn
+_src_getrange (GstPad * pad, GstObject * parent, guint64 offset, guint length,
+    GstBuffer ** buffer)
+{
+  if (offset >= ps_file_size)
+    return GST_FLOW_EOS;
+  length = MIN (length, ps_file_size - offset);
+
+  *buffer = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
+      ps_file + offset, length, 0, length, NULL, NULL);
+  GST_BUFFER_OFFSET (*buffer) = offset;
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  gboolean res = FALSE;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_DURATION:{
+      GstFormat fmt;
+
+      gst_query_parse_duration (query, &fmt, NULL);
+      if (fmt != GST_FORMAT_BYTES)
+        break;
+
+      gst_query_set_duration (query, fmt, ps_file_size);
+      res = TRUE;
+      break;
+    }
+    case GST_QUERY_SCHEDULING:{
+      gst_query_set_scheduling (query, GST_SCHEDULING_FLAG_SEEKABLE, 1, -1, 0);
+      gst_query_add_scheduling_mode (query, GST_PAD_MODE_PULL);
+      res = TRUE;
+      break;
+    }
+    default:
+      GST_DEBUG_OBJECT (pad, "unhandled %s query", GST_QUERY_TYPE_NAME (query));
+      break;
+  }
+
+  return res;
+}
+
+/* Records the stream time of the first buffer after a flush, and holds the
+ * streaming thread there while @block is set */
+static GstFlowReturn
+_sink_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  GstFlowReturn ret;
+
+  g_mutex_lock (&lock);
+  if (!have_first && GST_BUFFER_PTS_IS_VALID (buffer)) {
+    first_time = gst_segment_to_stream_time (&segment, GST_FORMAT_TIME,
+        GST_BUFFER_PTS (buffer));
+    have_first = TRUE;
+    g_cond_broadcast (&cond);
+  }
+  while (block && !flushing)
+    g_cond_wait (&cond, &lock);
+  ret = flushing ? GST_FLOW_FLUSHING : GST_FLOW_OK;
+  g_mutex_unlock (&lock);
+
+  gst_buffer_unref (buffer);
+
+  return ret;
+}
+
+static gboolean
+_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  GST_INFO_OBJECT (pad, "got %s event %p: %" GST_PTR_FORMAT,
+      GST_EVENT_TYPE_NAME (event), event, event);
+
+  g_mutex_lock (&lock);
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+      flushing = TRUE;
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      flushing = FALSE;
+      have_first = FALSE;
+      break;
+    case GST_EVENT_SEGMENT:
+      gst_event_copy_segment (event, &segment);
+      break;
+    case GST_EVENT_EOS:
+      have_eos = TRUE;
+      break;
+    default:
+      break;
+  }
+  g_cond_broadcast (&cond);
+  g_mutex_unlock (&lock);
+
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+static void
+_pad_added (GstElement * element, GstPad * pad, gpointer user_data)
+{
+  gchar *name = gst_pad_get_name (pad);
+
+  fail_unless_equals_string (name, "audio_c0");
+  fail_unless (gst_pad_link (pad, mysinkpad) == GST_PAD_LINK_OK);
+
+  g_free (name);
+}
+
+static GstElement *
+setup_demux (gboolean use_index, gboolean block_data)
+{
+  GstElement *demux;
+  GstPad *sinkpad;
+
+  have_eos = FALSE;
+  have_first = FALSE;
+  flushing = FALSE;
+  block = block_data;
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+
+  demux = gst_element_factory_make ("mpegpsdemux", NULL);
+  fail_unless (demux != NULL);
+  if (use_index)
+    g_object_set (demux, "index-location", index_location, NULL);
+  g_signal_connect (demux, "pad-added", G_CALLBACK (_pad_added), NULL);
+
+  mysinkpad = gst_pad_new_from_static_template (&mysinktemplate, "sink");
+  gst_pad_set_chain_function (mysinkpad, _sink_chain);
+  gst_pad_set_event_function (mysinkpad, _sink_event);
+
+  mysrcpad = gst_pad_new_from_static_template (&mysrctemplate, "src");
+  gst_pad_set_getrange_function (mysrcpad, _src_getrange);
+  gst_pad_set_query_function (mysrcpad, _src_query);
+
+  sinkpad = gst_element_get_static_pad (demux, "sink");
+  fail_unless (gst_pad_link (mysrcpad, sinkpad) == GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+
+  gst_pad_set_active (mysinkpad, TRUE);
+  gst_pad_set_active (mysrcpad, TRUE);
+
+  fail_unless_equals_int (gst_element_set_state (demux, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_SUCCESS);
+
+  return demux;
+}
+
+static void
+cleanup_demux (GstElement * demux)
+{
+  /* let the streaming thread go so that it can be stopped */
+  g_mutex_lock (&lock);
+  block = FALSE;
+  g_cond_broadcast (&cond);
+  g_mutex_unlock (&lock);
+
+  gst_element_set_state (demux, GST_STATE_NULL);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_pad_set_active (mysrcpad, FALSE);
+
+  gst_object_unref (demux);
+  gst_object_unref (mysinkpad);
+  gst_object_unref (mysrcpad);
+}
+
+/* Checks that the index file describes the generated packs and returns the
+ * number of entries */
+static guint
+check_index_file (void)
+{
+  gchar *contents;
+  gsize size;
+  guint32 version, n_entries;
+  guint64 upstream_size, scr, offset, last_scr = 0;
+  guint i;
+
+  fail_unless (g_file_get_contents (index_location, &contents, &size, NULL));
+  fail_unless (size >= INDEX_HEADER_SIZE);
+  fail_unless (memcmp (contents, "GSTPSIDX", 8) == 0);
+  memcpy (&version, contents + 8, 4);
+  fail_unless_equals_int (version, 1);
+  memcpy (&upstream_size, contents + 16, 8);
+  fail_unless_equals_uint64 (upstream_size, ps_file_size);
+  memcpy (&n_entries, contents + 24, 4);
+  fail_unless_equals_uint64 (size, INDEX_HEADER_SIZE +
+      n_entries * INDEX_ENTRY_SIZE);
+
+  /* the packs are indexed about every 0.5s while playing */
+  fail_unless (n_entries >= N_PACKS * SCR_STEP / 45000 / 2);
+
+  for (i = 0; i < n_entries; i++) {
+    memcpy (&scr, contents + INDEX_HEADER_SIZE + i * INDEX_ENTRY_SIZE, 8);
+    memcpy (&offset, contents + INDEX_HEADER_SIZE + i * INDEX_ENTRY_SIZE + 8,
+        8);
+
+    fail_unless (i == 0 || scr > last_scr);
+    fail_unless (offset % PACK_SIZE == 0);
+    fail_unless_equals_uint64 (scr,
+        FIRST_SCR + offset / PACK_SIZE * SCR_STEP);
+    last_scr = scr;
+  }
+
+  g_free (contents);
+
+  return n_entries;
+}
+
+static void
+play_to_eos (gboolean use_index)
+{
+  GstElement *demux;
+
+  demux = setup_demux (use_index, FALSE);
+
+  g_mutex_lock (&lock);
+  while (!have_eos)
+    g_cond_wait (&cond, &lock);
+  g_mutex_unlock (&lock);
+
+  fail_unless (have_first);
+  fail_unless_equals_uint64 (first_time, 0);
+
+  cleanup_demux (demux);
+}
+
+static void
+seek_and_check (gboolean use_index)
+{
+  GstElement *demux;
+  GstClockTimeDiff diff;
+
+  demux = setup_demux (use_index, TRUE);
+
+  /* the streaming thread is held back after the first buffer */
+  g_mutex_lock (&lock);
+  while (!have_first)
+    g_cond_wait (&cond, &lock);
+  fail_unless_equals_uint64 (first_time, 0);
+  g_mutex_unlock (&lock);
+
+  fail_unless (gst_pad_push_event (mysinkpad,
+          gst_event_new_seek (1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH,
+              GST_SEEK_TYPE_SET, SEEK_POSITION, GST_SEEK_TYPE_NONE, -1)));
+
+  g_mutex_lock (&lock);
+  while (!have_first && !have_eos)
+    g_cond_wait (&cond, &lock);
+  fail_unless (have_first);
+  diff = GST_CLOCK_DIFF (SEEK_POSITION, first_time);
+  g_mutex_unlock (&lock);
+
+  GST_INFO ("first buffer after seek at %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (first_time));
+  fail_unless (ABS (diff) <= 500 * GST_MSECOND);
+
+  cleanup_demux (demux);
+}
+
+GST_START_TEST (test_seek)
+{
+  seek_and_check (FALSE);
+  fail_if (g_file_test (index_location, G_FILE_TEST_EXISTS));
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_index_build)
+{
+  play_to_eos (TRUE);
+  check_index_file ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_index_seek)
+{
+  guint n_entries;
+
+  play_to_eos (TRUE);
+  n_entries = check_index_file ();
+
+  /* seeking with the loaded index lands on the same packs, and whatever it
+   * adds to the index keeps it consistent */
+  seek_and_check (TRUE);
+  fail_unless (check_index_file () >= n_entries);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_index_outdated)
+{
+  guint8 header[INDEX_HEADER_SIZE] = { 0, };
+  guint32 version = 1, byte_order = G_BYTE_ORDER;
+  guint64 upstream_size = ps_file_size + PACK_SIZE;
+
+  /* an empty index for another file is ignored and replaced */
+  memcpy (header, "GSTPSIDX", 8);
+  memcpy (header + 8, &version, 4);
+  memcpy (header + 12, &byte_order, 4);
+  memcpy (header + 16, &upstream_size, 8);
+  fail_unless (g_file_set_contents (index_location, (gchar *) header,
+          sizeof (header), NULL));
+
+  play_to_eos (TRUE);
+  check_index_file ();
+}
+
+GST_END_TEST;
+
+static Suite *
+mpegpsdemux_suite (void)
+{
+  Suite *s = suite_create ("mpegpsdemux");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_checked_fixture (tc_chain, setup, teardown);
+  tcase_add_test (tc_chain, test_seek);
+  tcase_add_test (tc_chain, test_index_build);
+  tcase_add_test (tc_chain, test_index_seek);
+  tcase_add_test (tc_chain, test_index_outdated);
+
+  return s;
+}
+
+GST_CHECK_MAIN (mpegpsdemux);
@@ -716,6 +716,119 @@ GST_START_TEST (test_multiple_state_change)
 
 GST_END_TEST;
 
+static guint64 throughput_bytes;
+static guint throughput_buffers;
+static gint throughput_packet_size;
+static gint throughput_align;
+
+static gboolean
+throughput_check_buffer (GstBuffer * buffer)
+{
+  GstMapInfo map;
+  gsize offset;
+  gint sync_offset = throughput_packet_size - 188;
+
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  fail_unless (map.size % throughput_packet_size == 0);
+  if (throughput_align > 0)
+    fail_unless_equals_int (map.size, throughput_align * throughput_packet_size);
+  for (offset = 0; offset < map.size; offset += throughput_packet_size)
+    fail_unless (map.data[offset + sync_offset] == 0x47);
+  throughput_bytes += map.size;
+  throughput_buffers++;
+  gst_buffer_unmap (buffer, &map);
+
+  return TRUE;
+}
+
+static gboolean
+throughput_list_foreach (GstBuffer ** buffer, guint idx, gpointer user_data)
+{
+  return throughput_check_buffer (*buffer);
+}
+
+static GstFlowReturn
+throughput_chain_func (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  throughput_check_buffer (buffer);
+  gst_buffer_unref (buffer);
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+throughput_chain_list_func (GstPad * pad, GstObject * parent,
+    GstBufferList * list)
+{
+  gst_buffer_list_foreach (list, throughput_list_foreach, NULL);
+  gst_buffer_list_unref (list);
+
+  return GST_FLOW_OK;
+}
+
+#define THROUGHPUT_FRAMES 500
+#define THROUGHPUT_FRAME_SIZE (64 * 1024)
+
+static void
+run_throughput (gboolean m2ts_mode, gint alignment)
+{
+  GstElement *mux;
+  gchar *padname;
+  GstCaps *caps;
+  GstBuffer *inbuffer;
+  gint64 start, elapsed;
+  guint i;
+
+  mux = setup_tsmux (&video_src_template, "sink_%d", &padname);
+  gst_pad_set_chain_function (mysinkpad, throughput_chain_func);
+  gst_pad_set_chain_list_function (mysinkpad, throughput_chain_list_func);
+  g_object_set (mux, "m2ts-mode", m2ts_mode, "alignment", alignment, NULL);
+
+  throughput_bytes = 0;
+  throughput_buffers = 0;
+  throughput_packet_size = m2ts_mode ? 192 : 188;
+  throughput_align = alignment < 0 ? (m2ts_mode ? 32 : 0) : alignment;
+
+  fail_unless (gst_element_set_state (mux,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_from_string (VIDEO_CAPS_STRING);
+  gst_check_setup_events (mysrcpad, mux, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < THROUGHPUT_FRAMES; i++) {
+    inbuffer = gst_buffer_new_and_alloc (THROUGHPUT_FRAME_SIZE);
+    gst_buffer_memset (inbuffer, 0, i & 0xff, THROUGHPUT_FRAME_SIZE);
+    GST_BUFFER_PTS (inbuffer) = i * GST_SECOND / 25;
+    GST_BUFFER_DTS (inbuffer) = GST_BUFFER_PTS (inbuffer);
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  }
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+  elapsed = MAX (g_get_monotonic_time () - start, 1);
+
+  /* every input byte must have made it out, plus headers */
+  fail_unless (throughput_bytes >=
+      (guint64) THROUGHPUT_FRAMES * THROUGHPUT_FRAME_SIZE);
+  GST_INFO ("m2ts %d, alignment %d: %" G_GUINT64_FORMAT " bytes in %u "
+      "buffers, %.1f Mbit/s", m2ts_mode, alignment, throughput_bytes,
+      throughput_buffers, (throughput_bytes * 8.0) / elapsed);
+
+  cleanup_tsmux (mux, padname);
+  g_free (padname);
+}
+
+GST_START_TEST (test_throughput)
+{
+  run_throughput (FALSE, -1);
+  run_throughput (FALSE, 7);
+  run_throughput (TRUE, -1);
+  run_throughput (TRUE, 7);
+}
+
+GST_END_TEST;
+
 static Suite *
 mpegtsmux_suite (void)
 {
@@ -730,6 +843,7 @@ mpegtsmux_suite (void)
   tcase_add_test (tc_chain, test_force_key_unit_event_upstream);
   tcase_add_test (tc_chain, test_propagate_flow_status);
   tcase_add_test (tc_chain, test_multiple_state_change);
+  tcase_add_test (tc_chain, test_throughput);
 
   return s;
 }
@@ -24,11 +24,43 @@
 #include <string.h>
 #include "mxfdemux.h"
 
+/* The file served in pull mode */
+static const guint8 *src_data;
+static gsize src_size;
+
 static GstPad *mysrcpad, *mysinkpad;
 static GMainLoop *loop = NULL;
 static gboolean have_eos = FALSE;
 static gboolean have_data = FALSE;
 
+/* Layout of mxf_file */
+#define HEADER_SIZE 19995
+#define ESSENCE_OFFSET 19995
+#define ESSENCE_KL_SIZE 20
+#define FOOTER_OFFSET 20031
+#define FOOTER_PARTITION_SIZE 140
+#define INDEX_SEGMENT_OFFSET 20171
+#define INDEX_SEGMENT_SIZE 100
+#define RIP_OFFSET 20271
+#define RIP_SIZE 48
+
+/* The file generated for the index tests: edit units of two sizes, each
+ * with its own constant bytes per element index table segment */
+#define N_UNITS 4
+static const guint unit_sizes[N_UNITS] = { 16, 16, 32, 32 };
+
+#define SEEK_UNIT 3
+#define EDIT_UNIT_DURATION (200 * GST_MSECOND)
+
+static GMutex lock;
+static GCond cond;
+static gboolean flushing;
+static gboolean have_first;
+static GstClockTime first_pts;
+static guint8 first_byte;
+static guint n_buffers;
+static gint structure_buffers;
+
 static GstStaticPadTemplate mysrctemplate =
 GST_STATIC_PAD_TEMPLATE ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
     GST_STATIC_CAPS ("application/mxf"));
@@ -134,11 +166,11 @@ static GstFlowReturn
 _src_getrange (GstPad * pad, GstObject * parent, guint64 offset, guint length,
     GstBuffer ** buffer)
 {
-  if (offset + length > sizeof (mxf_file))
+  if (offset + length > src_size)
     return GST_FLOW_EOS;
 
   *buffer = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
-      (guint8 *) (mxf_file + offset), length, 0, length, NULL, NULL);
+      (guint8 *) (src_data + offset), length, 0, length, NULL, NULL);
 
   return GST_FLOW_OK;
 }
@@ -156,7 +188,7 @@ _src_query (GstPad * pad, GstObject * parent, GstQuery * query)
       if (fmt != GST_FORMAT_BYTES)
         break;
 
-      gst_query_set_duration (query, fmt, sizeof (mxf_file));
+      gst_query_set_duration (query, fmt, src_size);
       res = TRUE;
       break;
     }
@@ -184,7 +216,8 @@ _create_src_pad_pull (void)
   return mysrcpad;
 }
 
-GST_START_TEST (test_pull)
+static void
+run_pull_test (gboolean lazy_metadata)
 {
   GstStateChangeReturn sret;
   GstElement *mxfdemux;
@@ -193,9 +226,12 @@ GST_START_TEST (test_pull)
   have_eos = FALSE;
   have_data = FALSE;
   loop = g_main_loop_new (NULL, FALSE);
+  src_data = mxf_file;
+  src_size = sizeof (mxf_file);
 
   mxfdemux = gst_element_factory_make ("mxfdemux", NULL);
   fail_unless (mxfdemux != NULL);
+  g_object_set (mxfdemux, "lazy-metadata", lazy_metadata, NULL);
   g_signal_connect (mxfdemux, "pad-added", G_CALLBACK (_pad_added), NULL);
   sinkpad = gst_element_get_static_pad (mxfdemux, "sink");
   fail_unless (sinkpad != NULL);
@@ -230,6 +266,367 @@ GST_START_TEST (test_pull)
   loop = NULL;
 }
 
+GST_START_TEST (test_pull)
+{
+  run_pull_test (FALSE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_pull_lazy_metadata)
+{
+  run_pull_test (TRUE);
+}
+
+GST_END_TEST;
+
+static guint64
+read_ber_length (const guint8 * data, guint * size)
+{
+  guint64 length = 0;
+  guint i;
+
+  if (data[0] < 0x80) {
+    *size = 1;
+    return data[0];
+  }
+
+  for (i = 1; i <= (data[0] & 0x7f); i++)
+    length = (length << 8) | data[i];
+  *size = i;
+
+  return length;
+}
+
+/* Sets the @tag items of all local sets in the KLV packets of @data to
+ * @value, and returns how many were set */
+static guint
+set_local_tag (guint8 * data, gsize size, guint16 tag, guint64 value)
+{
+  gsize offset = 0, pos, end;
+  guint n = 0, n_bytes, i;
+
+  while (offset + 17 <= size) {
+    end = read_ber_length (data + offset + 16, &n_bytes);
+    pos = offset + 16 + n_bytes;
+    end += pos;
+
+    /* local sets with 2 byte tags and lengths */
+    if (data[offset + 4] == 0x02 && data[offset + 5] == 0x53) {
+      while (pos + 4 <= end) {
+        guint16 t = GST_READ_UINT16_BE (data + pos);
+        guint16 l = GST_READ_UINT16_BE (data + pos + 2);
+
+        if (t == tag) {
+          for (i = 0; i < l; i++)
+            data[pos + 4 + l - 1 - i] = i < 8 ? (value >> (8 * i)) & 0xff : 0;
+          n++;
+        }
+        pos += 4 + l;
+      }
+    }
+    offset = end;
+  }
+
+  return n;
+}
+
+/* Generates a variant of mxf_file with N_UNITS edit units in the body
+ * and two index table segments in the footer. The durations in the metadata
+ * are unknown, only the index tells them */
+static guint8 *
+create_indexed_file (gsize * size)
+{
+  GByteArray *file = g_byte_array_new ();
+  guint64 footer;
+  guint8 *data;
+  guint i;
+
+  g_byte_array_append (file, mxf_file, HEADER_SIZE);
+  fail_unless (set_local_tag (file->data + 140, HEADER_SIZE - 140, 0x0202,
+          -1) > 0);
+
+  /* each edit unit is filled with its position */
+  for (i = 0; i < N_UNITS; i++) {
+    g_byte_array_append (file, mxf_file + ESSENCE_OFFSET, ESSENCE_KL_SIZE);
+    file->data[file->len - 1] = unit_sizes[i];
+    g_byte_array_set_size (file, file->len + unit_sizes[i]);
+    memset (file->data + file->len - unit_sizes[i], i, unit_sizes[i]);
+  }
+
+  footer = file->len;
+  g_byte_array_append (file, mxf_file + FOOTER_OFFSET, FOOTER_PARTITION_SIZE);
+  GST_WRITE_UINT64_BE (file->data + footer + 28, footer);
+  GST_WRITE_UINT64_BE (file->data + footer + 44, footer);
+  GST_WRITE_UINT64_BE (file->data + footer + 60, 2 * INDEX_SEGMENT_SIZE);
+  GST_WRITE_UINT64_BE (file->data + 44, footer);
+
+  for (i = 0; i < N_UNITS; i += 2) {
+    g_byte_array_append (file, mxf_file + INDEX_SEGMENT_OFFSET,
+        INDEX_SEGMENT_SIZE);
+    data = file->data + file->len - INDEX_SEGMENT_SIZE;
+    fail_unless (set_local_tag (data, INDEX_SEGMENT_SIZE, 0x3c0a, i + 1));
+    fail_unless (set_local_tag (data, INDEX_SEGMENT_SIZE, 0x3f0c, i));
+    fail_unless (set_local_tag (data, INDEX_SEGMENT_SIZE, 0x3f0d, 2));
+    fail_unless (set_local_tag (data, INDEX_SEGMENT_SIZE, 0x3f05,
+            ESSENCE_KL_SIZE + unit_sizes[i]));
+  }
+
+  g_byte_array_append (file, mxf_file + RIP_OFFSET, RIP_SIZE);
+  GST_WRITE_UINT64_BE (file->data + file->len - RIP_SIZE + 36, footer);
+
+  *size = file->len;
+  return g_byte_array_free (file, FALSE);
+}
+
+/* Records the first buffer after a flush and holds the streaming thread
+ * there until the next flush */
+static GstFlowReturn
+_sink_chain_seek (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  GstFlowReturn ret;
+
+  g_mutex_lock (&lock);
+  if (!have_first) {
+    first_pts = GST_BUFFER_PTS (buffer);
+    gst_buffer_extract (buffer, 0, &first_byte, 1);
+    have_first = TRUE;
+    g_cond_broadcast (&cond);
+  }
+  while (!flushing)
+    g_cond_wait (&cond, &lock);
+  ret = GST_FLOW_FLUSHING;
+  g_mutex_unlock (&lock);
+
+  gst_buffer_unref (buffer);
+
+  return ret;
+}
+
+static gboolean
+_sink_event_seek (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  g_mutex_lock (&lock);
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+      flushing = TRUE;
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      flushing = FALSE;
+      have_first = FALSE;
+      break;
+    case GST_EVENT_EOS:
+      have_eos = TRUE;
+      break;
+    default:
+      break;
+  }
+  g_cond_broadcast (&cond);
+  g_mutex_unlock (&lock);
+
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+GST_START_TEST (test_pull_seek_index)
+{
+  GstElement *mxfdemux;
+  GstPad *sinkpad;
+  guint8 *data;
+  gsize size;
+  gint64 duration;
+
+  data = create_indexed_file (&size);
+  src_data = data;
+  src_size = size;
+  have_eos = FALSE;
+  have_first = FALSE;
+  flushing = FALSE;
+  g_mutex_init (&lock);
+  g_cond_init (&cond);
+
+  mxfdemux = gst_element_factory_make ("mxfdemux", NULL);
+  fail_unless (mxfdemux != NULL);
+  g_signal_connect (mxfdemux, "pad-added", G_CALLBACK (_pad_added), NULL);
+  sinkpad = gst_element_get_static_pad (mxfdemux, "sink");
+
+  mysinkpad = gst_pad_new_from_static_template (&mysinktemplate, "sink");
+  gst_pad_set_chain_function (mysinkpad, _sink_chain_seek);
+  gst_pad_set_event_function (mysinkpad, _sink_event_seek);
+  mysrcpad = _create_src_pad_pull ();
+
+  fail_unless (gst_pad_link (mysrcpad, sinkpad) == GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+
+  gst_pad_set_active (mysinkpad, TRUE);
+  gst_pad_set_active (mysrcpad, TRUE);
+
+  fail_unless_equals_int (gst_element_set_state (mxfdemux, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_SUCCESS);
+
+  g_mutex_lock (&lock);
+  while (!have_first && !have_eos)
+    g_cond_wait (&cond, &lock);
+  fail_unless (have_first);
+  fail_unless_equals_uint64 (first_pts, 0);
+  fail_unless_equals_int (first_byte, 0);
+  g_mutex_unlock (&lock);
+
+  /* the edit unit is only found at its offset through the second index
+   * table segment */
+  fail_unless (gst_pad_push_event (mysinkpad,
+          gst_event_new_seek (1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH,
+              GST_SEEK_TYPE_SET, SEEK_UNIT * EDIT_UNIT_DURATION,
+              GST_SEEK_TYPE_NONE, -1)));
+
+  g_mutex_lock (&lock);
+  while (!have_first && !have_eos)
+    g_cond_wait (&cond, &lock);
+  fail_unless (have_first);
+  fail_unless_equals_uint64 (first_pts, SEEK_UNIT * EDIT_UNIT_DURATION);
+  fail_unless_equals_int (first_byte, SEEK_UNIT);
+  g_mutex_unlock (&lock);
+
+  /* the index was resolved for the seek */
+  fail_unless (gst_pad_peer_query_duration (mysinkpad, GST_FORMAT_TIME,
+          &duration));
+  fail_unless_equals_uint64 (duration, N_UNITS * EDIT_UNIT_DURATION);
+
+  /* let the streaming thread go so that it can be stopped */
+  g_mutex_lock (&lock);
+  flushing = TRUE;
+  g_cond_broadcast (&cond);
+  g_mutex_unlock (&lock);
+
+  gst_element_set_state (mxfdemux, GST_STATE_NULL);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_pad_set_active (mysrcpad, FALSE);
+
+  gst_object_unref (mxfdemux);
+  gst_object_unref (mysinkpad);
+  gst_object_unref (mysrcpad);
+  g_mutex_clear (&lock);
+  g_cond_clear (&cond);
+  g_free (data);
+}
+
+GST_END_TEST;
+
+/* Counts the buffers and records how many came before the structure tag */
+static GstFlowReturn
+_sink_chain_count (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  g_mutex_lock (&lock);
+  n_buffers++;
+  g_cond_broadcast (&cond);
+  g_mutex_unlock (&lock);
+
+  gst_buffer_unref (buffer);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+_sink_event_tags (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  GstTagList *tags;
+
+  g_mutex_lock (&lock);
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_TAG:
+      gst_event_parse_tag (event, &tags);
+      if (structure_buffers == -1
+          && gst_tag_list_get_value_index (tags, "mxf-structure", 0))
+        structure_buffers = n_buffers;
+      break;
+    case GST_EVENT_EOS:
+      have_eos = TRUE;
+      break;
+    default:
+      break;
+  }
+  g_cond_broadcast (&cond);
+  g_mutex_unlock (&lock);
+
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+/* Plays the generated file and returns how many buffers were output before
+ * the structure tag */
+static gint
+run_structure_tag_test (gboolean lazy_metadata)
+{
+  GstElement *mxfdemux;
+  GstPad *sinkpad;
+  guint8 *data;
+  gsize size;
+
+  data = create_indexed_file (&size);
+  src_data = data;
+  src_size = size;
+  have_eos = FALSE;
+  n_buffers = 0;
+  structure_buffers = -1;
+  g_mutex_init (&lock);
+  g_cond_init (&cond);
+
+  mxfdemux = gst_element_factory_make ("mxfdemux", NULL);
+  fail_unless (mxfdemux != NULL);
+  g_object_set (mxfdemux, "lazy-metadata", lazy_metadata, NULL);
+  g_signal_connect (mxfdemux, "pad-added", G_CALLBACK (_pad_added), NULL);
+  sinkpad = gst_element_get_static_pad (mxfdemux, "sink");
+
+  mysinkpad = gst_pad_new_from_static_template (&mysinktemplate, "sink");
+  gst_pad_set_chain_function (mysinkpad, _sink_chain_count);
+  gst_pad_set_event_function (mysinkpad, _sink_event_tags);
+  mysrcpad = _create_src_pad_pull ();
+
+  fail_unless (gst_pad_link (mysrcpad, sinkpad) == GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+
+  gst_pad_set_active (mysinkpad, TRUE);
+  gst_pad_set_active (mysrcpad, TRUE);
+
+  fail_unless_equals_int (gst_element_set_state (mxfdemux, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_SUCCESS);
+
+  g_mutex_lock (&lock);
+  while (n_buffers < N_UNITS && !have_eos)
+    g_cond_wait (&cond, &lock);
+  fail_unless_equals_int (n_buffers, N_UNITS);
+  g_mutex_unlock (&lock);
+
+  gst_element_set_state (mxfdemux, GST_STATE_NULL);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_pad_set_active (mysrcpad, FALSE);
+
+  gst_object_unref (mxfdemux);
+  gst_object_unref (mysinkpad);
+  gst_object_unref (mysrcpad);
+  g_mutex_clear (&lock);
+  g_cond_clear (&cond);
+  g_free (data);
+
+  return structure_buffers;
+}
+
+GST_START_TEST (test_pull_structure_tag)
+{
+  gint n;
+
+  /* the structure is known before the pads are created */
+  n = run_structure_tag_test (FALSE);
+  fail_unless_equals_int (n, 0);
+
+  /* the structure is only built once the first buffers are out, and sent
+   * with the following ones */
+  n = run_structure_tag_test (TRUE);
+  fail_unless (n >= 1 && n < N_UNITS, "structure tag after %d buffers", n);
+}
+
 GST_END_TEST;
 
 GST_START_TEST (test_push)
@@ -301,6 +698,9 @@ mxfdemux_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_set_timeout (tc_chain, 180);
   tcase_add_test (tc_chain, test_pull);
+  tcase_add_test (tc_chain, test_pull_lazy_metadata);
+  tcase_add_test (tc_chain, test_pull_seek_index);
+  tcase_add_test (tc_chain, test_pull_structure_tag);
   tcase_add_test (tc_chain, test_push);
 
   return s;
@@ -0,0 +1,261 @@
+/* GStreamer
+ *
+ * unit test for scenechange
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/check/gstcheck.h>
+#include <gst/video/gstscenechangemeta.h>
+
+#define WIDTH 64
+#define HEIGHT 48
+
+#define VIDEO_CAPS_STRING "video/x-raw, format = (string) I420, " \
+    "width = (int) 64, height = (int) 48, framerate = (fraction) 25/1"
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (VIDEO_CAPS_STRING)
+    );
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (VIDEO_CAPS_STRING)
+    );
+
+static GstPad *mysrcpad, *mysinkpad;
+static GstBus *bus;
+static guint n_key_unit_events;
+
+static GstPadProbeReturn
+event_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_CUSTOM_DOWNSTREAM &&
+      gst_structure_has_name (gst_event_get_structure (event),
+          "GstForceKeyUnit"))
+    n_key_unit_events++;
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstElement *
+setup_scenechange (guint downsample)
+{
+  GstElement *scenechange;
+  GstCaps *caps;
+
+  scenechange = gst_check_setup_element ("scenechange");
+  if (downsample)
+    g_object_set (scenechange, "downsample", downsample, NULL);
+  mysrcpad = gst_check_setup_src_pad (scenechange, &srctemplate);
+  mysinkpad = gst_check_setup_sink_pad (scenechange, &sinktemplate);
+  gst_pad_add_probe (mysinkpad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      event_probe, NULL, NULL);
+  n_key_unit_events = 0;
+
+  bus = gst_bus_new ();
+  gst_element_set_bus (scenechange, bus);
+
+  gst_pad_set_active (mysrcpad, TRUE);
+  gst_pad_set_active (mysinkpad, TRUE);
+  fail_unless (gst_element_set_state (scenechange, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_SUCCESS, "could not set to playing");
+
+  caps = gst_caps_from_string (VIDEO_CAPS_STRING);
+  gst_check_setup_events (mysrcpad, scenechange, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  return scenechange;
+}
+
+static void
+cleanup_scenechange (GstElement * scenechange)
+{
+  gst_check_drop_buffers ();
+  gst_bus_set_flushing (bus, TRUE);
+  gst_element_set_bus (scenechange, NULL);
+  gst_object_unref (bus);
+
+  gst_element_set_state (scenechange, GST_STATE_NULL);
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_src_pad (scenechange);
+  gst_check_teardown_sink_pad (scenechange);
+  gst_check_teardown_element (scenechange);
+}
+
+/* Pushes an I420 picture whose luma is @luma everywhere */
+static void
+push_picture (guint8 luma, guint index)
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+
+  buffer = gst_buffer_new_allocate (NULL, WIDTH * HEIGHT * 3 / 2, NULL);
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  memset (map.data, luma, WIDTH * HEIGHT);
+  memset (map.data + WIDTH * HEIGHT, 128, WIDTH * HEIGHT / 2);
+  gst_buffer_unmap (buffer, &map);
+
+  GST_BUFFER_PTS (buffer) = index * GST_SECOND / 25;
+  GST_BUFFER_DURATION (buffer) = GST_SECOND / 25;
+
+  fail_unless_equals_int (gst_pad_push (mysrcpad, buffer), GST_FLOW_OK);
+}
+
+/* Checks that a static scene followed by a cut gives exactly one
+ * "scenechange" message, for the picture of the cut */
+static void
+run_cut_test (guint downsample)
+{
+  GstElement *scenechange;
+  GstMessage *msg;
+  const GstStructure *s;
+  guint64 timestamp;
+  GstSceneChangeMeta *meta;
+  gdouble score, threshold;
+  GList *l;
+  guint i;
+
+  scenechange = setup_scenechange (downsample);
+
+  for (i = 0; i < 6; i++)
+    push_picture (16, i);
+  fail_if (gst_bus_have_pending (bus));
+  fail_unless_equals_int (n_key_unit_events, 0);
+
+  push_picture (200, 6);
+  push_picture (200, 7);
+  fail_unless_equals_int (g_list_length (buffers), 8);
+
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT);
+  fail_unless (msg != NULL);
+  fail_unless (GST_MESSAGE_SRC (msg) == GST_OBJECT (scenechange));
+  s = gst_message_get_structure (msg);
+  fail_unless (gst_structure_has_name (s, "scenechange"));
+  fail_unless (gst_structure_get_uint64 (s, "timestamp", &timestamp));
+  fail_unless_equals_uint64 (timestamp, 6 * GST_SECOND / 25);
+  /* the whole luma plane changes by the same amount */
+  fail_unless (gst_structure_get_double (s, "score", &score));
+  fail_unless (score > 183.9 && score < 184.1);
+  fail_unless (gst_structure_get_double (s, "threshold", &threshold));
+  fail_unless (threshold < score);
+  gst_message_unref (msg);
+
+  /* the picture after the cut is the same as the cut */
+  fail_if (gst_bus_have_pending (bus));
+  fail_unless_equals_int (n_key_unit_events, 1);
+
+  /* every picture carries its score, only the cut is a scene change */
+  for (l = buffers, i = 0; l; l = l->next, i++) {
+    meta = gst_buffer_get_scene_change_meta (GST_BUFFER_CAST (l->data));
+    fail_unless (meta != NULL);
+    fail_unless_equals_int (meta->scene_change, i == 6);
+    if (i == 6) {
+      fail_unless (meta->score == score);
+      fail_unless (meta->threshold == threshold);
+    } else {
+      fail_unless (meta->score == 0.0);
+    }
+  }
+
+  cleanup_scenechange (scenechange);
+}
+
+GST_START_TEST (test_cut)
+{
+  run_cut_test (0);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_cut_downsample)
+{
+  run_cut_test (4);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_downsample_property)
+{
+  GstElement *scenechange;
+  guint downsample;
+
+  scenechange = gst_check_setup_element ("scenechange");
+
+  g_object_get (scenechange, "downsample", &downsample, NULL);
+  fail_unless_equals_int (downsample, 1);
+
+  g_object_set (scenechange, "downsample", 4, NULL);
+  g_object_get (scenechange, "downsample", &downsample, NULL);
+  fail_unless_equals_int (downsample, 4);
+
+  gst_check_teardown_element (scenechange);
+}
+
+GST_END_TEST;
+
+/* Changing the factor while running starts a new history, which must not be
+ * reported as a scene change */
+GST_START_TEST (test_downsample_change)
+{
+  GstElement *scenechange;
+  guint i;
+
+  scenechange = setup_scenechange (0);
+
+  for (i = 0; i < 6; i++)
+    push_picture (16, i);
+  g_object_set (scenechange, "downsample", 2, NULL);
+  for (; i < 12; i++)
+    push_picture (16, i);
+
+  fail_unless_equals_int (g_list_length (buffers), 12);
+  fail_if (gst_bus_have_pending (bus));
+  fail_unless_equals_int (n_key_unit_events, 0);
+
+  cleanup_scenechange (scenechange);
+}
+
+GST_END_TEST;
+
+static Suite *
+scenechange_suite (void)
+{
+  Suite *s = suite_create ("scenechange");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_cut);
+  tcase_add_test (tc_chain, test_cut_downsample);
+  tcase_add_test (tc_chain, test_downsample_property);
+  tcase_add_test (tc_chain, test_downsample_change);
+
+  return s;
+}
+
+GST_CHECK_MAIN (scenechange);
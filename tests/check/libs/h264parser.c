@@ -150,6 +150,49 @@ GST_START_TEST (test_h264_parse_slice_dpa)
 
 GST_END_TEST;
 
+/* AUD, filler data with an emulation prevention byte, AUD */
+static guint8 stream_nalus[] = {
+  0x00, 0x00, 0x00, 0x01, 0x09, 0x10,
+  0x00, 0x00, 0x01, 0x0c, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0x00, 0x00, 0x03, 0x01, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0x80,
+  0x00, 0x00, 0x01, 0x09, 0x10
+};
+
+GST_START_TEST (test_h264_parse_start_codes)
+{
+  GstH264ParserResult res;
+  GstH264NalUnit nalu;
+
+  GstH264NalParser *parser = gst_h264_nal_parser_new ();
+
+  res = gst_h264_parser_identify_nalu (parser, stream_nalus, 0,
+      sizeof (stream_nalus), &nalu);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  assert_equals_int (nalu.type, GST_H264_NAL_AU_DELIMITER);
+  assert_equals_int (nalu.sc_offset, 0);
+  assert_equals_int (nalu.offset, 4);
+  assert_equals_int (nalu.size, 2);
+
+  res = gst_h264_parser_identify_nalu (parser, stream_nalus,
+      nalu.offset + nalu.size, sizeof (stream_nalus), &nalu);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  assert_equals_int (nalu.type, GST_H264_NAL_FILLER_DATA);
+  assert_equals_int (nalu.offset, 9);
+  assert_equals_int (nalu.size, 22);
+
+  res = gst_h264_parser_identify_nalu (parser, stream_nalus,
+      nalu.offset + nalu.size, sizeof (stream_nalus), &nalu);
+  assert_equals_int (res, GST_H264_PARSER_NO_NAL_END);
+  assert_equals_int (nalu.type, GST_H264_NAL_AU_DELIMITER);
+  assert_equals_int (nalu.offset, 34);
+  assert_equals_int (nalu.size, 2);
+
+  gst_h264_nal_parser_free (parser);
+}
+
+GST_END_TEST;
+
 static Suite *
 h264parser_suite (void)
 {
@@ -159,6 +202,7 @@ h264parser_suite (void)
 
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_h264_parse_slice_dpa);
+  tcase_add_test (tc_chain, test_h264_parse_start_codes);
 
   return s;
 }
@@ -202,6 +202,50 @@ GST_START_TEST (test_mpegts_pmt)
 GST_END_TEST;
 
 
+GST_START_TEST (test_mpegts_skip_validated_crc)
+{
+  GstMpegTsSection *section;
+  guint8 *data;
+  gsize size = sizeof (pmt_data_check);
+
+  gst_mpegts_set_skip_validated_crc (TRUE);
+
+  /* The first occurence of a section is always checked */
+  data = g_memdup (pmt_data_check, size);
+  section = gst_mpegts_section_new (0x30, data, size);
+  fail_if (section == NULL);
+  fail_if (gst_mpegts_section_get_pmt (section) == NULL);
+  gst_mpegts_section_unref (section);
+
+  /* A repetition with a different CRC field is checked again */
+  data = g_memdup (pmt_data_check, size);
+  data[size - 1]++;
+  section = gst_mpegts_section_new (0x30, data, size);
+  fail_if (section == NULL);
+  fail_unless (gst_mpegts_section_get_pmt (section) == NULL);
+  gst_mpegts_section_unref (section);
+
+  /* A repetition with the same CRC field is not checked */
+  data = g_memdup (pmt_data_check, size);
+  data[14]++;
+  section = gst_mpegts_section_new (0x30, data, size);
+  fail_if (section == NULL);
+  fail_if (gst_mpegts_section_get_pmt (section) == NULL);
+  gst_mpegts_section_unref (section);
+
+  /* ... unless skipping is disabled */
+  gst_mpegts_set_skip_validated_crc (FALSE);
+
+  data = g_memdup (pmt_data_check, size);
+  data[14]++;
+  section = gst_mpegts_section_new (0x30, data, size);
+  fail_if (section == NULL);
+  fail_unless (gst_mpegts_section_get_pmt (section) == NULL);
+  gst_mpegts_section_unref (section);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_mpegts_nit)
 {
   GstMpegTsNITStream *stream;
@@ -512,6 +556,7 @@ mpegts_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_mpegts_pat);
   tcase_add_test (tc_chain, test_mpegts_pmt);
+  tcase_add_test (tc_chain, test_mpegts_skip_validated_crc);
   tcase_add_test (tc_chain, test_mpegts_nit);
   tcase_add_test (tc_chain, test_mpegts_sdt);
   tcase_add_test (tc_chain, test_mpegts_descriptors);
@@ -0,0 +1,283 @@
+/* GStreamer
+ *
+ * unit test for GstUriDownloaderPool
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+#include <gst/check/gstcheck.h>
+#include <gst/base/gstadapter.h>
+#include <gst/uridownloader/gsturidownloaderpool.h>
+
+#define DATA_SIZE (64 * 1024)
+#define N_FETCHES 16
+
+static gchar *filename;
+static gchar *uri;
+static guint8 *data;
+
+static void
+setup (void)
+{
+  GError *err = NULL;
+  gint fd;
+  guint i;
+
+  data = g_malloc (DATA_SIZE);
+  for (i = 0; i < DATA_SIZE; i++)
+    data[i] = i % 251;
+
+  fd = g_file_open_tmp ("uridownloaderpool-XXXXXX", &filename, &err);
+  fail_unless (fd >= 0, "could not create temporary file");
+  close (fd);
+  fail_unless (g_file_set_contents (filename, (gchar *) data, DATA_SIZE,
+          &err));
+  uri = g_filename_to_uri (filename, NULL, &err);
+  fail_unless (uri != NULL);
+}
+
+static void
+teardown (void)
+{
+  g_unlink (filename);
+  g_free (filename);
+  g_free (uri);
+  g_free (data);
+}
+
+/* Checks that @fragment holds the whole file */
+static void
+check_fragment (GstFragment * fragment)
+{
+  GstBuffer *buffer;
+
+  buffer = gst_fragment_get_buffer (fragment);
+  fail_unless (buffer != NULL);
+  fail_unless_equals_int (gst_buffer_get_size (buffer), DATA_SIZE);
+  fail_unless (gst_buffer_memcmp (buffer, 0, data, DATA_SIZE) == 0);
+  gst_buffer_unref (buffer);
+}
+
+/* Waits for @future, which must either hold the whole file or have failed
+ * with an error */
+static gboolean
+wait_fetched_or_failed (GstUriDownloadFuture * future)
+{
+  GstFragment *fragment;
+  GError *err = NULL;
+
+  fragment = gst_uri_download_future_wait (future, &err);
+  fail_unless (gst_uri_download_future_is_done (future));
+  if (fragment == NULL) {
+    fail_unless (err != NULL);
+    g_error_free (err);
+    return FALSE;
+  }
+
+  fail_unless (err == NULL);
+  check_fragment (fragment);
+  g_object_unref (fragment);
+  return TRUE;
+}
+
+static void
+collect_data (GstFragment * fragment, GstBuffer * buffer, gpointer user_data)
+{
+  gst_adapter_push (GST_ADAPTER (user_data), buffer);
+}
+
+static void
+pool_finalized (gpointer user_data, GObject * pool)
+{
+  g_atomic_int_set ((gint *) user_data, TRUE);
+}
+
+GST_START_TEST (test_concurrent_fetches)
+{
+  GstUriDownloaderPool *pool;
+  GstUriDownloadFuture *futures[N_FETCHES];
+  guint i;
+
+  pool = gst_uri_downloader_pool_new (4);
+
+  for (i = 0; i < N_FETCHES; i++) {
+    futures[i] = gst_uri_downloader_pool_fetch_uri (pool, uri, NULL, FALSE,
+        FALSE, TRUE);
+    fail_unless (futures[i] != NULL);
+  }
+
+  /* wait in reverse order, the last fetches were queued behind the others */
+  for (i = N_FETCHES; i > 0; i--) {
+    fail_unless (wait_fetched_or_failed (futures[i - 1]));
+    gst_uri_download_future_unref (futures[i - 1]);
+  }
+
+  gst_object_unref (pool);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_cancel)
+{
+  GstUriDownloaderPool *pool;
+  GstUriDownloadFuture *futures[N_FETCHES];
+  GstUriDownloadFuture *future;
+  GstFragment *fragment;
+  gboolean failed = FALSE;
+  guint i;
+
+  /* a single connection, so that most of the fetches are still queued when
+   * they are cancelled */
+  pool = gst_uri_downloader_pool_new (1);
+
+  for (i = 0; i < N_FETCHES; i++)
+    futures[i] = gst_uri_downloader_pool_fetch_uri (pool, uri, NULL, FALSE,
+        FALSE, TRUE);
+
+  gst_uri_download_future_cancel (futures[N_FETCHES - 1]);
+  gst_uri_downloader_pool_cancel (pool);
+
+  /* the fetches run one after the other: the ones that were done before
+   * keep their data, the running one and all the queued ones after it fail
+   * with an error */
+  for (i = 0; i < N_FETCHES - 1; i++) {
+    if (wait_fetched_or_failed (futures[i]))
+      fail_if (failed, "fetch %u succeeded after a cancelled one", i);
+    else
+      failed = TRUE;
+    gst_uri_download_future_unref (futures[i]);
+  }
+
+  /* cancelled on its own while it was still queued */
+  fail_if (wait_fetched_or_failed (futures[N_FETCHES - 1]));
+  gst_uri_download_future_unref (futures[N_FETCHES - 1]);
+
+  /* the pool can still be used after cancelling */
+  future = gst_uri_downloader_pool_fetch_uri (pool, uri, NULL, FALSE, FALSE,
+      TRUE);
+  fail_unless (wait_fetched_or_failed (future));
+
+  /* cancelling a done fetch does not drop its data */
+  gst_uri_download_future_cancel (future);
+  fragment = gst_uri_download_future_wait (future, NULL);
+  fail_unless (fragment != NULL);
+  check_fragment (fragment);
+  g_object_unref (fragment);
+  gst_uri_download_future_unref (future);
+
+  gst_object_unref (pool);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_stream)
+{
+  GstUriDownloaderPool *pool;
+  GstUriDownloadFuture *futures[N_FETCHES];
+  GstAdapter *adapters[N_FETCHES];
+  GstFragment *fragment;
+  GstBuffer *buffer;
+  guint i;
+
+  pool = gst_uri_downloader_pool_new (2);
+
+  for (i = 0; i < N_FETCHES; i++) {
+    futures[i] = gst_uri_downloader_pool_fetch_uri (pool, uri, NULL, FALSE,
+        FALSE, TRUE);
+    adapters[i] = gst_adapter_new ();
+  }
+
+  /* the consumers are attached before, while and after the fetches run,
+   * they must get all the data in order either way */
+  for (i = 0; i < N_FETCHES; i++) {
+    gst_uri_download_future_set_data_func (futures[i], collect_data,
+        adapters[i], NULL);
+    fragment = gst_uri_download_future_wait (futures[i], NULL);
+    fail_unless (fragment != NULL);
+
+    /* the data was streamed, not collected in the fragment */
+    fail_unless (gst_fragment_get_buffer (fragment) == NULL);
+    g_object_unref (fragment);
+
+    fail_unless_equals_int (gst_adapter_available (adapters[i]), DATA_SIZE);
+    buffer = gst_adapter_take_buffer (adapters[i], DATA_SIZE);
+    fail_unless (gst_buffer_memcmp (buffer, 0, data, DATA_SIZE) == 0);
+    gst_buffer_unref (buffer);
+
+    g_object_unref (adapters[i]);
+    gst_uri_download_future_unref (futures[i]);
+  }
+
+  gst_object_unref (pool);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_shutdown)
+{
+  GstUriDownloaderPool *pool;
+  GstUriDownloadFuture *futures[N_FETCHES];
+  gint finalized = FALSE;
+  guint i;
+
+  pool = gst_uri_downloader_pool_new (2);
+  g_object_weak_ref (G_OBJECT (pool), pool_finalized, &finalized);
+
+  for (i = 0; i < N_FETCHES; i++)
+    futures[i] = gst_uri_downloader_pool_fetch_uri (pool, uri, NULL, FALSE,
+        FALSE, TRUE);
+
+  /* the requests keep the pool alive until they are done */
+  gst_object_unref (pool);
+  fail_if (g_atomic_int_get (&finalized));
+
+  for (i = 0; i < N_FETCHES; i++) {
+    fail_unless (wait_fetched_or_failed (futures[i]));
+    gst_uri_download_future_unref (futures[i]);
+  }
+
+  /* the last reference might be dropped from one of the pool threads */
+  for (i = 0; i < 500 && !g_atomic_int_get (&finalized); i++)
+    g_usleep (G_USEC_PER_SEC / 100);
+  fail_unless (g_atomic_int_get (&finalized));
+}
+
+GST_END_TEST;
+
+static Suite *
+uridownloaderpool_suite (void)
+{
+  Suite *s = suite_create ("uridownloaderpool");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_checked_fixture (tc_chain, setup, teardown);
+  tcase_add_test (tc_chain, test_concurrent_fetches);
+  tcase_add_test (tc_chain, test_cancel);
+  tcase_add_test (tc_chain, test_stream);
+  tcase_add_test (tc_chain, test_shutdown);
+
+  return s;
+}
+
+GST_CHECK_MAIN (uridownloaderpool);
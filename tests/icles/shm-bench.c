@@ -0,0 +1,269 @@
+/*
+ * shm-bench.c - Throughput of the shm allocator and protocol
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Measures how many blocks per second can be allocated/freed with the
+ * allocator of the shm elements, and how many buffers per second can be
+ * allocated, sent to the clients and acknowledged by them over a real
+ * shm pipe, with a number of buffers in flight like raw video frames
+ * held by the consumers.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <glib.h>
+
+#include "shmpipe.h"
+#include "shmalloc.h"
+
+static gint frame_size = 640 * 480 * 3 / 2;
+static gint in_flight = 100;
+static gint num_clients = 2;
+static gint iterations = 100000;
+static gint burst = 16;
+static gboolean no_ring = FALSE;
+
+static GOptionEntry entries[] = {
+  {"frame-size", 's', 0, G_OPTION_ARG_INT, &frame_size,
+      "Size of the buffers in bytes", NULL},
+  {"in-flight", 'f', 0, G_OPTION_ARG_INT, &in_flight,
+      "Number of buffers held by each client", NULL},
+  {"clients", 'c', 0, G_OPTION_ARG_INT, &num_clients,
+      "Number of clients", NULL},
+  {"iterations", 'n', 0, G_OPTION_ARG_INT, &iterations,
+      "Number of buffers to allocate", NULL},
+  {"burst", 'b', 0, G_OPTION_ARG_INT, &burst,
+      "Number of buffers sent before the clients read them", NULL},
+  {"no-ring", 0, 0, G_OPTION_ARG_NONE, &no_ring,
+      "Only use the socket protocol", NULL},
+  {NULL}
+};
+
+static void
+print_result (const gchar * name, gint64 start)
+{
+  gdouble elapsed = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+
+  g_print ("%-24s %10d in %8.3f s: %12.0f/s\n", name, iterations, elapsed,
+      iterations / elapsed);
+}
+
+static void
+bench_alloc (void)
+{
+  ShmAllocSpace *space;
+  ShmAllocBlock **blocks;
+  gint64 start;
+  gint i;
+
+  /* Room for the buffers in flight, plus some for the variable size ones */
+  space = shm_alloc_space_new ((gsize) frame_size * (in_flight + 2));
+  blocks = g_new0 (ShmAllocBlock *, in_flight);
+
+  /* Fixed size blocks, freed in order */
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++) {
+    gint slot = i % in_flight;
+
+    if (blocks[slot])
+      shm_alloc_space_block_dec (blocks[slot]);
+    blocks[slot] = shm_alloc_space_alloc_block (space, frame_size);
+    g_assert (blocks[slot] != NULL);
+    g_assert (shm_alloc_space_block_get (space,
+            shm_alloc_space_alloc_block_get_offset (blocks[slot])) ==
+        blocks[slot]);
+  }
+  print_result ("alloc/lookup/free fixed", start);
+
+  for (i = 0; i < in_flight; i++) {
+    if (blocks[i])
+      shm_alloc_space_block_dec (blocks[i]);
+    blocks[i] = NULL;
+  }
+
+  /* Variable size blocks, freed in random order */
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++) {
+    gint slot = g_random_int_range (0, in_flight);
+
+    if (blocks[slot])
+      shm_alloc_space_block_dec (blocks[slot]);
+    blocks[slot] = shm_alloc_space_alloc_block (space,
+        g_random_int_range (frame_size / 2, frame_size + 1));
+    g_assert (blocks[slot] != NULL);
+  }
+  print_result ("alloc/free variable", start);
+
+  for (i = 0; i < in_flight; i++) {
+    if (blocks[i])
+      shm_alloc_space_block_dec (blocks[i]);
+  }
+
+  g_free (blocks);
+  shm_alloc_space_free (space);
+}
+
+static gboolean
+fd_readable (int fd)
+{
+  struct pollfd pfd = { fd, POLLIN, 0 };
+
+  return poll (&pfd, 1, 0) > 0 && (pfd.revents & POLLIN);
+}
+
+/* Processes the acks of all clients, like the poll thread of shmsink */
+static void
+writer_recv (ShmPipe * writer, ShmClient ** clients)
+{
+  gint j;
+
+  for (j = 0; j < num_clients; j++) {
+    while (fd_readable (sp_writer_get_client_fd (clients[j])))
+      g_assert (sp_writer_recv (writer, clients[j], NULL, NULL) == 0);
+  }
+}
+
+/* Gets the next buffer, like shmsrc */
+static long int
+client_recv (ShmPipe * reader, char **buf)
+{
+  long int rv;
+
+  *buf = NULL;
+  do {
+    rv = sp_client_recv_pending (reader, buf);
+    if (*buf == NULL && fd_readable (sp_get_fd (reader)))
+      rv = sp_client_recv (reader, buf);
+    g_assert (rv >= 0);
+  } while (*buf == NULL);
+
+  return rv;
+}
+
+static void
+bench_pipe (void)
+{
+  ShmPipe *writer;
+  ShmPipe **readers;
+  ShmClient **clients;
+  GQueue *held;
+  gchar *path;
+  gint64 start;
+  gint i, j, k;
+
+  path = g_strdup_printf ("%s/shm-bench.%d", g_get_tmp_dir (), getpid ());
+  writer = sp_writer_create (path, (gsize) frame_size * (in_flight + burst +
+          2), 0600);
+  g_assert (writer != NULL);
+  sp_writer_set_use_ring (writer, !no_ring);
+
+  readers = g_new0 (ShmPipe *, num_clients);
+  clients = g_new0 (ShmClient *, num_clients);
+  held = g_new0 (GQueue, num_clients);
+
+  for (i = 0; i < num_clients; i++) {
+    readers[i] = sp_client_open (sp_writer_get_path (writer));
+    g_assert (readers[i] != NULL);
+    clients[i] = sp_writer_accept_client (writer);
+    g_assert (clients[i] != NULL);
+  }
+
+  /* Let the clients and the server agree on the protocol */
+  for (k = 0; k < 3; k++) {
+    for (i = 0; i < num_clients; i++) {
+      while (fd_readable (sp_get_fd (readers[i])))
+        g_assert (sp_client_recv (readers[i], NULL) == 0);
+    }
+    writer_recv (writer, clients);
+  }
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i += burst) {
+    for (k = 0; k < burst; k++) {
+      ShmBlock *block = sp_writer_alloc_block (writer, frame_size);
+
+      g_assert (block != NULL);
+      g_assert (sp_writer_send_buf (writer, sp_writer_block_get_buf (block),
+              frame_size, NULL) == num_clients);
+      /* The buffers keep the block alive */
+      sp_writer_free_block (block);
+    }
+
+    for (j = 0; j < num_clients; j++) {
+      for (k = 0; k < burst; k++) {
+        char *buf;
+
+        g_assert (client_recv (readers[j], &buf) == frame_size);
+        g_queue_push_tail (&held[j], buf);
+        if (held[j].length > in_flight)
+          sp_client_recv_finish (readers[j], g_queue_pop_head (&held[j]));
+      }
+    }
+
+    writer_recv (writer, clients);
+  }
+  print_result (no_ring ? "alloc/send/ack socket" : "alloc/send/ack ring",
+      start);
+
+  for (j = 0; j < num_clients; j++) {
+    while (!g_queue_is_empty (&held[j]))
+      sp_client_recv_finish (readers[j], g_queue_pop_head (&held[j]));
+  }
+  writer_recv (writer, clients);
+  g_assert (!sp_writer_pending_writes (writer));
+
+  for (j = 0; j < num_clients; j++)
+    sp_client_close (readers[j]);
+  sp_writer_close (writer, NULL, NULL);
+
+  g_free (held);
+  g_free (clients);
+  g_free (readers);
+  g_free (path);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+
+  ctx = g_option_context_new ("- shm allocator and protocol benchmark");
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_print ("Error initializing: %s\n", err->message);
+    g_clear_error (&err);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (frame_size <= 0 || in_flight <= 0 || num_clients <= 0 || burst <= 0)
+    return 1;
+
+  g_print ("%d bytes buffers, %d in flight, %d clients, bursts of %d\n",
+      frame_size, in_flight, num_clients, burst);
+
+  bench_alloc ();
+  bench_pipe ();
+
+  return 0;
+}